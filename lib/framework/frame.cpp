@@ -30,6 +30,7 @@
 
 #include <physfs.h>
 #include "physfs_ext.h"
+#include "savebatch.h"
 
 #include "frameresource.h"
 #include "input.h"
@@ -324,6 +325,13 @@ bool saveFile(const char *pFileName, const char *pFileData, UDWORD fileSize)
 	PHYSFS_file *pfile;
 	PHYSFS_uint32 size = fileSize;
 
+	if (SaveBatch *batch = saveBatchCurrent())
+	{
+		debug(LOG_WZ, "Queueing write of (%s) of size %d", pFileName, fileSize);
+		batch->addFile(pFileName, std::vector<char>(pFileData, pFileData + fileSize));
+		return true;
+	}
+
 	debug(LOG_WZ, "We are to write (%s) of size %d", pFileName, fileSize);
 	pfile = openSaveFile(pFileName);
 	if (!pfile)
@@ -0,0 +1,121 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file savebatch.cpp
+ *  Deferred file writes, see savebatch.h.
+ */
+
+#include "savebatch.h"
+#include "frame.h"
+#include "file.h"
+#include "physfs_ext.h"
+
+static std::unique_ptr<SaveBatch> currentBatch;
+
+void SaveBatch::addFile(std::string fileName, std::vector<char> data)
+{
+	files.push_back(File{std::move(fileName), std::move(data), nlohmann::json(), false});
+}
+
+void SaveBatch::addJSON(std::string fileName, nlohmann::json obj)
+{
+	files.push_back(File{std::move(fileName), std::vector<char>(), std::move(obj), true});
+}
+
+static bool saveBatchWriteFile(const char *fileName, const char *data, size_t size)
+{
+	PHYSFS_file *fileHandle = PHYSFS_openWrite(fileName);
+	if (fileHandle == nullptr)
+	{
+		debug(LOG_ERROR, "Could not open %s for writing: %s", fileName, WZ_PHYSFS_getLastError());
+		return false;
+	}
+	bool ok = WZ_PHYSFS_writeBytes(fileHandle, data, static_cast<PHYSFS_uint32>(size)) == static_cast<PHYSFS_sint64>(size);
+	if (!ok)
+	{
+		debug(LOG_ERROR, "%s could not write: %s", fileName, WZ_PHYSFS_getLastError());
+	}
+	if (!PHYSFS_close(fileHandle))
+	{
+		debug(LOG_ERROR, "Error closing %s: %s", fileName, WZ_PHYSFS_getLastError());
+		ok = false;
+	}
+	return ok;
+}
+
+bool SaveBatch::format(int jsonIndent, OutputFunction const &output)
+{
+	bool ok = true;
+	for (File &file : files)
+	{
+		if (file.isJSON)
+		{
+			std::string jsonString;
+			try
+			{
+				jsonString = file.json.dump(jsonIndent) + "\n";
+			}
+			catch (const std::exception &e)
+			{
+				debug(LOG_ERROR, "Failed to save JSON to %s with error: %s", file.fileName.c_str(), e.what());
+				ok = false;
+				continue;
+			}
+			file.json = nlohmann::json();
+			ok = output(file.fileName, jsonString.data(), jsonString.size()) && ok;
+		}
+		else
+		{
+			ok = output(file.fileName, file.data.data(), file.data.size()) && ok;
+			file.data = std::vector<char>();
+		}
+	}
+	files.clear();
+	return ok;
+}
+
+bool SaveBatch::write()
+{
+	std::string lastDirectory;
+	return format(4, [&lastDirectory](std::string const &fileName, const char *data, size_t size) {
+		std::string directory = fileName.substr(0, fileName.rfind('/') + 1);
+		if (!directory.empty() && directory != lastDirectory)
+		{
+			PHYSFS_mkdir(directory.c_str());
+			lastDirectory = directory;
+		}
+		return saveBatchWriteFile(fileName.c_str(), data, size);
+	});
+}
+
+void saveBatchBegin()
+{
+	ASSERT(currentBatch == nullptr, "Save batch already open");
+	currentBatch = std::unique_ptr<SaveBatch>(new SaveBatch());
+}
+
+std::unique_ptr<SaveBatch> saveBatchEnd()
+{
+	ASSERT(currentBatch != nullptr, "No save batch open");
+	return std::move(currentBatch);
+}
+
+SaveBatch *saveBatchCurrent()
+{
+	return currentBatch.get();
+}
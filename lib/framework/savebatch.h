@@ -0,0 +1,66 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file savebatch.h
+ *  Deferred file writes.
+ *
+ *  While a batch is open, files written by the main thread with saveFile() or WzConfig are queued in the batch instead
+ *  of being written. JSON is queued unformatted. The batch can then be written later, from any thread, so that
+ *  formatting and disk I/O don't stall the game. Directories are created when the batch is written, so code saving
+ *  into a batch should not create them.
+ */
+
+#ifndef _savebatch_h
+#define _savebatch_h
+
+#include <nlohmann/json.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SaveBatch
+{
+public:
+	void addFile(std::string fileName, std::vector<char> data);
+	void addJSON(std::string fileName, nlohmann::json obj);
+	size_t fileCount() const { return files.size(); }
+
+	typedef std::function<bool (std::string const &fileName, const char *data, size_t size)> OutputFunction;
+
+	/// Formats all queued files, in the order they were queued, passing each to output, and empties the batch. Does not touch any game state, so is safe to call from any thread.
+	bool format(int jsonIndent, OutputFunction const &output);
+	/// Formats and writes all queued files, creating any missing directories.
+	bool write();
+
+private:
+	struct File
+	{
+		std::string fileName;
+		std::vector<char> data;
+		nlohmann::json json;
+		bool isJSON;
+	};
+	std::vector<File> files;
+};
+
+void saveBatchBegin();                      ///< Starts queueing files saved on the main thread.
+std::unique_ptr<SaveBatch> saveBatchEnd();  ///< Stops queueing, and returns everything queued since saveBatchBegin().
+SaveBatch *saveBatchCurrent();              ///< Returns the open batch, or nullptr if files should be written immediately.
+
+#endif // _savebatch_h
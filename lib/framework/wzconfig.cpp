@@ -29,12 +29,19 @@
 #include <sstream>
 #include <limits>
 #include "physfs_ext.h"
+#include "savebatch.h"
 
 WzConfig::~WzConfig()
 {
 	if (mWarning == ReadAndWrite)
 	{
 		ASSERT(mObjStack.empty(), "Some json groups have not been closed, stack size %zu.", mObjStack.size());
+		if (SaveBatch *batch = saveBatchCurrent())
+		{
+			debug(LOG_SAVE, "Queueing %s", mFilename.toUtf8().c_str());
+			batch->addJSON(mFilename.toUtf8(), std::move(mRoot));
+			return;
+		}
 		std::ostringstream stream;
 		stream << mRoot.dump(4) << std::endl;
 		std::string jsonString = stream.str();
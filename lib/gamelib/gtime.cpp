@@ -522,3 +522,9 @@ void setPlayerGameTime(unsigned player, uint32_t time)
 		gameQueueTime[player] = time;
 	}
 }
+
+uint32_t getPlayerGameTime(unsigned player)
+{
+	ASSERT_OR_RETURN(0, player < MAX_GAMEQUEUE_SLOTS, "Unexpected player: %u", player);
+	return gameQueueTime[player];
+}
@@ -202,6 +202,7 @@ void sendPlayerGameTime();                                ///< Sends a GAME_GAME
 void recvPlayerGameTime(NETQUEUE queue);                  ///< Processes a GAME_GAME_TIME message.
 bool checkPlayerGameTime(unsigned player);                ///< Checks that we are not waiting for a GAME_GAME_TIME message from this player. (player can be NET_ALL_PLAYERS.)
 void setPlayerGameTime(unsigned player, uint32_t time);   ///< Sets the player's time.
+uint32_t getPlayerGameTime(unsigned player);              ///< Gets the player's time.
 
 bool gtimeShouldWaitForPlayer(unsigned player);
 
@@ -0,0 +1,140 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/*
+ * timerwheel.cpp
+ *
+ * Level 0 has one slot per tick. A timer in level n waits in the slot for its tick / 64^n, and is moved
+ * down a level (cascaded) when the current tick reaches the start of that slot, so each timer is moved
+ * at most NUM_LEVELS times before it expires.
+ */
+
+#include "lib/framework/frame.h"
+#include "timerwheel.h"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(uint32_t resolution)
+	: resolution(std::max<uint32_t>(resolution, 1))
+	, currentTick(0)
+	, numTimers(0)
+{}
+
+void TimerWheel::reset(uint32_t now)
+{
+	for (auto &level : levels)
+	{
+		for (Slot &slot : level)
+		{
+			slot.clear();
+		}
+	}
+	overflow.clear();
+	due.clear();
+	currentTick = now / resolution;
+	numTimers = 0;
+}
+
+void TimerWheel::add(uint32_t time, uint32_t value)
+{
+	insert({time / resolution, value});
+	++numTimers;
+}
+
+void TimerWheel::insert(Timer const &timer)
+{
+	if ((int32_t)(timer.tick - currentTick) <= 0)
+	{
+		due.push_back(timer);
+		return;
+	}
+
+	uint32_t delta = timer.tick - currentTick;
+	for (unsigned level = 0; level < NUM_LEVELS; ++level)
+	{
+		if (delta < 1u << (LEVEL_BITS * (level + 1)))
+		{
+			levels[level][(timer.tick >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1)].push_back(timer);
+			return;
+		}
+	}
+	overflow.push_back(timer);
+}
+
+void TimerWheel::cascade(Slot &slot)
+{
+	std::swap(slot, scratch);
+	for (Timer const &timer : scratch)
+	{
+		insert(timer);
+	}
+	scratch.clear();
+}
+
+void TimerWheel::advance(uint32_t now, std::vector<uint32_t> &expired)
+{
+	uint32_t targetTick = now / resolution;
+	if ((int32_t)(targetTick - currentTick) < 0)
+	{
+		return;  // Time went backwards.
+	}
+	if (numTimers == 0)
+	{
+		currentTick = targetTick;
+		return;
+	}
+
+	Slot fired;
+	std::swap(fired, due);
+	while (currentTick != targetTick && fired.size() < numTimers)
+	{
+		++currentTick;
+
+		for (unsigned level = 1; level < NUM_LEVELS; ++level)
+		{
+			if ((currentTick & ((1u << (LEVEL_BITS * level)) - 1)) != 0)
+			{
+				break;
+			}
+			cascade(levels[level][(currentTick >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1)]);
+		}
+		if ((currentTick & ((1u << (LEVEL_BITS * NUM_LEVELS)) - 1)) == 0)
+		{
+			cascade(overflow);
+		}
+
+		Slot &slot = levels[0][currentTick & (LEVEL_SLOTS - 1)];
+		fired.insert(fired.end(), slot.begin(), slot.end());
+		fired.insert(fired.end(), due.begin(), due.end());
+		slot.clear();
+		due.clear();
+	}
+	if (currentTick != targetTick)
+	{
+		currentTick = targetTick;  // All timers have expired, so nothing left to cascade.
+	}
+
+	std::sort(fired.begin(), fired.end(), [](Timer const &a, Timer const &b) {
+		return a.tick != b.tick ? (int32_t)(a.tick - b.tick) < 0 : a.value < b.value;
+	});
+	numTimers -= fired.size();
+	for (Timer const &timer : fired)
+	{
+		expired.push_back(timer.value);
+	}
+}
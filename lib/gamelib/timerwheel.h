@@ -0,0 +1,79 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/*! \file timerwheel.h
+ * \brief Hierarchical timer wheel, for scheduling work at given game times.
+ *
+ * Adding a timer and advancing the time both cost O(1) per timer, however many timers are waiting,
+ * so subsystems can schedule deadlines instead of checking every object against gameTime each tick.
+ */
+#ifndef __INCLUDED_LIB_GAMELIB_TIMERWHEEL_H__
+#define __INCLUDED_LIB_GAMELIB_TIMERWHEEL_H__
+
+#include <stdint.h>
+#include <vector>
+
+class TimerWheel
+{
+public:
+	/// Times are rounded down to multiples of resolution. Timers expiring in the same multiple expire together.
+	explicit TimerWheel(uint32_t resolution);
+
+	/// Remove all timers, and set the current time.
+	void reset(uint32_t now);
+
+	/// Add a timer, which expires once the time reaches time. The value is returned when the timer expires.
+	/// The same value may be added several times.
+	void add(uint32_t time, uint32_t value);
+
+	/// Advance the time to now, and append the values of all timers which expired to expired.
+	/// Timers are returned sorted by expiry time (rounded to the resolution), then by value, so the order is deterministic.
+	/// If now is before the current time (such as after loading a savegame), the timers are kept, but none expire.
+	void advance(uint32_t now, std::vector<uint32_t> &expired);
+
+	/// Number of timers which haven't expired yet.
+	size_t size() const { return numTimers; }
+
+private:
+	enum
+	{
+		LEVEL_BITS = 6,
+		LEVEL_SLOTS = 1 << LEVEL_BITS,
+		NUM_LEVELS = 4,  ///< Covers 2^24 multiples of the resolution, longer timers go to the overflow list.
+	};
+
+	struct Timer
+	{
+		uint32_t tick;   ///< Expiry time, divided by resolution.
+		uint32_t value;
+	};
+	typedef std::vector<Timer> Slot;
+
+	void insert(Timer const &timer);
+	void cascade(Slot &slot);
+
+	uint32_t resolution;
+	uint32_t currentTick;
+	size_t numTimers;
+	Slot levels[NUM_LEVELS][LEVEL_SLOTS];
+	Slot overflow;
+	Slot due;        ///< Timers added with an expiry time which has already passed.
+	Slot scratch;    ///< Used by cascade(), kept to avoid allocations.
+};
+
+#endif // __INCLUDED_LIB_GAMELIB_TIMERWHEEL_H__
@@ -0,0 +1,474 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file netbench.cpp
+ *
+ * Loopback network load generator, for measuring the netcode without real players.
+ *
+ * A simulated host accepts the simulated clients on a loopback port, using the same version and codec handshake as
+ * NETallowJoining and NETjoinGame. Every tick, each client sends a game time message and a burst of droid orders,
+ * shaped like the ones sendQueuedDroidInfo produces, and the host relays every message to every client, the way it
+ * relays game queues. Clients time the round trip of their own messages.
+ */
+
+#include "lib/framework/frame.h"
+#include "netbench.h"
+#include "netplay.h"
+#include "netqueue.h"
+#include "netsocket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const unsigned benchTimeout = 5000;  ///< Milliseconds to wait for connections, or for a tick's messages.
+
+struct BenchClient
+{
+	BenchClient()
+	{
+		fromHost.setWillNeverGetMessagesForNet();
+		fromClient.setWillNeverGetMessagesForNet();
+	}
+
+	Socket *socket = nullptr;      ///< Client end of the connection.
+	Socket *hostSocket = nullptr;  ///< Host end of the connection.
+	NetQueue fromHost;             ///< Messages received by the client.
+	NetQueue fromClient;           ///< Messages received by the host, from this client.
+	uint32_t nextSeq = 0;
+	size_t receivedThisTick = 0;
+};
+
+struct BenchStats
+{
+	size_t messagesSent = 0;       ///< By clients.
+	size_t messagesRelayed = 0;    ///< By the host, counting each recipient.
+	size_t hostRawBytes = 0;
+	size_t hostUncompressedBytes = 0;
+	size_t clientRawBytes = 0;
+	size_t clientUncompressedBytes = 0;
+	size_t maxHostPendingBytes = 0;
+	uint64_t hostMicroseconds = 0;
+	std::vector<uint32_t> latencies;  ///< Microseconds.
+};
+
+static uint64_t benchMicroseconds(BenchClock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(BenchClock::now() - start).count();
+}
+
+static void push32(std::vector<uint8_t> &data, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		data.push_back(value >> (i * 8));
+	}
+}
+
+static uint32_t read32(std::vector<uint8_t> const &data, size_t pos)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4 && pos + i < data.size(); ++i)
+	{
+		value |= uint32_t(data[pos + i]) << (i * 8);
+	}
+	return value;
+}
+
+static bool benchConnect(Socket *listenSocket, SocketAddress *addr, BenchClient &client, SocketCodecType codec)
+{
+	client.socket = socketOpen(addr, benchTimeout);
+	if (client.socket == nullptr)
+	{
+		debug(LOG_ERROR, "Couldn't connect to the simulated host: %s", strSockError(getSockErr()));
+		return false;
+	}
+	BenchClock::time_point start = BenchClock::now();
+	while ((client.hostSocket = socketAccept(listenSocket)) == nullptr)
+	{
+		if (benchMicroseconds(start) > benchTimeout * 1000)
+		{
+			debug(LOG_ERROR, "Simulated host didn't accept the connection.");
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// Version, then result and codec, as in NETjoinGame and NETallowJoining.
+	uint32_t version[2] = {htonl(NETGetMajorVersion()), htonl(NETGetMinorVersion())};
+	uint32_t hostVersion[2];
+	if (writeAll(client.socket, version, sizeof(version)) == SOCKET_ERROR
+	    || readAll(client.hostSocket, hostVersion, sizeof(hostVersion), benchTimeout) != sizeof(hostVersion)
+	    || !NETisCorrectVersion(ntohl(hostVersion[0]), ntohl(hostVersion[1])))
+	{
+		debug(LOG_ERROR, "Version handshake failed.");
+		return false;
+	}
+	uint32_t result[2] = {htonl(ERROR_NOERROR), htonl(static_cast<uint32_t>(codec))};
+	uint32_t clientResult[2];
+	if (writeAll(client.hostSocket, result, sizeof(result)) == SOCKET_ERROR
+	    || readAll(client.socket, clientResult, sizeof(clientResult), benchTimeout) != sizeof(clientResult)
+	    || ntohl(clientResult[0]) != ERROR_NOERROR)
+	{
+		debug(LOG_ERROR, "Codec handshake failed.");
+		return false;
+	}
+	socketBeginCompression(client.hostSocket, codec);
+	socketBeginCompression(client.socket, static_cast<SocketCodecType>(ntohl(clientResult[1])));
+	return true;
+}
+
+/// Queues a message with a header identifying the sender and send time, followed by the body.
+static void benchSend(BenchClient &client, uint32_t clientIndex, uint8_t type, std::vector<uint8_t> const &body, uint32_t now, BenchStats &stats)
+{
+	NetMessage message(type);
+	message.data.reserve(12 + body.size());
+	push32(message.data, clientIndex);
+	push32(message.data, client.nextSeq++);
+	push32(message.data, now);
+	message.data.insert(message.data.end(), body.begin(), body.end());
+
+	std::vector<uint8_t> raw;
+	message.rawDataAppendToVector(raw);
+	size_t rawBytes = 0;
+	writeAll(client.socket, raw.data(), raw.size(), &rawBytes);
+	stats.clientRawBytes += rawBytes;
+	stats.clientUncompressedBytes += raw.size();
+	++stats.messagesSent;
+}
+
+/// Sends this tick's messages from one client, returns the number of messages.
+static size_t benchClientTick(BenchClient &client, uint32_t clientIndex, uint32_t tick, std::mt19937 &rng, BenchClock::time_point start, BenchStats &stats)
+{
+	size_t sent = 0;
+	uint32_t now = benchMicroseconds(start);
+
+	// Game time, with the tick number and a checksum-sized payload.
+	std::vector<uint8_t> body;
+	push32(body, tick);
+	push32(body, rng());
+	benchSend(client, clientIndex, GAME_GAME_TIME, body, now, stats);
+	++sent;
+
+	// Droid orders: order header, then the count and deltas between droid ids.
+	unsigned bursts = std::uniform_int_distribution<unsigned>(0, 4)(rng);
+	for (unsigned burst = 0; burst < bursts; ++burst)
+	{
+		body.clear();
+		body.push_back(std::uniform_int_distribution<unsigned>(0, 40)(rng));  // Order type.
+		push32(body, std::uniform_int_distribution<uint32_t>(0, 256 * 128)(rng));  // Position.
+		push32(body, std::uniform_int_distribution<uint32_t>(0, 256 * 128)(rng));
+		push32(body, 0);  // Target id.
+		unsigned droids = std::uniform_int_distribution<unsigned>(1, 40)(rng);
+		body.push_back(droids);
+		for (unsigned droid = 0; droid < droids; ++droid)
+		{
+			body.push_back(std::uniform_int_distribution<unsigned>(1, 20)(rng));  // Small deltas encode to one byte.
+		}
+		benchSend(client, clientIndex, GAME_DROIDINFO, body, now, stats);
+		++sent;
+	}
+
+	size_t rawBytes = 0;
+	socketFlush(client.socket, clientIndex, &rawBytes);
+	stats.clientRawBytes += rawBytes;
+	return sent;
+}
+
+/// Reads once from each ready socket of the set into its queue. Returns false on errors.
+static bool benchReceive(SocketSet *set, std::vector<std::unique_ptr<BenchClient>> &clients, bool host, unsigned timeout)
+{
+	int ready = checkSockets(set, timeout);
+	if (ready == SOCKET_ERROR)
+	{
+		return false;
+	}
+	if (ready == 0)
+	{
+		return true;
+	}
+
+	uint8_t buffer[16384];
+	for (auto &client : clients)
+	{
+		Socket *sock = host ? client->hostSocket : client->socket;
+		if (!socketReadReady(sock))
+		{
+			continue;
+		}
+		ssize_t size = readNoInt(sock, buffer, sizeof(buffer));
+		if (size == SOCKET_ERROR || (size == 0 && socketReadDisconnected(sock)))
+		{
+			debug(LOG_ERROR, "Simulated connection broken: %s", strSockError(getSockErr()));
+			return false;
+		}
+		(host ? client->fromClient : client->fromHost).writeRawData(buffer, size);
+	}
+	return true;
+}
+
+static uint32_t benchPercentile(std::vector<uint32_t> const &sorted, double percentile)
+{
+	if (sorted.empty())
+	{
+		return 0;
+	}
+	return sorted[std::min<size_t>(sorted.size() - 1, sorted.size() * percentile)];
+}
+
+static void benchShutdown(std::vector<std::unique_ptr<BenchClient>> &clients, SocketSet *hostSet, SocketSet *clientSet, Socket *listenSocket, SocketAddress *addr)
+{
+	for (auto &client : clients)
+	{
+		if (client->socket != nullptr)
+		{
+			socketClose(client->socket);
+		}
+		if (client->hostSocket != nullptr)
+		{
+			socketClose(client->hostSocket);
+		}
+	}
+	deleteSocketSet(hostSet);
+	deleteSocketSet(clientSet);
+	if (listenSocket != nullptr)
+	{
+		socketClose(listenSocket);
+	}
+	if (addr != nullptr)
+	{
+		deleteSocketAddress(addr);
+	}
+	SOCKETshutdown();
+}
+
+int NETbenchLoopback(NetBenchOptions const &options)
+{
+	ASSERT_OR_RETURN(1, options.clients > 0 && options.codec < SocketCodecType::Count, "Invalid benchmark options");
+
+	SOCKETinit();
+	std::vector<std::unique_ptr<BenchClient>> clients;
+	SocketSet *hostSet = allocSocketSet();
+	SocketSet *clientSet = allocSocketSet();
+	Socket *listenSocket = socketListen(options.port);
+	SocketAddress *addr = resolveHost("127.0.0.1", options.port);
+	if (listenSocket == nullptr || addr == nullptr)
+	{
+		debug(LOG_ERROR, "Couldn't listen on loopback port %u: %s", options.port, strSockError(getSockErr()));
+		benchShutdown(clients, hostSet, clientSet, listenSocket, addr);
+		return 1;
+	}
+
+	for (unsigned i = 0; i < options.clients; ++i)
+	{
+		clients.emplace_back(new BenchClient);
+		if (!benchConnect(listenSocket, addr, *clients.back(), options.codec))
+		{
+			benchShutdown(clients, hostSet, clientSet, listenSocket, addr);
+			return 1;
+		}
+		SocketSet_AddSocket(hostSet, clients.back()->hostSocket);
+		SocketSet_AddSocket(clientSet, clients.back()->socket);
+	}
+
+	BenchStats stats;
+	NETresetMessageStats();
+	std::mt19937 rng(options.seed);
+	BenchClock::time_point start = BenchClock::now();
+	std::clock_t cpuStart = std::clock();
+
+	for (uint32_t tick = 0; tick < options.ticks; ++tick)
+	{
+		size_t messages = 0;
+		for (unsigned i = 0; i < clients.size(); ++i)
+		{
+			messages += benchClientTick(*clients[i], i, tick, rng, start, stats);
+			clients[i]->receivedThisTick = 0;
+		}
+
+		// Host: relay everything to everyone, then flush once, like NETflush.
+		size_t relayed = 0;
+		BenchClock::time_point tickStart = BenchClock::now();
+		while (relayed < messages)
+		{
+			if (benchMicroseconds(tickStart) > benchTimeout * 1000 || !benchReceive(hostSet, clients, true, 1))
+			{
+				debug(LOG_ERROR, "Simulated host stopped receiving at tick %" PRIu32 ".", tick);
+				benchShutdown(clients, hostSet, clientSet, listenSocket, addr);
+				return 1;
+			}
+			BenchClock::time_point hostStart = BenchClock::now();
+			for (auto &from : clients)
+			{
+				for (; from->fromClient.haveMessage(); from->fromClient.popMessage())
+				{
+					SocketSharedWrite shared(from->fromClient.getMessage().framed());
+					for (auto &to : clients)
+					{
+						size_t rawBytes = 0;
+						writeAllShared(to->hostSocket, shared, &rawBytes);
+						stats.hostRawBytes += rawBytes;
+						stats.hostUncompressedBytes += shared.size();
+						++stats.messagesRelayed;
+					}
+					++relayed;
+				}
+			}
+			stats.hostMicroseconds += benchMicroseconds(hostStart);
+		}
+		BenchClock::time_point flushStart = BenchClock::now();
+		for (auto &client : clients)
+		{
+			size_t rawBytes = 0;
+			socketFlush(client->hostSocket, 0, &rawBytes);
+			stats.hostRawBytes += rawBytes;
+			stats.maxHostPendingBytes = std::max(stats.maxHostPendingBytes, socketPendingWriteBytes(client->hostSocket));
+		}
+		stats.hostMicroseconds += benchMicroseconds(flushStart);
+
+		// Clients: wait for every relayed message, timing our own.
+		size_t pendingClients = clients.size();
+		while (pendingClients > 0)
+		{
+			if (benchMicroseconds(tickStart) > benchTimeout * 1000 || !benchReceive(clientSet, clients, false, 1))
+			{
+				debug(LOG_ERROR, "Simulated clients stopped receiving at tick %" PRIu32 ".", tick);
+				benchShutdown(clients, hostSet, clientSet, listenSocket, addr);
+				return 1;
+			}
+			uint32_t now = benchMicroseconds(start);
+			pendingClients = 0;
+			for (unsigned i = 0; i < clients.size(); ++i)
+			{
+				BenchClient &client = *clients[i];
+				for (; client.fromHost.haveMessage(); client.fromHost.popMessage())
+				{
+					NetMessage const &message = client.fromHost.getMessage();
+					if (read32(message.data, 0) == i)
+					{
+						stats.latencies.push_back(now - read32(message.data, 8));
+					}
+					++client.receivedThisTick;
+				}
+				pendingClients += client.receivedThisTick < messages;
+			}
+		}
+	}
+
+	double wallSeconds = benchMicroseconds(start) / 1e6;
+	double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	std::sort(stats.latencies.begin(), stats.latencies.end());
+
+	fprintf(stdout, "netbench: %u clients, %u ticks, codec %s\n", options.clients, options.ticks, socketCodecName(options.codec));
+	fprintf(stdout, "netbench: messages sent by clients %zu, delivered by host %zu\n", stats.messagesSent, stats.messagesRelayed);
+	fprintf(stdout, "netbench: host sent %zu bytes, %zu uncompressed (ratio %.3f)\n", stats.hostRawBytes, stats.hostUncompressedBytes, stats.hostUncompressedBytes != 0 ? double(stats.hostRawBytes) / stats.hostUncompressedBytes : 0.);
+	fprintf(stdout, "netbench: clients sent %zu bytes, %zu uncompressed\n", stats.clientRawBytes, stats.clientUncompressedBytes);
+	fprintf(stdout, "netbench: host processing %.3f ms total, %.1f us per tick\n", stats.hostMicroseconds / 1e3, double(stats.hostMicroseconds) / std::max(options.ticks, 1u));
+	fprintf(stdout, "netbench: round trip latency us: p50 %" PRIu32 ", p95 %" PRIu32 ", p99 %" PRIu32 ", max %" PRIu32 "\n", benchPercentile(stats.latencies, 0.5), benchPercentile(stats.latencies, 0.95), benchPercentile(stats.latencies, 0.99), stats.latencies.empty() ? 0 : stats.latencies.back());
+	fprintf(stdout, "netbench: max host pending write bytes %zu\n", stats.maxHostPendingBytes);
+	NetMessageStats messageStats = NETgetMessageStats();
+	fprintf(stdout, "netbench: message frames built %" PRIu64 " (%" PRIu64 " bytes), shared %" PRIu64 ", queue copies %" PRIu64 " (%" PRIu64 " bytes), moves %" PRIu64 "\n", messageStats.framesBuilt, messageStats.framesBuiltBytes, messageStats.framesShared, messageStats.queueCopies, messageStats.queueCopiedBytes, messageStats.queueMoves);
+	fprintf(stdout, "netbench: wall %.3f s, process CPU %.3f s\n", wallSeconds, cpuSeconds);
+	fflush(stdout);
+
+	benchShutdown(clients, hostSet, clientSet, listenSocket, addr);
+	return 0;
+}
+
+/// Runs fn over all the values several times, and returns the best time per value, in nanoseconds.
+template<typename Fn>
+static double benchVarintPass(size_t values, Fn fn)
+{
+	double best = 0;
+	for (int pass = 0; pass < 5; ++pass)
+	{
+		BenchClock::time_point start = BenchClock::now();
+		fn();
+		double ns = std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / std::max<size_t>(values, 1);
+		best = pass == 0 ? ns : std::min(best, ns);
+	}
+	return best;
+}
+
+int NETbenchVarint(NetBenchOptions const &options)
+{
+	// Mostly small values, like counts, player numbers and message lengths, with some larger ones, like object ids.
+	std::mt19937 rng(options.seed);
+	std::vector<uint32_t> values(options.varintValues);
+	for (uint32_t &value : values)
+	{
+		unsigned kind = rng() % 10;
+		value = kind < 6 ? rng() % encodedSingleByteLimit_uint32_t : kind < 9 ? rng() % 65536 : rng();
+	}
+
+	std::vector<uint8_t> bytewise(values.size() * encodedMaxLength_uint32_t);
+	std::vector<uint8_t> whole(values.size() * encodedMaxLength_uint32_t);
+	size_t bytewiseSize = 0, wholeSize = 0;
+	double encodeBytewiseNs = benchVarintPass(values.size(), [&]() {
+		uint8_t *out = bytewise.data();
+		for (uint32_t value : values)
+		{
+			uint32_t v = value;
+			for (unsigned n = 0; encode_uint32_t(*out++, v, n); ++n) {}
+		}
+		bytewiseSize = out - bytewise.data();
+	});
+	double encodeWholeNs = benchVarintPass(values.size(), [&]() {
+		uint8_t *out = whole.data();
+		for (uint32_t value : values)
+		{
+			out += encodeAll_uint32_t(value, out);
+		}
+		wholeSize = out - whole.data();
+	});
+	bool encodedSame = bytewiseSize == wholeSize && std::equal(bytewise.begin(), bytewise.begin() + bytewiseSize, whole.begin());
+
+	std::vector<uint32_t> decodedBytewise(values.size()), decodedWhole(values.size());
+	double decodeBytewiseNs = benchVarintPass(values.size(), [&]() {
+		uint8_t const *in = whole.data();
+		for (uint32_t &value : decodedBytewise)
+		{
+			value = 0;
+			for (unsigned n = 0; decode_uint32_t(*in++, value, n); ++n) {}
+		}
+	});
+	double decodeWholeNs = benchVarintPass(values.size(), [&]() {
+		uint8_t const *in = whole.data();
+		uint8_t const *end = whole.data() + wholeSize;
+		for (uint32_t &value : decodedWhole)
+		{
+			in += decodeAll_uint32_t(in, end - in, value);
+		}
+	});
+	bool decodedSame = decodedBytewise == values && decodedWhole == values;
+
+	fprintf(stdout, "netbench: varint %zu values, %zu encoded bytes\n", values.size(), wholeSize);
+	fprintf(stdout, "netbench: varint encode %.2f ns per value byte by byte, %.2f ns whole\n", encodeBytewiseNs, encodeWholeNs);
+	fprintf(stdout, "netbench: varint decode %.2f ns per value byte by byte, %.2f ns whole\n", decodeBytewiseNs, decodeWholeNs);
+	fprintf(stdout, "netbench: varint results %s\n", encodedSame && decodedSame ? "identical" : "DIFFERENT");
+	fflush(stdout);
+
+	return encodedSame && decodedSame ? 0 : 1;
+}
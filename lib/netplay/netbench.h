@@ -0,0 +1,45 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file netbench.h
+ *
+ * Loopback network load generator, for measuring the netcode without real players.
+ */
+#ifndef _net_bench_h
+#define _net_bench_h
+
+#include "lib/framework/types.h"
+#include "netsocketcodec.h"
+
+struct NetBenchOptions
+{
+	unsigned clients = 10;                          ///< Number of simulated clients.
+	unsigned ticks = 600;                           ///< Number of game ticks to simulate.
+	unsigned port = 2101;                           ///< Loopback port for the simulated host.
+	SocketCodecType codec = SocketCodecType::Zlib;  ///< Codec used by all connections, including loopback ones.
+	uint32_t seed = 1;                              ///< Seed for the simulated orders.
+	unsigned varintValues = 0;                      ///< If not 0, run NETbenchVarint() with this many values, instead of NETbenchLoopback().
+};
+
+/// Runs a simulated host and clients over loopback sockets, and prints statistics to stdout. Returns 0 on success.
+int NETbenchLoopback(NetBenchOptions const &options);
+/// Times encoding and decoding uint32_t values byte by byte and whole, checks they agree, and prints the results to stdout. Returns 0 on success.
+int NETbenchVarint(NetBenchOptions const &options);
+
+#endif //_net_bench_h
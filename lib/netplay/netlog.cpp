@@ -154,6 +154,12 @@ void NETlogPacket(uint8_t type, uint32_t size, bool received)
 	packetsize[received][type] += size;
 }
 
+void NETgetPacketStats(uint8_t type, bool received, uint32_t &count, uint32_t &bytes)
+{
+	count = packetcount[received][type];
+	bytes = packetsize[received][type];
+}
+
 bool NETlogEntry(const char *str, UDWORD a, UDWORD b)
 {
 	static const char star_line[] = "************************************************************\n";
@@ -28,5 +28,6 @@ bool NETstartLogging();
 bool NETstopLogging();
 WZ_DECL_NONNULL(1) bool NETlogEntry(const char *str, UDWORD a, UDWORD b);
 void NETlogPacket(uint8_t type, uint32_t size, bool received);
+void NETgetPacketStats(uint8_t type, bool received, uint32_t &count, uint32_t &bytes);  ///< Totals for a message type since NETinit, even when not logging to a file.
 
 #endif // _netlog_h
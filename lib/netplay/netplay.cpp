@@ -43,6 +43,7 @@
 #include <atomic>
 #include <limits>
 #include <deque>
+#include <unordered_map>
 #include <sodium.h>
 #include <re2/re2.h>
 
@@ -76,6 +77,7 @@
 #include "src/loadsave.h"
 #include "src/activity.h"
 #include "src/stdinreader.h"
+#include "src/main.h"
 
 #if defined (WZ_OS_MAC)
 # include "lib/framework/cocoa_wrapper.h"
@@ -89,6 +91,7 @@
 char masterserver_name[255] = {'\0'};
 static unsigned int masterserver_port = 0, gameserver_port = 0;
 static bool bJoinPrefTryIPv6First = true;
+static SocketCodecType hostCodec = SocketCodecType::Zlib;
 
 // This is for command line argument override
 // Disables port saving and reading from/to config
@@ -145,6 +148,10 @@ struct NETSTATS  // data regarding the last one second or so.
 	Statistic       rawBytes;               // Number of actual bytes, in about 1 sec.
 	Statistic       uncompressedBytes;      // Number of bytes sent, before compression, in about 1 sec.
 	Statistic       packets;                // Number of calls to writeAll, in about 1 sec.
+	Statistic       codecMicroseconds;      // Time spent encoding and decoding, in about 1 sec.
+	Statistic       flushes;                // Number of socket flushes which sent something, in about 1 sec.
+	Statistic       batches;                // Number of batches of broadcast messages sent, in about 1 sec.
+	Statistic       batchedMessages;        // Number of messages in those batches, in about 1 sec.
 };
 
 struct NET_PLAYER_DATA
@@ -272,10 +279,21 @@ static int32_t          NetGameFlags[4] = { 0, 0, 0, 0 };
 char iptoconnect[PATH_MAX] = "\0"; // holds IP/hostname from command line
 bool cliConnectToIpAsSpectator = false; // for cli option
 
-static NETSTATS nStats              = {{0, 0}, {0, 0}, {0, 0}};
-static NETSTATS nStatsLastSec       = {{0, 0}, {0, 0}, {0, 0}};
-static NETSTATS nStatsSecondLastSec = {{0, 0}, {0, 0}, {0, 0}};
-static const NETSTATS nZeroStats    = {{0, 0}, {0, 0}, {0, 0}};
+static NETSTATS nStats{};
+static NETSTATS nStatsLastSec{};
+static NETSTATS nStatsSecondLastSec{};
+static const NETSTATS nZeroStats{};
+
+/// In game, the host collects consecutive broadcasts with the same exclusion until the next NETflush, or until something else is sent,
+/// so that each batch is compressed once and written once per socket, instead of once per message.
+struct BroadcastBatch
+{
+	std::vector<uint8_t> data;
+	uint8_t exclude = NET_ALL_PLAYERS;
+	size_t messages = 0;
+};
+static BroadcastBatch broadcastBatch;
+static void NETflushBroadcastBatch();
 static int nStatsLastUpdateTime = 0;
 
 unsigned NET_PlayerConnectionStatus[CONNECTIONSTATUS_NORMAL][MAX_CONNECTED_PLAYERS];
@@ -1581,6 +1599,7 @@ int NETclose()
 
 	debug(LOG_NET, "Terminating sockets.");
 
+	NETflushBroadcastBatch();
 	NetPlay.isHost = false;
 	server_not_there = false;
 	allow_joining = false;
@@ -1663,9 +1682,22 @@ size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal)
 	case NetStatisticRawBytes:          statsType = &NETSTATS::rawBytes;          break;
 	case NetStatisticUncompressedBytes: statsType = &NETSTATS::uncompressedBytes; break;
 	case NetStatisticPackets:           statsType = &NETSTATS::packets;           break;
+	case NetStatisticCodecMicroseconds: statsType = &NETSTATS::codecMicroseconds; break;
+	case NetStatisticFlushes:           statsType = &NETSTATS::flushes;           break;
+	case NetStatisticBatches:           statsType = &NETSTATS::batches;           break;
+	case NetStatisticBatchedMessages:   statsType = &NETSTATS::batchedMessages;   break;
 	default: ASSERT(false, " "); return 0;
 	}
 
+	// The codecs keep their own totals.
+	nStats.codecMicroseconds = {0, 0};
+	for (size_t codec = 0; codec < static_cast<size_t>(SocketCodecType::Count); ++codec)
+	{
+		SocketCodecStats const &codecStats = socketGetCodecStats(static_cast<SocketCodecType>(codec));
+		nStats.codecMicroseconds.sent += codecStats.encodeMicroseconds;
+		nStats.codecMicroseconds.received += codecStats.decodeMicroseconds;
+	}
+
 	int time = wzGetTicks();
 	if ((unsigned)(time - nStatsLastUpdateTime) >= (unsigned)GAME_TICKS_PER_SEC)
 	{
@@ -1681,6 +1713,73 @@ size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal)
 	return nStatsLastSec.*statsType.*statisticType - nStatsSecondLastSec.*statsType.*statisticType;
 }
 
+size_t NETgetPendingWriteBytes(unsigned player)
+{
+	ASSERT_OR_RETURN(0, player < MAX_CONNECTED_PLAYERS, "Bad player %u", player);
+	if (connected_bsocket[player] == nullptr)
+	{
+		return 0;
+	}
+	return socketPendingWriteBytes(connected_bsocket[player]);
+}
+
+
+/// Writes the pending batch of broadcasts to all players, see BroadcastBatch. Must be called before writing anything else to the player sockets, to keep the order.
+static void NETflushBroadcastBatch()
+{
+	if (broadcastBatch.messages == 0)
+	{
+		return;
+	}
+
+	uint8_t exclude = broadcastBatch.exclude;
+	size_t messages = broadcastBatch.messages;
+	SocketSharedWrite sharedData(std::move(broadcastBatch.data));
+	broadcastBatch.data = std::vector<uint8_t>();
+	broadcastBatch.messages = 0;
+
+	ssize_t rawLen = sharedData.size();
+	for (uint8_t player = 0; player < MAX_CONNECTED_PLAYERS; ++player)
+	{
+		if (connected_bsocket[player] != nullptr && player != exclude)
+		{
+			size_t compressedRawLen;
+			ssize_t result = writeAllShared(connected_bsocket[player], sharedData, &compressedRawLen);
+			if (result == rawLen)
+			{
+				nStats.rawBytes.sent          += compressedRawLen;
+				nStats.uncompressedBytes.sent += rawLen;
+				nStats.packets.sent           += messages;  // Per message, like unbatched sends.
+			}
+			else if (result == SOCKET_ERROR)
+			{
+				// Write error, most likely client disconnect.
+				debug(LOG_ERROR, "Failed to send %zu messages (rawLen: %zu) to %" PRIu8 ": %s", messages, sharedData.size(), player, strSockError(getSockErr()));
+				NETlogEntry("client disconnect?", SYNC_FLAG, player);
+				NETplayerClientDisconnect(player);
+			}
+		}
+	}
+	nStats.batches.sent         += 1;
+	nStats.batchedMessages.sent += messages;
+}
+
+/// Writes the raw data of the message to the socket, without copying it into a temporary buffer first.
+static ssize_t writeMessage(Socket *sock, NetMessage const &message, size_t *compressedRawLen)
+{
+	uint8_t header[NetMessage::maxRawHeaderLength];
+	size_t headerLen = message.rawHeader(header);
+	size_t compressedHeaderLen = 0;
+	ssize_t result = writeAll(sock, header, headerLen, &compressedHeaderLen);
+	if (result == SOCKET_ERROR)
+	{
+		*compressedRawLen = compressedHeaderLen;
+		return result;
+	}
+	result = writeAll(sock, message.data.data(), message.data.size(), compressedRawLen);
+	*compressedRawLen += compressedHeaderLen;
+	return result == SOCKET_ERROR ? result : static_cast<ssize_t>(headerLen + message.data.size());
+}
 
 // ////////////////////////////////////////////////////////////////////////
 // Send a message to a player, option to guarantee message
@@ -1718,21 +1817,61 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 	{
 		int firstPlayer = player == NET_ALL_PLAYERS ? 0                         : player;
 		int lastPlayer  = player == NET_ALL_PLAYERS ? MAX_CONNECTED_PLAYERS - 1 : player;
+		if (firstPlayer != lastPlayer && GetGameMode() == GS_NORMAL && !ingame.localJoiningInProgress)
+		{
+			// In a running game, so batch the broadcast until the next NETflush. Lobby broadcasts are sent straight away, as before.
+			if (broadcastBatch.messages != 0 && broadcastBatch.exclude != queue.exclude)
+			{
+				NETflushBroadcastBatch();
+			}
+			broadcastBatch.exclude = queue.exclude;
+			message->rawDataAppendToVector(broadcastBatch.data);
+			++broadcastBatch.messages;
+			return true;
+		}
+		NETflushBroadcastBatch();
+		if (firstPlayer != lastPlayer)
+		{
+			// Broadcast, so encode and compress the message once, instead of once per player.
+			SocketSharedWrite sharedData(message->framed());
+			ssize_t rawLen = sharedData.size();
+			for (player = firstPlayer; player <= lastPlayer; ++player)
+			{
+				if (sockets[player] != nullptr && player != queue.exclude)
+				{
+					size_t compressedRawLen;
+					result = writeAllShared(sockets[player], sharedData, &compressedRawLen);
+					if (result == rawLen)
+					{
+						nStats.rawBytes.sent          += compressedRawLen;
+						nStats.uncompressedBytes.sent += rawLen;
+						nStats.packets.sent           += 1;
+					}
+					else if (result == SOCKET_ERROR)
+					{
+						// Write error, most likely client disconnect.
+						debug(LOG_ERROR, "Failed to send message (type: %" PRIu8 ", rawLen: %zu, compressedRawLen: %zu) to %" PRIu8 ": %s", message->type, message->rawLen(), compressedRawLen, player, strSockError(getSockErr()));
+						NETlogEntry("client disconnect?", SYNC_FLAG, player);
+						NETplayerClientDisconnect(player);
+					}
+				}
+			}
+			return true;
+		}
 		for (player = firstPlayer; player <= lastPlayer; ++player)
 		{
 			// We are the host, send directly to player.
 			if (sockets[player] != nullptr && player != queue.exclude)
 			{
-				uint8_t *rawData = message->rawDataDup();
-				if (!rawData)
+				if (isTmpQueue && socketWriteBackedUp(sockets[player]))
 				{
-					debug(LOG_FATAL, "Failed to allocate raw data (message type: %" PRIu8 ", player: %d)", message->type, player);
-					abort();
+					// Not yet a player, and not reading what we send, so don't buffer any more for it.
+					debug(LOG_NET, "Not sending message (type: %" PRIu8 ") to backed up pending connection %d", message->type, player);
+					continue;
 				}
 				ssize_t rawLen   = message->rawLen();
 				size_t compressedRawLen;
-				result = writeAll(sockets[player], rawData, rawLen, &compressedRawLen);
-				delete[] rawData;  // Done with the data.
+				result = writeMessage(sockets[player], *message, &compressedRawLen);
 
 				if (result == rawLen)
 				{
@@ -1759,11 +1898,9 @@ bool NETsend(NETQUEUE queue, NetMessage const *message)
 		// We are a client, send directly to player, who happens to be the host.
 		if (bsocket)
 		{
-			uint8_t *rawData = message->rawDataDup();
 			ssize_t rawLen   = message->rawLen();
 			size_t compressedRawLen;
-			result = writeAll(bsocket, rawData, rawLen, &compressedRawLen);
-			delete[] rawData;  // Done with the data.
+			result = writeMessage(bsocket, *message, &compressedRawLen);
 
 			if (result == rawLen)
 			{
@@ -1810,6 +1947,7 @@ void NETflush()
 	}
 
 	NETflushGameQueues();
+	NETflushBroadcastBatch();
 
 	size_t compressedRawLen;
 	if (NetPlay.isHost)
@@ -1821,6 +1959,7 @@ void NETflush()
 			{
 				socketFlush(connected_bsocket[player], player, &compressedRawLen);
 				nStats.rawBytes.sent += compressedRawLen;
+				nStats.flushes.sent  += compressedRawLen != 0;
 			}
 		}
 		for (int player = 0; player < MAX_TMP_SOCKETS; ++player)
@@ -1830,6 +1969,7 @@ void NETflush()
 			{
 				socketFlush(tmp_socket[player], std::numeric_limits<uint8_t>::max(), &compressedRawLen);
 				nStats.rawBytes.sent += compressedRawLen;
+				nStats.flushes.sent  += compressedRawLen != 0;
 			}
 		}
 	}
@@ -1839,6 +1979,7 @@ void NETflush()
 		{
 			socketFlush(bsocket, NetPlay.hostPlayer, &compressedRawLen);
 			nStats.rawBytes.sent += compressedRawLen;
+			nStats.flushes.sent  += compressedRawLen != 0;
 		}
 	}
 }
@@ -1861,6 +2002,7 @@ static bool swapPlayerIndexes(uint32_t playerIndexA, uint32_t playerIndexB)
 	NETend();
 
 	// Then swap the networking stuff for these slots
+	NETflushBroadcastBatch();
 	std::swap(connected_bsocket[playerIndexA], connected_bsocket[playerIndexB]);
 	// should be no need to call SocketSet_AddSocket, since should already be in the socket_set
 	NETswapQueues(NETnetQueue(playerIndexA), NETnetQueue(playerIndexB));
@@ -2357,7 +2499,7 @@ static bool NETprocessSystemMessage(NETQUEUE playerQueue, uint8_t type)
 
 			uint8_t player = 0;
 			uint32_t num = 0, n;
-			NetMessage const *message = nullptr;
+			NetMessage message;
 
 			// Encoded in NETprocessSystemMessage in nettypes.cpp.
 			NETbeginDecode(playerQueue, NET_SHARE_GAME_QUEUE);
@@ -2374,11 +2516,8 @@ static bool NETprocessSystemMessage(NETQUEUE playerQueue, uint8_t type)
 			{
 				NETnetMessage(&message);
 
-				NETinsertMessageFromNet(NETgameQueue(player), message);
-				NETlogPacket(message->type, static_cast<uint32_t>(message->rawLen()), true);
-
-				delete message;
-				message = nullptr;
+				NETlogPacket(message.type, static_cast<uint32_t>(message.rawLen()), true);
+				NETinsertMessageFromNet(NETgameQueue(player), std::move(message));
 			}
 			if (!NETend())
 			{
@@ -3757,10 +3896,16 @@ static void NETallowJoining()
 				}
 				else if (NETisCorrectVersion(major, minor))
 				{
+					// Tell the client which codec to use. Nothing to gain from compressing data to ourselves.
+					SocketCodecType codec = socketIsLoopback(tmp_socket[i]) ? SocketCodecType::None : hostCodec;
+					char resultBuf[sizeof(uint32_t) * 2];
 					result = htonl(ERROR_NOERROR);
-					memcpy(&buffer, &result, sizeof(result));
-					writeAll(tmp_socket[i], &buffer, sizeof(result));
-					socketBeginCompression(tmp_socket[i]);
+					memcpy(resultBuf, &result, sizeof(result));
+					uint32_t codecId = htonl(static_cast<uint32_t>(codec));
+					memcpy(resultBuf + sizeof(result), &codecId, sizeof(codecId));
+					writeAll(tmp_socket[i], resultBuf, sizeof(resultBuf));
+					socketBeginCompression(tmp_socket[i], codec);
+					debug(LOG_NET, "Using codec %s for connection %u", socketCodecName(codec), i);
 
 					// Connection is successful.
 					connectFailed = false;
@@ -3884,6 +4029,7 @@ static void NETallowJoining()
 
 					debug(LOG_NET, "freeing temp socket %p (%d), creating permanent socket.", static_cast<void *>(tmp_socket[i]), __LINE__);
 					SocketSet_DelSocket(tmp_socket_set, tmp_socket[i]);
+					NETflushBroadcastBatch();  // Batched before this player joined.
 					connected_bsocket[index] = tmp_socket[i];
 					NET_waitingForIndexChangeAckSince[index] = nullopt;
 					tmp_socket[i] = nullptr;
@@ -4475,6 +4621,21 @@ bool NETjoinGame(const char *host, uint32_t port, const char *playername, bool a
 	}
 
 	result = ntohl(result);
+	uint32_t codecId = static_cast<uint32_t>(SocketCodecType::Count);
+	if (result == ERROR_NOERROR)
+	{
+		// The host picks the codec, and sends it after accepting our version.
+		if (readAll(tcp_socket, &codecId, sizeof(codecId), 1500) != sizeof(codecId))
+		{
+			debug(LOG_ERROR, "Couldn't read the codec.");
+			result = ERROR_CONNECTION;
+		}
+		else if ((codecId = ntohl(codecId)) >= static_cast<uint32_t>(SocketCodecType::Count))
+		{
+			debug(LOG_ERROR, "Host requested unknown codec %" PRIu32 ".", codecId);
+			result = ERROR_WRONGVERSION;
+		}
+	}
 	if (result != ERROR_NOERROR)
 	{
 		debug(LOG_ERROR, "Received error %d", result);
@@ -4495,7 +4656,8 @@ bool NETjoinGame(const char *host, uint32_t port, const char *playername, bool a
 	// NOTE: tcp_socket = bsocket now!
 	bsocket = tcp_socket;
 	tcp_socket = nullptr;
-	socketBeginCompression(bsocket);
+	socketBeginCompression(bsocket, static_cast<SocketCodecType>(codecId));
+	debug(LOG_NET, "Using codec %s", socketCodecName(static_cast<SocketCodecType>(codecId)));
 
 	uint8_t playerType = (!asSpectator) ? NET_JOIN_PLAYER : NET_JOIN_SPECTATOR;
 
@@ -4676,6 +4838,24 @@ bool NETgetJoinPreferenceIPv6()
 	return bJoinPrefTryIPv6First;
 }
 
+/*!
+* Set the codec used for connections to remote clients, when hosting
+* \param codec The codec, clients on the same machine use SocketCodecType::None regardless.
+*/
+void NETsetHostCodec(SocketCodecType codec)
+{
+	ASSERT_OR_RETURN(, codec < SocketCodecType::Count, "Invalid codec");
+	hostCodec = codec;
+}
+
+/**
+* @return The codec used for connections to remote clients, when hosting.
+*/
+SocketCodecType NETgetHostCodec()
+{
+	return hostCodec;
+}
+
 
 void NETsetPlayerConnectionStatus(CONNECTION_STATUS status, unsigned player)
 {
@@ -4738,20 +4918,234 @@ struct SyncDebugEntry
 	char const *function;
 };
 
-struct SyncDebugString : public SyncDebugEntry
+#define MAX_LEN_LOG_LINE 512  // From debug.c - no use printing something longer.
+
+enum class SyncDebugArgType {None, Int, Long, LongLong, SizeT, IntMax, PtrDiff, Double, LongDouble, String, Pointer};
+
+/// Finds the next printf conversion specification in format, and returns a pointer past it, or nullptr if there are no more.
+/// numStars is the number of '*' widths and precisions, which take an int argument each, before the argument itself.
+static char const *syncDebugNextConversion(char const *format, char const *&specBegin, SyncDebugArgType &type, bool &isSigned, unsigned &numStars)
+{
+	specBegin = strchr(format, '%');
+	if (specBegin == nullptr)
+	{
+		return nullptr;
+	}
+	char const *p = specBegin + 1;
+	numStars = 0;
+	for (; *p != '\0' && strchr("-+ #0123456789.*", *p) != nullptr; ++p)
+	{
+		numStars += *p == '*';
+	}
+	int longs = 0;
+	char modifier = '\0';
+	for (; *p != '\0' && strchr("hlzjtL", *p) != nullptr; ++p)
+	{
+		longs += *p == 'l';
+		modifier = *p;
+	}
+	isSigned = *p == 'd' || *p == 'i';
+	switch (*p)
+	{
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+		switch (modifier)
+		{
+		case 'l': type = longs >= 2 ? SyncDebugArgType::LongLong : SyncDebugArgType::Long; break;
+		case 'z': type = SyncDebugArgType::SizeT;   break;
+		case 'j': type = SyncDebugArgType::IntMax;  break;
+		case 't': type = SyncDebugArgType::PtrDiff; break;
+		default:  type = SyncDebugArgType::Int;     break;  // Including 'h' and "hh", which are promoted to int.
+		}
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		type = modifier == 'L' ? SyncDebugArgType::LongDouble : SyncDebugArgType::Double;
+		break;
+	case 's': type = SyncDebugArgType::String;  break;
+	case 'p': type = SyncDebugArgType::Pointer; break;
+	case '%': type = SyncDebugArgType::None;    break;
+	default:
+		ASSERT(false, "Unsupported conversion \"%%%c\" in syncDebug format \"%s\".", *p, format);
+		type = SyncDebugArgType::None;
+		return *p != '\0' ? p + 1 : p;
+	}
+	return p + 1;
+}
+
+struct SyncDebugArgSpec
+{
+	SyncDebugArgType type;
+	bool isSigned;
+	unsigned numStars;
+};
+
+/// What syncDebug() needs to know about a format string, found the first time the format string is used.
+struct SyncDebugFormatInfo
+{
+	uint32_t formatCrc;
+	char const *lastFunction = nullptr;  ///< Usually, each format string is only used by one function.
+	uint32_t lastFunctionCrc = 0;
+	std::vector<SyncDebugArgSpec> args;
+};
+
+static std::unordered_map<char const *, SyncDebugFormatInfo> syncDebugFormatInfos;  ///< Indexed by format string pointer, which is fine since they are string literals.
+
+static SyncDebugFormatInfo &syncDebugGetFormatInfo(char const *format)
 {
-	void set(uint32_t &crc, char const *f, char const *string)
+	auto i = syncDebugFormatInfos.find(format);
+	if (i != syncDebugFormatInfos.end())
 	{
-		function = f;
-		crc = crcSum(crc, function, strlen(function) + 1);
-		crc = crcSum(crc, string,   strlen(string) + 1);
+		return i->second;
+	}
+	SyncDebugFormatInfo &info = syncDebugFormatInfos[format];
+	info.formatCrc = crcSum(0, format, strlen(format) + 1);
+	char const *specBegin;
+	SyncDebugArgSpec spec;
+	for (char const *p = format; (p = syncDebugNextConversion(p, specBegin, spec.type, spec.isSigned, spec.numStars)) != nullptr;)
+	{
+		info.args.push_back(spec);
+	}
+	return info;
+}
+
+/// Ints are stored in 4 bytes, everything else except strings in 8 bytes, big-endian, so the CRC doesn't depend on the platform.
+static inline void syncDebugAppend(std::vector<uint8_t> &args, uint64_t value, int bytes)
+{
+	uint8_t buf[8];
+	for (int n = 0; n < bytes; ++n)
+	{
+		buf[n] = uint8_t(value >> 8 * (bytes - 1 - n));
 	}
-	int snprint(char *buf, size_t bufSize, char const *&string) const
+	args.insert(args.end(), buf, buf + bytes);
+}
+
+static inline uint64_t syncDebugRead(uint8_t const *&args, int bytes)
+{
+	uint64_t value = 0;
+	for (int n = 0; n < bytes; ++n)
 	{
-		int ret = snprintf(buf, bufSize, "[%s] %s\n", function, string);
-		string += strlen(string) + 1;
-		return ret;
+		value = value << 8 | *args++;
 	}
+	return value;
+}
+
+/// A syncDebug() call. The arguments are stored unformatted, in a portable byte order, and only formatted if the log is dumped.
+struct SyncDebugFormat : public SyncDebugEntry
+{
+	void set(uint32_t &crc, char const *f, char const *fmt, std::vector<uint8_t> &args, va_list ap)
+	{
+		function = f;
+		format = fmt;
+		SyncDebugFormatInfo &info = syncDebugGetFormatInfo(format);
+		if (info.lastFunction != function)
+		{
+			info.lastFunction = function;
+			info.lastFunctionCrc = crcSum(0, function, strlen(function) + 1);
+		}
+		size_t argsBegin = args.size();
+		for (SyncDebugArgSpec const &spec : info.args)
+		{
+			for (unsigned n = 0; n < spec.numStars; ++n)
+			{
+				syncDebugAppend(args, va_arg(ap, int), 4);
+			}
+			switch (spec.type)
+			{
+			case SyncDebugArgType::None:     break;
+			case SyncDebugArgType::Int:      syncDebugAppend(args, va_arg(ap, unsigned), 4); break;
+			case SyncDebugArgType::Long:     syncDebugAppend(args, spec.isSigned ? va_arg(ap, long) : va_arg(ap, unsigned long), 8); break;
+			case SyncDebugArgType::LongLong: syncDebugAppend(args, va_arg(ap, unsigned long long), 8); break;
+			case SyncDebugArgType::SizeT:    syncDebugAppend(args, va_arg(ap, size_t), 8); break;
+			case SyncDebugArgType::IntMax:   syncDebugAppend(args, va_arg(ap, intmax_t), 8); break;
+			case SyncDebugArgType::PtrDiff:  syncDebugAppend(args, va_arg(ap, ptrdiff_t), 8); break;
+			case SyncDebugArgType::Pointer:  syncDebugAppend(args, reinterpret_cast<uintptr_t>(va_arg(ap, void *)), 8); break;
+			case SyncDebugArgType::Double:
+			case SyncDebugArgType::LongDouble:
+			{
+				double value = spec.type == SyncDebugArgType::Double ? va_arg(ap, double) : static_cast<double>(va_arg(ap, long double));
+				uint64_t bits;
+				memcpy(&bits, &value, sizeof(bits));
+				syncDebugAppend(args, bits, 8);
+				break;
+			}
+			case SyncDebugArgType::String:
+			{
+				char const *string = va_arg(ap, char const *);
+				string = string != nullptr ? string : "(null)";
+				args.insert(args.end(), string, string + strlen(string) + 1);
+				break;
+			}
+			}
+		}
+		uint32_t names[2] = {htonl(info.lastFunctionCrc), htonl(info.formatCrc)};
+		crc = crcSum(crc, names, sizeof(names));
+		crc = crcSum(crc, args.data() + argsBegin, args.size() - argsBegin);
+	}
+	int snprint(char *buf, size_t bufSize, uint8_t const *&args) const
+	{
+		char line[MAX_LEN_LOG_LINE];
+		size_t lineLen = 0;
+		auto append = [&](int len) {
+			lineLen = std::min<size_t>(lineLen + std::max(len, 0), sizeof(line) - 1);
+		};
+		char const *specBegin;
+		SyncDebugArgType type;
+		bool isSigned;
+		unsigned numStars;
+		char const *p = format;
+		for (char const *next; (next = syncDebugNextConversion(p, specBegin, type, isSigned, numStars)) != nullptr; p = next)
+		{
+			append(snprintf(line + lineLen, sizeof(line) - lineLen, "%.*s", static_cast<int>(specBegin - p), p));
+
+			// Copy the specification, with any '*' replaced by its value.
+			char spec[64];
+			size_t specLen = 0;
+			for (char const *c = specBegin; c != next && specLen + 12 < sizeof(spec); ++c)
+			{
+				if (*c == '*')
+				{
+					specLen += snprintf(spec + specLen, sizeof(spec) - specLen, "%d", static_cast<int>(syncDebugRead(args, 4)));
+					continue;
+				}
+				spec[specLen++] = *c;
+			}
+			spec[specLen] = '\0';
+
+			char *out = line + lineLen;
+			size_t outSize = sizeof(line) - lineLen;
+			switch (type)
+			{
+			case SyncDebugArgType::None:     append(snprintf(out, outSize, "%s", "%")); break;
+			case SyncDebugArgType::Int:      append(isSigned ? snprintf(out, outSize, spec, static_cast<int>(syncDebugRead(args, 4))) : snprintf(out, outSize, spec, static_cast<unsigned>(syncDebugRead(args, 4)))); break;
+			case SyncDebugArgType::Long:     append(isSigned ? snprintf(out, outSize, spec, static_cast<long>(syncDebugRead(args, 8))) : snprintf(out, outSize, spec, static_cast<unsigned long>(syncDebugRead(args, 8)))); break;
+			case SyncDebugArgType::LongLong: append(isSigned ? snprintf(out, outSize, spec, static_cast<long long>(syncDebugRead(args, 8))) : snprintf(out, outSize, spec, static_cast<unsigned long long>(syncDebugRead(args, 8)))); break;
+			case SyncDebugArgType::SizeT:    append(snprintf(out, outSize, spec, static_cast<size_t>(syncDebugRead(args, 8)))); break;
+			case SyncDebugArgType::IntMax:   append(snprintf(out, outSize, spec, static_cast<intmax_t>(syncDebugRead(args, 8)))); break;
+			case SyncDebugArgType::PtrDiff:  append(snprintf(out, outSize, spec, static_cast<ptrdiff_t>(syncDebugRead(args, 8)))); break;
+			case SyncDebugArgType::Pointer:  append(snprintf(out, outSize, spec, reinterpret_cast<void *>(static_cast<uintptr_t>(syncDebugRead(args, 8))))); break;
+			case SyncDebugArgType::Double:
+			case SyncDebugArgType::LongDouble:
+			{
+				uint64_t bits = syncDebugRead(args, 8);
+				double value;
+				memcpy(&value, &bits, sizeof(value));
+				append(type == SyncDebugArgType::Double ? snprintf(out, outSize, spec, value) : snprintf(out, outSize, spec, static_cast<long double>(value)));
+				break;
+			}
+			case SyncDebugArgType::String:
+			{
+				char const *string = reinterpret_cast<char const *>(args);
+				append(snprintf(out, outSize, spec, string));
+				args += strlen(string) + 1;
+				break;
+			}
+			}
+		}
+		append(snprintf(line + lineLen, sizeof(line) - lineLen, "%s", p));
+
+		return snprintf(buf, bufSize, "[%s] %s\n", function, line);
+	}
+
+	char const *format;
 };
 
 struct SyncDebugValueChange : public SyncDebugEntry
@@ -4870,24 +5264,18 @@ struct SyncDebugLog
 		log.clear();
 		time = 0;
 		crc = 0x00000000;
-		//printf("Freeing %d strings, %d valueChanges, %d intLists, %d chars, %d ints\n", (int)strings.size(), (int)valueChanges.size(), (int)intLists.size(), (int)chars.size(), (int)ints.size());
-		strings.clear();
+		//printf("Freeing %d formats, %d valueChanges, %d intLists, %d arg bytes, %d ints\n", (int)formats.size(), (int)valueChanges.size(), (int)intLists.size(), (int)args.size(), (int)ints.size());
+		formats.clear();
 		valueChanges.clear();
 		intLists.clear();
-		chars.clear();
+		args.clear();
 		ints.clear();
 	}
-	void string(char const *f, char const *s)
+	void format(char const *f, char const *fmt, va_list ap)
 	{
-		size_t offset = chars.size();
-		chars.resize(chars.size() + strlen(s) + 1);
-		char *buf = &chars[offset];
-		strcpy(buf, s);
-
-		strings.resize(strings.size() + 1);
-		strings.back().set(crc, f, buf);
-
-		log.push_back('s');
+		formats.resize(formats.size() + 1);
+		formats.back().set(crc, f, fmt, args, ap);
+		log.push_back('f');
 	}
 	void valueChange(char const *f, char const *vn, int nv, int i)
 	{
@@ -4908,10 +5296,10 @@ struct SyncDebugLog
 	}
 	int snprint(char *buf, size_t bufSize)
 	{
-		SyncDebugString const *stringPtr = strings.empty() ? nullptr : &strings[0]; // .empty() check, since &strings[0] is undefined if strings is empty(), even if it's likely to work, anyway.
+		SyncDebugFormat const *formatPtr = formats.empty() ? nullptr : &formats[0]; // .empty() check, since &formats[0] is undefined if formats is empty(), even if it's likely to work, anyway.
 		SyncDebugValueChange const *valueChangePtr = valueChanges.empty() ? nullptr : &valueChanges[0];
 		SyncDebugIntList const *intListPtr = intLists.empty() ? nullptr : &intLists[0];
-		char const *charPtr = chars.empty() ? nullptr : &chars[0];
+		uint8_t const *argPtr = args.empty() ? nullptr : &args[0];
 		int const *intPtr = ints.empty() ? nullptr : &ints[0];
 
 		int index = 0;
@@ -4920,8 +5308,8 @@ struct SyncDebugLog
 			char type = log[n];
 			switch (type)
 			{
-			case 's':
-				index += stringPtr++->snprint(buf + index, bufSize - index, charPtr);
+			case 'f':
+				index += formatPtr++->snprint(buf + index, bufSize - index, argPtr);
 				break;
 			case 'v':
 				index += valueChangePtr++->snprint(buf + index, bufSize - index);
@@ -4962,11 +5350,11 @@ private:
 	uint32_t time;
 	uint32_t crc;
 
-	std::vector<SyncDebugString> strings;
+	std::vector<SyncDebugFormat> formats;
 	std::vector<SyncDebugValueChange> valueChanges;
 	std::vector<SyncDebugIntList> intLists;
 
-	std::vector<char> chars;
+	std::vector<uint8_t> args;
 	std::vector<int> ints;
 
 private:
@@ -4974,7 +5362,6 @@ private:
 	SyncDebugLog &operator =(SyncDebugLog const &)/* = delete*/;
 };
 
-#define MAX_LEN_LOG_LINE 512  // From debug.c - no use printing something longer.
 #define MAX_SYNC_HISTORY 12
 
 static unsigned syncDebugNext = 0;
@@ -4994,13 +5381,9 @@ void _syncDebug(const char *function, const char *str, ...)
 #endif
 
 	va_list ap;
-	char outputBuffer[MAX_LEN_LOG_LINE];
-
 	va_start(ap, str);
-	vssprintf(outputBuffer, str, ap);
+	syncDebugLog[syncDebugNext].format(function, str, ap);
 	va_end(ap);
-
-	syncDebugLog[syncDebugNext].string(function, outputBuffer);
 }
 
 void _syncDebugIntList(const char *function, const char *str, int *ints, size_t numInts)
@@ -5293,6 +5676,7 @@ const char *messageTypeToString(unsigned messageType_)
 	case GAME_PLAYER_LEFT:              return "GAME_PLAYER_LEFT";
 	case GAME_DROIDDISEMBARK:           return "GAME_DROIDDISEMBARK";
 	case GAME_SYNC_REQUEST:             return "GAME_SYNC_REQUEST";
+	case GAME_STATE_HASH:               return "GAME_STATE_HASH";
 
 	// The following messages are used for debug mode.
 	case GAME_DEBUG_MODE:               return "GAME_DEBUG_MODE";
@@ -5304,7 +5688,7 @@ const char *messageTypeToString(unsigned messageType_)
 	case GAME_DEBUG_REMOVE_FEATURE:     return "GAME_DEBUG_REMOVE_FEATURE";
 	case GAME_DEBUG_FINISH_RESEARCH:    return "GAME_DEBUG_FINISH_RESEARCH";
 	// End of redundant messages.
-	case GAME_MAX_TYPE:                 return "GAME_MAX_TYPE";
+	// GAME_MAX_TYPE has the same value as REPLAY_ENDED.
 
 	// The following messages are used for playing back replays.
 	case REPLAY_ENDED:                  return "REPLAY_ENDED";
@@ -29,6 +29,7 @@
 #include "lib/framework/crc.h"
 #include "src/factionid.h"
 #include "nettypes.h"
+#include "netsocketcodec.h"
 #include <physfs.h>
 #include <vector>
 #include <functional>
@@ -127,12 +128,16 @@ enum MESSAGE_TYPES
 	GAME_DEBUG_REMOVE_FEATURE,      ///< Remove feature.
 	GAME_DEBUG_FINISH_RESEARCH,     ///< Research has been completed.
 	// End of debug messages.
+	// Add new GAME_ types here, so that the values of the older ones stay the same in replays. There is no room left before
+	// REPLAY_ENDED, though.
+	GAME_STATE_HASH,                ///< Per-subsystem game state hashes, for finding desyncs.
 	GAME_MAX_TYPE,                  ///< Maximum+1 valid GAME_ type, *MUST* be last.
 
 	// The following messages are used for playing back replays.
-	REPLAY_ENDED					///< A special message for signifying the end of the replay
+	REPLAY_ENDED = 133,				///< A special message for signifying the end of the replay, its value is stored in replays
 	// End of replay messages.
 };
+static_assert(GAME_MAX_TYPE <= REPLAY_ENDED, "A new GAME_ type has made REPLAY_ENDED a GAME_ type, move REPLAY_ENDED and translate it in NETreplayLoadNetMessage()");
 
 #define SYNC_FLAG 0x10000000	//special flag used for logging. (Not sure what this is. Was added in trunk, NUM_GAME_PACKETS not in newnet.)
 
@@ -389,8 +394,9 @@ void NETaddRedirects();
 void NETremRedirects();
 void NETdiscoverUPnPDevices();
 
-enum NetStatisticType {NetStatisticRawBytes, NetStatisticUncompressedBytes, NetStatisticPackets};
+enum NetStatisticType {NetStatisticRawBytes, NetStatisticUncompressedBytes, NetStatisticPackets, NetStatisticCodecMicroseconds, NetStatisticFlushes, NetStatisticBatches, NetStatisticBatchedMessages};
 size_t NETgetStatistic(NetStatisticType type, bool sent, bool isTotal = false);     // Return some statistic. Call regularly for good results.
+size_t NETgetPendingWriteBytes(unsigned player);     ///< Returns the number of bytes queued for the player, but not yet sent. Only meaningful for the host.
 
 void NETplayerKicked(UDWORD index);			// Cleanup after player has been kicked
 
@@ -471,6 +477,8 @@ void NETsetGameserverPort(unsigned int port);
 unsigned int NETgetGameserverPort();
 void NETsetJoinPreferenceIPv6(bool bTryIPv6First);
 bool NETgetJoinPreferenceIPv6();
+void NETsetHostCodec(SocketCodecType codec);
+SocketCodecType NETgetHostCodec();
 
 bool NETsetupTCPIP(const char *machine);
 void NETsetGamePassword(const char *password);
@@ -501,6 +509,7 @@ bool NETcheckPlayerConnectionStatus(CONNECTION_STATUS status, unsigned player);
 const char *messageTypeToString(unsigned messageType);
 
 /// Sync debugging. Only prints anything, if different players would print different things.
+/// The arguments are only formatted if printed, so str must stay valid until the next game, which string literals do.
 #define syncDebug(...) do { _syncDebug(__FUNCTION__, __VA_ARGS__); } while(0)
 #ifdef WZ_CC_MINGW
 void _syncDebug(const char *function, const char *str, ...) WZ_DECL_FORMAT(__MINGW_PRINTF_FORMAT, 2, 3);
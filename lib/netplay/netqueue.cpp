@@ -25,11 +25,28 @@
 #include "netqueue.h"
 #include "netplay.h"
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
 #include <cstdint>
 
 // See comments in netqueue.h.
 
+static struct
+{
+	std::atomic<uint64_t> framesBuilt{0};
+	std::atomic<uint64_t> framesBuiltBytes{0};
+	std::atomic<uint64_t> framesShared{0};
+	std::atomic<uint64_t> queueCopies{0};
+	std::atomic<uint64_t> queueCopiedBytes{0};
+	std::atomic<uint64_t> queueMoves{0};
+} messageStats;
+
+static inline void countMessageStat(std::atomic<uint64_t> &stat, uint64_t amount = 1)
+{
+	stat.fetch_add(amount, std::memory_order_relaxed);
+}
+
 
 // Byte n is the final byte, iff it is less than 256-a[n].
 
@@ -37,7 +54,7 @@
 // ASSERT(0xFFFFFFFF == 255*(1 + a[0]*(1 + a[1]*(1 + a[2]*(1 + a[3]*(1 + a[4]))))), "Maximum encodable value not 0xFFFFFFFF.");
 
 //static const unsigned table_uint32_t_a[5] = {14, 127, 74, 127, 0}, table_uint32_t_m[5] = {1, 14, 1778, 131572, 16709644};  // <242: 1 byte, <2048: 2 bytes, <325644: 3 bytes, <17298432: 4 bytes, <4294967296: 5 bytes
-static const unsigned table_uint32_t_a[5] = {78, 95, 32, 70, 0}, table_uint32_t_m[5] = {1, 78, 7410, 237120, 16598400};  // <178: 1 byte, <12736: 2 bytes, <1672576: 3 bytes, <45776896: 4 bytes, <4294967296: 5 bytes
+static constexpr unsigned table_uint32_t_a[5] = {78, 95, 32, 70, 0}, table_uint32_t_m[5] = {1, 78, 7410, 237120, 16598400};  // <178: 1 byte, <12736: 2 bytes, <1672576: 3 bytes, <45776896: 4 bytes, <4294967296: 5 bytes
 //static const unsigned table_uint32_t_a[5] = {78, 95, 71, 31, 0}, table_uint32_t_m[5] = {1, 78, 7410, 526110, 16309410};  // <178: 1 byte, <12736: 2 bytes, <1383586: 3 bytes, <119758336: 4 bytes, <4294967296: 5 bytes
 //static const unsigned table_uint32_t_a[5] = {104, 71, 19, 119, 0}, table_uint32_t_m[5] = {1, 104, 7384, 140296, 16695224};  // <152: 1 byte, <19392: 2 bytes, <1769400: 3 bytes, <20989952: 4 bytes, <4294967296: 5 bytes
 //static const unsigned table_uint32_t_a[5] = {104, 71, 20, 113, 0}, table_uint32_t_m[5] = {1, 104, 7384, 147680, 16687840};  // <152: 1 byte, <19392: 2 bytes, <1762016: 3 bytes, <22880256: 4 bytes, <4294967296: 5 bytes
@@ -53,6 +70,7 @@ static const unsigned table_uint32_t_a[5] = {78, 95, 32, 70, 0}, table_uint32_t_
 //static const unsigned table_uint32_t_a[5] = {104, 71, 120, 18, 0}, table_uint32_t_m[5] = {1, 104, 7384, 886080, 15949440};  // <152: 1 byte, <19392: 2 bytes, <1023616: 3 bytes, <211910656: 4 bytes, <4294967296: 5 bytes
 
 //static const unsigned table_uint32_t_m[5] = {1, a[0], a[0]*a[1], a[0]*a[1]*a[2], a[0]*a[1]*a[2]*a[3]};
+static_assert(256 - table_uint32_t_a[0] == encodedSingleByteLimit_uint32_t, "encodedSingleByteLimit_uint32_t doesn't match the table.");
 
 unsigned encodedlength_uint32_t(uint32_t v)
 {
@@ -104,60 +122,151 @@ bool decode_uint32_t(uint8_t b, uint32_t &v, unsigned n)
 	return !isLastByte;
 }
 
-uint8_t *NetMessage::rawDataDup() const
+// Same as calling encode_uint32_t and decode_uint32_t for each byte, but unrolled, so that the divisions are by constants.
+template<unsigned N>
+static inline unsigned encodeAllFrom_uint32_t(uint32_t v, uint8_t *out)
 {
-#if SIZE_MAX > UINT32_MAX
-	ASSERT_OR_RETURN(nullptr, data.size() <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "Trying to duplicate a very large packet (%zu bytes). (Message type: %" PRIu8 ")", data.size(), type);
-#endif
-	uint32_t dataSizeU32 = static_cast<uint32_t>(data.size());
-	unsigned encodedLengthOfSize = encodedlength_uint32_t(dataSizeU32);
+	constexpr unsigned a = table_uint32_t_a[N];
+	if (v < 256 - a)
+	{
+		out[N] = v;
+		return N + 1;
+	}
+	v -= 256 - a;
+	out[N] = 255 - v % a;
+	return encodeAllFrom_uint32_t<N + 1>(v / a, out);
+}
+
+template<>
+inline unsigned encodeAllFrom_uint32_t<4>(uint32_t v, uint8_t *out)
+{
+	out[4] = v;  // The last byte can hold any remaining value.
+	return 5;
+}
+
+template<unsigned N>
+static inline size_t decodeAllFrom_uint32_t(uint8_t const *data, size_t size, uint32_t &v)
+{
+	constexpr unsigned a = table_uint32_t_a[N];
+	constexpr unsigned m = table_uint32_t_m[N];
+	if (N >= size)
+	{
+		return 0;
+	}
+	uint8_t b = data[N];
+	if (b < 256 - a)
+	{
+		v += b * m;
+		return N + 1;
+	}
+	v += (256 - a + 255 - b) * m;
+	return decodeAllFrom_uint32_t<N + 1>(data, size, v);
+}
+
+template<>
+inline size_t decodeAllFrom_uint32_t<4>(uint8_t const *data, size_t size, uint32_t &v)
+{
+	if (4 >= size)
+	{
+		return 0;
+	}
+	v += data[4] * table_uint32_t_m[4];
+	return 5;
+}
 
-	uint8_t *ret = new uint8_t[1 + encodedLengthOfSize + dataSizeU32];
+unsigned encodeAllSlow_uint32_t(uint32_t v, uint8_t *out)
+{
+	return encodeAllFrom_uint32_t<0>(v, out);
+}
 
-	ret[0] = type;
-	uint32_t len = dataSizeU32;
-	for (unsigned n = 0; n < encodedLengthOfSize; ++n)
+size_t decodeAllSlow_uint32_t(uint8_t const *data, size_t size, uint32_t &v)
+{
+	uint32_t value = 0;
+	size_t used = decodeAllFrom_uint32_t<0>(data, size, value);
+	if (used != 0)
 	{
-		encode_uint32_t(ret[n + 1], len, n);
+		v = value;
 	}
+	return used;
+}
 
-	std::copy(data.begin(), data.begin() + dataSizeU32, ret + 1 + encodedLengthOfSize);
-	return ret;
+void NetMessage::reset(uint8_t type_)
+{
+	type = type_;
+	data.clear();
+	framedData.reset();
 }
 
-void NetMessage::rawDataAppendToVector(std::vector<uint8_t> &output) const
+unsigned NetMessage::rawHeader(uint8_t *header) const
 {
 #if SIZE_MAX > UINT32_MAX
-	ASSERT(data.size() <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "Trying to duplicate a very large packet (%zu bytes).", data.size());
+	ASSERT(data.size() <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "Trying to send a very large packet (%zu bytes). (Message type: %" PRIu8 ")", data.size(), type);
 #endif
-	uint32_t dataSizeU32 = static_cast<uint32_t>(data.size());
-
-	unsigned encodedLengthOfSize = encodedlength_uint32_t(dataSizeU32);
+	header[0] = type;
+	return 1 + encodeAll_uint32_t(static_cast<uint32_t>(data.size()), header + 1);
+}
 
-	output.push_back(type);
-	uint32_t len = dataSizeU32;
-	for (unsigned n = 0; n < encodedLengthOfSize; ++n)
+void NetMessage::rawDataAppendToVector(std::vector<uint8_t> &output) const
+{
+	if (framedData)
 	{
-		uint8_t b;
-		encode_uint32_t(b, len, n);
-		output.push_back(b);
+		output.insert(output.end(), framedData->begin(), framedData->end());
+		return;
 	}
 
+	uint8_t header[maxRawHeaderLength];
+	unsigned headerLen = rawHeader(header);
+
+	output.insert(output.end(), header, header + headerLen);
 	output.insert(output.end(), data.begin(), data.end());
 }
 
+std::shared_ptr<const std::vector<uint8_t>> const &NetMessage::framed() const
+{
+	if (framedData)
+	{
+		ASSERT(framedData->size() == rawLen(), "Message (type %" PRIu8 ") modified after being framed.", type);
+		countMessageStat(messageStats.framesShared);
+		return framedData;
+	}
+
+	auto frame = std::make_shared<std::vector<uint8_t>>();
+	frame->reserve(rawLen());
+	rawDataAppendToVector(*frame);
+	countMessageStat(messageStats.framesBuilt);
+	countMessageStat(messageStats.framesBuiltBytes, frame->size());
+	framedData = std::move(frame);
+	return framedData;
+}
+
 size_t NetMessage::rawLen() const
 {
 	return 1 + static_cast<size_t>(encodedlength_uint32_t(static_cast<uint32_t>(data.size()))) + data.size();
 }
 
+// Limits on the buffers kept by NetQueue::popOldMessages for reuse, so that a burst of large messages doesn't pin memory.
+static const size_t maxSpareMessageData = 64;
+static const size_t maxSpareMessageDataCapacity = 16384;
+
 NetQueue::NetQueue()
 	: canGetMessagesForNet(true)
 	, canGetMessages(true)
+	, dataPos(0)
+	, messagePos(0)
 	, pendingGameTimeUpdateMessages(0)
+{}
+
+NetMessage &NetQueue::newMessage(uint8_t type)
 {
-	dataPos = messages.end();
-	messagePos = messages.end();
+	messages.emplace_back(type);
+	NetMessage &message = messages.back();
+	if (!spareMessageData.empty())
+	{
+		message.data = std::move(spareMessageData.back());
+		spareMessageData.pop_back();
+		message.data.clear();
+	}
+	return message;
 }
 
 void NetQueue::writeRawData(const uint8_t *netData, size_t netLen)
@@ -165,31 +274,35 @@ void NetQueue::writeRawData(const uint8_t *netData, size_t netLen)
 	size_t used = 0;
 	std::vector<uint8_t> &buffer = incompleteReceivedMessageData;  // Short alias.
 
-	// Insert the data.
-	buffer.insert(buffer.end(), netData, netData + netLen);
+	// Parse straight from the network data, unless there is an incomplete message to finish first.
+	bool buffered = !buffer.empty();
+	if (buffered)
+	{
+		buffer.insert(buffer.end(), netData, netData + netLen);
+	}
+	const uint8_t *data = buffered ? buffer.data() : netData;
+	size_t size = buffered ? buffer.size() : netLen;
 
 	// Extract the messages.
-	while (buffer.size() - used > 1)
+	while (size - used > 1)
 	{
-		uint8_t type = buffer[used];
+		uint8_t type = data[used];
 
 		uint32_t len = 0;
-		bool moreBytes = true;
-		unsigned n;
-		for (n = 0; moreBytes && buffer.size() - used > 1 + n; ++n)
+		size_t lenLen = decodeAll_uint32_t(data + used + 1, size - used - 1, len);
+		if (lenLen == 0)
 		{
-			moreBytes = decode_uint32_t(buffer[used + 1 + n], len, n);
+			break;  // Don't have the whole length yet.
 		}
-		unsigned headerLen = 1 + n;
+		size_t headerLen = 1 + lenLen;
 
 		ASSERT(len < 40000000, "Trying to write a very large packet (%u bytes) to the queue.", len);
-		if (buffer.size() - used - headerLen < len)
+		if (size - used - headerLen < len)
 		{
 			break;  // Don't have a whole message ready yet.
 		}
 
-		messages.push_front(NetMessage(type));
-		messages.front().data.assign(buffer.begin() + used + headerLen, buffer.begin() + used + headerLen + len);
+		newMessage(type).data.assign(data + used + headerLen, data + used + headerLen + len);
 		if (type == GAME_GAME_TIME)
 		{
 			++pendingGameTimeUpdateMessages;
@@ -197,8 +310,15 @@ void NetQueue::writeRawData(const uint8_t *netData, size_t netLen)
 		used += headerLen + len;
 	}
 
-	// Recycle old data.
-	buffer.erase(buffer.begin(), buffer.begin() + used);
+	// Keep any incomplete message for next time.
+	if (buffered)
+	{
+		buffer.erase(buffer.begin(), buffer.begin() + used);
+	}
+	else
+	{
+		buffer.assign(netData + used, netData + netLen);
+	}
 }
 
 void NetQueue::setWillNeverGetMessagesForNet()
@@ -208,33 +328,24 @@ void NetQueue::setWillNeverGetMessagesForNet()
 
 unsigned NetQueue::numMessagesForNet() const
 {
-	unsigned count = 0;
-	if (canGetMessagesForNet)
-	{
-		for (List::iterator i = dataPos; i != messages.begin(); --i)
-		{
-			++count;
-		}
-	}
-
-	return count;
+	return canGetMessagesForNet ? static_cast<unsigned>(messages.size() - dataPos) : 0;
 }
 
 const NetMessage &NetQueue::getMessageForNet() const
 {
 	ASSERT(canGetMessagesForNet, "Wrong NetQueue type for getMessageForNet.");
-	ASSERT(dataPos != messages.begin(), "No message to get!");
+	ASSERT(dataPos < messages.size(), "No message to get!");
 
 	// Return the message.
-	return internal_getMessageForNet();
+	return messages[dataPos];
 }
 
 void NetQueue::popMessageForNet()
 {
 	ASSERT(canGetMessagesForNet, "Wrong NetQueue type for popMessageForNet.");
-	ASSERT(dataPos != messages.begin(), "No message to pop!");
+	ASSERT(dataPos < messages.size(), "No message to pop!");
 
-	if (messagePos != messages.begin() && internal_getMessageForNet().type == GAME_GAME_TIME)
+	if (messagePos < messages.size() && messages[dataPos].type == GAME_GAME_TIME)
 	{
 		if (pendingGameTimeUpdateMessages > 0)
 		{
@@ -243,7 +354,7 @@ void NetQueue::popMessageForNet()
 	}
 
 	// Pop the message.
-	--dataPos;
+	++dataPos;
 
 	// Recycle old data.
 	popOldMessages();
@@ -255,7 +366,22 @@ void NetQueue::pushMessage(const NetMessage &message)
 	{
 		++pendingGameTimeUpdateMessages;
 	}
-	messages.push_front(message);
+	newMessage(message.type).data.assign(message.data.begin(), message.data.end());
+	countMessageStat(messageStats.queueCopies);
+	countMessageStat(messageStats.queueCopiedBytes, message.data.size());
+}
+
+NetMessage const &NetQueue::pushMessage(NetMessage &&message)
+{
+	if (message.type == GAME_GAME_TIME)
+	{
+		++pendingGameTimeUpdateMessages;
+	}
+	NetMessage &queued = newMessage(message.type);
+	std::swap(queued.data, message.data);  // Give the caller the recycled buffer for its next message.
+	message.reset(0xFF);
+	countMessageStat(messageStats.queueMoves);
+	return queued;
 }
 
 void NetQueue::setWillNeverGetMessages()
@@ -266,24 +392,24 @@ void NetQueue::setWillNeverGetMessages()
 bool NetQueue::haveMessage() const
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for haveMessage.");
-	return messagePos != messages.begin();
+	return messagePos < messages.size();
 }
 
 const NetMessage &NetQueue::getMessage() const
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for getMessage.");
-	ASSERT(messagePos != messages.begin(), "No message to get!");
+	ASSERT(messagePos < messages.size(), "No message to get!");
 
 	// Return the message.
-	return internal_getMessage();
+	return messages[messagePos];
 }
 
 void NetQueue::popMessage()
 {
 	ASSERT(canGetMessages, "Wrong NetQueue type for popMessage.");
-	ASSERT(messagePos != messages.begin(), "No message to pop!");
+	ASSERT(messagePos < messages.size(), "No message to pop!");
 
-	if (messagePos != messages.begin() && internal_getMessage().type == GAME_GAME_TIME)
+	if (messagePos < messages.size() && messages[messagePos].type == GAME_GAME_TIME)
 	{
 		if (pendingGameTimeUpdateMessages > 0)
 		{
@@ -292,7 +418,7 @@ void NetQueue::popMessage()
 	}
 
 	// Pop the message.
-	--messagePos;
+	++messagePos;
 
 	// Recycle old data.
 	popOldMessages();
@@ -302,27 +428,44 @@ void NetQueue::popOldMessages()
 {
 	if (!canGetMessagesForNet)
 	{
-		dataPos = messages.begin();
+		dataPos = messages.size();
 	}
 	if (!canGetMessages)
 	{
-		messagePos = messages.begin();
+		messagePos = messages.size();
 	}
 
-	List::iterator i = messages.end();
-	while (i != dataPos && i != messagePos)
+	// Messages which were both sent and popped are no longer needed. The deque frees its blocks as they empty.
+	size_t done = std::min(dataPos, messagePos);
+	for (size_t i = 0; i < done; ++i)
 	{
-		--i;
+		std::vector<uint8_t> &data = messages.front().data;
+		if (spareMessageData.size() < maxSpareMessageData && data.capacity() != 0 && data.capacity() <= maxSpareMessageDataCapacity)
+		{
+			spareMessageData.push_back(std::move(data));
+		}
+		messages.pop_front();
 	}
+	dataPos -= done;
+	messagePos -= done;
+}
 
-	if (i == dataPos)
-	{
-		dataPos = messages.end();  // Old iterator will become invalid.
-	}
-	if (i == messagePos)
+NetMessageStats NETgetMessageStats()
+{
+	NetMessageStats stats;
+	stats.framesBuilt = messageStats.framesBuilt.load(std::memory_order_relaxed);
+	stats.framesBuiltBytes = messageStats.framesBuiltBytes.load(std::memory_order_relaxed);
+	stats.framesShared = messageStats.framesShared.load(std::memory_order_relaxed);
+	stats.queueCopies = messageStats.queueCopies.load(std::memory_order_relaxed);
+	stats.queueCopiedBytes = messageStats.queueCopiedBytes.load(std::memory_order_relaxed);
+	stats.queueMoves = messageStats.queueMoves.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void NETresetMessageStats()
+{
+	for (std::atomic<uint64_t> *stat : {&messageStats.framesBuilt, &messageStats.framesBuiltBytes, &messageStats.framesShared, &messageStats.queueCopies, &messageStats.queueCopiedBytes, &messageStats.queueMoves})
 	{
-		messagePos = messages.end();  // Old iterator will become invalid.
+		stat->store(0, std::memory_order_relaxed);
 	}
-
-	messages.erase(i, messages.end());
 }
@@ -28,6 +28,7 @@
 #include <vector>
 #include <list>
 #include <deque>
+#include <memory>
 #include <unordered_map>
 
 // At game level:
@@ -41,18 +42,45 @@
 // There should be a NetQueuePair per socket.
 
 
+/// Values below this are encoded as a single byte, equal to the value.
+static const uint32_t encodedSingleByteLimit_uint32_t = 178;
+/// Maximum number of bytes used to encode a uint32_t.
+static const unsigned encodedMaxLength_uint32_t = 5;
+
 /// A NetMessage consists of a type (uint8_t) and some data, the meaning of which depends on the type.
 class NetMessage
 {
 public:
+	/// Maximum length of the type and encoded data length, which come before the data in the raw data.
+	static const unsigned maxRawHeaderLength = 1 + encodedMaxLength_uint32_t;
+
 	NetMessage(uint8_t type_ = 0xFF) : type(type_) {}
-	uint8_t *rawDataDup() const;  ///< Returns data compatible with NetQueue::writeRawData(). Must be delete[]d.
+	void reset(uint8_t type_);    ///< Makes this an empty message of the given type, keeping the data's storage.
+	unsigned rawHeader(uint8_t *header) const;  ///< Writes the start of the raw data, up to maxRawHeaderLength bytes, to header. Returns the number of bytes written. The raw data is the header followed by data.
 	void rawDataAppendToVector(std::vector<uint8_t> &output) const;  ///< Appends data compatible with NetQueue::writeRawData() to the input vector.
-	size_t rawLen() const;        ///< Returns the length of the return value of rawDataDup().
+	std::shared_ptr<const std::vector<uint8_t>> const &framed() const;  ///< Returns data compatible with NetQueue::writeRawData(), built on the first call and shared after that. The message must not be modified after calling this, except by reset().
+	size_t rawLen() const;        ///< Returns the length of the raw data.
 	uint8_t type;
 	std::vector<uint8_t> data;
+
+private:
+	mutable std::shared_ptr<const std::vector<uint8_t>> framedData;  ///< Cached result of framed().
+};
+
+/// Counts the copies and allocations of message data, to check that sending messages doesn't copy them needlessly.
+struct NetMessageStats
+{
+	uint64_t framesBuilt = 0;       ///< Number of buffers allocated by NetMessage::framed().
+	uint64_t framesBuiltBytes = 0;
+	uint64_t framesShared = 0;      ///< Number of calls to NetMessage::framed() which returned an already built buffer.
+	uint64_t queueCopies = 0;       ///< Number of messages copied into a NetQueue, instead of moved.
+	uint64_t queueCopiedBytes = 0;
+	uint64_t queueMoves = 0;        ///< Number of messages moved into a NetQueue.
 };
 
+NetMessageStats NETgetMessageStats();
+void NETresetMessageStats();
+
 /// MessageWriter is used for serialising, using the same interface as MessageReader.
 class MessageWriter
 {
@@ -65,6 +93,10 @@ public:
 	{
 		message->data.push_back(v);
 	}
+	void bytes(uint8_t const *v, size_t size) const
+	{
+		message->data.insert(message->data.end(), v, v + size);
+	}
 	bool valid() const
 	{
 		return true;
@@ -112,7 +144,8 @@ public:
 
 	// All game clients should check game messages from all queues, including their own, and only the net messages sent to them.
 	// Message related, storing.
-	void pushMessage(const NetMessage &message);                       ///< Adds a message to the queue.
+	void pushMessage(const NetMessage &message);                       ///< Adds a copy of the message to the queue.
+	NetMessage const &pushMessage(NetMessage &&message);               ///< Moves the message into the queue, leaving an empty message, and returns the queued message.
 	// Message related, extracting.
 	void setWillNeverGetMessages();                                    ///< Marks that we will not be reading any of the messages (only sending over the network).
 	bool haveMessage() const;                                          ///< Return true if we have a message ready to return.
@@ -126,30 +159,17 @@ public:
 
 private:
 	void popOldMessages();                                             ///< Pops any messages that are no longer needed.
+	NetMessage &newMessage(uint8_t type);                              ///< Appends an empty message, reusing the storage of an old one if possible.
 
 	bool canGetMessagesForNet;                                         ///< True if we will send the messages over the network, false if we don't.
 	bool canGetMessages;                                               ///< True if we will get the messages, false if we don't use them ourselves.
 
-	inline const NetMessage &internal_getMessageForNet() const
-	{
-		// Return the message.
-		List::iterator i = dataPos;
-		--i;
-		return *i;
-	};
-
-	inline const NetMessage &internal_getMessage() const
-	{
-		// Return the message.
-		List::iterator i = messagePos;
-		--i;
-		return *i;
-	};
-
-	using List = std::list<NetMessage>;
-	List::iterator                dataPos;                             ///< Last message which was sent over the network.
-	List::iterator                messagePos;                          ///< Last message which was popped.
-	List                          messages;                            ///< List of messages. Messages are added to the front and read from the back.
+	// Messages are added to the back and read from the front. References to messages stay valid until they are popped.
+	using List = std::deque<NetMessage>;
+	size_t                        dataPos;                             ///< Number of messages which were sent over the network.
+	size_t                        messagePos;                          ///< Number of messages which were popped.
+	List                          messages;                            ///< Messages not yet both sent and popped.
+	std::vector<std::vector<uint8_t>> spareMessageData;                ///< Buffers of popped messages, for reuse by new messages.
 	std::vector<uint8_t>          incompleteReceivedMessageData;       ///< Data from network which has not yet formed an entire message.
 	size_t                        pendingGameTimeUpdateMessages;       ///< Pending GAME_GAME_TIME messages added to this queue
 };
@@ -180,4 +200,27 @@ bool encode_uint32_t(uint8_t &b, uint32_t &v, unsigned n);
 /// Input is b, output is v.
 bool decode_uint32_t(uint8_t b, uint32_t &v, unsigned n);
 
+unsigned encodeAllSlow_uint32_t(uint32_t v, uint8_t *out);
+size_t decodeAllSlow_uint32_t(uint8_t const *data, size_t size, uint32_t &v);
+/// Encodes all of v, into out, which must have room for encodedMaxLength_uint32_t bytes. Returns the number of bytes used.
+inline unsigned encodeAll_uint32_t(uint32_t v, uint8_t *out)
+{
+	if (v < encodedSingleByteLimit_uint32_t)
+	{
+		out[0] = static_cast<uint8_t>(v);  // Most values are small, so skip the tables.
+		return 1;
+	}
+	return encodeAllSlow_uint32_t(v, out);
+}
+/// Decodes all of v from data. Returns the number of bytes used, or 0 if size is too small to hold the whole value.
+inline size_t decodeAll_uint32_t(uint8_t const *data, size_t size, uint32_t &v)
+{
+	if (size != 0 && data[0] < encodedSingleByteLimit_uint32_t)
+	{
+		v = data[0];
+		return 1;
+	}
+	return decodeAllSlow_uint32_t(data, size, v);
+}
+
 #endif //_NET_QUEUE_H_
@@ -0,0 +1,223 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file netrelay.cpp
+ *
+ * Spectator relay, see netrelay.h.
+ */
+
+#include "lib/framework/frame.h"
+#include "netrelay.h"
+#include "netsocket.h"
+
+static const size_t relayMaxViewers = 200;
+
+static unsigned relayPort = 0;
+static Socket *relayListenSocket = nullptr;
+static SocketSet *relayViewerSet = nullptr;
+static std::vector<Socket *> relayViewers;
+static std::vector<SocketSharedWrite> relayHistory;  ///< Everything sent so far, for viewers joining late. Each chunk is compressed once, for all viewers.
+static size_t relayHistoryBytes = 0;
+static std::vector<uint8_t> relayPending;            ///< Data appended since the last NETrelayUpdate.
+static bool relayStreamStarted = false;
+static bool relayStreamEnded = false;
+
+void NETrelaySetPort(unsigned port)
+{
+	relayPort = port;
+}
+
+unsigned NETrelayGetPort()
+{
+	return relayPort;
+}
+
+bool NETrelayListen()
+{
+	if (relayPort == 0 || relayListenSocket != nullptr)
+	{
+		return relayListenSocket != nullptr;
+	}
+
+	relayListenSocket = socketListen(relayPort);
+	if (relayListenSocket == nullptr)
+	{
+		debug(LOG_ERROR, "Could not listen for relay viewers on port %u: %s", relayPort, strSockError(getSockErr()));
+		return false;
+	}
+	relayViewerSet = allocSocketSet();
+	debug(LOG_INFO, "Relaying the game to spectators on port %u.", relayPort);
+	return true;
+}
+
+bool NETrelayIsListening()
+{
+	return relayListenSocket != nullptr;
+}
+
+static void relayDisconnect(size_t i)
+{
+	debug(LOG_INFO, "Relay viewer %s disconnected.", getSocketTextAddress(relayViewers[i]));
+	SocketSet_DelSocket(relayViewerSet, relayViewers[i]);
+	socketClose(relayViewers[i]);
+	relayViewers.erase(relayViewers.begin() + i);
+}
+
+/// Sends the data appended since the last call to all viewers.
+static void relayFlushPending()
+{
+	if (relayPending.empty())
+	{
+		return;
+	}
+
+	relayHistoryBytes += relayPending.size();
+	relayHistory.emplace_back(std::move(relayPending));
+	relayPending = std::vector<uint8_t>();
+	SocketSharedWrite &chunk = relayHistory.back();
+
+	for (size_t i = relayViewers.size(); i-- > 0;)
+	{
+		Socket *viewer = relayViewers[i];
+		if (writeAllShared(viewer, chunk) == SOCKET_ERROR)
+		{
+			relayDisconnect(i);
+			continue;
+		}
+		socketFlush(viewer, 0);
+
+		// Late joiners start with the whole history queued, so only give up on viewers which fall behind by more than that.
+		if (socketPendingWriteBytes(viewer) > relayHistoryBytes + 1024 * 1024)
+		{
+			debug(LOG_WARNING, "Relay viewer %s is not keeping up, disconnecting.", getSocketTextAddress(viewer));
+			relayDisconnect(i);
+		}
+	}
+}
+
+void NETrelayStartStream(std::vector<uint8_t> const &replayHeader)
+{
+	if (relayListenSocket == nullptr)
+	{
+		return;
+	}
+
+	relayHistory.clear();
+	relayHistoryBytes = 0;
+	relayPending.clear();
+	uint32_t size = static_cast<uint32_t>(replayHeader.size());
+	uint8_t sizeBytes[4] = {uint8_t(size >> 24), uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size)};
+	relayPending.insert(relayPending.end(), sizeBytes, sizeBytes + 4);
+	relayPending.insert(relayPending.end(), replayHeader.begin(), replayHeader.end());
+	relayStreamStarted = true;
+	relayStreamEnded = false;
+}
+
+void NETrelayAppend(uint8_t const *data, size_t size)
+{
+	if (!relayStreamStarted || relayStreamEnded)
+	{
+		return;
+	}
+
+	relayPending.insert(relayPending.end(), data, data + size);
+}
+
+void NETrelayEndStream()
+{
+	if (!relayStreamStarted)
+	{
+		return;
+	}
+
+	relayFlushPending();
+	relayStreamEnded = true;
+}
+
+void NETrelayUpdate()
+{
+	if (relayListenSocket == nullptr || !relayStreamStarted)
+	{
+		return;
+	}
+
+	// New viewers get everything so far, then the pending data along with everyone else.
+	while (Socket *viewer = socketAccept(relayListenSocket))
+	{
+		if (relayViewers.size() >= relayMaxViewers)
+		{
+			debug(LOG_INFO, "Too many relay viewers, rejecting %s.", getSocketTextAddress(viewer));
+			socketClose(viewer);
+			continue;
+		}
+		socketBeginCompression(viewer);
+		for (SocketSharedWrite &chunk : relayHistory)
+		{
+			writeAllShared(viewer, chunk);
+		}
+		socketFlush(viewer, 0);
+		SocketSet_AddSocket(relayViewerSet, viewer);
+		relayViewers.push_back(viewer);
+		debug(LOG_INFO, "Relay viewer %s connected, %zu viewers.", getSocketTextAddress(viewer), relayViewers.size());
+	}
+
+	relayFlushPending();
+
+	// Viewers never send anything, so a readable viewer has disconnected.
+	if (!relayViewers.empty() && checkSockets(relayViewerSet, 0) > 0)
+	{
+		for (size_t i = relayViewers.size(); i-- > 0;)
+		{
+			if (!socketReadReady(relayViewers[i]))
+			{
+				continue;
+			}
+			uint8_t buffer[256];
+			ssize_t size = readNoInt(relayViewers[i], buffer, sizeof(buffer));
+			if (size == SOCKET_ERROR || (size == 0 && socketReadDisconnected(relayViewers[i])))
+			{
+				relayDisconnect(i);
+			}
+		}
+	}
+}
+
+void NETrelayShutdown()
+{
+	if (relayListenSocket == nullptr)
+	{
+		return;
+	}
+
+	relayFlushPending();
+	for (Socket *viewer : relayViewers)
+	{
+		socketClose(viewer);  // Sends anything still queued before closing.
+	}
+	relayViewers.clear();
+	deleteSocketSet(relayViewerSet);
+	relayViewerSet = nullptr;
+	socketClose(relayListenSocket);
+	relayListenSocket = nullptr;
+	relayHistory.clear();
+	relayHistoryBytes = 0;
+	relayPending = std::vector<uint8_t>();
+	relayStreamStarted = false;
+	relayStreamEnded = false;
+}
@@ -0,0 +1,48 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file netrelay.h
+ *
+ * Spectator relay. A game instance, typically a spectator of someone else's game, re-serves the replay stream it is
+ * recording to any number of downstream viewers, which watch it as a live replay. Viewers joining late get everything
+ * from the start of the game, and catch up by fast-forwarding.
+ *
+ * The stream is the size of the replay header, then the replay header and messages, exactly as in a replay file.
+ */
+#ifndef _net_relay_h
+#define _net_relay_h
+
+#include "lib/framework/types.h"
+#include <vector>
+
+void NETrelaySetPort(unsigned port);  ///< Relays the next games on the given port. 0 disables the relay.
+unsigned NETrelayGetPort();
+
+bool NETrelayListen();     ///< Starts accepting viewers, if a port is set. Call before NETreplaySaveStart.
+bool NETrelayIsListening();
+void NETrelayShutdown();   ///< Disconnects all viewers, after sending them everything queued. Call after NETreplaySaveStop.
+
+// Called by the replay recording code.
+void NETrelayStartStream(std::vector<uint8_t> const &replayHeader);
+void NETrelayAppend(uint8_t const *data, size_t size);
+void NETrelayEndStream();
+
+void NETrelayUpdate();     ///< Accepts new viewers, and sends them anything new. Call once per frame.
+
+#endif //_net_relay_h
@@ -41,19 +41,52 @@
 #  pragma GCC diagnostic pop
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <ctime>
 #include <memory>
+#include <zlib.h>
 
 #include "netreplay.h"
 #include "netplay.h"
+#include "netrelay.h"
+#include "netsocket.h"
 
 static PHYSFS_file *replaySaveHandle = nullptr;
 static PHYSFS_file *replayLoadHandle = nullptr;
+static uint64_t replaySaveOffset = 0;                   ///< Size of everything written to the replay so far, before compression.
+static std::vector<ReplayKeyframe> replaySaveKeyframes;
+static std::vector<std::vector<uint8_t>> replaySaveSnapshots;  ///< Compressed snapshot of each keyframe, written when the replay ends.
+static std::vector<ReplayKeyframe> replayLoadKeyframes;
+static std::string replayLoadFilename;                  ///< Reopened to read the keyframe snapshots, once the messages are loaded.
+static uint32_t replayLoadGameTimeElapsed = 0;
+static uint64_t replayLoadOffset = 0;                   ///< Size of the header and the messages parsed so far, as replaySaveOffset.
+
+// Live replay, read from a relay instead of a file.
+static const char replayRelayAddressPrefix[] = "wzrelay://";
+static const unsigned replayRelayHeaderTimeout = 15000;
+static const uint32_t replayRelayMaxHeaderSize = 64 * 1024 * 1024;
+static Socket *replayRelaySocket = nullptr;
+static SocketSet *replayRelaySocketSet = nullptr;
+static std::vector<uint8_t> replayRelayInput;  ///< Data received from the relay.
+static size_t replayRelayInputPos = 0;         ///< Data in replayRelayInput before this was already parsed.
+static bool replayRelayEnded = false;          ///< The relay closed the connection.
 
 static const uint32_t magicReplayNumber = 0x575A7270;  // "WZrp"
-static const uint32_t currentReplayFormatVer = 2;
+static const uint32_t currentReplayFormatVer = 3;
 static const size_t DefaultReplayBufferSize = 32768;
 static const size_t MaxReplayBufferSize = 2 * 1024 * 1024;
+static const uint32_t MaxReplayChunkSize = 64 * 1024 * 1024;
+static const uint32_t ReplayChunkUncompressed = 0x80000000;  ///< Set in the stored size of chunks that failed to compress.
+static const size_t ReplayLoadBlockSize = 65536;  ///< Size of the blocks read from uncompressed replays (format 2 and older).
+static const int ReplayLoadAheadChunks = 8;       ///< Number of chunks the load thread may decode ahead of the reader.
+
+static void replayAppendUBE32(std::vector<uint8_t> &data, uint32_t value)
+{
+	uint8_t b[4] = {uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)};
+	data.insert(data.end(), b, b + 4);
+}
 
 typedef std::vector<uint8_t> SerializedNetMessagesBuffer;
 static moodycamel::BlockingReaderWriterQueue<SerializedNetMessagesBuffer> serializedBufferWriteQueue(256);
@@ -61,6 +94,45 @@ static SerializedNetMessagesBuffer latestWriteBuffer;
 static size_t minBufferSizeToQueue = DefaultReplayBufferSize;
 static std::unique_ptr<wz::thread> saveThread;
 
+// Loading reads and decompresses the messages on a thread, ahead of the reader.
+static uint32_t replayLoadFormatVer = 0;
+static PHYSFS_sint64 replayLoadMessagesEnd = -1;  ///< End of the messages in uncompressed replays, where the end of game info starts.
+static moodycamel::BlockingReaderWriterQueue<SerializedNetMessagesBuffer> serializedBufferReadQueue(ReplayLoadAheadChunks + 1);
+static WZ_SEMAPHORE *loadThreadFreeSlots = nullptr;  ///< Number of chunks the load thread may still queue.
+static std::atomic<bool> loadThreadStop(false);
+static std::unique_ptr<wz::thread> loadThread;
+static SerializedNetMessagesBuffer replayLoadInput;  ///< Decoded messages from the load thread.
+static size_t replayLoadInputPos = 0;                ///< Data in replayLoadInput before this was already parsed.
+static bool replayLoadInputEnded = false;            ///< The load thread has queued its last chunk.
+
+/// Since format 3, the messages are stored in zlib compressed chunks, each preceded by its compressed and uncompressed
+/// size, and followed by an empty chunk. A chunk which fails to compress is stored as is, with ReplayChunkUncompressed
+/// set in its stored size.
+static void replayWriteChunk(PHYSFS_file *pSaveHandle, SerializedNetMessagesBuffer const &item)
+{
+	std::vector<uint8_t> chunk(8 + compressBound(static_cast<uLong>(item.size())));
+	uLongf storedSize = static_cast<uLongf>(chunk.size() - 8);
+	uint32_t storedFlags = 0;
+	if (item.empty())
+	{
+		storedSize = 0;
+	}
+	else if (compress2(chunk.data() + 8, &storedSize, item.data(), static_cast<uLong>(item.size()), Z_BEST_COMPRESSION) != Z_OK)
+	{
+		debug(LOG_ERROR, "Failed to compress replay chunk of %zu bytes, storing it uncompressed", item.size());
+		chunk.resize(8 + item.size());
+		std::copy(item.begin(), item.end(), chunk.begin() + 8);
+		storedSize = static_cast<uLongf>(item.size());
+		storedFlags = ReplayChunkUncompressed;
+	}
+	chunk.resize(8 + storedSize);
+	std::vector<uint8_t> sizes;
+	replayAppendUBE32(sizes, static_cast<uint32_t>(storedSize) | storedFlags);
+	replayAppendUBE32(sizes, static_cast<uint32_t>(item.size()));
+	std::copy(sizes.begin(), sizes.end(), chunk.begin());
+	WZ_PHYSFS_writeBytes(pSaveHandle, chunk.data(), chunk.size());
+}
+
 // This function is run in its own thread! Do not call any non-threadsafe functions!
 static void replaySaveThreadFunc(PHYSFS_file *pSaveHandle)
 {
@@ -72,12 +144,12 @@ static void replaySaveThreadFunc(PHYSFS_file *pSaveHandle)
 	while (true)
 	{
 		serializedBufferWriteQueue.wait_dequeue(item);
+		replayWriteChunk(pSaveHandle, item);
 		if (item.empty())
 		{
 			// end chunk - we're done
 			break;
 		}
-		WZ_PHYSFS_writeBytes(pSaveHandle, item.data(), item.size());
 	}
 }
 
@@ -128,7 +200,9 @@ bool NETreplaySaveStart(std::string const& subdir, ReplayOptionsHandler const &o
 
 	WZ_PHYSFS_SETBUFFER(replaySaveHandle, 1024 * 32)//;
 
-	PHYSFS_writeSBE32(replaySaveHandle, magicReplayNumber);
+	// Build the header in memory, since relay spectators get a copy of it.
+	std::vector<uint8_t> header;
+	replayAppendUBE32(header, magicReplayNumber);
 
 	// Save map name or map data and game settings and list of players in game and stuff.
 	nlohmann::json settings = nlohmann::json::object();
@@ -146,8 +220,8 @@ bool NETreplaySaveStart(std::string const& subdir, ReplayOptionsHandler const &o
 	settings["gameOptions"] = gameOptions;
 
 	auto data = settings.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
-	PHYSFS_writeUBE32(replaySaveHandle, data.size());
-	WZ_PHYSFS_writeBytes(replaySaveHandle, data.data(), data.size());
+	replayAppendUBE32(header, data.size());
+	header.insert(header.end(), data.begin(), data.end());
 
 	// Save extra map data (if present)
 	ReplayOptionsHandler::EmbeddedMapData embeddedMapData;
@@ -156,15 +230,18 @@ bool NETreplaySaveStart(std::string const& subdir, ReplayOptionsHandler const &o
 		// Failed to save map data - just empty it out for now
 		embeddedMapData.mapBinaryData.clear();
 	}
-	PHYSFS_writeUBE32(replaySaveHandle, embeddedMapData.dataVersion);
+	replayAppendUBE32(header, embeddedMapData.dataVersion);
 #if SIZE_MAX > UINT32_MAX
 	ASSERT_OR_RETURN(false, embeddedMapData.mapBinaryData.size() <= static_cast<size_t>(std::numeric_limits<uint32_t>::max()), "Embedded map data is way too big");
 #endif
-	PHYSFS_writeUBE32(replaySaveHandle, static_cast<uint32_t>(embeddedMapData.mapBinaryData.size()));
-	if (!embeddedMapData.mapBinaryData.empty())
-	{
-		WZ_PHYSFS_writeBytes(replaySaveHandle, embeddedMapData.mapBinaryData.data(), static_cast<uint32_t>(embeddedMapData.mapBinaryData.size()));
-	}
+	replayAppendUBE32(header, static_cast<uint32_t>(embeddedMapData.mapBinaryData.size()));
+	header.insert(header.end(), embeddedMapData.mapBinaryData.begin(), embeddedMapData.mapBinaryData.end());
+
+	WZ_PHYSFS_writeBytes(replaySaveHandle, header.data(), header.size());
+	NETrelayStartStream(header);
+	replaySaveOffset = header.size();
+	replaySaveKeyframes.clear();
+	replaySaveSnapshots.clear();
 
 	// determine best buffer size
 	size_t desiredBufferSize = optionsHandler.desiredBufferSize();
@@ -209,8 +286,11 @@ bool NETreplaySaveStop()
 
 	// v2: Append the "REPLAY_ENDED" message (from hostPlayer)
 	auto replayEndedMessage = NetMessage(REPLAY_ENDED);
+	size_t start = latestWriteBuffer.size();
 	latestWriteBuffer.push_back(NetPlay.hostPlayer);
 	replayEndedMessage.rawDataAppendToVector(latestWriteBuffer);
+	NETrelayAppend(latestWriteBuffer.data() + start, latestWriteBuffer.size() - start);
+	NETrelayEndStream();
 
 	// Queue the last chunk for writing
 	if (!latestWriteBuffer.empty())
@@ -238,6 +318,26 @@ bool NETreplaySaveStop()
 	// (this is JSON that is preceded *and* followed by its size - so it should be possible to seek to the end of the file, read the last uint32_t, and then back up and grab the JSON without processing the whole file)
 	nlohmann::json endOfGameInfo = nlohmann::json::object();
 	endOfGameInfo["gameTimeElapsed"] = gameTime;
+	if (!replaySaveKeyframes.empty())
+	{
+		// The snapshots go after the messages, so older versions, which stop at the end chunk, skip them.
+		nlohmann::json keyframes = nlohmann::json::array();
+		for (size_t i = 0; i < replaySaveKeyframes.size(); ++i)
+		{
+			ReplayKeyframe const &keyframe = replaySaveKeyframes[i];
+			std::vector<uint8_t> const &snapshot = replaySaveSnapshots[i];
+			PHYSFS_sint64 snapshotPos = PHYSFS_tell(replaySaveHandle);
+			if (snapshot.empty() || snapshotPos < 0 || WZ_PHYSFS_writeBytes(replaySaveHandle, snapshot.data(), snapshot.size()) != static_cast<PHYSFS_sint64>(snapshot.size()))
+			{
+				keyframes.push_back({keyframe.gameTime, keyframe.offset, keyframe.stateHash});
+				continue;
+			}
+			keyframes.push_back({keyframe.gameTime, keyframe.offset, keyframe.stateHash, snapshotPos, static_cast<uint32_t>(snapshot.size()), keyframe.snapshotSize});
+		}
+		endOfGameInfo["keyframes"] = std::move(keyframes);
+		replaySaveKeyframes.clear();
+		replaySaveSnapshots.clear();
+	}
 	// FUTURE TODO: Could save things like the game results / winners + losers
 
 	auto data = endOfGameInfo.dump();
@@ -264,8 +364,11 @@ void NETreplaySaveNetMessage(NetMessage const *message, uint8_t player)
 
 	if (message->type > GAME_MIN_TYPE && message->type < GAME_MAX_TYPE)
 	{
+		size_t start = latestWriteBuffer.size();
 		latestWriteBuffer.push_back(player);
 		message->rawDataAppendToVector(latestWriteBuffer);
+		NETrelayAppend(latestWriteBuffer.data() + start, latestWriteBuffer.size() - start);
+		replaySaveOffset += latestWriteBuffer.size() - start;
 
 		if (latestWriteBuffer.size() >= minBufferSizeToQueue)
 		{
@@ -276,37 +379,125 @@ void NETreplaySaveNetMessage(NetMessage const *message, uint8_t player)
 	}
 }
 
-bool NETreplayLoadStart(std::string const &filename, ReplayOptionsHandler& optionsHandler, uint32_t& output_replayFormatVer)
+bool NETreplaySaveIsActive()
 {
-	auto onFail = [&](char const *reason) {
-		debug(LOG_ERROR, "Could not load replay file %s: %s", filename.c_str(), reason);
-		if (replayLoadHandle != nullptr)
+	return replaySaveHandle != nullptr;
+}
+
+void NETreplaySaveKeyframe(uint32_t gameTime, uint32_t stateHash, std::vector<uint8_t> const &snapshot)
+{
+	if (!replaySaveHandle)
+	{
+		return;
+	}
+
+	// Compressed now, since the snapshots are kept in memory until the end of the game. A keyframe whose snapshot
+	// doesn't compress is kept without it, and can still be checked, but not seeked to.
+	std::vector<uint8_t> stored(compressBound(static_cast<uLong>(snapshot.size())));
+	uLongf storedSize = static_cast<uLongf>(stored.size());
+	if (snapshot.empty() || snapshot.size() > MaxReplayChunkSize || compress2(stored.data(), &storedSize, snapshot.data(), static_cast<uLong>(snapshot.size()), Z_BEST_SPEED) != Z_OK)
+	{
+		debug(LOG_WARNING, "Failed to compress replay keyframe snapshot of %zu bytes", snapshot.size());
+		storedSize = 0;
+	}
+	stored.resize(storedSize);
+	ReplayKeyframe keyframe{gameTime, replaySaveOffset, stateHash};
+	keyframe.snapshotSize = static_cast<uint32_t>(snapshot.size());
+	replaySaveKeyframes.push_back(keyframe);
+	replaySaveSnapshots.push_back(std::move(stored));
+}
+
+/// Reads the replay header, from a replay file or from a relay.
+class ReplayHeaderReader
+{
+public:
+	virtual ~ReplayHeaderReader() = default;
+	virtual bool read(void *buf, size_t size) = 0;
+	virtual bool skip(size_t size) = 0;
+
+	bool readUBE32(uint32_t &value)
+	{
+		uint8_t b[4];
+		if (!read(b, sizeof(b)))
 		{
-			PHYSFS_close(replayLoadHandle);
-			replayLoadHandle = nullptr;
+			return false;
 		}
-		return false;
-	};
+		value = uint32_t(b[0]) << 24 | uint32_t(b[1]) << 16 | uint32_t(b[2]) << 8 | uint32_t(b[3]);
+		return true;
+	}
+};
 
-	replayLoadHandle = PHYSFS_openRead(filename.c_str());
-	if (replayLoadHandle == nullptr)
+class PhysfsReplayHeaderReader : public ReplayHeaderReader
+{
+public:
+	PhysfsReplayHeaderReader(PHYSFS_file *handle_) : handle(handle_) {}
+
+	bool read(void *buf, size_t size) override
+	{
+		return WZ_PHYSFS_readBytes(handle, buf, static_cast<PHYSFS_uint32>(size)) == static_cast<PHYSFS_sint64>(size);
+	}
+	bool skip(size_t size) override
+	{
+		PHYSFS_sint64 filePos = PHYSFS_tell(handle);
+		return filePos >= 0 && PHYSFS_seek(handle, filePos + size) != 0;
+	}
+
+private:
+	PHYSFS_file *handle;
+};
+
+class MemoryReplayHeaderReader : public ReplayHeaderReader
+{
+public:
+	MemoryReplayHeaderReader(uint8_t const *data_, size_t size_) : data(data_), size(size_) {}
+
+	bool read(void *buf, size_t readSize) override
 	{
-		return onFail(WZ_PHYSFS_getLastError());
+		if (readSize > size - pos)
+		{
+			return false;
+		}
+		memcpy(buf, data + pos, readSize);
+		pos += readSize;
+		return true;
 	}
+	bool skip(size_t skipSize) override
+	{
+		if (skipSize > size - pos)
+		{
+			return false;
+		}
+		pos += skipSize;
+		return true;
+	}
+
+private:
+	uint8_t const *data;
+	size_t size;
+	size_t pos = 0;
+};
 
-	int32_t replayNumber = 0;
-	PHYSFS_readSBE32(replayLoadHandle, &replayNumber);
-	if ((uint32_t)replayNumber != magicReplayNumber)
+static bool replayLoadHeader(ReplayHeaderReader &reader, std::string const &name, ReplayOptionsHandler& optionsHandler, uint32_t& output_replayFormatVer)
+{
+	auto onFail = [&](char const *reason) {
+		debug(LOG_ERROR, "Could not load replay file %s: %s", name.c_str(), reason);
+		NETreplayLoadStop();
+		return false;
+	};
+
+	uint32_t replayNumber = 0;
+	if (!reader.readUBE32(replayNumber) || replayNumber != magicReplayNumber)
 	{
 		return onFail("bad header");
 	}
 
 	uint32_t dataSize = 0;
-	PHYSFS_readUBE32(replayLoadHandle, &dataSize);
 	std::string data;
-	data.resize(dataSize);
-	size_t dataRead = WZ_PHYSFS_readBytes(replayLoadHandle, &data[0], data.size());
-	if (dataRead != data.size())
+	if (reader.readUBE32(dataSize))
+	{
+		data.resize(dataSize);
+	}
+	if (data.empty() || !reader.read(&data[0], data.size()))
 	{
 		return onFail("truncated header");
 	}
@@ -340,16 +531,17 @@ bool NETreplayLoadStart(std::string const &filename, ReplayOptionsHandler& optio
 		ReplayOptionsHandler::EmbeddedMapData embeddedMapData;
 		if (replayFormatVer >= 2)
 		{
-			PHYSFS_readUBE32(replayLoadHandle, &embeddedMapData.dataVersion);
 			uint32_t binaryDataSize = 0;
-			PHYSFS_readUBE32(replayLoadHandle, &binaryDataSize);
+			if (!reader.readUBE32(embeddedMapData.dataVersion) || !reader.readUBE32(binaryDataSize))
+			{
+				return onFail("truncated embedded map data");
+			}
 			if (binaryDataSize > 0)
 			{
 				if (binaryDataSize <= optionsHandler.maximumEmbeddedMapBufferSize())
 				{
 					embeddedMapData.mapBinaryData.resize(binaryDataSize);
-					PHYSFS_sint64 binaryDataRead = WZ_PHYSFS_readBytes(replayLoadHandle, embeddedMapData.mapBinaryData.data(), embeddedMapData.mapBinaryData.size());
-					if (binaryDataRead != binaryDataSize)
+					if (!reader.read(embeddedMapData.mapBinaryData.data(), embeddedMapData.mapBinaryData.size()))
 					{
 						return onFail("truncated embedded map data");
 					}
@@ -358,13 +550,7 @@ bool NETreplayLoadStart(std::string const &filename, ReplayOptionsHandler& optio
 				{
 					// don't even bother trying to load this - it's too big
 					// just attempt to skip to where it claims the map data ends
-					PHYSFS_sint64 filePos = PHYSFS_tell(replayLoadHandle);
-					if (filePos < 0)
-					{
-						return onFail("error getting current file position");
-					}
-					PHYSFS_uint64 afterMapDataPos = filePos + binaryDataSize;
-					if (PHYSFS_seek(replayLoadHandle, afterMapDataPos) == 0)
+					if (!reader.skip(binaryDataSize))
 					{
 						return onFail("failed to seek after map data");
 					}
@@ -385,54 +571,485 @@ bool NETreplayLoadStart(std::string const &filename, ReplayOptionsHandler& optio
 		return onFail(parseError.c_str());
 	}
 
+	return true;
+}
+
+/// Reads the end of game info, which is preceded and followed by its size, from the end of the replay file, then seeks back.
+static void replayLoadEndOfGameInfo()
+{
+	PHYSFS_sint64 messagesPos = PHYSFS_tell(replayLoadHandle);
+	PHYSFS_sint64 fileLength = PHYSFS_fileLength(replayLoadHandle);
+	uint32_t size = 0, sizeBefore = 0;
+	replayLoadMessagesEnd = fileLength;
+	if (messagesPos < 0 || fileLength < messagesPos + 8
+	    || !PHYSFS_seek(replayLoadHandle, fileLength - 4) || !PHYSFS_readUBE32(replayLoadHandle, &size)
+	    || size > fileLength - messagesPos - 8
+	    || !PHYSFS_seek(replayLoadHandle, fileLength - 8 - size) || !PHYSFS_readUBE32(replayLoadHandle, &sizeBefore) || sizeBefore != size)
+	{
+		debug(LOG_WZ, "No end of game info in replay, it probably did not end properly");
+		PHYSFS_seek(replayLoadHandle, messagesPos);
+		return;
+	}
+
+	replayLoadMessagesEnd = fileLength - 8 - size;
+	std::vector<char> data(size);
+	if (WZ_PHYSFS_readBytes(replayLoadHandle, data.data(), size) == size)
+	{
+		nlohmann::json endOfGameInfo = nlohmann::json::parse(data.begin(), data.end(), nullptr, false);
+		try
+		{
+			if (endOfGameInfo.is_object())
+			{
+				replayLoadGameTimeElapsed = endOfGameInfo.value("gameTimeElapsed", 0u);
+				auto keyframes = endOfGameInfo.find("keyframes");
+				if (keyframes != endOfGameInfo.end())
+				{
+					for (auto const &keyframe : *keyframes)
+					{
+						replayLoadKeyframes.push_back(ReplayKeyframe{keyframe.at(0).get<uint32_t>(), keyframe.at(1).get<uint64_t>(), keyframe.at(2).get<uint32_t>()});
+						if (keyframe.size() >= 6)
+						{
+							replayLoadKeyframes.back().snapshotPos = keyframe.at(3).get<int64_t>();
+							replayLoadKeyframes.back().snapshotStoredSize = keyframe.at(4).get<uint32_t>();
+							replayLoadKeyframes.back().snapshotSize = keyframe.at(5).get<uint32_t>();
+						}
+					}
+				}
+			}
+		}
+		catch (const std::exception &e)
+		{
+			debug(LOG_WARNING, "Bad end of game info in replay: %s", e.what());
+			replayLoadKeyframes.clear();
+		}
+	}
+	PHYSFS_seek(replayLoadHandle, messagesPos);
+}
+
+/// Reads the next chunk of messages. Returns false at the end of the messages, or on errors.
+static bool replayLoadReadChunk(PHYSFS_file *pLoadHandle, SerializedNetMessagesBuffer &chunk)
+{
+	if (replayLoadFormatVer < 3)
+	{
+		// Uncompressed, so just read the next block, which may end in the middle of a message.
+		PHYSFS_sint64 pos = PHYSFS_tell(pLoadHandle);
+		size_t size = ReplayLoadBlockSize;
+		if (replayLoadMessagesEnd >= 0)
+		{
+			size = static_cast<size_t>(std::max<PHYSFS_sint64>(std::min<PHYSFS_sint64>(size, replayLoadMessagesEnd - pos), 0));
+		}
+		chunk.resize(size);
+		PHYSFS_sint64 read = size != 0 ? WZ_PHYSFS_readBytes(pLoadHandle, chunk.data(), static_cast<PHYSFS_uint32>(size)) : 0;
+		chunk.resize(static_cast<size_t>(std::max<PHYSFS_sint64>(read, 0)));
+		return !chunk.empty();
+	}
+
+	uint32_t storedSize = 0, size = 0;
+	if (!PHYSFS_readUBE32(pLoadHandle, &storedSize) || !PHYSFS_readUBE32(pLoadHandle, &size))
+	{
+		debug(LOG_ERROR, "Replay is truncated");
+		return false;
+	}
+	if (storedSize == 0)
+	{
+		return false;  // End of the messages.
+	}
+	bool uncompressed = (storedSize & ReplayChunkUncompressed) != 0;
+	storedSize &= ~ReplayChunkUncompressed;
+	if (size > MaxReplayChunkSize || storedSize > compressBound(size) || (uncompressed && storedSize != size))
+	{
+		debug(LOG_ERROR, "Bad replay chunk size %u (%u compressed)", size, storedSize);
+		return false;
+	}
+	if (uncompressed)
+	{
+		chunk.resize(size);
+		if (WZ_PHYSFS_readBytes(pLoadHandle, chunk.data(), size) != static_cast<PHYSFS_sint64>(size))
+		{
+			debug(LOG_ERROR, "Replay is truncated");
+			return false;
+		}
+		return true;
+	}
+	std::vector<uint8_t> stored(storedSize);
+	if (WZ_PHYSFS_readBytes(pLoadHandle, stored.data(), storedSize) != static_cast<PHYSFS_sint64>(storedSize))
+	{
+		debug(LOG_ERROR, "Replay is truncated");
+		return false;
+	}
+	chunk.resize(size);
+	uLongf decodedSize = size;
+	if (uncompress(chunk.data(), &decodedSize, stored.data(), storedSize) != Z_OK || decodedSize != size)
+	{
+		debug(LOG_ERROR, "Corrupt replay chunk");
+		return false;
+	}
+	return true;
+}
+
+// This function is run in its own thread! Do not call any non-threadsafe functions!
+static void replayLoadThreadFunc(PHYSFS_file *pLoadHandle)
+{
+	while (true)
+	{
+		wzSemaphoreWait(loadThreadFreeSlots);
+		if (loadThreadStop)
+		{
+			break;
+		}
+		SerializedNetMessagesBuffer chunk;
+		bool more = replayLoadReadChunk(pLoadHandle, chunk);
+		if (!more)
+		{
+			chunk.clear();  // An empty chunk means there are no more.
+		}
+		serializedBufferReadQueue.enqueue(std::move(chunk));
+		if (!more)
+		{
+			break;
+		}
+	}
+}
+
+static void replayLoadStartThread()
+{
+	ASSERT(loadThread.get() == nullptr, "Failed to release prior thread");
+	replayLoadInput.clear();
+	replayLoadInputPos = 0;
+	replayLoadInputEnded = false;
+	loadThreadStop = false;
+	loadThreadFreeSlots = wzSemaphoreCreate(ReplayLoadAheadChunks);
+	loadThread = std::unique_ptr<wz::thread>(new wz::thread(replayLoadThreadFunc, replayLoadHandle));
+}
+
+static void replayLoadStopThread()
+{
+	if (!loadThread)
+	{
+		return;
+	}
+	loadThreadStop = true;
+	wzSemaphorePost(loadThreadFreeSlots);
+	loadThread->join();
+	loadThread.reset();
+	SerializedNetMessagesBuffer chunk;
+	while (serializedBufferReadQueue.try_dequeue(chunk)) {}
+	wzSemaphoreDestroy(loadThreadFreeSlots);
+	loadThreadFreeSlots = nullptr;
+	replayLoadInput = SerializedNetMessagesBuffer();
+	replayLoadInputPos = 0;
+}
+
+std::vector<ReplayKeyframe> const &NETreplayLoadKeyframes()
+{
+	return replayLoadKeyframes;
+}
+
+bool NETreplayLoadKeyframeSnapshot(size_t index, std::vector<uint8_t> &snapshot)
+{
+	ASSERT_OR_RETURN(false, index < replayLoadKeyframes.size(), "No keyframe %zu", index);
+	ReplayKeyframe const &keyframe = replayLoadKeyframes[index];
+	if (keyframe.snapshotPos < 0 || replayLoadFilename.empty())
+	{
+		return false;  // Recorded by an older version, or from a relay.
+	}
+	if (keyframe.snapshotSize > MaxReplayChunkSize || keyframe.snapshotStoredSize > compressBound(keyframe.snapshotSize))
+	{
+		debug(LOG_ERROR, "Bad replay keyframe snapshot size %u (%u compressed)", keyframe.snapshotSize, keyframe.snapshotStoredSize);
+		return false;
+	}
+	PHYSFS_file *handle = PHYSFS_openRead(replayLoadFilename.c_str());
+	if (handle == nullptr)
+	{
+		debug(LOG_ERROR, "Could not reopen replay file %s: %s", replayLoadFilename.c_str(), WZ_PHYSFS_getLastError());
+		return false;
+	}
+	std::vector<uint8_t> stored(keyframe.snapshotStoredSize);
+	bool read = PHYSFS_seek(handle, keyframe.snapshotPos) != 0 && WZ_PHYSFS_readBytes(handle, stored.data(), keyframe.snapshotStoredSize) == static_cast<PHYSFS_sint64>(keyframe.snapshotStoredSize);
+	PHYSFS_close(handle);
+	snapshot.resize(keyframe.snapshotSize);
+	uLongf decodedSize = keyframe.snapshotSize;
+	if (!read || uncompress(snapshot.data(), &decodedSize, stored.data(), keyframe.snapshotStoredSize) != Z_OK || decodedSize != keyframe.snapshotSize)
+	{
+		debug(LOG_ERROR, "Corrupt replay keyframe snapshot at gameTime %u", keyframe.gameTime);
+		snapshot.clear();
+		return false;
+	}
+	return true;
+}
+
+uint32_t NETreplayLoadGameTimeElapsed()
+{
+	return replayLoadGameTimeElapsed;
+}
+
+uint64_t NETreplayLoadOffset()
+{
+	return replayLoadOffset;
+}
+
+bool NETreplayLoadStart(std::string const &filename, ReplayOptionsHandler& optionsHandler, uint32_t& output_replayFormatVer)
+{
+	replayLoadHandle = PHYSFS_openRead(filename.c_str());
+	if (replayLoadHandle == nullptr)
+	{
+		debug(LOG_ERROR, "Could not load replay file %s: %s", filename.c_str(), WZ_PHYSFS_getLastError());
+		return false;
+	}
+
+	PhysfsReplayHeaderReader reader(replayLoadHandle);
+	if (!replayLoadHeader(reader, filename, optionsHandler, output_replayFormatVer))
+	{
+		return false;
+	}
+
+	replayLoadKeyframes.clear();
+	replayLoadFilename = filename;
+	replayLoadGameTimeElapsed = 0;
+	replayLoadOffset = static_cast<uint64_t>(std::max<PHYSFS_sint64>(PHYSFS_tell(replayLoadHandle), 0));
+	replayLoadMessagesEnd = -1;
+	replayLoadFormatVer = output_replayFormatVer;
+	if (output_replayFormatVer >= 2)
+	{
+		replayLoadEndOfGameInfo();
+	}
+	replayLoadStartThread();
+
 	debug(LOG_INFO, "Started reading replay file \"%s\".", filename.c_str());
 	return true;
 }
 
-bool NETreplayLoadNetMessage(std::unique_ptr<NetMessage> &message, uint8_t &player)
+bool NETisReplayRelayAddress(std::string const &name)
 {
-	if (!replayLoadHandle)
+	return name.compare(0, strlen(replayRelayAddressPrefix), replayRelayAddressPrefix) == 0;
+}
+
+/// Reads whatever the relay has sent. Returns false, and marks the stream as ended, if the connection is gone.
+static bool replayRelayReceive(unsigned timeout)
+{
+	if (replayRelayEnded)
 	{
 		return false;
 	}
+	int ready = checkSockets(replayRelaySocketSet, timeout);
+	if (ready == SOCKET_ERROR)
+	{
+		replayRelayEnded = true;
+		return false;
+	}
+	if (ready == 0 || !socketReadReady(replayRelaySocket))
+	{
+		return true;
+	}
 
-	WZ_PHYSFS_readBytes(replayLoadHandle, &player, 1);
+	// Drop the data that was already parsed, before adding more.
+	if (replayRelayInputPos > 0)
+	{
+		replayRelayInput.erase(replayRelayInput.begin(), replayRelayInput.begin() + replayRelayInputPos);
+		replayRelayInputPos = 0;
+	}
 
-	uint8_t type;
-	WZ_PHYSFS_readBytes(replayLoadHandle, &type, 1);
+	uint8_t buffer[16384];
+	ssize_t size = readNoInt(replayRelaySocket, buffer, sizeof(buffer));
+	if (size == SOCKET_ERROR || (size == 0 && socketReadDisconnected(replayRelaySocket)))
+	{
+		debug(LOG_INFO, "Relay connection closed.");
+		replayRelayEnded = true;
+		return false;
+	}
+	replayRelayInput.insert(replayRelayInput.end(), buffer, buffer + size);
+	return true;
+}
 
-	uint32_t len = 0;
-	uint8_t b;
-	unsigned n = 0;
-	bool rd;
-	do
+/// Waits until at least size unparsed bytes have arrived from the relay.
+static bool replayRelayWaitFor(size_t size, unsigned timeout)
+{
+	int deadline = wzGetTicks() + timeout;
+	while (replayRelayInput.size() - replayRelayInputPos < size)
 	{
-		rd = WZ_PHYSFS_readBytes(replayLoadHandle, &b, 1);
-	} while (decode_uint32_t(b, len, n++));
+		int remaining = deadline - wzGetTicks();
+		if (remaining <= 0 || !replayRelayReceive(std::min<unsigned>(remaining, 100)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
-	if (!rd)
+bool NETreplayLoadStartRelay(std::string const &address, ReplayOptionsHandler& optionsHandler, uint32_t& output_replayFormatVer)
+{
+	ASSERT_OR_RETURN(false, NETisReplayRelayAddress(address), "Not a relay address: %s", address.c_str());
+	std::string hostPort = address.substr(strlen(replayRelayAddressPrefix));
+	size_t colon = hostPort.rfind(':');
+	std::string host = hostPort.substr(0, colon);
+	unsigned port = colon != std::string::npos ? atoi(hostPort.c_str() + colon + 1) : NETgetGameserverPort();
+	if (host.size() > 2 && host.front() == '[' && host.back() == ']')
+	{
+		host = host.substr(1, host.size() - 2);  // [IPv6 address]
+	}
+
+	SocketAddress *addr = resolveHost(host.c_str(), port);
+	if (addr == nullptr)
+	{
+		debug(LOG_ERROR, "Could not resolve relay %s: %s", address.c_str(), strSockError(getSockErr()));
+		return false;
+	}
+	replayRelaySocket = socketOpenAny(addr, 15000);
+	deleteSocketAddress(addr);
+	if (replayRelaySocket == nullptr)
+	{
+		debug(LOG_ERROR, "Could not connect to relay %s: %s", address.c_str(), strSockError(getSockErr()));
+		return false;
+	}
+	socketBeginCompression(replayRelaySocket);
+	replayRelaySocketSet = allocSocketSet();
+	SocketSet_AddSocket(replayRelaySocketSet, replayRelaySocket);
+	replayRelayInput.clear();
+	replayRelayInputPos = 0;
+	replayRelayEnded = false;
+
+	// The relay sends the size of the replay header, then the header, then the messages so far, then live messages.
+	uint32_t headerSize = 0;
+	if (replayRelayWaitFor(4, replayRelayHeaderTimeout))
+	{
+		MemoryReplayHeaderReader sizeReader(replayRelayInput.data(), 4);
+		sizeReader.readUBE32(headerSize);
+	}
+	if (headerSize == 0 || headerSize > replayRelayMaxHeaderSize || !replayRelayWaitFor(4 + headerSize, replayRelayHeaderTimeout))
+	{
+		debug(LOG_ERROR, "Could not load replay header from relay %s", address.c_str());
+		NETreplayLoadStop();
+		return false;
+	}
+	MemoryReplayHeaderReader reader(replayRelayInput.data() + 4, headerSize);
+	if (!replayLoadHeader(reader, address, optionsHandler, output_replayFormatVer))
 	{
 		return false;
 	}
+	replayRelayInputPos = 4 + headerSize;
+	replayLoadKeyframes.clear();
+	replayLoadFilename.clear();
+	replayLoadGameTimeElapsed = 0;
+	replayLoadOffset = headerSize;
 
-	message = std::unique_ptr<NetMessage>(new NetMessage(type));
-	message->data.resize(len);
-	size_t messageRead = WZ_PHYSFS_readBytes(replayLoadHandle, message->data.data(), message->data.size());
-	if (messageRead != message->data.size())
+	debug(LOG_INFO, "Started reading replay from relay \"%s\".", address.c_str());
+	return true;
+}
+
+bool NETreplayLoadIsLive()
+{
+	return replayRelaySocket != nullptr;
+}
+
+bool NETreplayLoadLiveEnded()
+{
+	return replayRelayEnded;
+}
+
+/// Parses the message at input[pos], if all of it is there.
+static bool replayParseNetMessage(std::vector<uint8_t> const &input, size_t &pos, std::unique_ptr<NetMessage> &message, uint8_t &player)
+{
+	uint8_t const *data = input.data() + pos;
+	size_t size = input.size() - pos;
+
+	uint32_t len = 0;
+	bool moreBytes = true;
+	size_t n;
+	for (n = 0; moreBytes && 2 + n < size; ++n)
+	{
+		moreBytes = decode_uint32_t(data[2 + n], len, n);
+	}
+	size_t headerLen = 2 + n;
+	if (moreBytes || size - headerLen < len)
 	{
 		return false;
 	}
+	player = data[0];
+	message = std::unique_ptr<NetMessage>(new NetMessage(data[1]));
+	message->data.assign(data + headerLen, data + headerLen + len);
+	pos += headerLen + len;
+	replayLoadOffset += headerLen + len;
+	return true;
+}
 
-	return (message->type > GAME_MIN_TYPE && message->type < GAME_MAX_TYPE) || message->type == REPLAY_ENDED;
+static bool replayIsValidMessageType(NetMessage const &message)
+{
+	return (message.type > GAME_MIN_TYPE && message.type < GAME_MAX_TYPE) || message.type == REPLAY_ENDED;
+}
+
+/// Parses the next message received from the relay, without waiting for more data.
+static bool replayRelayLoadNetMessage(std::unique_ptr<NetMessage> &message, uint8_t &player)
+{
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		if (replayParseNetMessage(replayRelayInput, replayRelayInputPos, message, player))
+		{
+			return replayIsValidMessageType(*message);
+		}
+
+		// Don't have a whole message ready yet.
+		if (attempt == 0 && !replayRelayReceive(0))
+		{
+			break;
+		}
+	}
+	return false;
+}
+
+bool NETreplayLoadNetMessage(std::unique_ptr<NetMessage> &message, uint8_t &player)
+{
+	if (replayRelaySocket != nullptr)
+	{
+		return replayRelayLoadNetMessage(message, player);
+	}
+
+	if (!replayLoadHandle || !loadThread)
+	{
+		return false;
+	}
+
+	while (!replayParseNetMessage(replayLoadInput, replayLoadInputPos, message, player))
+	{
+		if (replayLoadInputEnded)
+		{
+			return false;
+		}
+		SerializedNetMessagesBuffer chunk;
+		serializedBufferReadQueue.wait_dequeue(chunk);
+		wzSemaphorePost(loadThreadFreeSlots);
+		if (chunk.empty())
+		{
+			replayLoadInputEnded = true;
+			continue;
+		}
+		replayLoadInput.erase(replayLoadInput.begin(), replayLoadInput.begin() + replayLoadInputPos);
+		replayLoadInputPos = 0;
+		replayLoadInput.insert(replayLoadInput.end(), chunk.begin(), chunk.end());
+	}
+
+	return replayIsValidMessageType(*message);
 }
 
 bool NETreplayLoadStop()
 {
+	// The keyframes and the length of the replay are still needed while playing it, after loading all messages.
+	if (replayRelaySocket != nullptr)
+	{
+		socketClose(replayRelaySocket);
+		replayRelaySocket = nullptr;
+		deleteSocketSet(replayRelaySocketSet);
+		replayRelaySocketSet = nullptr;
+		replayRelayInput = std::vector<uint8_t>();
+		replayRelayInputPos = 0;
+		return true;
+	}
+
 	if (!replayLoadHandle)
 	{
 		return false;
 	}
 
+	replayLoadStopThread();
 	if (!PHYSFS_close(replayLoadHandle))
 	{
 		debug(LOG_ERROR, "Could not close replay file: %s", WZ_PHYSFS_getLastError());
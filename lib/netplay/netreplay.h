@@ -29,8 +29,33 @@ bool NETreplaySaveStart(std::string const& subdir, ReplayOptionsHandler const &o
 bool NETreplaySaveStop();
 void NETreplaySaveNetMessage(NetMessage const *message, uint8_t player);
 
+/// A point in a replay where the state hash of the world is known, for checking and seeking. The index of keyframes
+/// is saved in the end of game info, so replays without one still load. The snapshot of the world at each keyframe is
+/// stored compressed between the messages and the end of game info, where older versions don't look.
+struct ReplayKeyframe
+{
+	uint32_t gameTime;
+	uint64_t offset;                  ///< Offset of the first message after the keyframe, counting the messages before compression.
+	uint32_t stateHash;
+	int64_t snapshotPos = -1;         ///< Position of the compressed snapshot in the replay file, or -1 if there is none.
+	uint32_t snapshotStoredSize = 0;  ///< Compressed size of the snapshot.
+	uint32_t snapshotSize = 0;
+};
+bool NETreplaySaveIsActive();
+void NETreplaySaveKeyframe(uint32_t gameTime, uint32_t stateHash, std::vector<uint8_t> const &snapshot);
+
 bool NETreplayLoadStart(std::string const &filename, ReplayOptionsHandler& optionsHandler, uint32_t& output_replayFormatVer);
 bool NETreplayLoadNetMessage(std::unique_ptr<NetMessage> &message, uint8_t &player);
 bool NETreplayLoadStop();
+std::vector<ReplayKeyframe> const &NETreplayLoadKeyframes();  ///< Empty if the replay has none. Still valid after NETreplayLoadStop().
+bool NETreplayLoadKeyframeSnapshot(size_t index, std::vector<uint8_t> &snapshot);  ///< Reads the snapshot of a keyframe from the replay file.
+uint32_t NETreplayLoadGameTimeElapsed();                       ///< Length of the replay, or 0 if unknown.
+uint64_t NETreplayLoadOffset();                                ///< Offset of the next message, as in ReplayKeyframe::offset.
+
+// Live replays, streamed by a relay (see netrelay.h). Addresses look like "wzrelay://host:port".
+bool NETisReplayRelayAddress(std::string const &name);
+bool NETreplayLoadStartRelay(std::string const &address, ReplayOptionsHandler& optionsHandler, uint32_t& output_replayFormatVer);
+bool NETreplayLoadIsLive();     ///< True if the replay being loaded comes from a relay. NETreplayLoadNetMessage then only returns messages which have already arrived.
+bool NETreplayLoadLiveEnded();  ///< True if the relay closed the connection.
 
 #endif // _NETREPLAY_H
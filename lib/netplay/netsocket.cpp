@@ -26,15 +26,30 @@
 #include "lib/framework/frame.h"
 #include "lib/framework/wzapp.h"
 #include "netsocket.h"
+#include "netsocketcodec.h"
 
 #include <vector>
 #include <algorithm>
+#include <deque>
 #include <map>
 
-#if !defined(ZLIB_CONST)
-#  define ZLIB_CONST
+#if defined(WZ_OS_UNIX)
+# include <sys/uio.h>
+# if defined(HAVE_POLL_H)
+#  include <poll.h>
+#  define WZ_SOCKET_POLL
+# elif defined(HAVE_SYS_POLL_H)
+#  include <sys/poll.h>
+#  define WZ_SOCKET_POLL
+# endif
+# if defined(HAVE_SYS_EPOLL_H) && defined(WZ_SOCKET_POLL)
+#  include <sys/epoll.h>
+#  define WZ_SOCKET_EPOLL  // Used by the socket thread, checkSockets() still uses poll().
+# endif
+# if defined(HAVE_SYS_EVENTFD_H)
+#  include <sys/eventfd.h>
+# endif
 #endif
-#include <zlib.h>
 
 #if defined(__clang__)
 	#pragma clang diagnostic ignored "-Wshorten-64-to-32" // FIXME!!
@@ -56,27 +71,24 @@ struct Socket
 	 *
 	 * All non-listening sockets will only use the first socket handle.
 	 */
-	Socket() : ready(false), writeError(false), deleteLater(false), isCompressed(false), readDisconnected(false), zDeflateInSize(0)
-	{
-		memset(&zDeflate, 0, sizeof(zDeflate));
-		memset(&zInflate, 0, sizeof(zInflate));
-	}
-	~Socket();
+	Socket() : ready(false), writeError(false), deleteLater(false), writeBackedUp(false), isCompressed(false), readDisconnected(false), codec(SocketCodecType::None), encodeInSize(0)
+	{}
 
 	SOCKET fd[SOCK_COUNT];
 	bool ready;
 	bool writeError;
 	bool deleteLater;
+	bool writeBackedUp;     ///< True iff pending writes exceeded socketWriteHighWatermark, and haven't yet drained below socketWriteLowWatermark.
 	char textAddress[40] = {};
 
-	bool isCompressed;
+	bool isCompressed;      ///< True iff data goes through the encoder and decoder, even if the codec doesn't actually compress.
 	bool readDisconnected;  ///< True iff a call to recv() returned 0.
-	z_stream zDeflate;
-	z_stream zInflate;
-	unsigned zDeflateInSize;
-	bool zInflateNeedInput;
-	std::vector<uint8_t> zDeflateOutBuf;
-	std::vector<uint8_t> zInflateInBuf;
+	SocketCodecType codec;
+	std::unique_ptr<SocketEncoder> encoder;
+	std::unique_ptr<SocketDecoder> decoder;
+	unsigned encodeInSize;
+	std::vector<uint8_t> encodeOutBuf;
+	std::vector<uint8_t> decodeInBuf;
 };
 
 struct SocketSet
@@ -85,12 +97,126 @@ struct SocketSet
 };
 
 
+/// Pending output of a socket, as a chain of buffers, so that partial sends don't need to move the rest of the data.
+class SocketWriteQueue
+{
+public:
+	bool empty() const
+	{
+		return totalSize == 0;
+	}
+	size_t size() const
+	{
+		return totalSize;
+	}
+	void append(uint8_t const *data, size_t dataSize);
+	ssize_t send(SOCKET fd);  ///< Sends as much as possible in one call, returns the number of bytes sent or SOCKET_ERROR.
+
+private:
+	void consume(size_t count);
+
+	static const size_t chunkSize = 16384;
+	static const size_t maxChunksPerSend = 64;
+	std::deque<std::vector<uint8_t>> chunks;
+	size_t frontOffset = 0;  ///< Bytes of chunks.front() already sent.
+	size_t totalSize = 0;
+};
+
+void SocketWriteQueue::append(uint8_t const *data, size_t dataSize)
+{
+	while (dataSize > 0)
+	{
+		if (chunks.empty() || chunks.back().size() >= chunkSize)
+		{
+			chunks.emplace_back();
+			chunks.back().reserve(chunkSize);
+		}
+		std::vector<uint8_t> &chunk = chunks.back();
+		size_t count = std::min(dataSize, chunkSize - chunk.size());
+		chunk.insert(chunk.end(), data, data + count);
+		data += count;
+		dataSize -= count;
+		totalSize += count;
+	}
+}
+
+ssize_t SocketWriteQueue::send(SOCKET fd)
+{
+	size_t numBufs = std::min(chunks.size(), size_t(maxChunksPerSend));
+#if defined(WZ_OS_WIN)
+	WSABUF bufs[maxChunksPerSend];
+	for (size_t i = 0; i < numBufs; ++i)
+	{
+		size_t offset = i == 0 ? frontOffset : 0;
+		bufs[i].buf = reinterpret_cast<char *>(&chunks[i][offset]);
+		bufs[i].len = chunks[i].size() - offset;
+	}
+	DWORD sent = 0;
+	if (WSASend(fd, bufs, numBufs, &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+	{
+		return SOCKET_ERROR;
+	}
+	ssize_t ret = sent;
+#else
+	struct iovec bufs[maxChunksPerSend];
+	for (size_t i = 0; i < numBufs; ++i)
+	{
+		size_t offset = i == 0 ? frontOffset : 0;
+		bufs[i].iov_base = &chunks[i][offset];
+		bufs[i].iov_len = chunks[i].size() - offset;
+	}
+	struct msghdr msg = {};
+	msg.msg_iov = bufs;
+	msg.msg_iovlen = numBufs;
+	ssize_t ret = sendmsg(fd, &msg, MSG_NOSIGNAL);  // Like writev(), but can avoid SIGPIPE.
+	if (ret == SOCKET_ERROR)
+	{
+		return SOCKET_ERROR;
+	}
+#endif
+	consume(ret);
+	return ret;
+}
+
+void SocketWriteQueue::consume(size_t count)
+{
+	ASSERT_OR_RETURN(, count <= totalSize, "Consumed more than queued");
+	totalSize -= count;
+	while (count > 0)
+	{
+		size_t remaining = chunks.front().size() - frontOffset;
+		if (count < remaining)
+		{
+			frontOffset += count;
+			return;
+		}
+		count -= remaining;
+		chunks.pop_front();
+		frontOffset = 0;
+	}
+}
+
+/// Shared writes smaller than this go through the per-socket compression, which compresses small messages better, since it can refer to earlier data.
+static const size_t socketSharedDeflateMinSize = 256;
+
+static WZ_MUTEX *sharedDeflateMutex;
+
+/// Pending writes above this many bytes mean the peer isn't keeping up.
+static const size_t socketWriteHighWatermark = 1 << 20;
+static const size_t socketWriteLowWatermark = socketWriteHighWatermark / 4;
+
 static WZ_MUTEX *socketThreadMutex;
 static WZ_SEMAPHORE *socketThreadSemaphore;
 static WZ_THREAD *socketThread = nullptr;
 static bool socketThreadQuit;
-typedef std::map<Socket *, std::vector<uint8_t>> SocketThreadWriteMap;
+typedef std::map<Socket *, SocketWriteQueue> SocketThreadWriteMap;
 static SocketThreadWriteMap socketThreadWrites;
+#if defined(WZ_SOCKET_POLL)
+static int socketThreadWakeFd[2] = {-1, -1};  ///< Written to wake up the socket thread, which waits on the read end. Both ends are the same eventfd, if available.
+#endif
+#if defined(WZ_SOCKET_EPOLL)
+static int socketThreadEpollFd = -1;  ///< Sockets with pending writes, registered for EPOLLOUT.
+#endif
 
 
 static void socketCloseNow(Socket *sock);
@@ -392,128 +518,238 @@ static bool connectionIsOpen(Socket *sock)
 	return true;
 }
 
-static int socketThreadFunction(void *)
+/// Wakes up the socket thread, if it is waiting for sockets to become writable, or waiting for something to write.
+static void socketThreadWake()
 {
-	wzMutexLock(socketThreadMutex);
-	while (!socketThreadQuit)
+#if defined(WZ_SOCKET_POLL)
+	uint64_t one = 1;  // Eventfd needs exactly 8 bytes, a pipe doesn't care.
+	if (write(socketThreadWakeFd[1], &one, sizeof(one)) == SOCKET_ERROR && errno != EAGAIN)
 	{
-#if   defined(WZ_OS_UNIX)
-		SOCKET maxfd = INT_MIN;
-#elif defined(WZ_OS_WIN)
-		SOCKET maxfd = 0;
+		debug(LOG_ERROR, "Failed to wake socket thread: %s", strSockError(getSockErr()));
+	}
+#else
+	wzSemaphorePost(socketThreadSemaphore);
 #endif
-		fd_set fds;
-		FD_ZERO(&fds);
-		size_t descriptorsToWaitOn = 0;
-		for (SocketThreadWriteMap::iterator i = socketThreadWrites.begin(); i != socketThreadWrites.end();)
+}
+
+#if defined(WZ_SOCKET_POLL)
+static void socketThreadDrainWake()
+{
+	uint64_t buf[16];
+	while (read(socketThreadWakeFd[0], buf, sizeof(buf)) > 0)
+	{}
+}
+#endif
+
+/// Returns the pending writes of the socket, registering the socket with the socket thread if needed. Must hold socketThreadMutex.
+static SocketWriteQueue &socketThreadWriteQueue(Socket *sock)
+{
+	SocketThreadWriteMap::iterator i = socketThreadWrites.find(sock);
+	if (i != socketThreadWrites.end())
+	{
+		return i->second;
+	}
+
+#if defined(WZ_SOCKET_EPOLL)
+	// An epoll_wait in progress sees the new socket, no need to wake the thread.
+	struct epoll_event event = {};
+	event.events = EPOLLOUT;
+	event.data.ptr = sock;
+	if (epoll_ctl(socketThreadEpollFd, EPOLL_CTL_ADD, sock->fd[SOCK_CONNECTION], &event) == SOCKET_ERROR)
+	{
+		debug(LOG_ERROR, "Failed to add socket to epoll set: %s", strSockError(getSockErr()));
+	}
+#elif defined(WZ_SOCKET_POLL)
+	socketThreadWake();  // Thread must rebuild its list of descriptors.
+#else
+	if (socketThreadWrites.empty())
+	{
+		socketThreadWake();  // Thread is waiting on the semaphore.
+	}
+#endif
+	return socketThreadWrites[sock];
+}
+
+/// Stops writing to the socket, and closes it if it was waiting to be closed. Must hold socketThreadMutex.
+static void socketThreadWritesErase(SocketThreadWriteMap::iterator w)
+{
+	Socket *sock = w->first;
+#if defined(WZ_SOCKET_EPOLL)
+	struct epoll_event event = {};  // Ignored, but must not be null on old kernels.
+	epoll_ctl(socketThreadEpollFd, EPOLL_CTL_DEL, sock->fd[SOCK_CONNECTION], &event);
+#endif
+	socketThreadWrites.erase(w);
+	if (sock->deleteLater)
+	{
+		socketCloseNow(sock);
+	}
+}
+
+/// Waits until some of the sockets with pending writes are writable. Must hold socketThreadMutex, which is released while waiting.
+static void socketThreadWaitWritable(std::vector<Socket *> &writable)
+{
+	writable.clear();
+
+#if defined(WZ_SOCKET_EPOLL)
+	struct epoll_event events[64];
+	wzMutexUnlock(socketThreadMutex);
+	int ret = epoll_wait(socketThreadEpollFd, events, ARRAY_SIZE(events), -1);
+	wzMutexLock(socketThreadMutex);
+	for (int i = 0; i < ret; ++i)
+	{
+		if (events[i].data.ptr == nullptr)
 		{
-			if (!i->second.empty())
-			{
-				SOCKET fd = i->first->fd[SOCK_CONNECTION];
-				maxfd = std::max(maxfd, fd);
-				ASSERT(!FD_ISSET(fd, &fds), "Duplicate file descriptor!");  // Shouldn't be possible, but blocking in send, after select says it won't block, shouldn't be possible either.
-				FD_SET(fd, &fds);
-				++descriptorsToWaitOn;
-				++i;
-			}
-			else
-			{
-				ASSERT(false, "Empty buffer for pending socket writes"); // This shouldn't happen!
-				Socket *sock = i->first;
-				i = socketThreadWrites.erase(i);
-				if (sock->deleteLater)
-				{
-					socketCloseNow(sock);
-				}
-			}
+			socketThreadDrainWake();
+			continue;
 		}
-		struct timeval tv = {0, 50 * 1000};
-
-		// Check if we can write to any sockets.
-		int ret = -1;
-		if (descriptorsToWaitOn > 0)
+		writable.push_back(static_cast<Socket *>(events[i].data.ptr));  // Includes errors, so that send() can report them.
+	}
+#elif defined(WZ_SOCKET_POLL)
+	std::vector<struct pollfd> fds(1);
+	fds[0].fd = socketThreadWakeFd[0];
+	fds[0].events = POLLIN;
+	std::vector<Socket *> socks(1, nullptr);
+	for (SocketThreadWriteMap::const_iterator i = socketThreadWrites.begin(); i != socketThreadWrites.end(); ++i)
+	{
+		struct pollfd fd = {};
+		fd.fd = i->first->fd[SOCK_CONNECTION];
+		fd.events = POLLOUT;
+		fds.push_back(fd);
+		socks.push_back(i->first);
+	}
+	wzMutexUnlock(socketThreadMutex);
+	int ret = poll(&fds[0], fds.size(), -1);
+	wzMutexLock(socketThreadMutex);
+	if (ret > 0 && fds[0].revents != 0)
+	{
+		socketThreadDrainWake();
+	}
+	for (size_t i = 1; ret > 0 && i < fds.size(); ++i)
+	{
+		if (fds[i].revents != 0)
 		{
-			wzMutexUnlock(socketThreadMutex);
-			ret = select(maxfd + 1, nullptr, &fds, nullptr, &tv);
-			wzMutexLock(socketThreadMutex);
+			writable.push_back(socks[i]);
 		}
+	}
+#else
+	if (socketThreadWrites.empty())
+	{
+		// Nothing to do, expect to wait.
+		wzMutexUnlock(socketThreadMutex);
+		wzSemaphoreWait(socketThreadSemaphore);
+		wzMutexLock(socketThreadMutex);
+		return;
+	}
+
+	SOCKET maxfd = 0;
+	fd_set fds;
+	FD_ZERO(&fds);
+	for (SocketThreadWriteMap::const_iterator i = socketThreadWrites.begin(); i != socketThreadWrites.end(); ++i)
+	{
+		SOCKET fd = i->first->fd[SOCK_CONNECTION];
+		maxfd = std::max(maxfd, fd);
+		ASSERT(!FD_ISSET(fd, &fds), "Duplicate file descriptor!");  // Shouldn't be possible, but blocking in send, after select says it won't block, shouldn't be possible either.
+		FD_SET(fd, &fds);
+	}
+	struct timeval tv = {0, 50 * 1000};  // Can't wake up select() when new writes are queued, so poll.
+
+	wzMutexUnlock(socketThreadMutex);
+	int ret = select(maxfd + 1, nullptr, &fds, nullptr, &tv);
+	wzMutexLock(socketThreadMutex);
 
-		// We can write to some sockets. (Ignore errors from select, we may have deleted the socket after unlocking the mutex, and before calling select.)
-		if (ret > 0)
+	// Ignore errors from select, we may have deleted the socket after unlocking the mutex, and before calling select.
+	for (SocketThreadWriteMap::const_iterator i = socketThreadWrites.begin(); ret > 0 && i != socketThreadWrites.end(); ++i)
+	{
+		if (FD_ISSET(i->first->fd[SOCK_CONNECTION], &fds))
 		{
-			for (SocketThreadWriteMap::iterator i = socketThreadWrites.begin(); i != socketThreadWrites.end();)
-			{
-				SocketThreadWriteMap::iterator w = i;
-				++i;
+			writable.push_back(i->first);
+		}
+	}
+#endif
+}
 
-				Socket *sock = w->first;
-				std::vector<uint8_t> &writeQueue = w->second;
-				ASSERT(!writeQueue.empty(), "writeQueue[sock] must not be empty.");
+/// Notes whether the socket has too much pending output. Must hold socketThreadMutex.
+static void socketCheckWriteWatermark(Socket *sock, size_t pending)
+{
+	if (!sock->writeBackedUp && pending > socketWriteHighWatermark)
+	{
+		sock->writeBackedUp = true;
+		debug(LOG_WARNING, "Socket %s has %zu bytes of pending writes, peer is not keeping up.", sock->textAddress, pending);
+	}
+	else if (sock->writeBackedUp && pending < socketWriteLowWatermark)
+	{
+		sock->writeBackedUp = false;
+		debug(LOG_NET, "Socket %s has caught up with pending writes.", sock->textAddress);
+	}
+}
 
-				if (!FD_ISSET(sock->fd[SOCK_CONNECTION], &fds))
-				{
-					continue;  // This socket is not ready for writing, or we don't have anything to write.
-				}
+static void socketThreadWrite(SocketThreadWriteMap::iterator w)
+{
+	Socket *sock = w->first;
+	SocketWriteQueue &writeQueue = w->second;
+	if (writeQueue.empty())
+	{
+		ASSERT(false, "Empty buffer for pending socket writes"); // This shouldn't happen!
+		socketThreadWritesErase(w);
+		return;
+	}
 
-				// Write data.
-				// FIXME SOMEHOW AAARGH This send() call can't block, but unless the socket is not set to blocking (setting the socket to nonblocking had better work, or else), does anyway (at least sometimes, when someone quits). Not reproducible except in public releases.
-				ssize_t retSent = send(sock->fd[SOCK_CONNECTION], reinterpret_cast<char *>(&writeQueue[0]), writeQueue.size(), MSG_NOSIGNAL);
-				if (retSent != SOCKET_ERROR)
-				{
-					// Erase as much data as written.
-					writeQueue.erase(writeQueue.begin(), writeQueue.begin() + retSent);
-					if (writeQueue.empty())
-					{
-						socketThreadWrites.erase(w);  // Nothing left to write, delete from pending list.
-						if (sock->deleteLater)
-						{
-							socketCloseNow(sock);
-						}
-					}
-				}
-				else
-				{
-					switch (getSockErr())
-					{
-					case EAGAIN:
+	// Write data, removing as much data as written from the queue.
+	// FIXME SOMEHOW AAARGH This send() call can't block, but unless the socket is not set to blocking (setting the socket to nonblocking had better work, or else), does anyway (at least sometimes, when someone quits). Not reproducible except in public releases.
+	ssize_t retSent = writeQueue.send(sock->fd[SOCK_CONNECTION]);
+	if (retSent != SOCKET_ERROR)
+	{
+		socketCheckWriteWatermark(sock, writeQueue.size());
+		if (writeQueue.empty())
+		{
+			socketThreadWritesErase(w);  // Nothing left to write, delete from pending list.
+		}
+		return;
+	}
+
+	switch (getSockErr())
+	{
+	case EAGAIN:
 #if defined(EWOULDBLOCK) && EAGAIN != EWOULDBLOCK
-					case EWOULDBLOCK:
+	case EWOULDBLOCK:
 #endif
-						if (!connectionIsOpen(sock))
-						{
-							debug(LOG_NET, "Socket error");
-							sock->writeError = true;
-							socketThreadWrites.erase(w);  // Socket broken, don't try writing to it again.
-							if (sock->deleteLater)
-							{
-								socketCloseNow(sock);
-							}
-							break;
-						}
-					case EINTR:
-						break;
+		if (!connectionIsOpen(sock))
+		{
+			debug(LOG_NET, "Socket error");
+			sock->writeError = true;
+			socketThreadWritesErase(w);  // Socket broken, don't try writing to it again.
+			break;
+		}
+	case EINTR:
+		break;
 #if defined(EPIPE)
-					case EPIPE:
+	case EPIPE:
 #endif
-					default:
-						sock->writeError = true;
-						socketThreadWrites.erase(w);  // Socket broken, don't try writing to it again.
-						if (sock->deleteLater)
-						{
-							socketCloseNow(sock);
-						}
-						break;
-					}
-				}
-			}
-		}
+	default:
+		sock->writeError = true;
+		socketThreadWritesErase(w);  // Socket broken, don't try writing to it again.
+		break;
+	}
+}
+
+static int socketThreadFunction(void *)
+{
+	std::vector<Socket *> writable;
+
+	wzMutexLock(socketThreadMutex);
+	while (!socketThreadQuit)
+	{
+		// Waits without a timeout, unless using select(). Queuing writes to a new socket or quitting wakes us up.
+		socketThreadWaitWritable(writable);
 
-		if (socketThreadWrites.empty())
+		for (Socket *sock : writable)
 		{
-			// Nothing to do, expect to wait.
-			wzMutexUnlock(socketThreadMutex);
-			wzSemaphoreWait(socketThreadSemaphore);
-			wzMutexLock(socketThreadMutex);
+			// The socket may have been finished or closed while the mutex was unlocked.
+			SocketThreadWriteMap::iterator w = socketThreadWrites.find(sock);
+			if (w != socketThreadWrites.end())
+			{
+				socketThreadWrite(w);
+			}
 		}
 	}
 	wzMutexUnlock(socketThreadMutex);
@@ -540,17 +776,17 @@ ssize_t readNoInt(Socket *sock, void *buf, size_t max_size, size_t *rawByteCount
 
 	if (sock->isCompressed)
 	{
-		if (sock->zInflateNeedInput)
+		if (sock->decoder->needInput())
 		{
 			// No input data, read some.
 
-			sock->zInflateInBuf.resize(max_size + 1000);
+			sock->decodeInBuf.resize(max_size + 1000);
 
 			ssize_t received;
 			do
 			{
 				//                                                  v----- This weird cast is because recv() takes a char * on windows instead of a void *...
-				received = recv(sock->fd[SOCK_CONNECTION], (char *)&sock->zInflateInBuf[0], sock->zInflateInBuf.size(), 0);
+				received = recv(sock->fd[SOCK_CONNECTION], (char *)&sock->decodeInBuf[0], sock->decodeInBuf.size(), 0);
 			}
 			while (received == SOCKET_ERROR && getSockErr() == EINTR);
 			if (received < 0)
@@ -558,44 +794,16 @@ ssize_t readNoInt(Socket *sock, void *buf, size_t max_size, size_t *rawByteCount
 				return received;
 			}
 
-			sock->zInflate.next_in = &sock->zInflateInBuf[0];
-			sock->zInflate.avail_in = received;
+			sock->decoder->input(&sock->decodeInBuf[0], received);
 			rawBytes = received;
 
 			if (received == 0)
 			{
 				sock->readDisconnected = true;
 			}
-			else
-			{
-				sock->zInflateNeedInput = false;
-			}
 		}
 
-		sock->zInflate.next_out = (Bytef *)buf;
-		sock->zInflate.avail_out = max_size;
-		int ret = inflate(&sock->zInflate, Z_NO_FLUSH);
-		ASSERT(ret != Z_STREAM_ERROR, "zlib inflate not working!");
-		char const *err = nullptr;
-		switch (ret)
-		{
-		case Z_NEED_DICT:  err = "Z_NEED_DICT";  break;
-		case Z_DATA_ERROR: err = "Z_DATA_ERROR"; break;
-		case Z_MEM_ERROR:  err = "Z_MEM_ERROR";  break;
-		}
-		if (err != nullptr)
-		{
-			debug(LOG_ERROR, "Couldn't decompress data from socket. zlib error %s", err);
-			return -1;  // Bad data!
-		}
-
-		if (sock->zInflate.avail_out != 0)
-		{
-			sock->zInflateNeedInput = true;
-			ASSERT(sock->zInflate.avail_in == 0, "zlib not consuming all input!");
-		}
-
-		return max_size - sock->zInflate.avail_out;  // Got some data, return how much.
+		return sock->decoder->read(buf, max_size);
 	}
 
 	ssize_t received;
@@ -649,64 +857,69 @@ ssize_t writeAll(Socket *sock, const void *buf, size_t size, size_t *rawByteCoun
 		if (!sock->isCompressed)
 		{
 			wzMutexLock(socketThreadMutex);
-			if (socketThreadWrites.empty())
-			{
-				wzSemaphorePost(socketThreadSemaphore);
-			}
-			std::vector<uint8_t> &writeQueue = socketThreadWrites[sock];
-			writeQueue.insert(writeQueue.end(), static_cast<char const *>(buf), static_cast<char const *>(buf) + size);
+			SocketWriteQueue &writeQueue = socketThreadWriteQueue(sock);
+			writeQueue.append(static_cast<uint8_t const *>(buf), size);
+			socketCheckWriteWatermark(sock, writeQueue.size());
 			wzMutexUnlock(socketThreadMutex);
 			rawBytes = size;
 		}
 		else
 		{
-		#if ZLIB_VERNUM < 0x1252
-			// zlib < 1.2.5.2 does not support `#define ZLIB_CONST`
-			// Unfortunately, some OSes (ex. OpenBSD) ship with zlib < 1.2.5.2
-			// Workaround: cast away the const of the input, and disable the resulting -Wcast-qual warning
-			#if defined(__clang__)
-			#  pragma clang diagnostic push
-			#  pragma clang diagnostic ignored "-Wcast-qual"
-			#elif defined(__GNUC__)
-			#  pragma GCC diagnostic push
-			#  pragma GCC diagnostic ignored "-Wcast-qual"
-			#endif
-
-			// cast away the const for earlier zlib versions
-			sock->zDeflate.next_in = (Bytef *)buf; // -Wcast-qual
-
-			#if defined(__clang__)
-			#  pragma clang diagnostic pop
-			#elif defined(__GNUC__)
-			#  pragma GCC diagnostic pop
-			#endif
-		#else
-			// zlib >= 1.2.5.2 supports ZLIB_CONST
-			sock->zDeflate.next_in = (const Bytef *)buf;
-		#endif
-
-			sock->zDeflate.avail_in = size;
-			sock->zDeflateInSize += sock->zDeflate.avail_in;
-			do
-			{
-				size_t alreadyHave = sock->zDeflateOutBuf.size();
-				sock->zDeflateOutBuf.resize(alreadyHave + size + 20);  // A bit more than size should be enough to always do everything in one go.
-				sock->zDeflate.next_out = (Bytef *)&sock->zDeflateOutBuf[alreadyHave];
-				sock->zDeflate.avail_out = sock->zDeflateOutBuf.size() - alreadyHave;
+			sock->encodeInSize += size;
+			sock->encoder->write(static_cast<uint8_t const *>(buf), size, sock->encodeOutBuf);
+		}
+	}
 
-				int ret = deflate(&sock->zDeflate, Z_NO_FLUSH);
-				ASSERT(ret != Z_STREAM_ERROR, "zlib compression failed!");
+	return size;
+}
 
-				// Remove unused part of buffer.
-				sock->zDeflateOutBuf.resize(sock->zDeflateOutBuf.size() - sock->zDeflate.avail_out);
-			}
-			while (sock->zDeflate.avail_out == 0);
+SocketSharedWrite::SocketSharedWrite(std::vector<uint8_t> &&data)
+	: raw(std::make_shared<const std::vector<uint8_t>>(std::move(data)))
+{}
 
-			ASSERT(sock->zDeflate.avail_in == 0, "zlib didn't compress everything!");
-		}
+SocketSharedWrite::SocketSharedWrite(std::shared_ptr<const std::vector<uint8_t>> data)
+	: raw(std::move(data))
+{}
+
+std::shared_ptr<const std::vector<uint8_t>> const &SocketSharedWrite::deflatedData()
+{
+	if (deflated)
+	{
+		return deflated;
 	}
 
-	return size;
+	auto out = std::make_shared<std::vector<uint8_t>>();
+	wzMutexLock(sharedDeflateMutex);
+	socketDeflateStandalone(raw->data(), raw->size(), *out);
+	wzMutexUnlock(sharedDeflateMutex);
+
+	deflated = std::move(out);
+	return deflated;
+}
+
+ssize_t writeAllShared(Socket *sock, SocketSharedWrite &data, size_t *rawByteCount)
+{
+	if (!sock->isCompressed || data.size() < socketSharedDeflateMinSize || sock->fd[SOCK_CONNECTION] == INVALID_SOCKET || sock->writeError)
+	{
+		return writeAll(sock, data.rawData()->data(), data.size(), rawByteCount);
+	}
+
+	// The other end will inflate the shared blocks as part of this socket's stream, so end the current block on a byte
+	// boundary, and stop later data on this socket from referring to data before the shared blocks.
+	if (!sock->encoder->prepareDeflateSplice(sock->encodeOutBuf))
+	{
+		return writeAll(sock, data.rawData()->data(), data.size(), rawByteCount);  // Not a deflate stream.
+	}
+
+	size_t ignored;
+	size_t &rawBytes = rawByteCount != nullptr ? *rawByteCount : ignored;
+	rawBytes = 0;
+
+	std::vector<uint8_t> const &deflated = *data.deflatedData();
+	sock->encodeOutBuf.insert(sock->encodeOutBuf.end(), deflated.begin(), deflated.end());
+	sock->encodeInSize += data.size();
+
+	return data.size();
 }
 
 void socketFlush(Socket *sock, uint8_t player, size_t *rawByteCount)
@@ -717,55 +930,37 @@ void socketFlush(Socket *sock, uint8_t player, size_t *rawByteCount)
 
 	if (!sock->isCompressed)
 	{
-		return;  // Not compressed, so don't mess with zlib.
+		return;  // Not compressed, so don't mess with the codec.
 	}
 
 	ASSERT(!sock->writeError, "Socket write error?? (Player: %" PRIu8 "", player);
 
-	// Flush data out of zlib compression state.
-	do
-	{
-		sock->zDeflate.next_in = (Bytef *)nullptr;
-		sock->zDeflate.avail_in = 0;
-		size_t alreadyHave = sock->zDeflateOutBuf.size();
-		sock->zDeflateOutBuf.resize(alreadyHave + 1000);  // 100 bytes would probably be enough to flush the rest in one go.
-		sock->zDeflate.next_out = (Bytef *)&sock->zDeflateOutBuf[alreadyHave];
-		sock->zDeflate.avail_out = sock->zDeflateOutBuf.size() - alreadyHave;
-
-		int ret = deflate(&sock->zDeflate, Z_PARTIAL_FLUSH);
-		ASSERT(ret != Z_STREAM_ERROR, "zlib compression failed!");
-
-		// Remove unused part of buffer.
-		sock->zDeflateOutBuf.resize(sock->zDeflateOutBuf.size() - sock->zDeflate.avail_out);
-	}
-	while (sock->zDeflate.avail_out == 0);
+	// Flush data out of the compression state.
+	sock->encoder->flush(sock->encodeOutBuf);
 
-	if (sock->zDeflateOutBuf.empty())
+	if (sock->encodeOutBuf.empty())
 	{
 		return;  // No data to flush out.
 	}
 
 	wzMutexLock(socketThreadMutex);
-	if (socketThreadWrites.empty())
-	{
-		wzSemaphorePost(socketThreadSemaphore);
-	}
-	std::vector<uint8_t> &writeQueue = socketThreadWrites[sock];
-	writeQueue.insert(writeQueue.end(), sock->zDeflateOutBuf.begin(), sock->zDeflateOutBuf.end());
+	SocketWriteQueue &writeQueue = socketThreadWriteQueue(sock);
+	writeQueue.append(&sock->encodeOutBuf[0], sock->encodeOutBuf.size());
+	socketCheckWriteWatermark(sock, writeQueue.size());
 	wzMutexUnlock(socketThreadMutex);
 
 	// Primitive network logging, uncomment to use.
-	//printf("Size %3u ->%3zu, buf =", sock->zDeflateInSize, sock->zDeflateOutBuf.size());
-	//for (unsigned n = 0; n < std::min<unsigned>(sock->zDeflateOutBuf.size(), 40); ++n) printf(" %02X", sock->zDeflateOutBuf[n]);
+	//printf("Size %3u ->%3zu, buf =", sock->encodeInSize, sock->encodeOutBuf.size());
+	//for (unsigned n = 0; n < std::min<unsigned>(sock->encodeOutBuf.size(), 40); ++n) printf(" %02X", sock->encodeOutBuf[n]);
 	//printf("\n");
 
 	// Data sent, don't send again.
-	rawBytes = sock->zDeflateOutBuf.size();
-	sock->zDeflateInSize = 0;
-	sock->zDeflateOutBuf.clear();
+	rawBytes = sock->encodeOutBuf.size();
+	sock->encodeInSize = 0;
+	sock->encodeOutBuf.clear();
 }
 
-void socketBeginCompression(Socket *sock)
+void socketBeginCompression(Socket *sock, SocketCodecType codec)
 {
 	if (sock->isCompressed)
 	{
@@ -774,34 +969,23 @@ void socketBeginCompression(Socket *sock)
 
 	wzMutexLock(socketThreadMutex);
 
-	// Init deflate.
-	sock->zDeflate.zalloc = Z_NULL;
-	sock->zDeflate.zfree = Z_NULL;
-	sock->zDeflate.opaque = Z_NULL;
-	int ret = deflateInit(&sock->zDeflate, 6);
-	ASSERT(ret == Z_OK, "deflateInit failed! Sockets won't work.");
-
-	sock->zInflate.zalloc = Z_NULL;
-	sock->zInflate.zfree = Z_NULL;
-	sock->zInflate.opaque = Z_NULL;
-	sock->zInflate.avail_in = 0;
-	sock->zInflate.next_in = Z_NULL;
-	ret = inflateInit(&sock->zInflate);
-	ASSERT(ret == Z_OK, "deflateInit failed! Sockets won't work.");
-
-	sock->zInflateNeedInput = true;
+	sock->codec = codec;
+	sock->encoder = socketCreateEncoder(codec);
+	sock->decoder = socketCreateDecoder(codec);
+	ASSERT(sock->encoder && sock->decoder, "Failed to create codec %s! Sockets won't work.", socketCodecName(codec));
 
 	sock->isCompressed = true;
 	wzMutexUnlock(socketThreadMutex);
 }
 
-Socket::~Socket()
+SocketCodecType socketGetCodec(Socket const *sock)
 {
-	if (isCompressed)
-	{
-		deflateEnd(&zDeflate);
-		deflateEnd(&zInflate);
-	}
+	return sock->codec;
+}
+
+bool socketIsLoopback(Socket const *sock)
+{
+	return strncmp(sock->textAddress, "127.", 4) == 0 || strcmp(sock->textAddress, "::1") == 0;  // IPv4-mapped addresses are already converted to IPv4.
 }
 
 SocketSet *allocSocketSet()
@@ -948,24 +1132,16 @@ int checkSockets(const SocketSet *set, unsigned int timeout)
 		return 0;
 	}
 
-#if   defined(WZ_OS_UNIX)
-	SOCKET maxfd = INT_MIN;
-#elif defined(WZ_OS_WIN)
-	SOCKET maxfd = 0;
-#endif
-
 	bool compressedReady = false;
 	for (size_t i = 0; i < set->fds.size(); ++i)
 	{
 		ASSERT(set->fds[i]->fd[SOCK_CONNECTION] != INVALID_SOCKET, "Invalid file descriptor!");
 
-		if (set->fds[i]->isCompressed && !set->fds[i]->zInflateNeedInput)
+		if (set->fds[i]->isCompressed && !set->fds[i]->decoder->needInput())
 		{
 			compressedReady = true;
 			break;
 		}
-
-		maxfd = std::max(maxfd, set->fds[i]->fd[SOCK_CONNECTION]);
 	}
 
 	if (compressedReady)
@@ -975,13 +1151,49 @@ int checkSockets(const SocketSet *set, unsigned int timeout)
 		int ret = 0;
 		for (size_t i = 0; i < set->fds.size(); ++i)
 		{
-			set->fds[i]->ready = set->fds[i]->isCompressed && !set->fds[i]->zInflateNeedInput;
+			set->fds[i]->ready = set->fds[i]->isCompressed && !set->fds[i]->decoder->needInput();
 			++ret;
 		}
 		return ret;
 	}
 
 	int ret;
+#if defined(WZ_SOCKET_POLL)
+	// poll() has no FD_SETSIZE limit, and doesn't need the sets rebuilt if interrupted.
+	std::vector<struct pollfd> fds(set->fds.size());
+	for (size_t i = 0; i < set->fds.size(); ++i)
+	{
+		fds[i].fd = set->fds[i]->fd[SOCK_CONNECTION];
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+	do
+	{
+		ret = poll(&fds[0], fds.size(), timeout);
+	}
+	while (ret == SOCKET_ERROR && getSockErr() == EINTR);
+
+	if (ret == SOCKET_ERROR)
+	{
+		debug(LOG_ERROR, "poll failed: %s", strSockError(getSockErr()));
+		return SOCKET_ERROR;
+	}
+
+	for (size_t i = 0; i < set->fds.size(); ++i)
+	{
+		set->fds[i]->ready = fds[i].revents != 0;  // Errors and hangups count as ready, the next recv() reports them.
+	}
+#else
+#if   defined(WZ_OS_UNIX)
+	SOCKET maxfd = INT_MIN;
+#elif defined(WZ_OS_WIN)
+	SOCKET maxfd = 0;
+#endif
+	for (size_t i = 0; i < set->fds.size(); ++i)
+	{
+		maxfd = std::max(maxfd, set->fds[i]->fd[SOCK_CONNECTION]);
+	}
+
 	fd_set fds;
 	do
 	{
@@ -1009,6 +1221,7 @@ int checkSockets(const SocketSet *set, unsigned int timeout)
 	{
 		set->fds[i]->ready = FD_ISSET(set->fds[i]->fd[SOCK_CONNECTION], &fds);
 	}
+#endif
 
 	return ret;
 }
@@ -1121,6 +1334,23 @@ static void socketCloseNow(Socket *sock)
 	delete sock;
 }
 
+size_t socketPendingWriteBytes(Socket *sock)
+{
+	wzMutexLock(socketThreadMutex);
+	SocketThreadWriteMap::const_iterator i = socketThreadWrites.find(sock);
+	size_t pending = i != socketThreadWrites.end() ? i->second.size() : 0;
+	wzMutexUnlock(socketThreadMutex);
+	return pending;
+}
+
+bool socketWriteBackedUp(Socket *sock)
+{
+	wzMutexLock(socketThreadMutex);
+	bool backedUp = sock->writeBackedUp;
+	wzMutexUnlock(socketThreadMutex);
+	return backedUp;
+}
+
 void socketClose(Socket *sock)
 {
 	wzMutexLock(socketThreadMutex);
@@ -1716,6 +1946,30 @@ void SOCKETinit()
 		socketThreadQuit = false;
 		socketThreadMutex = wzMutexCreate();
 		socketThreadSemaphore = wzSemaphoreCreate(0);
+		sharedDeflateMutex = wzMutexCreate();
+#if defined(WZ_SOCKET_POLL)
+# if defined(HAVE_SYS_EVENTFD_H)
+		socketThreadWakeFd[0] = socketThreadWakeFd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (socketThreadWakeFd[0] == SOCKET_ERROR)
+# elif defined(HAVE_PIPE2)
+		if (pipe2(socketThreadWakeFd, O_NONBLOCK | O_CLOEXEC) == SOCKET_ERROR)
+# else
+		if (pipe(socketThreadWakeFd) == SOCKET_ERROR
+		    || fcntl(socketThreadWakeFd[0], F_SETFL, O_NONBLOCK) == SOCKET_ERROR
+		    || fcntl(socketThreadWakeFd[1], F_SETFL, O_NONBLOCK) == SOCKET_ERROR)
+# endif
+		{
+			debug(LOG_ERROR, "Failed to create socket thread wakeup: %s", strSockError(getSockErr()));
+		}
+#endif
+#if defined(WZ_SOCKET_EPOLL)
+		socketThreadEpollFd = epoll_create1(EPOLL_CLOEXEC);
+		ASSERT(socketThreadEpollFd != SOCKET_ERROR, "epoll_create1 failed: %s", strSockError(getSockErr()));
+		struct epoll_event wakeEvent = {};
+		wakeEvent.events = EPOLLIN;
+		wakeEvent.data.ptr = nullptr;  // Not a socket.
+		epoll_ctl(socketThreadEpollFd, EPOLL_CTL_ADD, socketThreadWakeFd[0], &wakeEvent);
+#endif
 		socketThread = wzThreadCreate(socketThreadFunction, nullptr);
 		wzThreadStart(socketThread);
 	}
@@ -1729,10 +1983,25 @@ void SOCKETshutdown()
 		socketThreadQuit = true;
 		socketThreadWrites.clear();
 		wzMutexUnlock(socketThreadMutex);
-		wzSemaphorePost(socketThreadSemaphore);  // Wake up the thread, so it can quit.
+		socketThreadWake();  // Wake up the thread, so it can quit.
 		wzThreadJoin(socketThread);
 		wzMutexDestroy(socketThreadMutex);
 		wzSemaphoreDestroy(socketThreadSemaphore);
+		socketCodecShutdown();
+		wzMutexDestroy(sharedDeflateMutex);
+		sharedDeflateMutex = nullptr;
+#if defined(WZ_SOCKET_EPOLL)
+		close(socketThreadEpollFd);
+		socketThreadEpollFd = -1;
+#endif
+#if defined(WZ_SOCKET_POLL)
+		close(socketThreadWakeFd[0]);
+		if (socketThreadWakeFd[1] != socketThreadWakeFd[0])
+		{
+			close(socketThreadWakeFd[1]);
+		}
+		socketThreadWakeFd[0] = socketThreadWakeFd[1] = -1;
+#endif
 		socketThread = nullptr;
 	}
 
@@ -22,6 +22,8 @@
 #define _net_socket_h
 
 #include "lib/framework/types.h"
+#include "netsocketcodec.h"
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -76,6 +78,28 @@ struct Socket;
 struct SocketSet;
 typedef struct addrinfo SocketAddress;
 
+/// Data to be written to several Sockets, which is compressed at most once, instead of once per Socket.
+class SocketSharedWrite
+{
+public:
+	explicit SocketSharedWrite(std::vector<uint8_t> &&data);
+	explicit SocketSharedWrite(std::shared_ptr<const std::vector<uint8_t>> data);  ///< Shares the data, instead of copying it.
+
+	size_t size() const
+	{
+		return raw->size();
+	}
+	std::shared_ptr<const std::vector<uint8_t>> const &rawData() const
+	{
+		return raw;
+	}
+	std::shared_ptr<const std::vector<uint8_t>> const &deflatedData();  ///< Self-contained raw deflate blocks, byte aligned, which can be spliced into any deflate stream.
+
+private:
+	std::shared_ptr<const std::vector<uint8_t>> raw;
+	std::shared_ptr<const std::vector<uint8_t>> deflated;
+};
+
 #ifndef WZ_OS_WIN
 static const int SOCKET_ERROR = -1;
 #endif
@@ -117,9 +141,15 @@ WZ_DECL_NONNULL(1, 2)
 ssize_t readAll(Socket *sock, void *buf, size_t size, unsigned timeout);///< Reads exactly size bytes from the Socket, or blocks until the timeout expires.
 WZ_DECL_NONNULL(1, 2)
 ssize_t writeAll(Socket *sock, const void *buf, size_t size, size_t *rawByteCount = nullptr);  ///< Nonblocking write of size bytes to the Socket. All bytes will be written asynchronously, by a separate thread. Raw count of bytes (after compression) returned in rawByteCount, which will often be 0 until the socket is flushed.
+WZ_DECL_NONNULL(1)
+ssize_t writeAllShared(Socket *sock, SocketSharedWrite &data, size_t *rawByteCount = nullptr);  ///< Same as writeAll, but reuses the compressed data when writing the same data to several Sockets.
+WZ_DECL_NONNULL(1) size_t socketPendingWriteBytes(Socket *sock);       ///< Returns the number of bytes queued, but not yet sent, by the Socket.
+WZ_DECL_NONNULL(1) bool socketWriteBackedUp(Socket *sock);             ///< Returns true if the Socket has so much queued output that the peer is evidently not keeping up.
 
 // Sockets, compressed.
-WZ_DECL_NONNULL(1) void socketBeginCompression(Socket *sock); ///< Makes future data sent compressed, and future data received expected to be compressed.
+WZ_DECL_NONNULL(1) void socketBeginCompression(Socket *sock, SocketCodecType codec = SocketCodecType::Zlib); ///< Makes future data sent compressed, and future data received expected to be compressed, with the given codec.
+WZ_DECL_NONNULL(1) SocketCodecType socketGetCodec(Socket const *sock);  ///< Returns the codec given to socketBeginCompression.
+WZ_DECL_NONNULL(1) bool socketIsLoopback(Socket const *sock);           ///< Returns true if the peer is on this machine.
 WZ_DECL_NONNULL(1) bool socketReadDisconnected(Socket *sock);  ///< If readNoInt returned 0, returns true if this is the result of a disconnect, or false if the input compressed data just hasn't produced any output bytes.
 WZ_DECL_NONNULL(1) void socketFlush(Socket *sock, uint8_t player, size_t *rawByteCount = nullptr); ///< Actually sends the data written with writeAll. Only useful on compressed sockets. Note that flushing too often makes compression less effective. Raw count of bytes (after compression) returned in rawByteCount.
 
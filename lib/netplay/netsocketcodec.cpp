@@ -0,0 +1,356 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file netsocketcodec.cpp
+ *
+ * Stream codecs used to encode and decode data sent over Sockets.
+ */
+
+#include "lib/framework/frame.h"
+#include "netsocketcodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+#if !defined(ZLIB_CONST)
+#  define ZLIB_CONST
+#endif
+#include <zlib.h>
+
+static SocketCodecStats codecStats[static_cast<size_t>(SocketCodecType::Count)];
+
+static z_stream standaloneDeflate;
+static bool standaloneDeflateInitialised = false;
+
+/// Adds the time taken until destruction to a statistic.
+class CodecTimer
+{
+public:
+	explicit CodecTimer(uint64_t &microseconds_) : microseconds(microseconds_), start(std::chrono::steady_clock::now()) {}
+	~CodecTimer()
+	{
+		microseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+private:
+	uint64_t &microseconds;
+	std::chrono::steady_clock::time_point start;
+};
+
+static void setDeflateInput(z_stream &stream, uint8_t const *data, size_t size)
+{
+#if ZLIB_VERNUM < 0x1252
+	// zlib < 1.2.5.2 does not support `#define ZLIB_CONST`
+	// Unfortunately, some OSes (ex. OpenBSD) ship with zlib < 1.2.5.2
+	// Workaround: cast away the const of the input, and disable the resulting -Wcast-qual warning
+	#if defined(__clang__)
+	#  pragma clang diagnostic push
+	#  pragma clang diagnostic ignored "-Wcast-qual"
+	#elif defined(__GNUC__)
+	#  pragma GCC diagnostic push
+	#  pragma GCC diagnostic ignored "-Wcast-qual"
+	#endif
+
+	// cast away the const for earlier zlib versions
+	stream.next_in = (Bytef *)data; // -Wcast-qual
+
+	#if defined(__clang__)
+	#  pragma clang diagnostic pop
+	#elif defined(__GNUC__)
+	#  pragma GCC diagnostic pop
+	#endif
+#else
+	// zlib >= 1.2.5.2 supports ZLIB_CONST
+	stream.next_in = (const Bytef *)data;
+#endif
+	stream.avail_in = size;
+}
+
+/// Runs deflate until it has consumed all input, and output everything it wants to for the given flush mode.
+static void runDeflate(z_stream &stream, int flush, size_t outGuess, std::vector<uint8_t> &out)
+{
+	do
+	{
+		size_t alreadyHave = out.size();
+		out.resize(alreadyHave + outGuess);
+		stream.next_out = (Bytef *)&out[alreadyHave];
+		stream.avail_out = out.size() - alreadyHave;
+
+		int ret = deflate(&stream, flush);  // Z_BUF_ERROR just means there was nothing to do.
+		ASSERT(ret != Z_STREAM_ERROR, "zlib compression failed!");
+
+		// Remove unused part of buffer.
+		out.resize(out.size() - stream.avail_out);
+	}
+	while (stream.avail_out == 0);
+
+	ASSERT(stream.avail_in == 0, "zlib didn't compress everything!");
+}
+
+class NoneEncoder : public SocketEncoder
+{
+public:
+	void write(uint8_t const *data, size_t size, std::vector<uint8_t> &out) override
+	{
+		SocketCodecStats &stats = codecStats[static_cast<size_t>(SocketCodecType::None)];
+		stats.encodeInBytes += size;
+		stats.encodeOutBytes += size;
+		out.insert(out.end(), data, data + size);
+	}
+	void flush(std::vector<uint8_t> &) override
+	{}
+};
+
+class NoneDecoder : public SocketDecoder
+{
+public:
+	bool needInput() const override
+	{
+		return inSize == 0;
+	}
+	void input(uint8_t const *data, size_t size) override
+	{
+		SocketCodecStats &stats = codecStats[static_cast<size_t>(SocketCodecType::None)];
+		stats.decodeInBytes += size;
+		stats.decodeOutBytes += size;
+		in = data;
+		inSize = size;
+	}
+	ssize_t read(void *buf, size_t maxSize) override
+	{
+		size_t size = std::min(maxSize, inSize);
+		memcpy(buf, in, size);
+		in += size;
+		inSize -= size;
+		return size;
+	}
+
+private:
+	uint8_t const *in = nullptr;
+	size_t inSize = 0;
+};
+
+class ZlibEncoder : public SocketEncoder
+{
+public:
+	ZlibEncoder(SocketCodecType type_, int level) : type(type_)
+	{
+		memset(&stream, 0, sizeof(stream));
+		stream.zalloc = Z_NULL;
+		stream.zfree = Z_NULL;
+		stream.opaque = Z_NULL;
+		int ret = deflateInit(&stream, level);
+		ASSERT(ret == Z_OK, "deflateInit failed! Sockets won't work.");
+	}
+	~ZlibEncoder() override
+	{
+		deflateEnd(&stream);
+	}
+	void write(uint8_t const *data, size_t size, std::vector<uint8_t> &out) override
+	{
+		SocketCodecStats &stats = codecStats[static_cast<size_t>(type)];
+		CodecTimer timer(stats.encodeMicroseconds);
+		size_t alreadyHave = out.size();
+		setDeflateInput(stream, data, size);
+		runDeflate(stream, Z_NO_FLUSH, size + 20, out);  // A bit more than size should be enough to always do everything in one go.
+		stats.encodeInBytes += size;
+		stats.encodeOutBytes += out.size() - alreadyHave;
+	}
+	void flush(std::vector<uint8_t> &out) override
+	{
+		SocketCodecStats &stats = codecStats[static_cast<size_t>(type)];
+		CodecTimer timer(stats.encodeMicroseconds);
+		size_t alreadyHave = out.size();
+		setDeflateInput(stream, nullptr, 0);
+		runDeflate(stream, Z_PARTIAL_FLUSH, 1000, out);  // 100 bytes would probably be enough to flush the rest in one go.
+		stats.encodeOutBytes += out.size() - alreadyHave;
+	}
+	bool prepareDeflateSplice(std::vector<uint8_t> &out) override
+	{
+		SocketCodecStats &stats = codecStats[static_cast<size_t>(type)];
+		CodecTimer timer(stats.encodeMicroseconds);
+		size_t alreadyHave = out.size();
+		setDeflateInput(stream, nullptr, 0);
+		runDeflate(stream, Z_FULL_FLUSH, 1000, out);
+		stats.encodeOutBytes += out.size() - alreadyHave;
+		return true;
+	}
+
+private:
+	SocketCodecType type;
+	z_stream stream;
+};
+
+class ZlibDecoder : public SocketDecoder
+{
+public:
+	explicit ZlibDecoder(SocketCodecType type_) : type(type_)
+	{
+		memset(&stream, 0, sizeof(stream));
+		stream.zalloc = Z_NULL;
+		stream.zfree = Z_NULL;
+		stream.opaque = Z_NULL;
+		stream.avail_in = 0;
+		stream.next_in = Z_NULL;
+		int ret = inflateInit(&stream);
+		ASSERT(ret == Z_OK, "inflateInit failed! Sockets won't work.");
+	}
+	~ZlibDecoder() override
+	{
+		inflateEnd(&stream);
+	}
+	bool needInput() const override
+	{
+		return inputNeeded;
+	}
+	void input(uint8_t const *data, size_t size) override
+	{
+		stream.next_in = data;
+		stream.avail_in = size;
+		inputNeeded = size == 0;
+		codecStats[static_cast<size_t>(type)].decodeInBytes += size;
+	}
+	ssize_t read(void *buf, size_t maxSize) override
+	{
+		SocketCodecStats &stats = codecStats[static_cast<size_t>(type)];
+		CodecTimer timer(stats.decodeMicroseconds);
+		stream.next_out = (Bytef *)buf;
+		stream.avail_out = maxSize;
+		int ret = inflate(&stream, Z_NO_FLUSH);
+		ASSERT(ret != Z_STREAM_ERROR, "zlib inflate not working!");
+		char const *err = nullptr;
+		switch (ret)
+		{
+		case Z_NEED_DICT:  err = "Z_NEED_DICT";  break;
+		case Z_DATA_ERROR: err = "Z_DATA_ERROR"; break;
+		case Z_MEM_ERROR:  err = "Z_MEM_ERROR";  break;
+		}
+		if (err != nullptr)
+		{
+			debug(LOG_ERROR, "Couldn't decompress data from socket. zlib error %s", err);
+			return -1;  // Bad data!
+		}
+
+		if (stream.avail_out != 0)
+		{
+			inputNeeded = true;
+			ASSERT(stream.avail_in == 0, "zlib not consuming all input!");
+		}
+
+		stats.decodeOutBytes += maxSize - stream.avail_out;
+		return maxSize - stream.avail_out;  // Got some data, return how much.
+	}
+
+private:
+	SocketCodecType type;
+	z_stream stream;
+	bool inputNeeded = true;
+};
+
+char const *socketCodecName(SocketCodecType type)
+{
+	switch (type)
+	{
+	case SocketCodecType::None:     return "none";
+	case SocketCodecType::Zlib:     return "zlib";
+	case SocketCodecType::ZlibFast: return "zlib-fast";
+	case SocketCodecType::Count:    break;
+	}
+	return "invalid";
+}
+
+bool socketCodecFromName(char const *name, SocketCodecType &type)
+{
+	for (unsigned codec = 0; codec < static_cast<unsigned>(SocketCodecType::Count); ++codec)
+	{
+		if (strcmp(name, socketCodecName(static_cast<SocketCodecType>(codec))) == 0)
+		{
+			type = static_cast<SocketCodecType>(codec);
+			return true;
+		}
+	}
+	return false;
+}
+
+std::unique_ptr<SocketEncoder> socketCreateEncoder(SocketCodecType type)
+{
+	switch (type)
+	{
+	case SocketCodecType::None:     return std::unique_ptr<SocketEncoder>(new NoneEncoder());
+	case SocketCodecType::Zlib:     return std::unique_ptr<SocketEncoder>(new ZlibEncoder(type, 6));
+	case SocketCodecType::ZlibFast: return std::unique_ptr<SocketEncoder>(new ZlibEncoder(type, 1));
+	case SocketCodecType::Count:    break;
+	}
+	ASSERT(false, "Invalid codec %u", static_cast<unsigned>(type));
+	return nullptr;
+}
+
+std::unique_ptr<SocketDecoder> socketCreateDecoder(SocketCodecType type)
+{
+	switch (type)
+	{
+	case SocketCodecType::None:     return std::unique_ptr<SocketDecoder>(new NoneDecoder());
+	case SocketCodecType::Zlib:
+	case SocketCodecType::ZlibFast: return std::unique_ptr<SocketDecoder>(new ZlibDecoder(type));
+	case SocketCodecType::Count:    break;
+	}
+	ASSERT(false, "Invalid codec %u", static_cast<unsigned>(type));
+	return nullptr;
+}
+
+void socketDeflateStandalone(uint8_t const *data, size_t size, std::vector<uint8_t> &out)
+{
+	SocketCodecStats &stats = codecStats[static_cast<size_t>(SocketCodecType::Zlib)];
+	CodecTimer timer(stats.encodeMicroseconds);
+	if (!standaloneDeflateInitialised)
+	{
+		// Raw deflate (no zlib header or checksum), at the same level as the default per-socket streams.
+		memset(&standaloneDeflate, 0, sizeof(standaloneDeflate));
+		int ret = deflateInit2(&standaloneDeflate, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+		ASSERT(ret == Z_OK, "deflateInit2 failed!");
+		standaloneDeflateInitialised = true;
+	}
+	else
+	{
+		deflateReset(&standaloneDeflate);  // Don't refer to data the receivers haven't seen.
+	}
+
+	size_t alreadyHave = out.size();
+	setDeflateInput(standaloneDeflate, data, size);
+	runDeflate(standaloneDeflate, Z_SYNC_FLUSH, size + 20, out);  // Z_SYNC_FLUSH ends on a byte boundary, without marking the last block as final.
+	stats.encodeInBytes += size;
+	stats.encodeOutBytes += out.size() - alreadyHave;
+}
+
+SocketCodecStats const &socketGetCodecStats(SocketCodecType type)
+{
+	static const SocketCodecStats invalid;
+	ASSERT_OR_RETURN(invalid, type < SocketCodecType::Count, "Invalid codec %u", static_cast<unsigned>(type));
+	return codecStats[static_cast<size_t>(type)];
+}
+
+void socketCodecShutdown()
+{
+	if (standaloneDeflateInitialised)
+	{
+		deflateEnd(&standaloneDeflate);
+		standaloneDeflateInitialised = false;
+	}
+}
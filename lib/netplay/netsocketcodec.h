@@ -0,0 +1,85 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file netsocketcodec.h
+ *
+ * Stream codecs used to encode and decode data sent over Sockets.
+ */
+#ifndef _net_socket_codec_h
+#define _net_socket_codec_h
+
+#include "lib/framework/types.h"
+#include <memory>
+#include <vector>
+
+/// Codec of a connection, agreed during the join handshake. The values are sent over the network, don't renumber.
+enum class SocketCodecType : uint8_t
+{
+	None = 0,      ///< No compression, for loopback connections.
+	Zlib = 1,      ///< Zlib level 6, the traditional codec.
+	ZlibFast = 2,  ///< Zlib level 1, less CPU per flush for fast links.
+	Count
+};
+
+struct SocketCodecStats
+{
+	uint64_t encodeInBytes = 0;       ///< Bytes given to encoders.
+	uint64_t encodeOutBytes = 0;      ///< Bytes output by encoders.
+	uint64_t encodeMicroseconds = 0;
+	uint64_t decodeInBytes = 0;       ///< Bytes given to decoders.
+	uint64_t decodeOutBytes = 0;      ///< Bytes output by decoders.
+	uint64_t decodeMicroseconds = 0;
+};
+
+class SocketEncoder
+{
+public:
+	virtual ~SocketEncoder() = default;
+	virtual void write(uint8_t const *data, size_t size, std::vector<uint8_t> &out) = 0;  ///< Encodes data, appending to out. Some output may be held back until flush().
+	virtual void flush(std::vector<uint8_t> &out) = 0;  ///< Appends the rest of the output for the data written so far, so that the other end can decode all of it.
+	/// If the stream is raw deflate blocks, ends the current block on a byte boundary, and forgets the earlier data, so that the
+	/// output of socketDeflateStandalone() can follow, and returns true. Otherwise returns false.
+	virtual bool prepareDeflateSplice(std::vector<uint8_t> &out)
+	{
+		(void)out;
+		return false;
+	}
+};
+
+class SocketDecoder
+{
+public:
+	virtual ~SocketDecoder() = default;
+	virtual bool needInput() const = 0;  ///< True if all input has been decoded, and read() would return 0.
+	virtual void input(uint8_t const *data, size_t size) = 0;  ///< Data must remain valid until needInput().
+	virtual ssize_t read(void *buf, size_t maxSize) = 0;  ///< Returns the number of bytes decoded into buf, or -1 on bad data.
+};
+
+char const *socketCodecName(SocketCodecType type);
+bool socketCodecFromName(char const *name, SocketCodecType &type);  ///< Inverse of socketCodecName(), returns false if there is no such codec.
+std::unique_ptr<SocketEncoder> socketCreateEncoder(SocketCodecType type);
+std::unique_ptr<SocketDecoder> socketCreateDecoder(SocketCodecType type);
+
+/// Compresses data as self-contained, byte aligned, non-final raw deflate blocks, which can be spliced into any deflate stream after prepareDeflateSplice().
+void socketDeflateStandalone(uint8_t const *data, size_t size, std::vector<uint8_t> &out);
+
+SocketCodecStats const &socketGetCodecStats(SocketCodecType type);  ///< Totals since startup, for the codec.
+void socketCodecShutdown();
+
+#endif //_net_socket_codec_h
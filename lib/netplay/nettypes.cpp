@@ -41,6 +41,7 @@
 #include "netqueue.h"
 #include "netlog.h"
 #include "src/order.h"
+#include <array>
 #include <cstring>
 #include <limits>
 
@@ -99,33 +100,36 @@ static void queue(const Q &q, uint16_t &v)
 	}
 }
 
-template<class Q>
-static void queue(const Q &q, uint32_t &vOrig)
+static void queue(const MessageWriter &q, uint32_t &v)
 {
-	if (Q::Direction == Q::Write)
+	uint8_t b[encodedMaxLength_uint32_t];
+	q.bytes(b, encodeAll_uint32_t(v, b));
+}
+
+static void queue(const MessageReader &q, uint32_t &vOrig)
+{
+	std::vector<uint8_t> const &data = q.message->data;
+	if (q.index < data.size())
 	{
-		uint32_t v = vOrig;
-		bool moreBytes = true;
-		for (int n = 0; moreBytes; ++n)
+		size_t used = decodeAll_uint32_t(&data[q.index], data.size() - q.index, vOrig);
+		if (used != 0)
 		{
-			uint8_t b;
-			moreBytes = encode_uint32_t(b, v, n);
-			queue(q, b);
+			q.index += used;
+			return;
 		}
 	}
-	else if (Q::Direction == Q::Read)
-	{
-		uint32_t v = 0;
-		bool moreBytes = true;
-		for (int n = 0; moreBytes; ++n)
-		{
-			uint8_t b = 0;
-			queue(q, b);
-			moreBytes = decode_uint32_t(b, v, n);
-		}
 
-		vOrig = v;
+	// Truncated message, read byte by byte, so that the reader ends up invalid.
+	uint32_t v = 0;
+	bool moreBytes = true;
+	for (int n = 0; moreBytes; ++n)
+	{
+		uint8_t b = 0;
+		queue(q, b);
+		moreBytes = decode_uint32_t(b, v, n);
 	}
+
+	vOrig = v;
 }
 
 template<class Q>
@@ -421,6 +425,11 @@ void NETinsertMessageFromNet(NETQUEUE queue, NetMessage const *newMessage)
 	receiveQueue(queue)->pushMessage(*newMessage);
 }
 
+void NETinsertMessageFromNet(NETQUEUE queue, NetMessage &&newMessage)
+{
+	receiveQueue(queue)->pushMessage(std::move(newMessage));
+}
+
 bool NETisMessageReady(NETQUEUE queue)
 {
 	return receiveQueue(queue)->haveMessage();
@@ -503,7 +512,7 @@ void NETbeginEncode(NETQUEUE queue, uint8_t type)
 	NETsetPacketDir(PACKET_ENCODE);
 
 	queueInfo = queue;
-	message = type;
+	message.reset(type);  // Keeps the buffer recycled by the last NetQueue::pushMessage().
 	writer = MessageWriter(message);
 }
 
@@ -512,10 +521,9 @@ void NETbeginDecode(NETQUEUE queue, uint8_t type)
 	NETsetPacketDir(PACKET_DECODE);
 
 	queueInfo = queue;
-	message = receiveQueue(queueInfo)->getMessage();
-	reader = MessageReader(message);
+	reader = MessageReader(receiveQueue(queueInfo)->getMessage());  // Read the message in place, it stays in the queue until NETpop().
 
-	assert(type == message.type);
+	assert(type == reader.message->type);
 }
 
 bool NETend()
@@ -536,23 +544,26 @@ bool NETend()
 			debug(LOG_WARNING, "Sending %s to null queue, type %d.", messageTypeToString(message.type), queueInfo.queueType);
 			return true;
 		}
-		queue->pushMessage(message);
-		NETlogPacket(message.type, static_cast<uint32_t>(message.data.size()), false);
+		// Move the message into the queue, the queued message is the one sent over the network and recorded in replays.
+		NetMessage const &queued = queue->pushMessage(std::move(message));
+		uint8_t type = queued.type;
+		size_t size = queued.data.size();
+		NETlogPacket(type, static_cast<uint32_t>(size), false);
 
 		if (queueInfo.queueType == QUEUE_GAME || queueInfo.queueType == QUEUE_GAME_FORCED)
 		{
-			ASSERT(message.type > GAME_MIN_TYPE && message.type < GAME_MAX_TYPE, "Inserting %s into game queue.", messageTypeToString(message.type));
+			ASSERT(type > GAME_MIN_TYPE && type < GAME_MAX_TYPE, "Inserting %s into game queue.", messageTypeToString(type));
 		}
 		else
 		{
-			ASSERT(message.type > NET_MIN_TYPE && message.type < NET_MAX_TYPE, "Inserting %s into net queue.", messageTypeToString(message.type));
+			ASSERT(type > NET_MIN_TYPE && type < NET_MAX_TYPE, "Inserting %s into net queue.", messageTypeToString(type));
 		}
 
 		if (queueInfo.queueType == QUEUE_NET || queueInfo.queueType == QUEUE_BROADCAST || queueInfo.queueType == QUEUE_TMP)
 		{
 			NETsend(queueInfo, &queue->getMessageForNet());
 			queue->popMessageForNet();
-			ASSERT(queue->numMessagesForNet() == 0, "Queue not empty (%u messages remaining). (message = type: %" PRIu8 ", size: %zu), (queue = index: %" PRIu8 "; queueType: %" PRIu8 "; exclude: %" PRIu8 "; isPair: %d)", queue->numMessagesForNet(), message.type, message.data.size(), queueInfo.index, queueInfo.queueType, queueInfo.exclude, (int)queueInfo.isPair);
+			ASSERT(queue->numMessagesForNet() == 0, "Queue not empty (%u messages remaining). (message = type: %" PRIu8 ", size: %zu), (queue = index: %" PRIu8 "; queueType: %" PRIu8 "; exclude: %" PRIu8 "; isPair: %d)", queue->numMessagesForNet(), type, size, queueInfo.index, queueInfo.queueType, queueInfo.exclude, (int)queueInfo.isPair);
 		}
 
 		// We have ended the serialisation, so mark the direction invalid
@@ -573,7 +584,7 @@ bool NETend()
 			// Decoded in NETprocessSystemMessage in netplay.cpp.
 			uint8_t player = queueInfo.index;
 			uint32_t num = 1;
-			NetMessage backupMessage = message;  // 'message' will be overwritten, so we need a copy (to avoid trying to insert a message into itself).
+			NetMessage backupMessage = queued;  // Copy the queued message, since the game queue may be popped before we're done with it.
 			NETbeginEncode(NETbroadcastQueue(), NET_SHARE_GAME_QUEUE);
 			NETuint8_t(&player);
 			NETuint32_t(&num);
@@ -857,55 +868,144 @@ void NETnetMessage(NetMessage const **msg)
 	}
 }
 
+void NETnetMessage(NetMessage *msg)
+{
+	queueAuto(*msg);
+}
+
 ReplayOptionsHandler::~ReplayOptionsHandler() { }
 
+/// Number of messages queued for each player before each keyframe of the replay, for NETreplaySkipToKeyframe().
+static std::vector<std::array<uint32_t, MAX_GAMEQUEUE_SLOTS>> replayKeyframeMessages;
+
+/// Adds a message from a replay to its game queue. Returns true if it was the REPLAY_ENDED message.
+static bool replayQueueMessage(NetMessage &&message, uint8_t player, std::array<uint32_t, MAX_GAMEQUEUE_SLOTS> *queued = nullptr)
+{
+	if ((player >= MAX_PLAYERS && player != NetPlay.hostPlayer) || gameQueues[player] == nullptr)
+	{
+		debug((message.type != GAME_GAME_TIME) ? LOG_ERROR : LOG_INFO, "Skipping message to player %d in replay.", player);
+		return false;
+	}
+	if (message.type == REPLAY_ENDED)
+	{
+		return true;
+	}
+	gameQueues[player]->pushMessage(std::move(message));
+	if (queued != nullptr)
+	{
+		++(*queued)[player];
+	}
+	return false;
+}
+
+/// Records the number of messages queued before the keyframes which are at or before the given offset.
+static void replayMarkKeyframes(uint64_t offset, std::array<uint32_t, MAX_GAMEQUEUE_SLOTS> const &queued)
+{
+	std::vector<ReplayKeyframe> const &keyframes = NETreplayLoadKeyframes();
+	while (replayKeyframeMessages.size() < keyframes.size() && keyframes[replayKeyframeMessages.size()].offset <= offset)
+	{
+		replayKeyframeMessages.push_back(queued);
+	}
+}
+
 // TODO Call this function somewhere.
 bool NETloadReplay(std::string const &filename, ReplayOptionsHandler& optionsHandler)
 {
 	uint32_t replayFormatVer = 0;
-	if (!NETreplayLoadStart(filename, optionsHandler, replayFormatVer))
+	bool live = NETisReplayRelayAddress(filename);
+	if (!(live ? NETreplayLoadStartRelay(filename, optionsHandler, replayFormatVer) : NETreplayLoadStart(filename, optionsHandler, replayFormatVer)))
 	{
 		return false;
 	}
 	std::unique_ptr<NetMessage> newMessage;
 	uint8_t player;
 	bool gotReplayEnded = false;
-	while (NETreplayLoadNetMessage(newMessage, player))
+	std::array<uint32_t, MAX_GAMEQUEUE_SLOTS> queued = {};
+	replayKeyframeMessages.clear();
+	uint64_t messageStart = NETreplayLoadOffset();
+	while (!gotReplayEnded && NETreplayLoadNetMessage(newMessage, player))
 	{
-		if ((player >= MAX_PLAYERS && player != NetPlay.hostPlayer) || gameQueues[player] == nullptr)
-		{
-			debug((newMessage->type != GAME_GAME_TIME) ? LOG_ERROR : LOG_INFO, "Skipping message to player %d in replay.", player);
-			continue;
-		}
-		if (newMessage->type == REPLAY_ENDED)
-		{
-			gotReplayEnded = true;
-			break;
-		}
-		gameQueues[player]->pushMessage(*newMessage);
+		replayMarkKeyframes(messageStart, queued);
+		messageStart = NETreplayLoadOffset();
+		gotReplayEnded = replayQueueMessage(std::move(*newMessage), player, &queued);
+	}
+	replayMarkKeyframes(messageStart, queued);
+	if (live && !gotReplayEnded && !NETreplayLoadLiveEnded())
+	{
+		// The rest of the game arrives while playing, see NETreplayUpdateLive.
+		bIsReplay = true;
+		return true;
 	}
 	if (!gotReplayEnded && replayFormatVer >= 2)
 	{
 		debug(LOG_POPUP, _("Unable to load replay: The replay file is incomplete or corrupted."));
+		NETreplayLoadStop();
 		bIsReplay = true;
 		NETshutdownReplay();
 		return false;
 	}
 	// Add special REPLAY_ENDED message to the end of the host's gameQueue
-	newMessage = std::unique_ptr<NetMessage>(new NetMessage(REPLAY_ENDED));
-	gameQueues[NetPlay.hostPlayer]->pushMessage(*newMessage);
+	gameQueues[NetPlay.hostPlayer]->pushMessage(NetMessage(REPLAY_ENDED));
 	NETreplayLoadStop();
 	bIsReplay = true;
 	return true;
 }
 
+void NETreplayUpdateLive()
+{
+	if (!bIsReplay || !NETreplayLoadIsLive())
+	{
+		return;
+	}
+
+	std::unique_ptr<NetMessage> newMessage;
+	uint8_t player;
+	bool gotReplayEnded = false;
+	while (!gotReplayEnded && NETreplayLoadNetMessage(newMessage, player))
+	{
+		gotReplayEnded = replayQueueMessage(std::move(*newMessage), player);
+	}
+	if (gotReplayEnded || NETreplayLoadLiveEnded())
+	{
+		if (!gotReplayEnded)
+		{
+			debug(LOG_INFO, "Lost connection to the relay, ending the replay.");
+		}
+		gameQueues[NetPlay.hostPlayer]->pushMessage(NetMessage(REPLAY_ENDED));
+		NETreplayLoadStop();
+	}
+}
+
 bool NETisReplay()
 {
 	return bIsReplay;
 }
 
+bool NETreplayCanSkipToKeyframe(size_t index)
+{
+	return bIsReplay && index < replayKeyframeMessages.size();
+}
+
+bool NETreplaySkipToKeyframe(size_t index)
+{
+	ASSERT_OR_RETURN(false, NETreplayCanSkipToKeyframe(index), "No messages known for keyframe %zu", index);
+	for (unsigned player = 0; player < MAX_GAMEQUEUE_SLOTS; ++player)
+	{
+		for (uint32_t n = 0; n < replayKeyframeMessages[index][player]; ++n)
+		{
+			ASSERT_OR_RETURN(false, gameQueues[player] != nullptr && gameQueues[player]->haveMessage(), "Replay messages already read");
+			gameQueues[player]->popMessage();
+		}
+	}
+	return true;
+}
+
 void NETshutdownReplay()
 {
+	if (NETreplayLoadIsLive())
+	{
+		NETreplayLoadStop();  // Left while still watching a relay.
+	}
 	if (bIsReplay)
 	{
 		// extra replay spectator gamequeue
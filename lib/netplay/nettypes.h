@@ -71,6 +71,7 @@ NETQUEUE NETbroadcastQueue(unsigned excludePlayer = NET_NO_EXCLUDE);  ///< The q
 
 void NETinsertRawData(NETQUEUE queue, uint8_t *data, size_t dataLen);  ///< Dump raw data from sockets and raw data sent via host here.
 void NETinsertMessageFromNet(NETQUEUE queue, NetMessage const *message);     ///< Dump whole NetMessages into the queue.
+void NETinsertMessageFromNet(NETQUEUE queue, NetMessage &&message);          ///< Moves a whole NetMessage into the queue, leaving an empty message.
 bool NETisMessageReady(NETQUEUE queue);       ///< Returns true if there is a complete message ready to deserialise in this queue.
 NetMessage const *NETgetMessage(NETQUEUE queue);///< Returns the current message in the queue which is ready to be deserialised. Do not delete the message.
 
@@ -201,6 +202,7 @@ static inline void NETauto(T (&ar)[N])
 }
 
 void NETnetMessage(NetMessage const **message);  ///< If decoding, must delete the NETMESSAGE.
+void NETnetMessage(NetMessage *message);         ///< If decoding, overwrites the message, which can then be moved into a queue.
 
 #include <nlohmann/json_fwd.hpp>
 
@@ -224,6 +226,9 @@ public:
 
 bool NETloadReplay(std::string const &filename, ReplayOptionsHandler& optionsHandler);
 bool NETisReplay();
+void NETreplayUpdateLive();  ///< Adds messages newly received from a relay to the game queues. Call once per frame.
+bool NETreplayCanSkipToKeyframe(size_t index);  ///< False if the keyframe is after the last message loaded.
+bool NETreplaySkipToKeyframe(size_t index);     ///< Drops the replay messages before a keyframe, before the first game tick.
 void NETshutdownReplay();
 
 bool NETgameIsBehindPlayersByAtLeast(size_t numGameTimeUpdates = 2);
@@ -543,7 +543,7 @@ static SDWORD targetAttackWeight(BASE_OBJECT *psTarget, BASE_OBJECT *psAttacker,
 // Find the best nearest target for a droid.
 // If extraRange is higher than zero, then this is the range it accepts for movement to target.
 // Returns integer representing target priority, -1 if failed
-int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, int extraRange)
+static int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, int extraRange, GridSearch &search)
 {
 	int failure = -1;
 	int bestMod = 0;
@@ -581,8 +581,7 @@ int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, i
 	// Range was previously 9*TILE_UNITS. Increasing this doesn't seem to help much, though. Not sure why.
 	int droidRange = std::min(aiDroidRange(psDroid, weapon_slot) + extraRange, objSensorRange(psDroid) + 6 * TILE_UNITS);
 
-	static GridList gridList;  // static to avoid allocations.
-	gridList = gridStartIterate(psDroid->pos.x, psDroid->pos.y, droidRange);
+	GridList const &gridList = gridStartIterate(psDroid->pos.x, psDroid->pos.y, droidRange, search);
 	for (GridIterator gi = gridList.begin(); gi != gridList.end(); ++gi)
 	{
 		BASE_OBJECT *friendlyObj = nullptr;
@@ -728,6 +727,12 @@ int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, i
 	return failure;
 }
 
+int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, int extraRange)
+{
+	static GridSearch search;  // static to avoid allocations.
+	return aiBestNearestTarget(psDroid, ppsObj, weapon_slot, extraRange, search);
+}
+
 // Are there a lot of bullets heading towards the droid?
 static bool aiDroidIsProbablyDoomed(DROID *psDroid, bool isDirect)
 {
@@ -818,12 +823,43 @@ static bool aiObjIsWall(BASE_OBJECT *psObj)
 }
 
 
+/* See if there is a target in range for a droid */
+static bool aiChooseDroidTarget(DROID *psDroid, BASE_OBJECT **ppsTarget, int weapon_slot, bool bUpdateTarget, GridSearch &search)
+{
+	BASE_OBJECT *psTarget = nullptr;
+	BASE_OBJECT *psCurrTarget = psDroid->psActionTarget[0];
+	SDWORD curTargetWeight = -1;
+
+	/* find a new target */
+	int newTargetWeight = aiBestNearestTarget(psDroid, &psTarget, weapon_slot, 0, search);
+
+	/* Calculate weight of the current target if updating; but take care not to target
+	 * ourselves... */
+	if (bUpdateTarget && psCurrTarget != psDroid)
+	{
+		curTargetWeight = targetAttackWeight(psCurrTarget, psDroid, weapon_slot);
+	}
+
+	if (newTargetWeight >= 0		// found a new target
+	    && (!bUpdateTarget			// choosing a new target, don't care if current one is better
+	        || curTargetWeight <= 0		// attacker had no valid target, use new one
+	        || newTargetWeight > curTargetWeight + OLD_TARGET_THRESHOLD)	// updating and new target is better
+	    && validTarget(psDroid, psTarget, weapon_slot)
+	    && aiDroidHasRange(psDroid, psTarget, weapon_slot))
+	{
+		ASSERT(!isDead(psTarget), "Droid found a dead target!");
+		*ppsTarget = psTarget;
+		return true;
+	}
+
+	return false;
+}
+
 /* See if there is a target in range */
 bool aiChooseTarget(BASE_OBJECT *psObj, BASE_OBJECT **ppsTarget, int weapon_slot, bool bUpdateTarget, TARGET_ORIGIN *targetOrigin)
 {
 	BASE_OBJECT		*psTarget = nullptr;
 	DROID			*psCommander;
-	SDWORD			curTargetWeight = -1;
 	TARGET_ORIGIN		tmpOrigin = ORIGIN_UNKNOWN;
 
 	if (targetOrigin)
@@ -836,29 +872,8 @@ bool aiChooseTarget(BASE_OBJECT *psObj, BASE_OBJECT **ppsTarget, int weapon_slot
 	/* See if there is a something in range */
 	if (psObj->type == OBJ_DROID)
 	{
-		BASE_OBJECT *psCurrTarget = ((DROID *)psObj)->psActionTarget[0];
-
-		/* find a new target */
-		int newTargetWeight = aiBestNearestTarget((DROID *)psObj, &psTarget, weapon_slot);
-
-		/* Calculate weight of the current target if updating; but take care not to target
-		 * ourselves... */
-		if (bUpdateTarget && psCurrTarget != psObj)
-		{
-			curTargetWeight = targetAttackWeight(psCurrTarget, psObj, weapon_slot);
-		}
-
-		if (newTargetWeight >= 0		// found a new target
-		    && (!bUpdateTarget			// choosing a new target, don't care if current one is better
-		        || curTargetWeight <= 0		// attacker had no valid target, use new one
-		        || newTargetWeight > curTargetWeight + OLD_TARGET_THRESHOLD)	// updating and new target is better
-		    && validTarget(psObj, psTarget, weapon_slot)
-		    && aiDroidHasRange((DROID *)psObj, psTarget, weapon_slot))
-		{
-			ASSERT(!isDead(psTarget), "Droid found a dead target!");
-			*ppsTarget = psTarget;
-			return true;
-		}
+		static GridSearch search;  // static to avoid allocations.
+		return aiChooseDroidTarget((DROID *)psObj, ppsTarget, weapon_slot, bUpdateTarget, search);
 	}
 	else if (psObj->type == OBJ_STRUCTURE)
 	{
@@ -1076,42 +1091,29 @@ static bool updateAttackTarget(BASE_OBJECT *psAttacker, SDWORD weapon_slot)
 	return false;
 }
 
-/* Do the AI for a droid */
-void aiUpdateDroid(DROID *psDroid)
+/* Work out whether a droid should look for a new target, or update its current one */
+static void aiDroidTargetState(DROID *psDroid, bool *lookForTarget, bool *updateTarget)
 {
-	bool		lookForTarget, updateTarget;
-
-	ASSERT(psDroid != nullptr, "Invalid droid pointer");
-	if (!psDroid || isDead((BASE_OBJECT *)psDroid))
-	{
-		return;
-	}
-
-	if (psDroid->droidType != DROID_SENSOR && psDroid->numWeaps == 0)
-	{
-		return;
-	}
-
-	lookForTarget = false;
-	updateTarget = false;
+	*lookForTarget = false;
+	*updateTarget = false;
 
 	// look for a target if doing nothing
 	if (orderState(psDroid, DORDER_NONE) ||
 	    orderState(psDroid, DORDER_GUARD) ||
 	    orderState(psDroid, DORDER_HOLD))
 	{
-		lookForTarget = true;
+		*lookForTarget = true;
 	}
 	// but do not choose another target if doing anything while guarding
 	// exception for sensors, to allow re-targetting when target is doomed
 	if (orderState(psDroid, DORDER_GUARD) && psDroid->action != DACTION_NONE && psDroid->droidType != DROID_SENSOR)
 	{
-		lookForTarget = false;
+		*lookForTarget = false;
 	}
 	// don't look for a target if sulking
 	if (psDroid->action == DACTION_SULK)
 	{
-		lookForTarget = false;
+		*lookForTarget = false;
 	}
 
 	/* Only try to update target if already have some target */
@@ -1120,26 +1122,26 @@ void aiUpdateDroid(DROID *psDroid)
 	    psDroid->action == DACTION_MOVETOATTACK ||
 	    psDroid->action == DACTION_ROTATETOATTACK)
 	{
-		updateTarget = true;
+		*updateTarget = true;
 	}
 	if ((orderState(psDroid, DORDER_OBSERVE) || orderState(psDroid, DORDER_ATTACKTARGET)) &&
 	    psDroid->order.psObj && psDroid->order.psObj->died)
 	{
-		lookForTarget = true;
-		updateTarget = false;
+		*lookForTarget = true;
+		*updateTarget = false;
 	}
 
 	/* Don't update target if we are sent to attack and reached attack destination (attacking our target) */
 	if (orderState(psDroid, DORDER_ATTACK) && psDroid->psActionTarget[0] == psDroid->order.psObj)
 	{
-		updateTarget = false;
+		*updateTarget = false;
 	}
 
 	// don't look for a target if there are any queued orders
 	if (psDroid->listSize > 0)
 	{
-		lookForTarget = false;
-		updateTarget = false;
+		*lookForTarget = false;
+		*updateTarget = false;
 	}
 
 	// don't allow units to start attacking if they will switch to guarding the commander
@@ -1147,29 +1149,48 @@ void aiUpdateDroid(DROID *psDroid)
 	// they have wider view
 	if (hasCommander(psDroid) && psDroid->droidType != DROID_SENSOR)
 	{
-		lookForTarget = false;
-		updateTarget = false;
+		*lookForTarget = false;
+		*updateTarget = false;
 	}
 
 	if (bMultiPlayer && isVtolDroid(psDroid) && isHumanPlayer(psDroid->player))
 	{
-		lookForTarget = false;
-		updateTarget = false;
+		*lookForTarget = false;
+		*updateTarget = false;
 	}
 
 	// CB and VTOL CB droids can't autotarget.
 	if (psDroid->droidType == DROID_SENSOR && !standardSensorDroid(psDroid))
 	{
-		lookForTarget = false;
-		updateTarget = false;
+		*lookForTarget = false;
+		*updateTarget = false;
 	}
 
 	// do not attack if the attack level is wrong
 	if (secondaryGetState(psDroid, DSO_ATTACK_LEVEL) != DSS_ALEV_ALWAYS)
 	{
-		lookForTarget = false;
+		*lookForTarget = false;
+	}
+}
+
+/* Do the AI for a droid */
+void aiUpdateDroid(DROID *psDroid)
+{
+	bool		lookForTarget, updateTarget;
+
+	ASSERT(psDroid != nullptr, "Invalid droid pointer");
+	if (!psDroid || isDead((BASE_OBJECT *)psDroid))
+	{
+		return;
+	}
+
+	if (psDroid->droidType != DROID_SENSOR && psDroid->numWeaps == 0)
+	{
+		return;
 	}
 
+	aiDroidTargetState(psDroid, &lookForTarget, &updateTarget);
+
 	/* For commanders and non-assigned non-commanders: look for a better target once in a while */
 	if (!lookForTarget && updateTarget && psDroid->numWeaps > 0 && !hasCommander(psDroid)
 	    && (psDroid->id + gameTime) / TARGET_UPD_SKIP_FRAMES != (psDroid->id + gameTime - deltaGameTime) / TARGET_UPD_SKIP_FRAMES)
@@ -1199,7 +1220,20 @@ void aiUpdateDroid(DROID *psDroid)
 		}
 		else
 		{
-			if (aiChooseTarget((BASE_OBJECT *)psDroid, &psTarget, 0, true, nullptr))
+			bool found = false;
+			bool decided = psDroid->decidedTime == gameTime;
+			if (decided)
+			{
+				// Chosen in advance by aiDecideDroidTarget(), check it's still good.
+				psTarget = psDroid->psDecidedTarget;
+				found = psTarget != nullptr && !isDead(psTarget) && validTarget(psDroid, psTarget, 0) && aiDroidHasRange(psDroid, psTarget, 0);
+			}
+			if (!decided || (!found && psDroid->psDecidedTarget != nullptr))
+			{
+				// No decision, or the decided target died or moved away earlier this tick, so search now.
+				found = aiChooseTarget((BASE_OBJECT *)psDroid, &psTarget, 0, true, nullptr);
+			}
+			if (found)
 			{
 				if (!orderState(psDroid, DORDER_HOLD)
 					&& secondaryGetState(psDroid, DSO_HALTTYPE) == DSS_HALT_PURSUE)
@@ -1212,6 +1246,30 @@ void aiUpdateDroid(DROID *psDroid)
 	}
 }
 
+void aiDecideDroidTarget(DROID *psDroid, GridSearch &search)
+{
+	bool lookForTarget, updateTarget;
+
+	if (isDead(psDroid) || psDroid->droidType == DROID_SENSOR || psDroid->numWeaps == 0)
+	{
+		return;
+	}
+
+	aiDroidTargetState(psDroid, &lookForTarget, &updateTarget);
+	if (!lookForTarget || updateTarget)
+	{
+		return;
+	}
+
+	BASE_OBJECT *psTarget = nullptr;
+	if (!aiChooseDroidTarget(psDroid, &psTarget, 0, true, search))
+	{
+		psTarget = nullptr;
+	}
+	psDroid->psDecidedTarget = psTarget;
+	psDroid->decidedTime = gameTime;
+}
+
 /* Check if any of our weapons can hit the target... */
 bool checkAnyWeaponsTarget(BASE_OBJECT *psObject, BASE_OBJECT *psTarget)
 {
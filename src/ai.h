@@ -26,6 +26,7 @@
 
 struct BASE_OBJECT;
 struct DROID;
+struct GridSearch;
 
 #include "weapondef.h"
 
@@ -63,6 +64,10 @@ bool aiShutdown();
 /* Do the AI for a droid */
 void aiUpdateDroid(DROID *psDroid);
 
+// Choose in advance the target aiUpdateDroid() will look for this tick, if any.
+// Only reads the game state, so may be called for several droids at once, with one search per thread.
+void aiDecideDroidTarget(DROID *psDroid, GridSearch &search);
+
 // Find the nearest best target for a droid
 // returns integer representing quality of choice, -1 if failed
 int aiBestNearestTarget(DROID *psDroid, BASE_OBJECT **ppsObj, int weapon_slot, int extraRange = 0);
@@ -84,6 +84,7 @@ static CHEAT_ENTRY cheatCodes[] =
 	{"showorders", kf_ToggleOrders}, //displays unit order/action state.
 	{"pause", kf_TogglePauseMode}, // Pause the game.
 	{"power info", kf_PowerInfo},
+	{"snapshot test", kf_SnapshotRoundTrip}, // capture and restore the world state, and check it hashes identically
 	{"reload me", kf_Reload},	// reload selected weapons immediately
 	{"desync me", kf_ForceDesync},
 	{"damage me", kf_DamageMe},
@@ -28,6 +28,8 @@
 #include "lib/framework/string_ext.h"
 #include "lib/ivis_opengl/screen.h"
 #include "lib/netplay/netplay.h"
+#include "lib/netplay/netbench.h"
+#include "lib/netplay/netrelay.h"
 #include "lib/ivis_opengl/pieclip.h"
 
 #include "levels.h"
@@ -89,6 +91,13 @@ static bool wz_streamer_spectator_mode = false;
 static bool wz_lobby_slashcommands = false;
 static WZ_Command_Interface wz_cmd_interface = WZ_Command_Interface::None;
 static int wz_min_autostart_players = -1;
+static bool wz_netbench = false;
+static NetBenchOptions wz_netbench_options;
+static unsigned wz_replay_seek_seconds = 0;
+static bool wz_replay_bench = false;
+static std::string wz_verify_replays_directory;
+static unsigned wz_verify_replays_jobs = 0;
+static std::string wz_replay_verify_file;
 
 #if defined(WZ_OS_WIN)
 
@@ -350,6 +359,14 @@ typedef enum
 	CLI_ADD_LOBBY_ADMINPUBLICKEY,
 	CLI_COMMAND_INTERFACE,
 	CLI_STARTPLAYERS,
+	CLI_NETBENCH,
+	CLI_RELAY,
+	CLI_RELAYJOIN,
+	CLI_REPLAYSEEK,
+	CLI_REPLAYBENCH,
+	CLI_VERIFYREPLAYS,
+	CLI_VERIFYJOBS,
+	CLI_VERIFYREPLAY,
 } CLI_OPTIONS;
 
 // Separate table that avoids *any* translated strings, to avoid any risk of gettext / libintl function calls
@@ -429,6 +446,14 @@ static const struct poptOption *getOptionsTable()
 		{ "addlobbyadminpublickey", POPT_ARG_STRING, CLI_ADD_LOBBY_ADMINPUBLICKEY, N_("Add a lobby admin public key (for slash commands)"), N_("b64-pub-key")},
 		{ "enablecmdinterface", POPT_ARG_STRING, CLI_COMMAND_INTERFACE, N_("Enable command interface"), N_("(stdin)")},
 		{ "startplayers", POPT_ARG_STRING, CLI_STARTPLAYERS, N_("Minimum required players to auto-start game"), N_("startplayers")},
+		{ "relay", POPT_ARG_STRING, CLI_RELAY, N_("Relay multiplayer games to spectators, as live replays"), N_("port")},
+		{ "relayjoin", POPT_ARG_STRING, CLI_RELAYJOIN, N_("Watch a game from a relay"), N_("host[:port]")},
+		{ "replayseek", POPT_ARG_STRING, CLI_REPLAYSEEK, N_("Skip ahead in the replay loaded with --loadreplay"), N_("seconds")},
+		{ "replaybench", POPT_ARG_NONE, CLI_REPLAYBENCH, N_("Play the replay loaded with --loadreplay headless and as fast as possible, then print timings and exit"), nullptr},
+		{ "netbench", POPT_ARG_STRING, CLI_NETBENCH, N_("Run a loopback network benchmark, or the varint encoding benchmark, and exit"), N_("clients[:ticks[:codec]] or varint[:values]")},
+		{ "verifyreplays", POPT_ARG_STRING, CLI_VERIFYREPLAYS, N_("Verify all replays in a directory, several at once, then print the results as JSON and exit"), N_("directory")},
+		{ "verifyjobs", POPT_ARG_STRING, CLI_VERIFYJOBS, N_("Number of replays --verifyreplays verifies at once (default: number of cores)"), N_("jobs")},
+		{ "verifyreplay", POPT_ARG_STRING, CLI_VERIFYREPLAY, N_("Play a replay headless and as fast as possible, then print its result as JSON and exit"), N_("replay file")},
 		// Terminating entry
 		{ nullptr, 0, 0,              nullptr,                                    nullptr },
 	};
@@ -599,6 +624,17 @@ bool ParseCommandLineEarly(int argc, const char * const *argv)
 	return true;
 }
 
+/// Loads the replay in saveGameName, when the game starts.
+static void loadReplayFromCommandLine()
+{
+	setHostLaunch(HostLaunch::LoadReplay);
+	sstrcpy(sRequestResult, saveGameName); // hack to avoid crashes
+	SPinit(LEVEL_TYPE::SKIRMISH);
+	bMultiPlayer = true;
+	game.maxPlayers = 4; //DEFAULTSKIRMISHMAPMAXPLAYERS;
+	SetGameMode(GS_SAVEGAMELOAD);
+}
+
 //! second half of parsing the commandline
 /**
  * Second half of command line parsing. See ParseCommandLineEarly() for
@@ -827,12 +863,7 @@ bool ParseCommandLine(int argc, const char * const *argv)
 			{
 				qFatal("Unable to find specified replay");
 			}
-			setHostLaunch(HostLaunch::LoadReplay);
-			sstrcpy(sRequestResult, saveGameName); // hack to avoid crashes
-			SPinit(LEVEL_TYPE::SKIRMISH);
-			bMultiPlayer = true;
-			game.maxPlayers = 4; //DEFAULTSKIRMISHMAPMAXPLAYERS;
-			SetGameMode(GS_SAVEGAMELOAD);
+			loadReplayFromCommandLine();
 			break;
 		}
 		case CLI_CONTINUE:
@@ -1033,6 +1064,136 @@ bool ParseCommandLine(int argc, const char * const *argv)
 			debug(LOG_INFO, "Games will automatically start with [%d] players (when ready)", wz_min_autostart_players);
 			break;
 
+		case CLI_RELAY:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || atoi(token) <= 0 || atoi(token) > 65535)
+			{
+				qFatal("Bad relay port");
+			}
+			NETrelaySetPort(atoi(token));
+			break;
+
+		case CLI_RELAYJOIN:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || strlen(token) == 0)
+			{
+				qFatal("Bad relay address");
+			}
+			// Loaded like a replay file, see loadGameInit
+			snprintf(saveGameName, sizeof(saveGameName), "wzrelay://%s", token);
+			setHostLaunch(HostLaunch::LoadReplay);
+			sstrcpy(sRequestResult, saveGameName); // hack to avoid crashes
+			SPinit(LEVEL_TYPE::SKIRMISH);
+			bMultiPlayer = true;
+			game.maxPlayers = 4; //DEFAULTSKIRMISHMAPMAXPLAYERS;
+			SetGameMode(GS_SAVEGAMELOAD);
+			break;
+
+		case CLI_REPLAYSEEK:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || atoi(token) <= 0)
+			{
+				qFatal("Bad replay seek time");
+			}
+			wz_replay_seek_seconds = atoi(token);
+			break;
+
+		case CLI_REPLAYBENCH:
+			wz_replay_bench = true;
+			wz_cli_headless = true;
+			setHeadlessGameMode(true);
+			war_setSoundEnabled(false);
+			break;
+
+		case CLI_VERIFYREPLAYS:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || *token == '\0')
+			{
+				qFatal("Bad replay directory");
+			}
+			wz_verify_replays_directory = token;
+			break;
+
+		case CLI_VERIFYJOBS:
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || atoi(token) <= 0)
+			{
+				qFatal("Bad number of jobs");
+			}
+			wz_verify_replays_jobs = atoi(token);
+			break;
+
+		case CLI_VERIFYREPLAY:
+		{
+			token = poptGetOptArg(poptCon);
+			if (token == nullptr || *token == '\0')
+			{
+				qFatal("Unrecognised replay name");
+			}
+			// The replay can be anywhere, so mount its directory.
+			std::string path = token;
+			size_t separator = path.find_last_of("/\\");
+			std::string directory = separator == std::string::npos ? "." : separator == 0 ? path.substr(0, 1) : path.substr(0, separator);
+			std::string fileName = separator == std::string::npos ? path : path.substr(separator + 1);
+			if (PHYSFS_mount(directory.c_str(), "verifyreplay", PHYSFS_PREPEND) == 0)
+			{
+				qFatal("Could not open replay directory %s: %s", directory.c_str(), WZ_PHYSFS_getLastError());
+			}
+			snprintf(saveGameName, sizeof(saveGameName), "verifyreplay/%s", fileName.c_str());
+			if (!PHYSFS_exists(saveGameName))
+			{
+				qFatal("Unable to find specified replay");
+			}
+			loadReplayFromCommandLine();
+			wz_replay_verify_file = path;
+			wz_replay_bench = true;
+			wz_cli_headless = true;
+			setHeadlessGameMode(true);
+			war_setSoundEnabled(false);
+			break;
+		}
+
+		case CLI_NETBENCH:
+			{
+				token = poptGetOptArg(poptCon);
+				if (token == nullptr)
+				{
+					qFatal("Bad netbench settings");
+				}
+				if (strncmp(token, "varint", strlen("varint")) == 0)
+				{
+					int values = 10000000;
+					if (token[strlen("varint")] != '\0' && (sscanf(token, "varint:%d", &values) != 1 || values <= 0))
+					{
+						qFatal("Bad netbench settings, expected varint[:values]");
+					}
+					wz_netbench_options.varintValues = values;
+					wz_netbench = true;
+					break;
+				}
+				int clients = 0, ticks = 0;
+				char codec[20] = "";
+				int count = sscanf(token, "%d:%d:%19s", &clients, &ticks, codec);
+				if (count < 1 || clients <= 0 || (count >= 2 && ticks <= 0))
+				{
+					qFatal("Bad netbench settings, expected clients[:ticks[:codec]]");
+				}
+				wz_netbench_options.clients = clients;
+				if (count >= 2)
+				{
+					wz_netbench_options.ticks = ticks;
+				}
+				if (count >= 3)
+				{
+					if (!socketCodecFromName(codec, wz_netbench_options.codec))
+					{
+						qFatal("Unsupported netbench codec, expected none, zlib or zlib-fast");
+					}
+				}
+				wz_netbench = true;
+			}
+			break;
+
 		};
 	}
 
@@ -1090,3 +1251,33 @@ int min_autostart_player_count()
 {
 	return wz_min_autostart_players;
 }
+
+const NetBenchOptions *netbench_options()
+{
+	return wz_netbench ? &wz_netbench_options : nullptr;
+}
+
+unsigned replay_seek_seconds()
+{
+	return wz_replay_seek_seconds;
+}
+
+bool replay_bench_enabled()
+{
+	return wz_replay_bench;
+}
+
+const char *verify_replays_directory()
+{
+	return !wz_verify_replays_directory.empty() ? wz_verify_replays_directory.c_str() : nullptr;
+}
+
+unsigned verify_replays_jobs()
+{
+	return wz_verify_replays_jobs;
+}
+
+const char *replay_verify_file()
+{
+	return !wz_replay_verify_file.empty() ? wz_replay_verify_file.c_str() : nullptr;
+}
@@ -48,4 +48,14 @@ WZ_Command_Interface wz_command_interface();
 
 int min_autostart_player_count();
 
+struct NetBenchOptions;
+const NetBenchOptions *netbench_options();  ///< Settings given with --netbench, or nullptr if no benchmark was requested.
+
+unsigned replay_seek_seconds();  ///< Game time to skip to in the replay, from --replayseek, or 0.
+bool replay_bench_enabled();      ///< True if the replay loaded with --loadreplay is to be benchmarked, see replaybench.h.
+
+const char *verify_replays_directory();  ///< Directory given with --verifyreplays, or nullptr, see replayverify.h.
+unsigned verify_replays_jobs();          ///< Number of jobs given with --verifyreplays, or 0 for the default.
+const char *replay_verify_file();        ///< Replay given with --verifyreplay, or nullptr.
+
 #endif // __INCLUDED_SRC_CLPARSE_H__
@@ -483,6 +483,10 @@ int32_t objDamage(BASE_OBJECT *psObj, unsigned damage, unsigned originalhp, WEAP
 
 	// Subtract the dealt damage from the droid's remaining body points
 	psObj->body -= actualDamage;
+	if (psObj->type == OBJ_STRUCTURE)
+	{
+		structureWake((STRUCTURE *)psObj);
+	}
 
 	syncDebugObject(psObj, 'D');
 
@@ -53,6 +53,7 @@
 #include "display.h"
 #include "keybind.h" // for MAP_ZOOM_RATE_STEP
 #include "loadsave.h" // for autosaveEnabled
+#include "savecontainer.h" // for saveContainerEnabled
 #include "clparse.h" // for autoratingUrl
 
 #include <type_traits>
@@ -406,6 +407,13 @@ bool loadConfig()
 		NETsetGameserverPort(iniGetInteger("gameserver_port", GAMESERVERPORT).value());
 	}
 	NETsetJoinPreferenceIPv6(iniGetBool("prefer_ipv6", true).value());
+	SocketCodecType hostCodec = SocketCodecType::Zlib;
+	std::string hostCodecName = iniGetString("host_codec", socketCodecName(hostCodec)).value();
+	if (!socketCodecFromName(hostCodecName.c_str(), hostCodec))
+	{
+		debug(LOG_WARNING, "Unsupported host_codec \"%s\", expected none, zlib or zlib-fast", hostCodecName.c_str());
+	}
+	NETsetHostCodec(hostCodec);
 	setPublicIPv4LookupService(iniGetString("publicIPv4LookupService_Url", WZ_DEFAULT_PUBLIC_IPv4_LOOKUP_SERVICE_URL).value(), iniGetString("publicIPv4LookupService_JSONKey", WZ_DEFAULT_PUBLIC_IPv4_LOOKUP_SERVICE_JSONKEY).value());
 	setPublicIPv6LookupService(iniGetString("publicIPv6LookupService_Url", WZ_DEFAULT_PUBLIC_IPv6_LOOKUP_SERVICE_URL).value(), iniGetString("publicIPv6LookupService_JSONKey", WZ_DEFAULT_PUBLIC_IPv6_LOOKUP_SERVICE_JSONKEY).value());
 	war_SetFMVmode((FMV_MODE)iniGetInteger("FMVmode", FMV_FULLSCREEN).value());
@@ -548,6 +556,7 @@ bool loadConfig()
 	BlueprintTrackAnimationSpeed = iniGetInteger("BlueprintTrackAnimationSpeed", 20).value();
 	lockCameraScrollWhileRotating = iniGetBool("lockCameraScrollWhileRotating", false).value();
 	autosaveEnabled = iniGetBool("autosaveEnabled", true).value();
+	saveContainerEnabled = iniGetBool("saveContainer", false).value();
 	bool fogEnabled = iniGetBool("fog", false).value();
 	if (fogEnabled)
 	{
@@ -677,6 +686,7 @@ bool saveConfig()
 		iniSetInteger("gameserver_port", (int)NETgetGameserverPort());
 	}
 	iniSetBool("prefer_ipv6", NETgetJoinPreferenceIPv6());
+	iniSetString("host_codec", socketCodecName(NETgetHostCodec()));
 	iniSetString("publicIPv4LookupService_Url", getPublicIPv4LookupServiceUrl());
 	iniSetString("publicIPv4LookupService_JSONKey", getPublicIPv4LookupServiceJSONKey());
 	iniSetString("publicIPv6LookupService_Url", getPublicIPv6LookupServiceUrl());
@@ -718,6 +728,7 @@ bool saveConfig()
 	iniSetInteger("BlueprintTrackAnimationSpeed", BlueprintTrackAnimationSpeed);
 	iniSetBool("lockCameraScrollWhileRotating", lockCameraScrollWhileRotating);
 	iniSetBool("autosaveEnabled", autosaveEnabled);
+	iniSetBool("saveContainer", saveContainerEnabled);
 	iniSetBool("fog", pie_GetFogEnabled());
 	iniSetInteger("hostAutoLagKickSeconds", war_getAutoLagKickSeconds());
 	iniSetBool("disableReplayRecord", war_getDisableReplayRecording());
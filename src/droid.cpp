@@ -71,6 +71,7 @@
 #include "combat.h"
 #include "template.h"
 #include "qtscript.h"
+#include "snapshot.h"
 
 #define DEFAULT_RECOIL_TIME	(GAME_TICKS_PER_SEC/4)
 #define	DROID_DAMAGE_SPREAD	(16 - rand()%32)
@@ -395,6 +396,37 @@ void add_to_experience_queue(int player, int value)
 	recycled_experience[player].push(value);
 }
 
+void droidExperienceSnapshotWrite(SnapshotWriter &writer)
+{
+	for (auto queue : recycled_experience)
+	{
+		writer.u32(static_cast<uint32_t>(queue.size()));
+		for (; !queue.empty(); queue.pop())
+		{
+			writer.i32(queue.top());
+		}
+	}
+}
+
+bool droidExperienceSnapshotRead(SnapshotReader &reader)
+{
+	std::priority_queue<int> queues[MAX_PLAYERS];
+	for (auto &queue : queues)
+	{
+		uint32_t count = reader.u32();
+		for (uint32_t n = 0; n < count && reader.valid(); ++n)
+		{
+			queue.push(reader.i32());
+		}
+	}
+	if (!reader.valid())
+	{
+		return false;
+	}
+	std::move(queues, queues + MAX_PLAYERS, recycled_experience);
+	return true;
+}
+
 // recycle a droid (retain it's experience and some of it's cost)
 void recycleDroid(DROID *psDroid)
 {
@@ -65,6 +65,13 @@ std::priority_queue<int> copy_experience_queue(int player);
 int getTopExperience(int player);
 void add_to_experience_queue(int player, int value);
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/// Saves and restores the experience kept from recycled droids, see snapshot.h.
+void droidExperienceSnapshotWrite(SnapshotWriter &writer);
+bool droidExperienceSnapshotRead(SnapshotReader &reader);
+
 // initialise droid module
 bool droidInit();
 
@@ -0,0 +1,144 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/*
+ * droiddecide.cpp
+ *
+ * Each droid only writes its own decision, and only reads the rest of the game state,
+ * so the droids can be split between the threads in any way.
+ */
+
+#include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
+
+#include "droiddecide.h"
+#include "objects.h"
+#include "ai.h"
+#include "mapgrid.h"
+#include "objmem.h"
+
+#include <atomic>
+#include <thread>
+
+#define MAX_DECIDE_THREADS      8       ///< Including the main thread.
+#define MIN_DROIDS_PER_THREAD   64      ///< Not worth waking up a thread for fewer droids than this.
+
+static std::vector<WZ_THREAD *> decideThreads;
+static WZ_SEMAPHORE *decideSemaphore = nullptr;      ///< Posted once per worker thread, to start deciding.
+static WZ_SEMAPHORE *decideDoneSemaphore = nullptr;  ///< Posted by each worker thread, when done deciding.
+static bool decideQuit = false;
+
+static std::vector<DROID *> decideDroids;
+static std::atomic<size_t> decideNext(0);
+
+static void droidDecideDroids(GridSearch &search)
+{
+	size_t i;
+	while ((i = decideNext++) < decideDroids.size())
+	{
+		aiDecideDroidTarget(decideDroids[i], search);
+	}
+}
+
+static int droidDecideThreadFunc(void *)
+{
+	GridSearch search;
+
+	while (true)
+	{
+		wzSemaphoreWait(decideSemaphore);
+		if (decideQuit)
+		{
+			break;
+		}
+		droidDecideDroids(search);
+		wzSemaphorePost(decideDoneSemaphore);
+	}
+	return 0;
+}
+
+bool droidDecideInitialise()
+{
+	ASSERT_OR_RETURN(false, decideThreads.empty(), "Decide threads already running");
+
+	unsigned numThreads = std::min<unsigned>(std::max(std::thread::hardware_concurrency(), 1u), MAX_DECIDE_THREADS);
+
+	decideQuit = false;
+	decideSemaphore = wzSemaphoreCreate(0);
+	decideDoneSemaphore = wzSemaphoreCreate(0);
+	for (unsigned n = 1; n < numThreads; ++n)
+	{
+		WZ_THREAD *thread = wzThreadCreate(droidDecideThreadFunc, nullptr);
+		wzThreadStart(thread);
+		decideThreads.push_back(thread);
+	}
+	debug(LOG_WZ, "Deciding droid targets on %u threads", numThreads);
+	return true;
+}
+
+void droidDecideShutdown()
+{
+	decideQuit = true;
+	for (size_t n = 0; n < decideThreads.size(); ++n)
+	{
+		wzSemaphorePost(decideSemaphore);  // Wake up thread.
+	}
+	for (WZ_THREAD *thread : decideThreads)
+	{
+		wzThreadJoin(thread);
+	}
+	decideThreads.clear();
+	if (decideSemaphore)
+	{
+		wzSemaphoreDestroy(decideSemaphore);
+		decideSemaphore = nullptr;
+	}
+	if (decideDoneSemaphore)
+	{
+		wzSemaphoreDestroy(decideDoneSemaphore);
+		decideDoneSemaphore = nullptr;
+	}
+	decideDroids.clear();
+}
+
+void droidDecideUpdate()
+{
+	decideDroids.clear();
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (DROID *psDroid = apsDroidLists[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+		{
+			decideDroids.push_back(psDroid);
+		}
+	}
+	decideNext = 0;
+
+	size_t numWorkers = std::min(decideThreads.size(), decideDroids.size() / MIN_DROIDS_PER_THREAD);
+	for (size_t n = 0; n < numWorkers; ++n)
+	{
+		wzSemaphorePost(decideSemaphore);
+	}
+
+	static GridSearch search;  // static to avoid allocations.
+	droidDecideDroids(search);
+
+	for (size_t n = 0; n < numWorkers; ++n)
+	{
+		wzSemaphoreWait(decideDoneSemaphore);
+	}
+}
@@ -0,0 +1,37 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2005-2020  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Read-only "decide" stage of the droid update, run on several threads before the droids are updated in order.
+ */
+
+#ifndef __INCLUDED_SRC_DROIDDECIDE_H__
+#define __INCLUDED_SRC_DROIDDECIDE_H__
+
+/// Start the worker threads.
+bool droidDecideInitialise();
+
+/// Stop the worker threads.
+void droidDecideShutdown();
+
+/// Decide in advance what each droid will do this tick, without changing the game state.
+/// The decisions are applied (or discarded, if no longer valid) by droidUpdate(), in the usual order.
+/// Must be called after gridReset(), and the result does not depend on the number of threads.
+void droidDecideUpdate();
+
+#endif // __INCLUDED_SRC_DROIDDECIDE_H__
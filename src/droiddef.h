@@ -143,6 +143,8 @@ struct DROID : public BASE_OBJECT
 	DROID_ACTION    action;
 	Vector2i        actionPos;
 	BASE_OBJECT    *psActionTarget[MAX_WEAPONS] = {}; ///< Action target object
+	BASE_OBJECT    *psDecidedTarget = nullptr;      ///< Target chosen in advance by aiDecideDroidTarget(), only valid if decidedTime == gameTime
+	UDWORD          decidedTime = UDWORD_MAX;       ///< Game time psDecidedTarget was chosen
 	UDWORD          actionStarted;                  ///< Game time action started
 	UDWORD          actionPoints;                   ///< number of points done by action since start
 	UDWORD          expectedDamageDirect;                 ///< Expected damage to be caused by all currently incoming direct projectiles. This info is shared between all players,
@@ -24,6 +24,7 @@
  *
  */
 
+#include <algorithm>
 #include <future>
 #include <unordered_map>
 
@@ -37,6 +38,7 @@
 #include "map.h"
 #include "multiplay.h"
 #include "astar.h"
+#include "snapshot.h"
 
 #include "fpath.h"
 
@@ -311,6 +313,84 @@ void fpathRemoveDroidData(int id)
 	pathResults.erase(id);
 }
 
+/// A future which already has its result, for results restored from a snapshot.
+static wz::future<PATHRESULT> fpathReadyResult(PATHRESULT const &result)
+{
+	packagedPathJob task([result]() { return result; });
+	wz::future<PATHRESULT> future = task.get_future();
+	task();
+	return future;
+}
+
+void fpathSnapshotWrite(SnapshotWriter &writer)
+{
+	std::vector<uint32_t> ids;
+	for (auto const &result : pathResults)
+	{
+		ids.push_back(result.first);
+	}
+	std::sort(ids.begin(), ids.end());
+	writer.u32(static_cast<uint32_t>(ids.size()));
+	for (uint32_t id : ids)
+	{
+		wz::future<PATHRESULT> &future = pathResults[id];
+		PATHRESULT result = future.get();
+		future = fpathReadyResult(result);  // get() can only be called once.
+
+		// Only these fields are used by fpathRoute().
+		writer.u32(id);
+		writer.u32(result.droidID);
+		writer.i32(result.sMove.destination.x);
+		writer.i32(result.sMove.destination.y);
+		writer.u32(static_cast<uint32_t>(result.sMove.asPath.size()));
+		for (Vector2i const &point : result.sMove.asPath)
+		{
+			writer.i32(point.x);
+			writer.i32(point.y);
+		}
+		writer.u8(result.retval);
+		writer.i32(result.originalDest.x);
+		writer.i32(result.originalDest.y);
+	}
+}
+
+bool fpathSnapshotRead(SnapshotReader &reader)
+{
+	std::vector<std::pair<uint32_t, PATHRESULT>> read;
+	uint32_t count = reader.u32();
+	for (uint32_t n = 0; n < count && reader.valid(); ++n)
+	{
+		uint32_t id = reader.u32();
+		PATHRESULT result;
+		result.droidID = reader.u32();
+		result.sMove.destination.x = reader.i32();
+		result.sMove.destination.y = reader.i32();
+		uint32_t pathSize = reader.u32();
+		for (uint32_t i = 0; i < pathSize && reader.valid(); ++i)
+		{
+			Vector2i point;
+			point.x = reader.i32();
+			point.y = reader.i32();
+			result.sMove.asPath.push_back(point);
+		}
+		result.retval = static_cast<FPATH_RETVAL>(reader.u8());
+		result.originalDest.x = reader.i32();
+		result.originalDest.y = reader.i32();
+		read.emplace_back(id, std::move(result));
+	}
+	if (!reader.valid())
+	{
+		return false;
+	}
+	// Jobs still in the queue finish into futures nobody waits for, like the jobs of deleted droids.
+	pathResults.clear();
+	for (auto const &result : read)
+	{
+		pathResults[result.first] = fpathReadyResult(result.second);
+	}
+	return true;
+}
+
 static FPATH_RETVAL fpathRoute(MOVE_CONTROL *psMove, unsigned id, int startX, int startY, int tX, int tY, PROPULSION_TYPE propulsionType,
                                DROID_TYPE droidType, FPATH_MOVETYPE moveType, int owner, bool acceptNearest, StructureBounds const &dstStructure)
 {
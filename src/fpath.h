@@ -124,6 +124,13 @@ bool fpathCheck(Position orig, Position dest, PROPULSION_TYPE propulsion);
 /** Unit testing. */
 void fpathTest(int x, int y, int x2, int y2);
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/** Saves and restores the results of the path-finding jobs, see snapshot.h. Saving waits for the jobs to finish. */
+void fpathSnapshotWrite(SnapshotWriter &writer);
+bool fpathSnapshotRead(SnapshotReader &reader);
+
 /** @} */
 
 #endif // __INCLUDED_SRC_FPATH_H__
@@ -29,6 +29,7 @@
 #include "lib/framework/wzconfig.h"
 #include "lib/framework/file.h"
 #include "lib/framework/physfs_ext.h"
+#include "lib/framework/savebatch.h"
 #include "lib/framework/strres.h"
 #include "lib/framework/frameresource.h"
 #include "lib/framework/wztime.h"
@@ -42,6 +43,7 @@
 #include "lib/ivis_opengl/piepalette.h"
 #include "lib/ivis_opengl/textdraw.h"
 #include "lib/netplay/netplay.h"
+#include "lib/netplay/netreplay.h"
 #include "lib/sound/audio.h"
 #include "lib/sound/audio_id.h"
 #include "modding.h"
@@ -59,6 +61,7 @@
 #include "power.h"
 #include "projectile.h"
 #include "loadsave.h"
+#include "savecontainer.h"
 #include "text.h"
 #include "message.h"
 #include "hci.h"
@@ -113,8 +116,14 @@
 # pragma GCC diagnostic ignored "-Wunused-function"
 #endif
 
-bool saveJSONToFile(const nlohmann::json& obj, const char* pFileName)
+bool saveJSONToFile(nlohmann::json obj, const char* pFileName)
 {
+	if (SaveBatch *batch = saveBatchCurrent())
+	{
+		debug(LOG_SAVE, "%s %s", "Queueing", pFileName);
+		batch->addJSON(pFileName, std::move(obj));
+		return true;
+	}
 	std::ostringstream stream;
 	try {
 		stream << obj.dump(4) << std::endl;
@@ -2276,7 +2285,7 @@ bool loadGameInit(const char *fileName)
 {
 	ASSERT_OR_RETURN(false, fileName != nullptr, "fileName is null??");
 
-	if (strEndsWith(fileName, ".wzrp"))
+	if (strEndsWith(fileName, ".wzrp") || NETisReplayRelayAddress(fileName))
 	{
 		SetGameMode(GS_TITLE_SCREEN); // hack - the caller sets this to GS_NORMAL but we actually want to proceed with normal startGameLoop
 
@@ -2487,6 +2496,9 @@ bool loadGame(const char *pGameToLoad, bool keepObjects, bool freeMem, bool User
 	                missionScrollMaxX = 0, missionScrollMaxY = 0;
 	uint32_t        mapSeed = 0;
 
+	autoSaveWait();  // In case we are loading the save still being written.
+	saveContainerMount(pGameToLoad);  // The search path may have been rebuilt since gameLoad().
+
 	/* Stop the game clock */
 	gameTimeStop();
 
@@ -3337,7 +3349,7 @@ error:
 }
 // -----------------------------------------------------------------------------------------
 
-bool saveGame(const char *aFileName, GAME_TYPE saveType)
+static bool saveGameFiles(const char *aFileName, GAME_TYPE saveType)
 {
 	size_t			fileExtension;
 	DROID			*psDroid, *psNext;
@@ -3364,7 +3376,10 @@ bool saveGame(const char *aFileName, GAME_TYPE saveType)
 	CurrentFileName[strlen(CurrentFileName) - 4] = '\0';
 
 	//create dir will fail if directory already exists but don't care!
-	(void) PHYSFS_mkdir(CurrentFileName);
+	if (saveBatchCurrent() == nullptr)  // Otherwise created when the batch is written.
+	{
+		(void) PHYSFS_mkdir(CurrentFileName);
+	}
 
 	writeMainFile(std::string(CurrentFileName) + "/main.json", saveType);
 
@@ -3637,6 +3652,20 @@ error:
 	return false;
 }
 
+// -----------------------------------------------------------------------------------------
+bool saveGame(const char *aFileName, GAME_TYPE saveType)
+{
+	// Collect the files to put them in a container, unless someone else already collects them.
+	if (!saveContainerEnabled || saveBatchCurrent() != nullptr)
+	{
+		return saveGameFiles(aFileName, saveType);
+	}
+	saveBatchBegin();
+	bool saved = saveGameFiles(aFileName, saveType);
+	std::unique_ptr<SaveBatch> batch = saveBatchEnd();
+	return saved && saveContainerWrite(*batch, aFileName);
+}
+
 // -----------------------------------------------------------------------------------------
 static bool writeMapFile(const char *fileName)
 {
@@ -3661,6 +3690,9 @@ static bool writeMapFile(const char *fileName)
 // -----------------------------------------------------------------------------------------
 static bool gameLoad(const char *fileName)
 {
+	autoSaveWait();  // In case we are loading the save still being written.
+	saveContainerMount(fileName);
+
 	char CurrentFileName[PATH_MAX];
 	strcpy(CurrentFileName, fileName);
 	GAME_SAVEHEADER fileHeader = {};
@@ -4978,7 +5010,7 @@ static bool writeGameFile(const char *fileName, SDWORD saveType)
 	const std::string pathToCommonSaveDir(fileNameStr, 0, lastSep + 1);
 	const std::string gameName(fileNameStr, lastSep + 1, len - pathToCommonSaveDir.size() - 4);
 	const std::string pathToThisSaveDir = pathToCommonSaveDir + gameName + "/";
-	if (!PHYSFS_exists(pathToThisSaveDir.c_str()))
+	if (saveBatchCurrent() == nullptr && !PHYSFS_exists(pathToThisSaveDir.c_str()))
 	{
 		PHYSFS_mkdir(pathToThisSaveDir.c_str());
 	}
@@ -4999,12 +5031,12 @@ static bool writeGameFile(const char *fileName, SDWORD saveType)
 	auto saveInfoJson = saveInfoJsonOpt.value();
 	// new .json format
 	serializeSaveGameData_json(gamJson, saveInfoJson, gameName.c_str(), &saveGame);
-	if (!saveJSONToFile(gamJson, jsonFileName.c_str()))
+	if (!saveJSONToFile(std::move(gamJson), jsonFileName.c_str()))
 	{
 		debug(LOG_ERROR, "Failed to save: %s", jsonFileName.c_str());
 		return false;
 	}
-	if (!saveJSONToFile(saveInfoJson, saveInfoJsonFilename.c_str()))
+	if (!saveJSONToFile(std::move(saveInfoJson), saveInfoJsonFilename.c_str()))
 	{
 		debug(LOG_ERROR, "Failed to save: %s", saveInfoJsonFilename.c_str());
 		return false;
@@ -5823,7 +5855,7 @@ static bool writeDroidFile(const char *pFileName, DROID **ppsCurrentDroidLists)
 		}
 	}
 
-	return saveJSONToFile(mRoot, pFileName);
+	return saveJSONToFile(std::move(mRoot), pFileName);
 }
 
 
@@ -6966,7 +6998,7 @@ bool writeTemplateFile(const char *pFileName)
 	}
 	mRoot["localTemplates"] = std::move(localtemplates_array);
 
-	return saveJSONToFile(mRoot, pFileName);
+	return saveJSONToFile(std::move(mRoot), pFileName);
 }
 
 // -----------------------------------------------------------------------------------------
@@ -7341,6 +7373,7 @@ bool loadSaveResearch(const char *pFileName)
 			{
 				researchResult(statInc, plr, false, nullptr, false);
 			}
+			invalidateResearchCandidates(plr);
 		}
 		ini.endGroup();
 	}
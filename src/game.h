@@ -69,5 +69,5 @@ const char *savegameWithoutExtension(const char *name);
 void gameScreenSizeDidChange(unsigned int oldWidth, unsigned int oldHeight, unsigned int newWidth, unsigned int newHeight);
 void gameDisplayScaleFactorDidChange(float newDisplayScaleFactor);
 nonstd::optional<nlohmann::json> parseJsonFile(const char *filename);
-bool saveJSONToFile(const nlohmann::json& obj, const char* pFileName);
+bool saveJSONToFile(nlohmann::json obj, const char* pFileName);
 #endif // __INCLUDED_SRC_GAME_H__
@@ -104,6 +104,31 @@ DROID_GROUP *grpFind(int id)
 	return psGroup;
 }
 
+std::vector<DROID_GROUP *> grpSnapshotGroups()
+{
+	std::vector<DROID_GROUP *> groups;
+	for (auto const &group : grpGlobalManager)
+	{
+		groups.push_back(group.second);
+	}
+	return groups;
+}
+
+void grpSnapshotReplace(std::vector<DROID_GROUP *> const &groups)
+{
+	ASSERT(grpInitialized, "Group code not initialized yet");
+	for (auto const &group : grpGlobalManager)
+	{
+		delete group.second;
+	}
+	grpGlobalManager.clear();
+	for (DROID_GROUP *psGroup : groups)
+	{
+		ASSERT(grpGlobalManager.count(psGroup->id) == 0, "Group %d is already created!", psGroup->id);
+		grpGlobalManager.emplace(psGroup->id, psGroup);
+	}
+}
+
 // add a droid to a group
 void DROID_GROUP::add(DROID *psDroid)
 {
@@ -26,6 +26,8 @@
 
 #include "orderdef.h"
 
+#include <vector>
+
 struct BASE_OBJECT;
 struct DROID;
 
@@ -70,4 +72,9 @@ DROID_GROUP *grpCreate(int id = -1);
 /// lookup group by its unique id, or create it if not found
 DROID_GROUP *grpFind(int id);
 
+/// All groups, ordered by id, for snapshots.
+std::vector<DROID_GROUP *> grpSnapshotGroups();
+/// Replaces all groups by the ones restored from a snapshot. The old groups are deleted without touching their members.
+void grpSnapshotReplace(std::vector<DROID_GROUP *> const &groups);
+
 #endif // __INCLUDED_SRC_GROUP_H__
@@ -0,0 +1,137 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/**
+ * @file hosttelemetry.cpp
+ *
+ * Network telemetry for the command interface, so that autohosts can watch for lag without a debugger.
+ */
+
+#include <nlohmann/json.hpp> // Must come before WZ includes
+using json = nlohmann::json;
+
+#include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
+#include "lib/gamelib/gtime.h"
+#include "lib/netplay/netplay.h"
+#include "lib/netplay/netlog.h"
+
+#include "hosttelemetry.h"
+#include "multiplay.h"
+#include "stdinreader.h"
+
+#include <algorithm>
+
+struct TickTiming
+{
+	uint64_t ticks = 0;
+	uint64_t totalMicroseconds = 0;
+	uint64_t maxMicroseconds = 0;
+};
+
+static TickTiming tickTiming;  ///< Since the previous telemetry report.
+static unsigned telemetryInterval = 0;
+static uint32_t lastTelemetryTime = 0;
+
+void hostTelemetryRecordTick(uint64_t microseconds)
+{
+	++tickTiming.ticks;
+	tickTiming.totalMicroseconds += microseconds;
+	tickTiming.maxMicroseconds = std::max(tickTiming.maxMicroseconds, microseconds);
+}
+
+std::string hostTelemetryJSON()
+{
+	json telemetry = json::object();
+	telemetry["realTime"] = realTime;
+	telemetry["gameTime"] = gameTime;
+	telemetry["isHost"] = NetPlay.isHost;
+
+	json players = json::array();
+	for (unsigned i = 0; i < MAX_CONNECTED_PLAYERS; ++i)
+	{
+		if (!NetPlay.players[i].allocated || i == NetPlay.hostPlayer)
+		{
+			continue;
+		}
+		json player = json::object();
+		player["index"] = i;
+		player["ip"] = NetPlay.players[i].IPtextAddress;
+		player["spectator"] = NetPlay.players[i].isSpectator;
+		player["ping"] = ingame.PingTimes[i];
+		player["lagCounter"] = ingame.LagCounter[i];
+		player["pendingBytes"] = NETgetPendingWriteBytes(i);
+		players.push_back(std::move(player));
+	}
+	telemetry["players"] = std::move(players);
+
+	// Raw bytes are what went over the wire, uncompressed bytes are before the codec.
+	json bytes = json::object();
+	bytes["sentRaw"] = NETgetStatistic(NetStatisticRawBytes, true, true);
+	bytes["sentUncompressed"] = NETgetStatistic(NetStatisticUncompressedBytes, true, true);
+	bytes["receivedRaw"] = NETgetStatistic(NetStatisticRawBytes, false, true);
+	bytes["receivedUncompressed"] = NETgetStatistic(NetStatisticUncompressedBytes, false, true);
+	bytes["codecMicroseconds"] = NETgetStatistic(NetStatisticCodecMicroseconds, true, true) + NETgetStatistic(NetStatisticCodecMicroseconds, false, true);
+	telemetry["bytes"] = std::move(bytes);
+
+	// Only message types which have been used, as [count, bytes].
+	json messages = json::object();
+	for (unsigned type = 0; type < 256; ++type)
+	{
+		uint32_t sentCount, sentBytes, receivedCount, receivedBytes;
+		NETgetPacketStats(type, false, sentCount, sentBytes);
+		NETgetPacketStats(type, true, receivedCount, receivedBytes);
+		if (sentCount == 0 && receivedCount == 0)
+		{
+			continue;
+		}
+		messages[messageTypeToString(type)] = {{"sent", {sentCount, sentBytes}}, {"received", {receivedCount, receivedBytes}}};
+	}
+	telemetry["messages"] = std::move(messages);
+
+	json ticks = json::object();
+	ticks["count"] = tickTiming.ticks;
+	ticks["avgMicroseconds"] = tickTiming.ticks != 0 ? tickTiming.totalMicroseconds / tickTiming.ticks : 0;
+	ticks["maxMicroseconds"] = tickTiming.maxMicroseconds;
+	telemetry["ticks"] = std::move(ticks);
+	tickTiming = TickTiming();
+
+	return telemetry.dump();
+}
+
+void hostTelemetryOutput()
+{
+	std::string line = "WZTELEMETRY: " + hostTelemetryJSON() + "\n";
+	wz_command_interface_output_str(line.c_str());
+}
+
+void hostTelemetrySetInterval(unsigned seconds)
+{
+	telemetryInterval = seconds;
+	lastTelemetryTime = realTime;
+}
+
+void hostTelemetryUpdate()
+{
+	if (telemetryInterval == 0 || realTime - lastTelemetryTime < telemetryInterval * GAME_TICKS_PER_SEC)
+	{
+		return;
+	}
+	lastTelemetryTime = realTime;
+	hostTelemetryOutput();
+}
@@ -0,0 +1,38 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/// Records the time taken by one game state update.
+void hostTelemetryRecordTick(uint64_t microseconds);
+
+/// Returns the network telemetry as a single line of JSON, and starts a new tick timing window.
+std::string hostTelemetryJSON();
+
+/// Outputs the telemetry on the command interface now.
+void hostTelemetryOutput();
+
+/// Outputs the telemetry on the command interface every given number of seconds. 0 disables.
+void hostTelemetrySetInterval(unsigned seconds);
+
+/// Call once per frame, outputs the telemetry if it is time to.
+void hostTelemetryUpdate();
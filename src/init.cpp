@@ -56,6 +56,7 @@
 #include "difficulty.h" // for "double up" and "biffer baker" cheats
 #include "display.h"
 #include "display3d.h"
+#include "droiddecide.h"
 #include "edit3d.h"
 #include "effects.h"
 #include "fpath.h"
@@ -1048,6 +1049,8 @@ bool systemInitialise(unsigned int horizScalePercentage, unsigned int vertScaleP
 //
 void systemShutdown()
 {
+	autoSaveWait();
+
 	if (bLoadSaveUp)
 	{
 		closeLoadSaveOnShutdown(); // TODO: Ideally this would not be required here (refactor loadsave.cpp / frontend.cpp?)
@@ -1277,6 +1280,11 @@ bool stageOneInitialise()
 		return false;
 	}
 
+	if (!droidDecideInitialise())
+	{
+		return false;
+	}
+
 	if (!allocPlayerPower())	/*set up the PlayerPower for each player - this should only be done ONCE now*/
 	{
 		return false;
@@ -1331,6 +1339,8 @@ bool stageOneShutDown()
 
 	releaseMission();
 
+	droidDecideShutdown();
+
 	if (!aiShutdown())
 	{
 		return false;
@@ -75,6 +75,7 @@
 #include "game.h"
 #include "droid.h"
 #include "spectatorwidgets.h"
+#include "snapshot.h"
 
 #include "activity.h"
 
@@ -195,6 +196,20 @@ void	kf_PowerInfo()
 	}
 }
 
+/// Captures a world snapshot, lets the game run for a second, then rewinds to the snapshot and comes back, checking that
+/// both restored states hash identically.
+void kf_SnapshotRoundTrip()
+{
+	if (snapshotRoundTripIsRunning())
+	{
+		console("Snapshot round trip already running");
+		return;
+	}
+	snapshotRoundTripStart(GAME_UPDATES_PER_SEC, [](SnapshotRoundTrip const &roundTrip) {
+		console("Snapshot of %zu bytes, hash 0x%08X: captured in %llu us, restored in %llu us, %s", roundTrip.bytes, roundTrip.hash, (unsigned long long)roundTrip.captureUs, (unsigned long long)roundTrip.restoreUs, roundTrip.ok ? "identical" : roundTrip.error.c_str());
+	});
+}
+
 void kf_DamageMe()
 {
 #ifndef DEBUG
@@ -230,6 +245,7 @@ void kf_DamageMe()
 		if (psStruct->selected)
 		{
 			int val = psStruct->body - ((structureBody(psStruct) / 100) * 20);
+			structureWake(psStruct);
 			if (val > 0)
 			{
 				psStruct->body = val;
@@ -705,6 +721,24 @@ void	kf_FrameRate()
 		                          NETgetStatistic(NetStatisticUncompressedBytes, false),
 		                          NETgetStatistic(NetStatisticPackets, true),
 		                          NETgetStatistic(NetStatisticPackets, false));
+		CONPRINTF("NETWORK:  Codec time (us): s-%zu r-%zu",
+		                          NETgetStatistic(NetStatisticCodecMicroseconds, true),
+		                          NETgetStatistic(NetStatisticCodecMicroseconds, false));
+		CONPRINTF("NETWORK:  Flushes: %zu  Broadcast batches: %zu  Batched messages: %zu",
+		                          NETgetStatistic(NetStatisticFlushes, true),
+		                          NETgetStatistic(NetStatisticBatches, true),
+		                          NETgetStatistic(NetStatisticBatchedMessages, true));
+		for (size_t codec = 0; codec < static_cast<size_t>(SocketCodecType::Count); ++codec)
+		{
+			SocketCodecStats const &stats = socketGetCodecStats(static_cast<SocketCodecType>(codec));
+			if (stats.encodeInBytes != 0 || stats.decodeOutBytes != 0)
+			{
+				CONPRINTF("NETWORK:  Codec %s: encoded %" PRIu64 " -> %" PRIu64 " in %" PRIu64 " us, decoded %" PRIu64 " -> %" PRIu64 " in %" PRIu64 " us",
+				          socketCodecName(static_cast<SocketCodecType>(codec)),
+				          stats.encodeInBytes, stats.encodeOutBytes, stats.encodeMicroseconds,
+				          stats.decodeInBytes, stats.decodeOutBytes, stats.decodeMicroseconds);
+			}
+		}
 	}
 	gameStats = !gameStats;
 	CONPRINTF("Built: %s %s", getCompileDate(), __TIME__);
@@ -185,6 +185,7 @@ bool runningMultiplayer();
 
 void kf_ForceDesync();
 void kf_PowerInfo();
+void kf_SnapshotRoundTrip();
 void kf_BuildNextPage();
 void kf_BuildPrevPage();
 void kf_DamageMe();
@@ -28,6 +28,8 @@
 #include <physfs.h>
 #include "lib/framework/file.h"
 #include "lib/framework/physfs_ext.h"
+#include "lib/framework/savebatch.h"
+#include "lib/framework/wzapp.h"
 #include <ctime>
 
 #include "lib/framework/frame.h"
@@ -42,6 +44,7 @@
 #include "lib/ivis_opengl/pieblitfunc.h"		// for boxfill
 #include "hci.h"
 #include "loadsave.h"
+#include "savecontainer.h"
 #include "multiplay.h"
 #include "game.h"
 #include "lib/sound/audio_id.h"
@@ -370,6 +373,7 @@ bool addLoadSave(LOADSAVE_MODE savemode, const char *title)
 	}
 
 	debug(LOG_SAVE, "Searching \"%s\" for savegames", NewSaveGamePath.c_str());
+	saveContainerMountAll(NewSaveGamePath);
 
 	// add savegame filenames minus extensions to buttons
 
@@ -568,6 +572,9 @@ void deleteSaveGame(std::string saveGameFolderPath)
 		PHYSFS_delete(oldParentFile.c_str());
 	}
 
+	// a single file savegame is mounted where the directory would be, so remove it before looking for the directory
+	saveContainerDelete(saveGameFolderPath);
+
 	// check for a directory and remove that too.
 	WZ_PHYSFS_enumerateFiles(saveGameFolderPath.c_str(), [saveGameFolderPath](const char *i) -> bool {
 		// Construct the full path to the file by appending the
@@ -600,6 +607,7 @@ static bool findLastSaveFrom(SAVEGAME_LOC loc)
 	const char *path = SaveGameLocToPath[loc];
 	debug(LOG_SAVEGAME, "looking for last save in %s", path);
 	const std::string pathToCommonSaveDir = std::string(path);
+	saveContainerMountAll(pathToCommonSaveDir);
 	try
 	{
 		WZ_PHYSFS_enumerateFolders(pathToCommonSaveDir, [&found, &pathToCommonSaveDir, loc] (const char * dirName) {
@@ -1066,17 +1074,18 @@ static bool freeAutoSaveSlot_old(const char *path)
 	return WZ_PHYSFS_cleanupOldFilesInFolder(path, sSaveGameExtension, -1, [](const char *fileName){ deleteSaveGame_classic(fileName); return true; }) > 0;
 }
 
-static void freeAutoSaveSlot(SAVEGAME_LOC loc)
+static void freeAutoSaveSlot(SAVEGAME_LOC loc, std::string const &newSaveName)
 {
 	const char *path = SaveGameLocToPath[loc];
 	int64_t oldestEpoch = INT64_MAX;
 	std::string oldestKey;
 	unsigned count = 0;
+	saveContainerMountAll(path);
 	try
 	{
-		WZ_PHYSFS_enumerateFolders(path, [path, &oldestKey, &oldestEpoch, &count](const char* dirName){
+		WZ_PHYSFS_enumerateFolders(path, [path, &newSaveName, &oldestKey, &oldestEpoch, &count](const char* dirName){
 			if (!dirName) { return true; }
-			if (strcmp(dirName, "auto") == 0)
+			if (strcmp(dirName, "auto") == 0 || newSaveName == dirName)
 			{
 				return true; // continue
 			}
@@ -1121,6 +1130,17 @@ static void freeAutoSaveSlot(SAVEGAME_LOC loc)
 	deleteSaveGame_classic(savefile);
 }
 
+static std::unique_ptr<wz::thread> autoSaveThread;
+
+void autoSaveWait()
+{
+	if (autoSaveThread)
+	{
+		autoSaveThread->join();
+		autoSaveThread.reset();
+	}
+}
+
 bool autoSave()
 {
 	// Bail out if we're running a _true_ multiplayer game or are playing a tutorial/debug/cheating/autogames
@@ -1134,14 +1154,11 @@ bool autoSave()
 	{
 		return false;
 	}
+	autoSaveWait();  // The previous autosave should long be finished by now.
+
 	const char *dir = bMultiPlayer ? SAVEGAME_SKI_AUTO : SAVEGAME_CAM_AUTO;
-	// Backward compatibility: remove later
-	if (!freeAutoSaveSlot_old(dir))
-	{
-		// no old .gam found: check for new saves
-		freeAutoSaveSlot(bMultiPlayer ? SAVEGAME_LOC_SKI_AUTO : SAVEGAME_LOC_CAM_AUTO);
-	}
-	
+	const SAVEGAME_LOC loc = bMultiPlayer ? SAVEGAME_LOC_SKI_AUTO : SAVEGAME_LOC_CAM_AUTO;
+
 	time_t now = time(nullptr);
 	struct tm timeinfo = getLocalTime(now);
 	char savedate[PATH_MAX];
@@ -1150,14 +1167,39 @@ bool autoSave()
 	std::string suggestedName = suggestSaveName(dir).toStdString();
 	char savefile[PATH_MAX];
 	snprintf(savefile, sizeof(savefile), "%s/%s_%s.gam", dir, suggestedName.c_str(), savedate);
-	if (saveGame(savefile, GTYPE_SAVE_MIDMISSION))
-	{
-		console(_("AutoSave %s"), savegameWithoutExtension(savefile));
-		return true;
-	}
-	else
+	std::string saveName = savegameWithoutExtension(savefile);
+	std::string saveDirName = suggestedName + "_" + savedate;
+
+	// Only collect the save on the main thread. Formatting it, and all the disk access, is done in the background.
+	saveBatchBegin();
+	bool saved = saveGame(savefile, GTYPE_SAVE_MIDMISSION);
+	std::shared_ptr<SaveBatch> batch(saveBatchEnd());
+	if (!saved)
 	{
-		console(_("AutoSave %s failed"), savegameWithoutExtension(savefile));
+		console(_("AutoSave %s failed"), saveName.c_str());
 		return false;
 	}
+
+	bool container = saveContainerEnabled;
+	std::string gamFileName = savefile;
+	autoSaveThread = std::unique_ptr<wz::thread>(new wz::thread([batch, dir, loc, saveName, saveDirName, container, gamFileName]() {
+		// Backward compatibility: remove later
+		if (!freeAutoSaveSlot_old(dir))
+		{
+			// no old .gam found: check for new saves
+			freeAutoSaveSlot(loc, saveDirName);
+		}
+		bool written = container ? saveContainerWrite(*batch, gamFileName) : batch->write();
+		wzAsyncExecOnMainThread([written, saveName]() {
+			if (written)
+			{
+				console(_("AutoSave %s"), saveName.c_str());
+			}
+			else
+			{
+				console(_("AutoSave %s failed"), saveName.c_str());
+			}
+		});
+	}));
+	return true;
 }
@@ -93,5 +93,6 @@ void loadSaveScreenSizeDidChange(unsigned int oldWidth, unsigned int oldHeight,
 bool findLastSave();
 
 bool autoSave();
+void autoSaveWait();  ///< Waits for the previous autosave to finish writing in the background.
 
 #endif // __INCLUDED_SRC_LOADSAVE_H__
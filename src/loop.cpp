@@ -80,10 +80,16 @@
 #include "wrappers.h"
 #include "random.h"
 #include "qtscript.h"
+#include "wzapi.h"
 #include "version.h"
 #include "notifications.h"
 #include "scores.h"
 #include "clparse.h"
+#include "droiddecide.h"
+#include "hosttelemetry.h"
+#include "replaybench.h"
+#include "snapshot.h"
+#include "statehash.h"
 
 #include "warzoneconfig.h"
 
@@ -92,6 +98,7 @@
 #endif
 
 #include <numeric>
+#include <chrono>
 
 
 /*
@@ -119,6 +126,7 @@ struct PAUSE_STATE
 static PAUSE_STATE pauseState;
 static size_t maxFastForwardTicks = WZ_DEFAULT_MAX_FASTFORWARD_TICKS;
 static bool fastForwardTicksFixedToNormalTickRate = true; // can be set to false to "catch-up" as quickly as possible (but this may result in more jerky behavior)
+static uint32_t replaySeekGameTime = 0;  // fast-forward as quickly as possible until this gameTime, see setReplaySeekGameTime
 
 static unsigned numDroids[MAX_PLAYERS];
 static unsigned numMissionDroids[MAX_PLAYERS];
@@ -492,6 +500,8 @@ void countUpdate(bool synch)
 
 static void gameStateUpdate()
 {
+	replayBenchPhase(ReplayBenchPhase::Network);
+
 	syncDebug("map = \"%s\", pseudorandom 32-bit integer = 0x%08X, allocated = %d %d %d %d %d %d %d %d %d %d, position = %d %d %d %d %d %d %d %d %d %d", game.map, gameRandU32(),
 	          NetPlay.players[0].allocated, NetPlay.players[1].allocated, NetPlay.players[2].allocated, NetPlay.players[3].allocated, NetPlay.players[4].allocated, NetPlay.players[5].allocated, NetPlay.players[6].allocated, NetPlay.players[7].allocated, NetPlay.players[8].allocated, NetPlay.players[9].allocated,
 	          NetPlay.players[0].position, NetPlay.players[1].position, NetPlay.players[2].position, NetPlay.players[3].position, NetPlay.players[4].position, NetPlay.players[5].position, NetPlay.players[6].position, NetPlay.players[7].position, NetPlay.players[8].position, NetPlay.players[9].position
@@ -508,18 +518,24 @@ static void gameStateUpdate()
 
 	// Actually send pending droid orders.
 	sendQueuedDroidInfo();
+	sendStateHash();
 
 	sendPlayerGameTime();
 	NETflush();  // Make sure the game time tick message is really sent over the network.
 
+	replayBenchPhase(ReplayBenchPhase::Scripts);
 	if (!paused && !scriptPaused())
 	{
 		updateScripts();
 	}
 
+	// Apply the upgrades researched since the last tick
+	wzapi::applyPendingUpgrades();
+
 	// Update abandoned structures
 	handleAbandonedStructures();
 
+	replayBenchPhase(ReplayBenchPhase::Visibility);
 	// Update the visibility change stuff
 	visUpdateLevel();
 
@@ -530,25 +546,34 @@ static void gameStateUpdate()
 	processVisibility();
 
 	// Update the map.
+	replayBenchPhase(ReplayBenchPhase::Map);
 	mapUpdate();
 
 	//update the findpath system
+	replayBenchPhase(ReplayBenchPhase::Pathfinding);
 	fpathUpdate();
 
 	// update the command droids
+	replayBenchPhase(ReplayBenchPhase::Droids);
 	cmdDroidUpdate();
 
+	// choose droid targets in parallel, before updating the droids in order
+	droidDecideUpdate();
+
 	for (unsigned i = 0; i < MAX_PLAYERS; i++)
 	{
 		//update the current power available for a player
+		replayBenchPhase(ReplayBenchPhase::Power);
 		updatePlayerPower(i);
 
+		replayBenchPhase(ReplayBenchPhase::Droids);
 		DROID *psNext;
 		for (DROID *psCurr = apsDroidLists[i]; psCurr != nullptr; psCurr = psNext)
 		{
 			// Copy the next pointer - not 100% sure if the droid could get destroyed but this covers us anyway
 			psNext = psCurr->psNext;
 			droidUpdate(psCurr);
+			stateHashDroid(psCurr);
 		}
 
 		for (DROID *psCurr = mission.apsDroidLists[i]; psCurr != nullptr; psCurr = psNext)
@@ -557,36 +582,49 @@ static void gameStateUpdate()
 			get destroyed but this covers us anyway */
 			psNext = psCurr->psNext;
 			missionDroidUpdate(psCurr);
+			stateHashDroid(psCurr);
 		}
 
 		// FIXME: These for-loops are code duplicationo
+		replayBenchPhase(ReplayBenchPhase::Structures);
 		STRUCTURE *psNBuilding;
 		for (STRUCTURE *psCBuilding = apsStructLists[i]; psCBuilding != nullptr; psCBuilding = psNBuilding)
 		{
 			/* Copy the next pointer - not 100% sure if the structure could get destroyed but this covers us anyway */
 			psNBuilding = psCBuilding->psNext;
+			if (psCBuilding->asleep)
+			{
+				continue;  // Nothing happened to it, so nothing to update.
+			}
 			structureUpdate(psCBuilding, false);
+			stateHashStructure(psCBuilding);
 		}
 		for (STRUCTURE *psCBuilding = mission.apsStructLists[i]; psCBuilding != nullptr; psCBuilding = psNBuilding)
 		{
 			/* Copy the next pointer - not 100% sure if the structure could get destroyed but this covers us anyway. It shouldn't do since its not even on the map!*/
 			psNBuilding = psCBuilding->psNext;
 			structureUpdate(psCBuilding, true); // update for mission
+			stateHashStructure(psCBuilding);
 		}
 	}
 
+	replayBenchPhase(ReplayBenchPhase::Cleanup);
 	missionTimerUpdate();
 
+	replayBenchPhase(ReplayBenchPhase::Projectiles);
 	proj_UpdateAll();
 
+	replayBenchPhase(ReplayBenchPhase::Features);
 	FEATURE *psNFeat;
 	for (FEATURE *psCFeat = apsFeatureLists[0]; psCFeat; psCFeat = psNFeat)
 	{
 		psNFeat = psCFeat->psNext;
 		featureUpdate(psCFeat);
+		stateHashFeature(psCFeat);
 	}
 
 	// Free dead droid memory.
+	replayBenchPhase(ReplayBenchPhase::Cleanup);
 	objmemUpdate();
 
 	// Must end update, since we may or may not have ticked, and some message queue processing code may vary depending on whether it's in an update.
@@ -594,6 +632,8 @@ static void gameStateUpdate()
 
 	// Must be at the end of gameStateUpdate, since countUpdate is also called randomly (unsynchronised) between gameStateUpdate calls, but should have no effect if we already called it, and recvMessage requires consistent counts on all clients.
 	countUpdate(true);
+	stateHashTickEnd();
+	replayBenchTickEnd();
 }
 
 size_t getMaxFastForwardTicks()
@@ -607,6 +647,16 @@ void setMaxFastForwardTicks(optional<size_t> value, bool fixedToNormalTickRate)
 	fastForwardTicksFixedToNormalTickRate = fixedToNormalTickRate;
 }
 
+void setReplaySeekGameTime(uint32_t targetGameTime)
+{
+	replaySeekGameTime = targetGameTime;
+}
+
+bool isSeekingReplay()
+{
+	return replaySeekGameTime != 0;
+}
+
 /* The main game loop */
 GAMECODE gameLoop()
 {
@@ -623,6 +673,7 @@ GAMECODE gameLoop()
 
 	size_t numRegularUpdatesTicks = 0;
 	size_t numFastForwardTicks = 0;
+	unsigned loopStartTicks = wzGetTicks();
 	gameTimeUpdateBegin();
 	while (true)
 	{
@@ -632,14 +683,15 @@ GAMECODE gameLoop()
 
 		bool selectedPlayerIsSpectator = bMultiPlayer && NetPlay.players[selectedPlayer].isSpectator;
 		bool multiplayerHostDisconnected = bMultiPlayer && !NetPlay.isHostAlive && NetPlay.bComms && !NetPlay.isHost; // do not fast-forward after the host has disconnected
+		bool seeking = replaySeekGameTime != 0 && gameTime < replaySeekGameTime;
 		bool canFastForwardGameTime =
 			selectedPlayerIsSpectator 			// current player must be a spectator
 			&& !NetPlay.isHost					// AND NOT THE HOST (!)
 			&& !multiplayerHostDisconnected		// and the multiplayer host must not be disconnected ("host quit")
-			&& numFastForwardTicks < maxFastForwardTicks // and the number of forced updates this call of gameLoop must not exceed the max allowed
+			&& (seeking ? wzGetTicks() - loopStartTicks < 100 : numFastForwardTicks < maxFastForwardTicks) // and the number of forced updates this call of gameLoop must not exceed the max allowed (when seeking, keep rendering about 10 frames per second)
 			&& checkPlayerGameTime(NET_ALL_PLAYERS);	// and there must be a new game tick available to process from all players
 
-		bool forceTryGameTickUpdate = canFastForwardGameTime && ((!fastForwardTicksFixedToNormalTickRate && numForcedUpdatesLastCall > 0) || numRegularUpdatesTicks > 0) && NETgameIsBehindPlayersByAtLeast(4);
+		bool forceTryGameTickUpdate = canFastForwardGameTime && (seeking || (!fastForwardTicksFixedToNormalTickRate && numForcedUpdatesLastCall > 0) || numRegularUpdatesTicks > 0) && NETgameIsBehindPlayersByAtLeast(4);
 
 		// Update gameTime and graphicsTime, and corresponding deltas. Note that gameTime and graphicsTime pause, if we aren't getting our GAME_GAME_TIME messages.
 		auto timeUpdateResult = gameTimeUpdate(renderBudget > 0 || previousUpdateWasRender, forceTryGameTickUpdate);
@@ -662,9 +714,13 @@ GAMECODE gameLoop()
 		ASSERT(!paused && !gameUpdatePaused(), "Nonsensical pause values.");
 
 		unsigned before = wzGetTicks();
+		auto tickStart = std::chrono::steady_clock::now();
 		syncDebug("Begin game state update, gameTime = %d", gameTime);
 		gameStateUpdate();
 		syncDebug("End game state update, gameTime = %d", gameTime);
+		hostTelemetryRecordTick(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tickStart).count());
+		snapshotUpdateReplayKeyframes();
+		snapshotUpdateRoundTrip();
 		unsigned after = wzGetTicks();
 
 		renderBudget -= (after - before) * renderFraction.n;
@@ -674,12 +730,18 @@ GAMECODE gameLoop()
 		ASSERT(deltaGraphicsTime == 0, "Shouldn't update graphics and game state at once.");
 	}
 	numForcedUpdatesLastCall = numFastForwardTicks;
+	if (replaySeekGameTime != 0 && gameTime >= replaySeekGameTime)
+	{
+		debug(LOG_INFO, "Replay reached gameTime %u", gameTime);
+		replaySeekGameTime = 0;
+	}
 
 	if (realTime - lastFlushTime >= 400u)
 	{
 		lastFlushTime = realTime;
 		NETflush();  // Make sure that we aren't waiting too long to send data.
 	}
+	hostTelemetryUpdate();
 
 	unsigned before = wzGetTicks();
 	GAMECODE renderReturn = renderLoop();
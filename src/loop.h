@@ -78,6 +78,9 @@ bool consolePaused();
 constexpr size_t WZ_DEFAULT_MAX_FASTFORWARD_TICKS = 1;
 size_t getMaxFastForwardTicks();
 void setMaxFastForwardTicks(optional<size_t> value = nullopt, bool fixedToNormalTickRate = true);
+/// Fast-forwards a replay as quickly as possible, while still rendering now and then, until reaching the given gameTime.
+void setReplaySeekGameTime(uint32_t targetGameTime);
+bool isSeekingReplay();
 
 void setGameUpdatePause(bool state);
 void setAudioPause(bool state);
@@ -69,12 +69,17 @@
 #include "lib/ivis_opengl/piepalette.h"
 #include "lib/ivis_opengl/piemode.h"
 #include "lib/ivis_opengl/screen.h"
+#include "lib/netplay/netbench.h"
 #include "lib/netplay/netplay.h"
+#include "lib/netplay/netrelay.h"
 #include "lib/netplay/netreplay.h"
 #include "lib/sound/audio.h"
 #include "lib/sound/cdaudio.h"
 
 #include "clparse.h"
+#include "replaybench.h"
+#include "replayverify.h"
+#include "statehash.h"
 #include "challenge.h"
 #include "configuration.h"
 #include "display.h"
@@ -100,6 +105,7 @@
 #include "map.h"
 #include "keybind.h"
 #include "random.h"
+#include "snapshot.h"
 #include "urlhelpers.h"
 #include "urlrequest.h"
 #include <time.h>
@@ -996,6 +1002,8 @@ static void startGameLoop()
 	}
 	triggerEvent(TRIGGER_START_LEVEL);
 	screen_disableMapPreview();
+	stateHashReset();
+	snapshotResetReplayKeyframes();
 
 	auto currentGameMode = ActivityManager::instance().getCurrentGameMode();
 	switch (currentGameMode)
@@ -1010,8 +1018,9 @@ static void startGameLoop()
 		case ActivitySink::GameMode::SKIRMISH:
 		case ActivitySink::GameMode::MULTIPLAYER:
 		{
-			// start saving a replay
-			if (!war_getDisableReplayRecording())
+			// start saving a replay, which is also what the relay sends to its spectators
+			bool relaying = currentGameMode == ActivitySink::GameMode::MULTIPLAYER && NETrelayListen();
+			if (!war_getDisableReplayRecording() || relaying)
 			{
 				WZGameReplayOptionsHandler replayOptions;
 				NETreplaySaveStart((currentGameMode == ActivitySink::GameMode::MULTIPLAYER) ? "multiplay" : "skirmish", replayOptions, war_getMaxReplaysSaved(), (currentGameMode == ActivitySink::GameMode::MULTIPLAYER));
@@ -1023,7 +1032,7 @@ static void startGameLoop()
 	}
 
 	setMaxFastForwardTicks(WZ_DEFAULT_MAX_FASTFORWARD_TICKS, true); // default value / spectator "catch-up" behavior
-	if (NETisReplay())
+	if (NETisReplay() && !NETreplayLoadIsLive())  // live replays from a relay catch up like spectators
 	{
 		if (!headlessGameMode() && !autogame_enabled())
 		{
@@ -1035,6 +1044,24 @@ static void startGameLoop()
 			// when loading replays in headless / autogame mode, set to fast-forward
 			setMaxFastForwardTicks(10, false);
 		}
+		if (replay_seek_seconds() > 0)
+		{
+			uint32_t seekGameTime = replay_seek_seconds() * GAME_TICKS_PER_SEC;
+			uint32_t replayLength = NETreplayLoadGameTimeElapsed();
+			if (replayLength != 0 && seekGameTime > replayLength)
+			{
+				debug(LOG_WARNING, "Replay is only %u seconds long", replayLength / GAME_TICKS_PER_SEC);
+				seekGameTime = replayLength;
+			}
+			snapshotSeekReplay(seekGameTime);  // Only simulates from the last keyframe, if the replay has snapshots.
+			setReplaySeekGameTime(seekGameTime);
+		}
+		if (replay_bench_enabled())
+		{
+			// run every tick as soon as it is available, until the replay ends
+			setReplaySeekGameTime(UINT32_MAX);
+			replayBenchStart();
+		}
 	}
 }
 
@@ -1048,6 +1075,7 @@ static void stopGameLoop()
 	clearInfoMessages(); // clear CONPRINTF messages before each new game/mission
 
 	NETreplaySaveStop();
+	NETrelayShutdown();
 	NETshutdownReplay();
 
 	if (gameLoopStatus != GAMECODE_NEWLEVEL)
@@ -1952,8 +1980,33 @@ int realmain(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	// Save new (commandline) settings
-	saveConfig();
+	// Run the network benchmark instead of the game, if requested
+	if (const NetBenchOptions *netbench = netbench_options())
+	{
+		NetBenchOptions options = *netbench;
+		if (netGameserverPortOverride)
+		{
+			options.port = NETgetGameserverPort();
+		}
+		if (options.varintValues != 0)
+		{
+			return NETbenchVarint(options) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		return NETbenchLoopback(options) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// Verify a directory of replays, each in its own process, instead of running the game, unless this is one of them
+	const char *replayDirectory = verify_replays_directory();
+	if (replayDirectory != nullptr && replay_verify_file() == nullptr)
+	{
+		return replayVerifyBatch(replayDirectory, verify_replays_jobs(), utfargc, utfargv);
+	}
+
+	// Save new (commandline) settings, unless this is one of several processes verifying replays
+	if (replay_verify_file() == nullptr)
+	{
+		saveConfig();
+	}
 
 	// Print out some initial information if in headless mode
 	if (headlessGameMode())
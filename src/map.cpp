@@ -30,6 +30,8 @@
 #include "lib/framework/endian_hack.h"
 #include "lib/framework/file.h"
 #include "lib/framework/physfs_ext.h"
+#include "lib/framework/savebatch.h"
+#include "lib/gamelib/timerwheel.h"
 #include "lib/ivis_opengl/tex.h"
 #include "lib/netplay/netplay.h"  // For syncDebug
 #include <wzmaplib/map.h>
@@ -68,6 +70,9 @@ static int bucketcounter;
 static UDWORD lastDangerUpdate = 0;
 static int lastDangerPlayer = -1;
 
+static TimerWheel fireTimers(GAME_TICKS_PER_UPDATE);  ///< When to extinguish burning tiles, values are posX + posY * mapWidth.
+static std::vector<uint32_t> expiredFireTimers;       ///< Kept to avoid allocations.
+
 //scroll min and max values
 SDWORD		scrollMinX, scrollMaxX, scrollMinY, scrollMaxY;
 
@@ -757,6 +762,13 @@ public:
 				pFile = PHYSFS_openRead(filename.c_str());
 				break;
 			case WzMap::BinaryIOStream::OpenMode::WRITE:
+				if (saveBatchCurrent() != nullptr)
+				{
+					// Collect the data, and queue it when closed.
+					batchFilename = filename;
+					batching = true;
+					return;
+				}
 				pFile = PHYSFS_openWrite(filename.c_str());
 				break;
 		}
@@ -770,7 +782,7 @@ public:
 		close();
 	};
 
-	bool openedFile() const { return pFile != nullptr; }
+	bool openedFile() const { return pFile != nullptr || batching; }
 
 	virtual optional<size_t> readBytes(void *buffer, size_t len) override
 	{
@@ -786,6 +798,11 @@ public:
 
 	virtual optional<size_t> writeBytes(const void *buffer, size_t len) override
 	{
+		if (batching)
+		{
+			batchData.insert(batchData.end(), static_cast<const char *>(buffer), static_cast<const char *>(buffer) + len);
+			return len;
+		}
 		if (!pFile) { return nullopt; }
 		PHYSFS_sint64 result = WZ_PHYSFS_writeBytes(pFile, buffer, static_cast<uint32_t>(len));
 		if (result < 0)
@@ -798,6 +815,13 @@ public:
 
 	virtual bool close() override
 	{
+		if (batching)
+		{
+			batching = false;
+			ASSERT_OR_RETURN(false, saveBatchCurrent() != nullptr, "Save batch of %s closed early", batchFilename.c_str());
+			saveBatchCurrent()->addFile(std::move(batchFilename), std::move(batchData));
+			return true;
+		}
 		if (pFile == nullptr)
 		{
 			return false;
@@ -815,6 +839,9 @@ public:
 	}
 private:
 	PHYSFS_File *pFile = nullptr;
+	bool batching = false;          ///< Writing into a save batch, see savebatch.h.
+	std::string batchFilename;
+	std::vector<char> batchData;
 };
 
 std::unique_ptr<WzMap::BinaryIOStream> WzMapPhysFSIO::openBinaryStream(const std::string& filename, WzMap::BinaryIOStream::OpenMode mode)
@@ -1140,6 +1167,8 @@ bool mapShutdown()
 		psAuxMap[x].reset();
 	}
 
+	fireTimers.reset(0);
+
 	map = nullptr;
 	floodbucket = nullptr;
 	psGroundTypes = nullptr;
@@ -1615,17 +1644,8 @@ void getTileMaxMin(int x, int y, int *pMax, int *pMin)
 /* This will save out the visibility data */
 bool writeVisibilityData(const char *fileName)
 {
-	unsigned int i;
 	VIS_SAVEHEADER fileHeader;
 
-	PHYSFS_file *fileHandle = openSaveFile(fileName);
-	if (!fileHandle)
-	{
-		return false;
-	}
-
-	WZ_PHYSFS_SETBUFFER(fileHandle, 4096)//;
-
 	fileHeader.aFileType[0] = 'v';
 	fileHeader.aFileType[1] = 'i';
 	fileHeader.aFileType[2] = 's';
@@ -1633,32 +1653,33 @@ bool writeVisibilityData(const char *fileName)
 
 	fileHeader.version = CURRENT_VERSION_NUM;
 
-	// Write out the current file header
-	if (WZ_PHYSFS_writeBytes(fileHandle, fileHeader.aFileType, sizeof(fileHeader.aFileType)) != sizeof(fileHeader.aFileType)
-	    || !PHYSFS_writeUBE32(fileHandle, fileHeader.version))
+	int planes = (game.maxPlayers + 7) / 8;
+	size_t numTiles = static_cast<size_t>(mapWidth) * mapHeight;
+
+	// Build the whole file in memory, since writing it a byte at a time through PhysFS is slow.
+	std::vector<char> data;
+	data.reserve(sizeof(fileHeader.aFileType) + 4 + planes * numTiles);
+	data.insert(data.end(), fileHeader.aFileType, fileHeader.aFileType + sizeof(fileHeader.aFileType));
+	for (int shift = 24; shift >= 0; shift -= 8)
 	{
-		debug(LOG_ERROR, "writeVisibilityData: could not write header to %s; PHYSFS error: %s", fileName, WZ_PHYSFS_getLastError());
-		PHYSFS_close(fileHandle);
-		return false;
+		data.push_back(static_cast<char>(fileHeader.version >> shift));
 	}
 
-	int planes = (game.maxPlayers + 7) / 8;
-
 	for (unsigned plane = 0; plane < planes; ++plane)
 	{
-		for (i = 0; i < mapWidth * mapHeight; ++i)
+		for (size_t i = 0; i < numTiles; ++i)
 		{
-			if (!PHYSFS_writeUBE8(fileHandle, psMapTiles[i].tileExploredBits >> (plane * 8)))
-			{
-				debug(LOG_ERROR, "writeVisibilityData: could not write to %s; PHYSFS error: %s", fileName, WZ_PHYSFS_getLastError());
-				PHYSFS_close(fileHandle);
-				return false;
-			}
+			data.push_back(static_cast<char>(psMapTiles[i].tileExploredBits >> (plane * 8)));
 		}
 	}
 
+	if (!saveFile(fileName, data.data(), static_cast<UDWORD>(data.size())))
+	{
+		debug(LOG_ERROR, "writeVisibilityData: could not write to %s", fileName);
+		return false;
+	}
+
 	// Everything is just fine!
-	PHYSFS_close(fileHandle);
 	return true;
 }
 
@@ -1854,6 +1875,7 @@ void tileSetFire(int32_t x, int32_t y, uint32_t duration)
 	// Burn, tile, burn!
 	tile->tileInfoBits |= BITS_ON_FIRE;
 	tile->fireEndTime = fireEndTime;
+	fireTimers.add(gameTime + duration, posX + posY * mapWidth);
 
 	syncDebug("Fire tile{%d, %d} dur%u end%d", posX, posY, duration, fireEndTime);
 }
@@ -2050,6 +2072,8 @@ void mapInit()
 	lastDangerUpdate = 0;
 	lastDangerPlayer = -1;
 
+	fireTimers.reset(gameTime);
+
 	// Start danger thread (not used for campaign for now - mission map swaps too icky)
 	ASSERT(dangerSemaphore == nullptr && dangerThread == nullptr, "Map data not cleaned up before starting!");
 	if (game.type == LEVEL_TYPE::SKIRMISH)
@@ -2069,24 +2093,48 @@ void mapInit()
 	}
 }
 
+void mapRestartFireTimers()
+{
+	const uint32_t currentTime = gameTime / GAME_TICKS_PER_UPDATE;
+
+	fireTimers.reset(gameTime);
+	for (int index = 0; index < mapWidth * mapHeight; ++index)
+	{
+		MAPTILE const &tile = psMapTiles[index];
+		if ((tile.tileInfoBits & BITS_ON_FIRE) != 0)
+		{
+			uint16_t remaining = tile.fireEndTime - (uint16_t)currentTime;
+			fireTimers.add((currentTime + remaining) * GAME_TICKS_PER_UPDATE, index);
+		}
+	}
+}
+
 void mapUpdate()
 {
 	const uint16_t currentTime = gameTime / GAME_TICKS_PER_UPDATE;
-	int posX, posY;
 
-	for (posY = 0; posY < mapHeight; ++posY)
-		for (posX = 0; posX < mapWidth; ++posX)
+	// Timers expire in order of tile index, so tiles are extinguished in the same order as when checking each tile.
+	expiredFireTimers.clear();
+	fireTimers.advance(gameTime, expiredFireTimers);
+	for (uint32_t index : expiredFireTimers)
+	{
+		if (index >= (uint32_t)(mapWidth * mapHeight))
 		{
-			MAPTILE *const tile = mapTile(posX, posY);
+			continue;  // Map changed since the tile was set on fire.
+		}
+		const int posX = index % mapWidth;
+		const int posY = index / mapWidth;
+		MAPTILE *const tile = mapTile(posX, posY);
 
-			if ((tile->tileInfoBits & BITS_ON_FIRE) != 0 && tile->fireEndTime == currentTime)
-			{
-				// Extinguish, tile, extinguish!
-				tile->tileInfoBits &= ~BITS_ON_FIRE;
+		// If the fire was made to last longer, there is another timer for when it ends.
+		if ((tile->tileInfoBits & BITS_ON_FIRE) != 0 && tile->fireEndTime == currentTime)
+		{
+			// Extinguish, tile, extinguish!
+			tile->tileInfoBits &= ~BITS_ON_FIRE;
 
-				syncDebug("Extinguished tile{%d, %d}", posX, posY);
-			}
+			syncDebug("Extinguished tile{%d, %d}", posX, posY);
 		}
+	}
 
 	if (gameTime > lastDangerUpdate + GAME_TICKS_FOR_DANGER && game.type == LEVEL_TYPE::SKIRMISH)
 	{
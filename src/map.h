@@ -551,6 +551,7 @@ extern SDWORD scrollMinX, scrollMaxX, scrollMinY, scrollMaxY;
 void mapFloodFillContinents();
 
 void tileSetFire(int32_t x, int32_t y, uint32_t duration);
+void mapRestartFireTimers();  ///< Reschedules putting out the burning tiles, after restoring their BITS_ON_FIRE and fireEndTime.
 bool fireOnLocation(unsigned int x, unsigned int y);
 
 /**
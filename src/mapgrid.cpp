@@ -169,6 +169,22 @@ GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius)
 	return gridStartIterateFiltered(x, y, radius, nullptr, ConditionTrue());
 }
 
+GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius, GridSearch &search)
+{
+	gridPointTree->query(x, y, radius, search.points);
+
+	search.objects.clear();
+	for (void *point : search.points)
+	{
+		BASE_OBJECT *obj = static_cast<BASE_OBJECT *>(point);
+		if (isInRadius(obj->pos.x - x, obj->pos.y - y, radius))  // Check that search result is less than radius (since they can be up to a factor of sqrt(2) more).
+		{
+			search.objects.push_back(obj);
+		}
+	}
+	return search.objects;
+}
+
 GridList const &gridStartIterateArea(int32_t x, int32_t y, uint32_t x2, uint32_t y2)
 {
 	return gridStartIterateFilteredArea(x, y, x2, y2, ConditionTrue());
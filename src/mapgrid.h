@@ -40,6 +40,17 @@ void gridReset();
 /// Find all objects within radius.
 GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius);
 
+/// Storage for searches which may run concurrently with other searches. Use one per thread.
+struct GridSearch
+{
+	std::vector<void *> points;
+	GridList objects;
+};
+
+/// Find all objects within radius. Returns search.objects.
+/// Thread safe, as long as the grid is not reset meanwhile.
+GridList const &gridStartIterate(int32_t x, int32_t y, uint32_t radius, GridSearch &search);
+
 /// Find all objects within radius.
 GridList const &gridStartIterateArea(int32_t x, int32_t y, uint32_t x2, uint32_t y2);
 
@@ -752,6 +752,7 @@ bool pickupArtefact(int toPlayer, int fromPlayer)
 				if (asResearch[topic].researchPower && asResearch[topic].researchPoints)
 				{
 					MakeResearchPossible(&asPlayerResList[toPlayer][topic]);
+					invalidateResearchCandidates(toPlayer);
 					if (toPlayer == selectedPlayer)
 					{
 						CONPRINTF(_("You Discover Blueprints For %s"), getStatsName(&asResearch[topic]));
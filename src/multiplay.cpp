@@ -67,6 +67,7 @@
 
 #include "template.h"
 #include "lib/netplay/netplay.h"								// the netplay library.
+#include "lib/netplay/netrelay.h"
 #include "modding.h"
 #include "multiplay.h"								// warzone net stuff.
 #include "multijoin.h"								// player management stuff.
@@ -84,6 +85,8 @@
 #include "stdinreader.h"
 #include "spectatorwidgets.h"
 #include "challenge.h"
+#include "replaybench.h"
+#include "statehash.h"
 
 // ////////////////////////////////////////////////////////////////////////////
 // ////////////////////////////////////////////////////////////////////////////
@@ -1098,6 +1101,7 @@ HandleMessageAction getMessageHandlingAction(NETQUEUE& queue, uint8_t type)
 		{
 			case GAME_GAME_TIME:
 			case GAME_PLAYER_LEFT:
+			case GAME_STATE_HASH:
 				// always allowed
 				return HandleMessageAction::Process_Message;
 			case GAME_SYNC_REQUEST:
@@ -1173,6 +1177,9 @@ bool recvMessage()
 	NETQUEUE queue;
 	uint8_t type;
 
+	NETreplayUpdateLive();  // Game messages from a relay, if watching one.
+	NETrelayUpdate();       // Spectators of our own relay, if any.
+
 	while (NETrecvNet(&queue, &type) || NETrecvGame(&queue, &type))          // for all incoming messages.
 	{
 		bool processedMessage1 = false;
@@ -1218,6 +1225,9 @@ bool recvMessage()
 			case GAME_SYNC_REQUEST:
 				recvSyncRequest(queue);
 				break;
+			case GAME_STATE_HASH:
+				recvStateHash(queue);
+				break;
 			case GAME_DROIDDISEMBARK:
 				recvDroidDisEmbark(queue);           //droid has disembarked from a Transporter
 				break;
@@ -1257,6 +1267,11 @@ bool recvMessage()
 					// ignore
 					break;
 				}
+				if (replayBenchIsRunning())
+				{
+					replayBenchFinish(false);
+					break;
+				}
 				addConsoleMessage(_("REPLAY HAS ENDED"), CENTRE_JUSTIFY, SYSTEM_MESSAGE, false, MAX_CONSOLE_MESSAGE_DURATION);
 				addConsoleMessage(_("(Press ESC to quit.)"), CENTRE_JUSTIFY, SYSTEM_MESSAGE, false, MAX_CONSOLE_MESSAGE_DURATION);
 				break;
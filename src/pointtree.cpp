@@ -129,7 +129,7 @@ static unsigned current(std::vector<unsigned> &filterData, unsigned i)
 }
 
 template<bool IsFiltered>
-PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo)
+void PointTree::queryMaybeFilter(Filter &filter, int32_t minXo, int32_t minYo, int32_t maxXo, int32_t maxYo, ResultVector &results, IndexVector &filteredIndices) const
 {
 	uint64_t minX = expandX(minXo);
 	uint64_t maxX = expandX(maxXo);
@@ -225,10 +225,10 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 		--numRanges;
 	}
 
-	lastQueryResults.clear();
+	results.clear();
 	if (IsFiltered)
 	{
-		lastFilteredQueryIndices.clear();
+		filteredIndices.clear();
 	}
 	for (int r = 0; r != numRanges; ++r)
 	{
@@ -242,10 +242,10 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 			uint64_t py = points[i].first & 0x5555555555555555ULL;
 			if (px >= minX && px <= maxX && py >= minY && py <= maxY)  // Only add point if it's at least in the desired square.
 			{
-				lastQueryResults.push_back(points[i].second);
+				results.push_back(points[i].second);
 				if (IsFiltered)
 				{
-					lastFilteredQueryIndices.push_back(i);
+					filteredIndices.push_back(i);
 				}
 #ifdef DUMP_IMAGE
 				if (doDump)
@@ -267,23 +267,30 @@ PointTree::ResultVector &PointTree::queryMaybeFilter(Filter &filter, int32_t min
 	}
 #endif //DUMP_IMAGE
 
-	return lastQueryResults;
 }
 
 PointTree::ResultVector &PointTree::query(int32_t x, int32_t y, uint32_t x2, uint32_t y2)
 {
 	Filter unused;
-	return queryMaybeFilter<false>(unused, x, y, x2, y2);
+	queryMaybeFilter<false>(unused, x, y, x2, y2, lastQueryResults, lastFilteredQueryIndices);
+	return lastQueryResults;
 }
 
 PointTree::ResultVector &PointTree::query(int32_t x, int32_t y, uint32_t radius)
+{
+	query(x, y, radius, lastQueryResults);
+	return lastQueryResults;
+}
+
+void PointTree::query(int32_t x, int32_t y, uint32_t radius, ResultVector &results) const
 {
 	Filter unused;
+	IndexVector unusedIndices;
 	int32_t minXo = x - radius;
 	int32_t maxXo = x + radius;
 	int32_t minYo = y - radius;
 	int32_t maxYo = y + radius;
-	return queryMaybeFilter<false>(unused, minXo, minYo, maxXo, maxYo);
+	queryMaybeFilter<false>(unused, minXo, minYo, maxXo, maxYo, results, unusedIndices);
 }
 
 PointTree::ResultVector &PointTree::query(Filter &filter, int32_t x, int32_t y, uint32_t radius)
@@ -292,5 +299,6 @@ PointTree::ResultVector &PointTree::query(Filter &filter, int32_t x, int32_t y,
 	int32_t maxXo = x + radius;
 	int32_t minYo = y - radius;
 	int32_t maxYo = y + radius;
-	return queryMaybeFilter<true>(filter, minXo, minYo, maxXo, maxYo);
+	queryMaybeFilter<true>(filter, minXo, minYo, maxXo, maxYo, lastQueryResults, lastFilteredQueryIndices);
+	return lastQueryResults;
 }
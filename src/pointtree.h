@@ -59,6 +59,9 @@ public:
 	/// (More specifically, returns all objects in a square with edge length 2*radius.)
 	/// Note: Not thread safe, because it modifies lastQueryResults.
 	ResultVector &query(int32_t x, int32_t y, uint32_t radius);
+	/// Same as above, but returns the points in results instead of lastQueryResults.
+	/// Thread safe, as long as the PointTree isn't modified meanwhile.
+	void query(int32_t x, int32_t y, uint32_t radius, ResultVector &results) const;
 	/// Returns all points which have not been filtered away, less than or equal to radius from (x, y), possibly plus some extra nearby points.
 	/// (More specifically, returns objects in a square with edge length 2*radius.)
 	/// Note: Not thread safe, because it modifies lastQueryResults, lastFilteredQueryIndices and the internal filter representation for faster lookups.
@@ -74,7 +77,7 @@ private:
 	typedef std::vector<Point> Vector;
 
 	template<bool IsFiltered>
-	ResultVector &queryMaybeFilter(Filter &filter, int32_t minXo, int32_t maxXo, int32_t minYo, int32_t maxYo);
+	void queryMaybeFilter(Filter &filter, int32_t minXo, int32_t maxXo, int32_t minYo, int32_t maxYo, ResultVector &results, IndexVector &filteredIndices) const;
 
 	Vector points;
 };
@@ -37,6 +37,7 @@
 #include "structure.h"
 #include "mission.h"
 #include "intdisplay.h"
+#include "snapshot.h"
 
 #include <fmt/core.h>
 
@@ -405,3 +406,53 @@ bool requestPrecisePowerFor(STRUCTURE *psStruct, int64_t amount)
 	syncDebug("requestPrecisePowerFor%d,%u wait,amount%" PRId64"", psStruct->player, psStruct->id, amount);
 	return false;  // Not enough power in the queue.
 }
+
+void powerSnapshotWrite(SnapshotWriter &writer)
+{
+	writer.u8(powerCalculated);
+	for (PlayerPower const &power : asPower)
+	{
+		writer.i64(power.currentPower);
+		writer.i32(power.powerModifier);
+		writer.i64(power.maxStorage);
+		writer.i64(power.extractedPower);
+		writer.i64(power.wastedPower);
+		writer.i64(power.powerGeneratedLastUpdate);
+		writer.u32(static_cast<uint32_t>(power.powerQueue.size()));
+		for (PowerRequest const &request : power.powerQueue)
+		{
+			writer.i64(request.amount);
+			writer.u32(request.id);
+		}
+	}
+}
+
+bool powerSnapshotRead(SnapshotReader &reader)
+{
+	bool calculated = reader.u8() != 0;
+	std::vector<PlayerPower> read(MAX_PLAYERS);
+	for (PlayerPower &power : read)
+	{
+		power.currentPower = reader.i64();
+		power.powerModifier = reader.i32();
+		power.maxStorage = reader.i64();
+		power.extractedPower = reader.i64();
+		power.wastedPower = reader.i64();
+		power.powerGeneratedLastUpdate = reader.i64();
+		uint32_t queueSize = reader.u32();
+		for (uint32_t n = 0; n < queueSize && reader.valid(); ++n)
+		{
+			PowerRequest request;
+			request.amount = reader.i64();
+			request.id = reader.u32();
+			power.powerQueue.push_back(request);
+		}
+	}
+	if (!reader.valid())
+	{
+		return false;
+	}
+	powerCalculated = calculated;
+	std::move(read.begin(), read.end(), asPower);
+	return true;
+}
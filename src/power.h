@@ -78,4 +78,11 @@ void powerCalc(bool on);
 /** Flag used to check for power calculations to be done or not. */
 extern bool powerCalculated;
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/// Saves and restores the power of all players, see snapshot.h.
+void powerSnapshotWrite(SnapshotWriter &writer);
+bool powerSnapshotRead(SnapshotReader &reader);
+
 #endif // __INCLUDED_SRC_POWER_H__
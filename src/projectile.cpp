@@ -57,6 +57,7 @@
 #include "mapgrid.h"
 #include "random.h"
 #include "display3d.h"
+#include "snapshot.h"
 
 #include <algorithm>
 #include <functional>
@@ -231,6 +232,161 @@ proj_Shutdown()
 
 /***************************************************************************/
 
+static void projSnapshotWriteRef(SnapshotWriter &writer, BASE_OBJECT const *psObj)
+{
+	writer.u32(psObj != nullptr ? psObj->id : 0);
+}
+
+static bool projSnapshotReadRef(SnapshotReader &reader, BASE_OBJECT *&psObj)
+{
+	uint32_t id = reader.u32();
+	psObj = id != 0 ? snapshotFindObject(id) : nullptr;
+	return id == 0 || psObj != nullptr;
+}
+
+void projSnapshotWrite(SnapshotWriter &writer)
+{
+	writer.u32(projectileTrackerIDIncrement);
+	for (int gain : experienceGain)
+	{
+		writer.i32(gain);
+	}
+	writer.u32(static_cast<uint32_t>(psProjectileList.size()));
+	for (PROJECTILE const *psProj : psProjectileList)
+	{
+		writer.u32(psProj->id);
+		writer.u8(psProj->player);
+		writer.i32(psProj->pos.x);
+		writer.i32(psProj->pos.y);
+		writer.i32(psProj->pos.z);
+		writer.u16(psProj->rot.direction);
+		writer.u16(psProj->rot.pitch);
+		writer.u16(psProj->rot.roll);
+		writer.u32(psProj->born);
+		writer.u32(psProj->died);
+		writer.u32(psProj->time);
+		writer.u8(psProj->state);
+		writer.u32(psProj->psWStats != nullptr ? static_cast<uint32_t>(psProj->psWStats - asWeaponStats) : UINT32_MAX);
+		projSnapshotWriteRef(writer, psProj->psSource);
+		projSnapshotWriteRef(writer, psProj->psDest);
+		writer.u32(static_cast<uint32_t>(psProj->psDamaged.size()));
+		for (BASE_OBJECT const *psObj : psProj->psDamaged)
+		{
+			projSnapshotWriteRef(writer, psObj);
+		}
+		Vector3i const *vectors[] = {&psProj->src, &psProj->dst, &psProj->prevSpacetime.pos};
+		for (Vector3i const *vector : vectors)
+		{
+			writer.i32(vector->x);
+			writer.i32(vector->y);
+			writer.i32(vector->z);
+		}
+		writer.i32(psProj->vXY);
+		writer.i32(psProj->vZ);
+		writer.u32(psProj->prevSpacetime.time);
+		writer.u16(psProj->prevSpacetime.rot.direction);
+		writer.u16(psProj->prevSpacetime.rot.pitch);
+		writer.u16(psProj->prevSpacetime.rot.roll);
+		writer.u32(psProj->expectedDamageCaused);
+		writer.i32(psProj->partVisible);
+	}
+}
+
+bool projSnapshotRead(SnapshotReader &reader)
+{
+	uint32_t idIncrement = reader.u32();
+	int gains[MAX_PLAYERS];
+	for (int &gain : gains)
+	{
+		gain = reader.i32();
+	}
+	std::vector<std::unique_ptr<PROJECTILE>> read;
+	bool refsOk = true;
+	uint32_t count = reader.u32();
+	for (uint32_t n = 0; n < count && reader.valid() && refsOk; ++n)
+	{
+		uint32_t id = reader.u32();
+		uint8_t player = reader.u8();
+		read.emplace_back(new PROJECTILE(id, player));
+		PROJECTILE *psProj = read.back().get();
+		psProj->pos.x = reader.i32();
+		psProj->pos.y = reader.i32();
+		psProj->pos.z = reader.i32();
+		psProj->rot.direction = reader.u16();
+		psProj->rot.pitch = reader.u16();
+		psProj->rot.roll = reader.u16();
+		psProj->born = reader.u32();
+		psProj->died = reader.u32();
+		psProj->time = reader.u32();
+		psProj->state = reader.u8();
+		psProj->bVisible = false;
+		uint32_t stats = reader.u32();
+		refsOk = stats == UINT32_MAX || stats < numWeaponStats;
+		psProj->psWStats = stats < numWeaponStats ? &asWeaponStats[stats] : nullptr;
+		refsOk = projSnapshotReadRef(reader, psProj->psSource) && refsOk;
+		refsOk = projSnapshotReadRef(reader, psProj->psDest) && refsOk;
+		uint32_t numDamaged = reader.u32();
+		for (uint32_t i = 0; i < numDamaged && reader.valid() && refsOk; ++i)
+		{
+			BASE_OBJECT *psObj = nullptr;
+			refsOk = projSnapshotReadRef(reader, psObj);
+			psProj->psDamaged.push_back(psObj);
+		}
+		Vector3i *vectors[] = {&psProj->src, &psProj->dst, &psProj->prevSpacetime.pos};
+		for (Vector3i *vector : vectors)
+		{
+			vector->x = reader.i32();
+			vector->y = reader.i32();
+			vector->z = reader.i32();
+		}
+		psProj->vXY = reader.i32();
+		psProj->vZ = reader.i32();
+		psProj->prevSpacetime.time = reader.u32();
+		psProj->prevSpacetime.rot.direction = reader.u16();
+		psProj->prevSpacetime.rot.pitch = reader.u16();
+		psProj->prevSpacetime.rot.roll = reader.u16();
+		psProj->expectedDamageCaused = reader.u32();
+		psProj->partVisible = reader.i32();
+	}
+	if (!reader.valid() || !refsOk)
+	{
+		return false;
+	}
+	proj_FreeAllProjectiles();
+	for (auto &psProj : read)
+	{
+		psProjectileList.push_back(psProj.release());
+	}
+	psProjectileNext = psProjectileList.end();
+	projectileTrackerIDIncrement = idIncrement;
+	std::copy(gains, gains + MAX_PLAYERS, experienceGain);
+	return true;
+}
+
+void projSnapshotWriteLocal(SnapshotWriter &writer)
+{
+	writer.u32(static_cast<uint32_t>(psProjectileList.size()));
+	for (PROJECTILE const *psProj : psProjectileList)
+	{
+		writer.u8(psProj->bVisible);
+	}
+}
+
+bool projSnapshotReadLocal(SnapshotReader &reader)
+{
+	if (reader.u32() != psProjectileList.size())
+	{
+		return false;
+	}
+	for (PROJECTILE *psProj : psProjectileList)
+	{
+		psProj->bVisible = reader.u8();
+	}
+	return reader.valid();
+}
+
+/***************************************************************************/
+
 // Reset the first/next methods, and give out the first projectile in the list.
 PROJECTILE *
 proj_GetFirst()
@@ -1417,6 +1573,10 @@ static void proj_checkPeriodicalDamage(PROJECTILE *psProj)
 			psCurr->periodicalDamageStart = gameTime;
 			psCurr->periodicalDamage = 0;  // Reset periodical damage done this tick.
 		}
+		if (psCurr->type == OBJ_STRUCTURE)
+		{
+			structureWake((STRUCTURE *)psCurr);
+		}
 		unsigned damageRate = calcDamage(weaponPeriodicalDamage(psStats, psProj->player), psStats->periodicalDamageWeaponEffect, psCurr);
 		debug(LOG_NEVER, "Periodical damage of %d per second to object %d, player %d\n", damageRate, psCurr->id, psCurr->player);
 
@@ -59,6 +59,16 @@ void	proj_FreeAllProjectiles();	///< Free all projectiles in the list.
 void setExpGain(int player, int gain);
 int getExpGain(int player);
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/// Saves and restores the projectiles, see snapshot.h. Reading needs the objects to be restored already.
+void projSnapshotWrite(SnapshotWriter &writer);
+bool projSnapshotRead(SnapshotReader &reader);
+/// Saves and restores which projectiles the selected player sees, after projSnapshotRead().
+void projSnapshotWriteLocal(SnapshotWriter &writer);
+bool projSnapshotReadLocal(SnapshotReader &reader);
+
 /// Calculate the initial velocities of an indirect projectile. Returns the flight time.
 int32_t projCalcIndirectVelocities(const int32_t dx, const int32_t dz, int32_t v, int32_t *vx, int32_t *vz, int min_angle);
 
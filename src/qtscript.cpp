@@ -58,6 +58,7 @@
 #include "modding.h"
 #include "version.h"
 #include "game.h"
+#include "snapshot.h"
 #include "warzoneconfig.h"
 #include "challenge.h"
 
@@ -431,6 +432,7 @@ bool scripting_engine::shutdownScripts()
 	lastTimerID = 0;
 	timerIDMap.clear();
 	monitors.clear();
+	wzapi::clearPendingUpgrades();
 	for (auto& script : scripts)
 	{
 		delete script;
@@ -871,6 +873,294 @@ bool scripting_engine::loadScriptStates(const char *filename)
 	return true;
 }
 
+void scriptSnapshotWrite(SnapshotWriter &writer)
+{
+	scripting_engine::instance().snapshotWrite(writer);
+}
+
+bool scriptSnapshotRead(SnapshotReader &reader)
+{
+	return scripting_engine::instance().snapshotRead(reader);
+}
+
+bool scriptSnapshotMatches(SnapshotReader &reader)
+{
+	return scripting_engine::instance().snapshotMatches(reader);
+}
+
+static void scriptSnapshotWriteJson(SnapshotWriter &writer, nlohmann::json const &value)
+{
+	writer.blob(nlohmann::json::to_cbor(value));
+}
+
+static bool scriptSnapshotReadJson(SnapshotReader &reader, nlohmann::json &value)
+{
+	std::vector<uint8_t> cbor = reader.blob();
+	if (!reader.valid())
+	{
+		return false;
+	}
+	try
+	{
+		value = nlohmann::json::from_cbor(cbor);
+	}
+	catch (const std::exception &e)
+	{
+		debug(LOG_ERROR, "Corrupt script state in snapshot: %s", e.what());
+		return false;
+	}
+	return true;
+}
+
+void scripting_engine::snapshotWrite(SnapshotWriter &writer)
+{
+	writer.u32(static_cast<uint32_t>(scripts.size()));
+	for (wzapi::scripting_instance *instance : scripts)
+	{
+		writer.i32(instance->player());
+		writer.string(instance->scriptName());
+		nlohmann::json globals = nlohmann::json::object();
+		instance->saveScriptGlobals(globals);
+		globals.erase("me");
+		globals.erase("scriptName");
+		scriptSnapshotWriteJson(writer, globals);
+
+		GROUPMAP *psMap = getGroupMap(instance);
+		writer.i32(psMap != nullptr ? psMap->getLastNewGroupId() : 0);
+		std::map<uint32_t, int> members;
+		if (psMap != nullptr)
+		{
+			for (auto const &member : psMap->map())
+			{
+				members[member.first->id] = member.second;
+			}
+		}
+		writer.u32(static_cast<uint32_t>(members.size()));
+		for (auto const &member : members)
+		{
+			writer.u32(member.first);
+			writer.i32(member.second);
+		}
+	}
+
+	writer.u32(static_cast<uint32_t>(timers.size()));
+	for (auto const &node : timers)
+	{
+		auto instance = std::find(scripts.begin(), scripts.end(), node->instance);
+		writer.u32(static_cast<uint32_t>(instance - scripts.begin()));
+		writer.u64(node->timerID);
+		writer.string(node->timerName);
+		writer.i32(node->baseobj);
+		writer.u32(node->baseobjtype);
+		writer.i32(node->frameTime);
+		writer.i32(node->ms);
+		writer.i32(node->player);
+		writer.i32(node->calls);
+		writer.u32(node->type);
+		scriptSnapshotWriteJson(writer, node->instance->saveTimerFunction(node->timerID, node->timerName, node->additionalTimerFuncParam.get()));
+	}
+	writer.u64(lastTimerID);
+
+	writer.u32(static_cast<uint32_t>(labels.size()));
+	for (auto const &label : labels)
+	{
+		LABEL const &l = label.second;
+		writer.string(label.first);
+		writer.i32(l.p1.x);
+		writer.i32(l.p1.y);
+		writer.i32(l.p2.x);
+		writer.i32(l.p2.y);
+		writer.i32(l.id);
+		writer.i32(l.type);
+		writer.i32(l.player);
+		writer.i32(l.subscriber);
+		writer.i32(l.triggered);
+		writer.u32(static_cast<uint32_t>(l.idlist.size()));
+		for (int id : l.idlist)
+		{
+			writer.i32(id);
+		}
+	}
+}
+
+bool scripting_engine::snapshotMatches(SnapshotReader &reader)
+{
+	if (reader.u32() != scripts.size())
+	{
+		return false;
+	}
+	for (wzapi::scripting_instance *instance : scripts)
+	{
+		int player = reader.i32();
+		std::string scriptName = reader.string();
+		if (player != instance->player() || scriptName != instance->scriptName())
+		{
+			return false;
+		}
+		reader.blob();  // Globals.
+		reader.i32();   // Last new group id.
+		uint32_t numMembers = reader.u32();
+		for (uint32_t n = 0; n < numMembers && reader.valid(); ++n)
+		{
+			reader.u32();
+			reader.i32();
+		}
+	}
+	return reader.valid();
+}
+
+bool scripting_engine::snapshotRead(SnapshotReader &reader)
+{
+	struct InstanceState
+	{
+		nlohmann::json globals;
+		int lastNewGroupId;
+		std::vector<std::pair<BASE_OBJECT const *, int>> members;
+	};
+
+	// The snapshot is of this game, so the same scripts must be running.
+	if (reader.u32() != scripts.size())
+	{
+		debug(LOG_ERROR, "Different scripts are running than when the snapshot was captured");
+		return false;
+	}
+	std::vector<InstanceState> instances(scripts.size());
+	for (size_t i = 0; i < scripts.size(); ++i)
+	{
+		int player = reader.i32();
+		std::string scriptName = reader.string();
+		if (player != scripts[i]->player() || scriptName != scripts[i]->scriptName())
+		{
+			debug(LOG_ERROR, "Different scripts are running than when the snapshot was captured");
+			return false;
+		}
+		InstanceState &state = instances[i];
+		if (!scriptSnapshotReadJson(reader, state.globals))
+		{
+			return false;
+		}
+		state.lastNewGroupId = reader.i32();
+		uint32_t numMembers = reader.u32();
+		for (uint32_t n = 0; n < numMembers && reader.valid(); ++n)
+		{
+			uint32_t id = reader.u32();
+			int groupId = reader.i32();
+			BASE_OBJECT *psObj = snapshotFindObject(id);
+			if (psObj == nullptr)
+			{
+				debug(LOG_ERROR, "Script group member %u not found", id);
+				return false;
+			}
+			state.members.emplace_back(psObj, groupId);
+		}
+	}
+
+	std::vector<std::shared_ptr<timerNode>> nodes;
+	uint32_t numTimers = reader.u32();
+	for (uint32_t n = 0; n < numTimers && reader.valid(); ++n)
+	{
+		uint32_t instanceIndex = reader.u32();
+		std::shared_ptr<timerNode> node = std::make_shared<timerNode>();
+		node->timerID = reader.u64();
+		node->timerName = reader.string();
+		node->baseobj = reader.i32();
+		node->baseobjtype = static_cast<OBJECT_TYPE>(reader.u32());
+		node->frameTime = reader.i32();
+		node->ms = reader.i32();
+		node->player = reader.i32();
+		node->calls = reader.i32();
+		node->type = static_cast<timerType>(reader.u32());
+		nlohmann::json functionRestoreInfo;
+		if (instanceIndex >= scripts.size() || !scriptSnapshotReadJson(reader, functionRestoreInfo))
+		{
+			return false;
+		}
+		node->instance = scripts[instanceIndex];
+		try
+		{
+			auto restoredTimerInfo = node->instance->restoreTimerFunction(functionRestoreInfo);
+			node->function = std::get<0>(restoredTimerInfo);
+			node->additionalTimerFuncParam = std::move(std::get<1>(restoredTimerInfo));
+		}
+		catch (const std::exception &e)
+		{
+			debug(LOG_ERROR, "Failed to restore timer function from snapshot: %s", e.what());
+			return false;
+		}
+		nodes.push_back(std::move(node));
+	}
+	uniqueTimerID restoredLastTimerID = reader.u64();
+
+	LABELMAP restoredLabels;
+	uint32_t numLabels = reader.u32();
+	for (uint32_t n = 0; n < numLabels && reader.valid(); ++n)
+	{
+		std::string key = reader.string();
+		LABEL l;
+		l.p1.x = reader.i32();
+		l.p1.y = reader.i32();
+		l.p2.x = reader.i32();
+		l.p2.y = reader.i32();
+		l.id = reader.i32();
+		l.type = reader.i32();
+		l.player = reader.i32();
+		l.subscriber = reader.i32();
+		l.triggered = reader.i32();
+		uint32_t numIds = reader.u32();
+		for (uint32_t i = 0; i < numIds && reader.valid(); ++i)
+		{
+			l.idlist.push_back(reader.i32());
+		}
+		restoredLabels[key] = std::move(l);
+	}
+	if (!reader.valid())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < scripts.size(); ++i)
+	{
+		wzapi::scripting_instance *instance = scripts[i];
+		InstanceState &state = instances[i];
+		instance->loadScriptGlobals(state.globals);
+
+		GROUPMAP *psMap = getGroupMap(instance);
+		if (psMap == nullptr)
+		{
+			continue;
+		}
+		// The old members were deleted with the objects they point to, only the group ids are still meaningful.
+		std::vector<int> oldGroups;
+		for (auto const &group : psMap->m_groups)
+		{
+			oldGroups.push_back(group.first);
+		}
+		*psMap = GROUPMAP();
+		psMap->saveLoadSetLastNewGroupId(state.lastNewGroupId);
+		for (auto const &member : state.members)
+		{
+			psMap->insertObjectIntoGroup(member.first, member.second);
+		}
+		for (int groupId : oldGroups)
+		{
+			instance->updateGroupSizes(groupId, psMap->groupSize(groupId));
+		}
+		for (auto const &group : psMap->m_groups)
+		{
+			instance->updateGroupSizes(group.first, group.second.size());
+		}
+	}
+
+	removeTimersIf([](const timerNode &) { return true; });
+	for (auto &node : nodes)
+	{
+		addTimerNode(std::move(node));
+	}
+	lastTimerID = restoredLastTimerID;
+	labels = std::move(restoredLabels);
+	return true;
+}
+
 std::unordered_map<wzapi::scripting_instance *, nlohmann::json> scripting_engine::debug_GetGlobalsSnapshot() const
 {
 	MODELMAP debug_globals;
@@ -111,6 +111,13 @@ wzapi::scripting_instance* loadPlayerScript(const WzString& path, int player, AI
 bool loadScriptStates(const char *filename);
 bool saveScriptStates(const char *filename);
 
+/// Saves and restores the script globals, groups, timers and labels, see snapshot.h. As in savegames, only the globals
+/// which can be serialised are restored. Reading needs the objects to be restored already.
+void scriptSnapshotWrite(SnapshotWriter &writer);
+bool scriptSnapshotRead(SnapshotReader &reader);
+/// Checks that a snapshot is of the scripts which are running, without restoring anything.
+bool scriptSnapshotMatches(SnapshotReader &reader);
+
 /// Tell script system that an object has been removed.
 void scriptRemoveObject(const BASE_OBJECT *psObj);
 
@@ -308,6 +315,10 @@ public:
 	bool loadScriptStates(const char *filename);
 	bool saveScriptStates(const char *filename);
 
+	void snapshotWrite(SnapshotWriter &writer);
+	bool snapshotRead(SnapshotReader &reader);
+	bool snapshotMatches(SnapshotReader &reader);
+
 	bool unregisterFunctions(wzapi::scripting_instance *instance);
 	void prepareLabels();
 
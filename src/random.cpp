@@ -18,6 +18,7 @@
 	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 */
 #include "random.h"
+#include "snapshot.h"
 #include "lib/netplay/netplay.h"
 
 static MersenneTwister gamePseudorandomNumberGenerator;
@@ -78,6 +79,37 @@ void MersenneTwister::generate()
 	}
 }
 
+uint32_t MersenneTwister::positionHash() const
+{
+	// The last generated number, before tempering, and where it came from.
+	return state[(offset + 623) % 624] ^ offset * 0x9E3779B9;
+}
+
+void MersenneTwister::snapshotWrite(SnapshotWriter &writer) const
+{
+	writer.u32(offset);
+	for (uint32_t value : state)
+	{
+		writer.u32(value);
+	}
+}
+
+bool MersenneTwister::snapshotRead(SnapshotReader &reader)
+{
+	MersenneTwister read;
+	read.offset = reader.u32();
+	for (uint32_t &value : read.state)
+	{
+		value = reader.u32();
+	}
+	if (!reader.valid() || read.offset < 0 || read.offset > 624)
+	{
+		return false;
+	}
+	*this = read;
+	return true;
+}
+
 void gameSRand(uint32_t seed)
 {
 	lastSeed = seed;
@@ -99,3 +131,25 @@ int32_t gameRand(uint32_t limit)
 	syncDebug("Used a random number.");
 	return gamePseudorandomNumberGenerator.u32() % limit;
 }
+
+uint32_t gameRandStateHash()
+{
+	return gamePseudorandomNumberGenerator.positionHash();
+}
+
+void gameRandSnapshotWrite(SnapshotWriter &writer)
+{
+	writer.u32(lastSeed);
+	gamePseudorandomNumberGenerator.snapshotWrite(writer);
+}
+
+bool gameRandSnapshotRead(SnapshotReader &reader)
+{
+	uint32_t seed = reader.u32();
+	if (!gamePseudorandomNumberGenerator.snapshotRead(reader))
+	{
+		return false;
+	}
+	lastSeed = seed;
+	return true;
+}
@@ -22,6 +22,9 @@
 
 #include "lib/framework/types.h"
 
+class SnapshotWriter;
+class SnapshotReader;
+
 // Pseudorandom number generator with 19937 bit state and period of 2**19937 - 1. Equidistributed in up to 623 dimensions.
 // See http://en.wikipedia.org/wiki/Mersenne_twister
 // If all clients use the same seed, they will generate the same pseudorandom number sequence.
@@ -30,6 +33,10 @@ class MersenneTwister
 public:
 	MersenneTwister(uint32_t seed = 42);
 	uint32_t u32();  ///< Generates a random number in the interval [0...UINT32_MAX].
+	uint32_t positionHash() const;  ///< Changes with every generated number, cheap to compute.
+
+	void snapshotWrite(SnapshotWriter &writer) const;
+	bool snapshotRead(SnapshotReader &reader);
 
 private:
 	void generate();  ///< Generates more random numbers.
@@ -52,4 +59,11 @@ uint32_t gameRandU32();
 /// Must not be called from graphics routines, only for making game decisions.
 int32_t gameRand(uint32_t limit);
 
+/// Identifies how far the game's random number generator has got, see statehash.h.
+uint32_t gameRandStateHash();
+
+/// Saves and restores the state of the game's random number generator, see snapshot.h.
+void gameRandSnapshotWrite(SnapshotWriter &writer);
+bool gameRandSnapshotRead(SnapshotReader &reader);
+
 #endif //_RAND_H_
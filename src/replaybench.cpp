@@ -0,0 +1,213 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Replay benchmark, see replaybench.h.
+ */
+
+#include "lib/framework/frame.h"
+#include "lib/framework/wzapp.h"
+#include "lib/gamelib/gtime.h"
+
+#include "replaybench.h"
+#include "clparse.h"
+#include "replayverify.h"
+#include "snapshot.h"
+#include "version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <ctime>
+
+#if defined(WZ_OS_WIN)
+#ifndef WIN32_LEAN_AND_MEAN
+# define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef WIN32_EXTRA_LEAN
+# define WIN32_EXTRA_LEAN
+#endif
+# undef NOMINMAX
+# define NOMINMAX 1
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const char *phaseNames[static_cast<size_t>(ReplayBenchPhase::Count)] = {
+	"network", "scripts", "visibility", "map", "pathfinding", "droids", "power", "structures", "projectiles", "features", "cleanup"
+};
+
+static bool running = false;
+static BenchClock::time_point startTime;
+static std::clock_t cpuStart;
+static uint32_t startGameTime = 0;
+
+static uint64_t ticks = 0;
+static uint64_t maxTickNs = 0;
+static uint64_t phaseNs[static_cast<size_t>(ReplayBenchPhase::Count)] = {};
+static ReplayBenchPhase currentPhase = ReplayBenchPhase::Network;
+static BenchClock::time_point tickStart;
+static BenchClock::time_point phaseStart;
+
+static uint32_t nextRoundTripTime = 0;
+static unsigned roundTrips = 0;
+static unsigned roundTripsFailed = 0;
+static std::string roundTripError;
+static SnapshotRoundTrip lastRoundTrip;
+
+void replayBenchStart()
+{
+	running = true;
+	startTime = BenchClock::now();
+	cpuStart = std::clock();
+	startGameTime = gameTime;
+	ticks = 0;
+	maxTickNs = 0;
+	std::fill(std::begin(phaseNs), std::end(phaseNs), 0);
+	currentPhase = ReplayBenchPhase::Network;
+	tickStart = phaseStart = BenchClock::time_point();
+	nextRoundTripTime = gameTime;
+	roundTrips = 0;
+	roundTripsFailed = 0;
+	roundTripError.clear();
+	lastRoundTrip = SnapshotRoundTrip();
+}
+
+bool replayBenchIsRunning()
+{
+	return running;
+}
+
+void replayBenchPhase(ReplayBenchPhase phase)
+{
+	if (!running)
+	{
+		return;
+	}
+	BenchClock::time_point now = BenchClock::now();
+	if (phaseStart == BenchClock::time_point())
+	{
+		tickStart = now;  // First phase of the tick.
+	}
+	else
+	{
+		phaseNs[static_cast<size_t>(currentPhase)] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - phaseStart).count();
+	}
+	currentPhase = phase;
+	phaseStart = now;
+}
+
+void replayBenchTickEnd()
+{
+	if (!running || phaseStart == BenchClock::time_point())
+	{
+		return;
+	}
+	BenchClock::time_point now = BenchClock::now();
+	phaseNs[static_cast<size_t>(currentPhase)] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - phaseStart).count();
+	maxTickNs = std::max<uint64_t>(maxTickNs, std::chrono::duration_cast<std::chrono::nanoseconds>(now - tickStart).count());
+	phaseStart = BenchClock::time_point();
+	++ticks;
+
+	// Check the snapshots regularly, rewinding a second and coming back, which must leave the replay unchanged.
+	if (replay_verify_file() == nullptr && !snapshotRoundTripIsRunning() && gameTime >= nextRoundTripTime)
+	{
+		nextRoundTripTime = gameTime + SNAPSHOT_REPLAY_KEYFRAME_INTERVAL;
+		snapshotRoundTripStart(GAME_UPDATES_PER_SEC, [](SnapshotRoundTrip const &roundTrip) {
+			++roundTrips;
+			if (!roundTrip.ok && roundTripsFailed++ == 0)
+			{
+				roundTripError = astringf("at gameTime %" PRIu32 ": %s", gameTime, roundTrip.error.c_str());
+			}
+			lastRoundTrip = roundTrip;
+		});
+	}
+}
+
+/// Peak resident memory of the process, in KiB, or 0 if unknown.
+static uint64_t peakMemoryKiB()
+{
+#if defined(WZ_OS_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize / 1024;
+	}
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+# if defined(WZ_OS_MAC)
+	return usage.ru_maxrss / 1024;  // In bytes on macOS.
+# else
+	return usage.ru_maxrss;
+# endif
+#endif
+}
+
+void replayBenchFinish(bool gameOver)
+{
+	if (!running)
+	{
+		return;
+	}
+	running = false;
+
+	if (replay_verify_file() != nullptr)
+	{
+		wzQuit(replayVerifyPrintResult(gameOver) ? 0 : 1);
+		return;
+	}
+
+	double wallSeconds = std::chrono::duration<double>(BenchClock::now() - startTime).count();
+	double cpuSeconds = double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	uint64_t updateNs = 0;
+	for (uint64_t ns : phaseNs)
+	{
+		updateNs += ns;
+	}
+
+	WorldSnapshot snapshot;
+	uint32_t stateHash = snapshotCapture(snapshot) ? snapshotSynchronisedHash(snapshot) : 0;
+	unsigned keyframesChecked = 0, keyframesDiverged = 0;
+	snapshotGetReplayKeyframeStats(keyframesChecked, keyframesDiverged);
+
+	fprintf(stdout, "replaybench: version %s\n", version_getVersionString());
+	fprintf(stdout, "replaybench: %" PRIu64 " ticks, %.1f game seconds\n", ticks, (gameTime - startGameTime) / double(GAME_TICKS_PER_SEC));
+	fprintf(stdout, "replaybench: wall %.3f s, process CPU %.3f s, game state update %.3f s\n", wallSeconds, cpuSeconds, updateNs / 1e9);
+	fprintf(stdout, "replaybench: per tick %.1f us average, %.1f us max\n", ticks != 0 ? updateNs / 1e3 / ticks : 0., maxTickNs / 1e3);
+	for (size_t phase = 0; phase < static_cast<size_t>(ReplayBenchPhase::Count); ++phase)
+	{
+		fprintf(stdout, "replaybench: phase %-12s %10.3f ms %5.1f%%\n", phaseNames[phase], phaseNs[phase] / 1e6, updateNs != 0 ? 100. * phaseNs[phase] / updateNs : 0.);
+	}
+	fprintf(stdout, "replaybench: peak memory %" PRIu64 " KiB\n", peakMemoryKiB());
+	fprintf(stdout, "replaybench: keyframes checked %u, diverged %u\n", keyframesChecked, keyframesDiverged);
+	fprintf(stdout, "replaybench: final state hash 0x%08" PRIX32 " at gameTime %" PRIu32 "\n", stateHash, gameTime);
+	fprintf(stdout, "replaybench: snapshot round trips %u, failed %u%s%s\n", roundTrips, roundTripsFailed, roundTripsFailed != 0 ? ", first " : "", roundTripError.c_str());
+	fprintf(stdout, "replaybench: last snapshot %zu bytes, capture %" PRIu64 " us, restore %" PRIu64 " us\n", lastRoundTrip.bytes, lastRoundTrip.captureUs, lastRoundTrip.restoreUs);
+	fflush(stdout);
+
+	wzQuit(keyframesDiverged == 0 && roundTripsFailed == 0 ? 0 : 1);
+}
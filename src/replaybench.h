@@ -0,0 +1,53 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Replay benchmark, for --replaybench.
+ *
+ *  Plays a replay headless and as fast as possible, timing each part of gameStateUpdate(), then prints a report to
+ *  stdout and quits. Once per keyframe interval, the world snapshots are checked by a round trip, which rewinds a second
+ *  and comes back. The exit code is non-zero if the replay diverged from its recorded keyframes, or a snapshot round
+ *  trip failed. When verifying a replay (see replayverify.h), prints the result of the replay instead of the timings.
+ */
+
+#ifndef __INCLUDED_SRC_REPLAYBENCH_H__
+#define __INCLUDED_SRC_REPLAYBENCH_H__
+
+enum class ReplayBenchPhase
+{
+	Network,
+	Scripts,
+	Visibility,
+	Map,
+	Pathfinding,
+	Droids,
+	Power,
+	Structures,
+	Projectiles,
+	Features,
+	Cleanup,
+	Count
+};
+
+void replayBenchStart();                         ///< Starts timing, when the replay starts playing.
+bool replayBenchIsRunning();
+void replayBenchPhase(ReplayBenchPhase phase);   ///< The following part of gameStateUpdate() belongs to phase.
+void replayBenchTickEnd();                       ///< Called at the end of gameStateUpdate().
+void replayBenchFinish(bool gameOver);           ///< Prints the report and quits, when the game or the replay ends.
+
+#endif // __INCLUDED_SRC_REPLAYBENCH_H__
@@ -0,0 +1,354 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Replay verification, see replayverify.h.
+ */
+
+#include <nlohmann/json.hpp> // Must come before WZ includes
+
+#include "lib/framework/frame.h"
+#include "lib/framework/physfs_ext.h"
+#include "lib/framework/string_ext.h"
+#include "lib/framework/wzapp.h"
+#include "lib/gamelib/gtime.h"
+#include "lib/netplay/netplay.h"
+
+#include "replayverify.h"
+#include "clparse.h"
+#include "multiplay.h"
+#include "scores.h"
+#include "snapshot.h"
+#include "statehash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#if !defined(WZ_OS_WIN)
+#include <sys/wait.h>
+#endif
+
+static const char resultPrefix[] = "replayverify: ";
+static const char replayExtension[] = ".wzrp";
+static const char childEnvironmentVariable[] = "WZ_VERIFYREPLAYS_CHILD";  ///< Set for the processes started by replayVerifyBatch().
+
+static std::string hashString(uint32_t hash)
+{
+	return astringf("%08X", hash);
+}
+
+bool replayVerifyPrintResult(bool gameOver)
+{
+	nlohmann::json result = nlohmann::json::object();
+	result["replay"] = replay_verify_file() != nullptr ? replay_verify_file() : "";
+	result["ended"] = gameOver ? "gameover" : "replayended";
+	result["gameTime"] = gameTime;
+
+	nlohmann::json players = nlohmann::json::array();
+	nlohmann::json winners = nlohmann::json::array();
+	for (unsigned n = 0; n < std::min<unsigned>(MAX_PLAYERS, (unsigned)game.maxPlayers); ++n)
+	{
+		if (NetPlay.players[n].ai < 0)
+		{
+			continue;  // Closed or open slot.
+		}
+		bool defeated = NetPlay.players[n].isSpectator || playerCantDoAnything(n);
+		players.push_back({
+			{"index", n},
+			{"name", NetPlay.players[n].name},
+			{"team", NetPlay.players[n].team},
+			{"human", NetPlay.players[n].allocated},
+			{"defeated", defeated},
+		});
+		if (gameOver && !defeated)
+		{
+			winners.push_back(n);
+		}
+	}
+	result["players"] = std::move(players);
+	result["winners"] = gameOver ? std::move(winners) : nlohmann::json();
+
+	WorldSnapshot snapshot;
+	result["finalHash"] = snapshotCapture(snapshot) ? nlohmann::json(hashString(snapshotSynchronisedHash(snapshot))) : nlohmann::json();
+	nlohmann::json subsystemHashes = nlohmann::json::object();
+	for (size_t subsystem = 0; subsystem < static_cast<size_t>(StateHashSubsystem::Count); ++subsystem)
+	{
+		subsystemHashes[stateHashSubsystemName(static_cast<StateHashSubsystem>(subsystem))] = hashString(stateHashGet(static_cast<StateHashSubsystem>(subsystem)));
+	}
+	result["subsystemHashes"] = std::move(subsystemHashes);
+
+	unsigned keyframesChecked = 0, keyframesDiverged = 0;
+	snapshotGetReplayKeyframeStats(keyframesChecked, keyframesDiverged);
+	result["keyframes"] = {{"checked", keyframesChecked}, {"diverged", keyframesDiverged}};
+
+	uint32_t divergedSubsystems = stateHashDivergedSubsystems();
+	nlohmann::json desyncSubsystems = nlohmann::json::array();
+	for (size_t subsystem = 0; subsystem < static_cast<size_t>(StateHashSubsystem::Count); ++subsystem)
+	{
+		if (divergedSubsystems & 1 << subsystem)
+		{
+			desyncSubsystems.push_back(stateHashSubsystemName(static_cast<StateHashSubsystem>(subsystem)));
+		}
+	}
+	bool desync = keyframesDiverged != 0 || divergedSubsystems != 0;
+	result["desync"] = desync;
+	result["desyncSubsystems"] = std::move(desyncSubsystems);
+
+	fprintf(stdout, "%s%s\n", resultPrefix, result.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace).c_str());
+	fflush(stdout);
+	return !desync;
+}
+
+// MARK: - Batch verification
+
+/// Quotes an argument for the shell used by popen().
+static std::string shellQuote(std::string const &arg)
+{
+#if defined(WZ_OS_WIN)
+	return "\"" + arg + "\"";  // Windows paths can't contain quotes.
+#else
+	std::string quoted = "'";
+	for (char c : arg)
+	{
+		if (c == '\'')
+		{
+			quoted += "'\\''";
+		}
+		else
+		{
+			quoted += c;
+		}
+	}
+	return quoted + "'";
+#endif
+}
+
+/// Returns the number of arguments, starting at argv[i], which make up a verification option, or 0 if argv[i] isn't one.
+static int verifyOptionLength(int argc, const char * const *argv, int i)
+{
+	static const struct
+	{
+		const char *name;
+		bool hasValue;
+	} options[] = {{"--verifyreplays", true}, {"--verifyjobs", true}, {"--verifyreplay", true}, {"--loadreplay", true}, {"--replaybench", false}};
+	for (auto const &option : options)
+	{
+		size_t nameLength = strlen(option.name);
+		if (strncmp(argv[i], option.name, nameLength) != 0)
+		{
+			continue;
+		}
+		if (argv[i][nameLength] == '\0')
+		{
+			// "--option value", so the value is the next argument.
+			return option.hasValue && i + 1 < argc ? 2 : 1;
+		}
+		if (argv[i][nameLength] != '=')
+		{
+			continue;  // Some other option, such as --verifyreplays when looking for --verifyreplay.
+		}
+		// "--option="quoted value"" may continue over several arguments, until the one with the closing quote.
+		const char *value = argv[i] + nameLength + 1;
+		int length = 1;
+		if (value[0] == '"' && strchr(value + 1, '"') == nullptr)
+		{
+			while (i + length < argc && strchr(argv[i + length++], '"') == nullptr) {}
+		}
+		return length;
+	}
+	return 0;
+}
+
+/// Runs --verifyreplay for the replay, and returns its result.
+static nlohmann::json verifyReplay(std::string const &command, std::string const &replayName)
+{
+	nlohmann::json result = nlohmann::json::object();
+	result["replay"] = replayName;
+	auto start = std::chrono::steady_clock::now();
+
+#if defined(WZ_OS_WIN)
+	FILE *output = _popen(("\"" + command + "\"").c_str(), "r");  // cmd.exe strips the outer quotes.
+#else
+	FILE *output = popen(command.c_str(), "r");
+#endif
+	if (output == nullptr)
+	{
+		result["error"] = "could not start process";
+		return result;
+	}
+
+	nlohmann::json verdict;
+	std::string line;
+	char buffer[4096];
+	while (fgets(buffer, sizeof(buffer), output) != nullptr)
+	{
+		line += buffer;
+		if (line.empty() || line.back() != '\n')
+		{
+			continue;  // Long line.
+		}
+		if (line.compare(0, strlen(resultPrefix), resultPrefix) == 0)
+		{
+			verdict = nlohmann::json::parse(line.begin() + strlen(resultPrefix), line.end(), nullptr, false);
+		}
+		line.clear();
+	}
+
+#if defined(WZ_OS_WIN)
+	int exitCode = _pclose(output);
+#else
+	int status = pclose(output);
+	int exitCode = status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+
+	result["exitCode"] = exitCode;
+	result["seconds"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!verdict.is_object())
+	{
+		result["error"] = "no result, the replay could not be played";
+		return result;
+	}
+	for (auto it = verdict.begin(); it != verdict.end(); ++it)
+	{
+		if (it.key() != "replay")
+		{
+			result[it.key()] = it.value();
+		}
+	}
+	return result;
+}
+
+int replayVerifyBatch(std::string const &directory, unsigned jobs, int argc, const char * const *argv)
+{
+	ASSERT_OR_RETURN(EXIT_FAILURE, argc > 0, "No executable");
+	if (getenv(childEnvironmentVariable) != nullptr || replay_verify_file() != nullptr)
+	{
+		fprintf(stderr, "Not verifying replays from a process which is itself verifying a replay\n");
+		return EXIT_FAILURE;
+	}
+	const char mountPoint[] = "verifyreplays";
+	if (PHYSFS_mount(directory.c_str(), mountPoint, PHYSFS_APPEND) == 0)
+	{
+		fprintf(stderr, "Could not open replay directory %s: %s\n", directory.c_str(), WZ_PHYSFS_getLastError());
+		return EXIT_FAILURE;
+	}
+	std::vector<std::string> replayNames;
+	WZ_PHYSFS_enumerateFiles(mountPoint, [&](const char *fileName) -> bool {
+		if (strEndsWith(fileName, replayExtension))
+		{
+			replayNames.push_back(fileName);
+		}
+		return true;
+	});
+	WZ_PHYSFS_unmount(directory.c_str());
+	std::sort(replayNames.begin(), replayNames.end());
+
+	// Every replay gets its own process, with the same settings as this one.
+	std::string command = shellQuote(argv[0]);
+	for (int i = 1; i < argc;)
+	{
+		int length = verifyOptionLength(argc, argv, i);
+		if (length == 0)
+		{
+			command += " " + shellQuote(argv[i]);
+			length = 1;
+		}
+		i += length;
+	}
+	std::string directoryPrefix = directory;
+	if (!directoryPrefix.empty() && directoryPrefix.back() != '/' && directoryPrefix.back() != '\\')
+	{
+		directoryPrefix += PHYSFS_getDirSeparator();
+	}
+#if defined(WZ_OS_WIN)
+	const char discardOutput[] = " 2>NUL";
+#else
+	const char discardOutput[] = " 2>/dev/null";
+#endif
+
+	if (jobs == 0)
+	{
+		jobs = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	jobs = std::min<unsigned>(jobs, std::max<size_t>(replayNames.size(), 1));
+
+	// Inherited by the processes, so that none of them starts another batch.
+#if defined(WZ_OS_WIN)
+	_putenv_s(childEnvironmentVariable, "1");
+#else
+	setenv(childEnvironmentVariable, "1", 1);
+#endif
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<nlohmann::json> results(replayNames.size());
+	std::atomic<size_t> nextReplay(0);
+	std::atomic<size_t> finished(0);
+	auto worker = [&]() {
+		for (size_t i; (i = nextReplay++) < replayNames.size();)
+		{
+			std::string replayCommand = command + " " + shellQuote("--verifyreplay=" + directoryPrefix + replayNames[i]) + discardOutput;
+			results[i] = verifyReplay(replayCommand, replayNames[i]);
+			fprintf(stderr, "[%zu/%zu] %s: %s\n", ++finished, replayNames.size(), replayNames[i].c_str(),
+			        results[i].contains("error") ? "failed" : results[i].value("desync", false) ? "desync" : "ok");
+		}
+	};
+	std::vector<std::unique_ptr<wz::thread>> threads;
+	for (unsigned job = 0; job < jobs; ++job)
+	{
+		threads.emplace_back(new wz::thread(worker));
+	}
+	for (auto &thread : threads)
+	{
+		thread->join();
+	}
+
+	size_t verified = 0, desynced = 0, failed = 0;
+	nlohmann::json replays = nlohmann::json::array();
+	for (nlohmann::json &result : results)
+	{
+		if (result.contains("error"))
+		{
+			++failed;
+		}
+		else if (result.value("desync", false))
+		{
+			++desynced;
+		}
+		else
+		{
+			++verified;
+		}
+		replays.push_back(std::move(result));
+	}
+
+	nlohmann::json report = nlohmann::json::object();
+	report["directory"] = directory;
+	report["jobs"] = jobs;
+	report["seconds"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	report["summary"] = {{"total", replayNames.size()}, {"verified", verified}, {"desync", desynced}, {"failed", failed}};
+	report["replays"] = std::move(replays);
+	fprintf(stdout, "%s\n", report.dump(4, ' ', false, nlohmann::json::error_handler_t::replace).c_str());
+	fflush(stdout);
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,40 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Replay verification, for --verifyreplays and --verifyreplay.
+ *
+ *  --verifyreplay plays a single replay like --replaybench, then prints a line "replayverify: " followed by the result
+ *  as JSON: the winners, the final state hashes, and whether the replay diverged from its keyframes or from the state
+ *  hashes recorded in it. --verifyreplays runs --verifyreplay for every replay in a directory, several processes at
+ *  once, and prints all the results as a single JSON document.
+ */
+
+#ifndef __INCLUDED_SRC_REPLAYVERIFY_H__
+#define __INCLUDED_SRC_REPLAYVERIFY_H__
+
+#include <string>
+
+/// Verifies all replays in directory, running up to jobs processes at once, or one per core if 0. The processes get the
+/// same command line arguments, apart from the verification options. Returns the exit code.
+int replayVerifyBatch(std::string const &directory, unsigned jobs, int argc, const char * const *argv);
+
+/// Prints the result of the replay being verified, when it ends. Returns false if it diverged.
+bool replayVerifyPrintResult(bool gameOver);
+
+#endif // __INCLUDED_SRC_REPLAYVERIFY_H__
@@ -25,6 +25,8 @@
  */
 #include <string.h>
 #include <map>
+#include <set>
+#include <unordered_map>
 
 #include "lib/framework/frame.h"
 #include "lib/netplay/netplay.h"
@@ -47,6 +49,8 @@
 #include "qtscript.h"
 #include "stats.h"
 #include "wzapi.h"
+#include "statehash.h"
+#include "snapshot.h"
 
 // The stores for the research stats
 std::vector<RESEARCH> asResearch;
@@ -61,6 +65,16 @@ SDWORD					CBResFacilityOwner;
 //List of pointers to arrays of PLAYER_RESEARCH[numResearch] for each player
 std::vector<PLAYER_RESEARCH> asPlayerResList[MAX_PLAYERS];
 
+// Index into asResearch for each research id, for getResearch()
+static std::unordered_map<std::string, size_t> researchIndexById;
+// Topics having each topic as a pre-requisite
+static std::vector<std::vector<uint16_t>> researchDependents;
+// Topics which might be available for each player. A superset of the topics researchAvailable() accepts, since
+// a topic can only become available by being enabled, by having its pre-requisites researched, or by being cancelled
+// (after having been available), and only stops being a candidate once researched.
+static std::set<uint16_t> researchCandidates[MAX_PLAYERS];
+static bool researchCandidatesValid[MAX_PLAYERS] = {false};
+
 /* Default level of sensor, Repair and ECM */
 UDWORD					aDefaultSensor[MAX_PLAYERS];
 UDWORD					aDefaultECM[MAX_PLAYERS];
@@ -82,21 +96,32 @@ std::vector<PlayerUpgradeCounts> playerUpgradeCounts;
 
 //set the iconID based on the name read in in the stats
 static UWORD setIconID(const char *pIconName, const char *pName);
-static void replaceComponent(COMPONENT_STATS *pNewComponent, COMPONENT_STATS *pOldComponent,
-                             UBYTE player);
+/// The component replacements of a research result, applied together in one pass over the player's objects.
+struct ComponentReplacements
+{
+	std::vector<int> newIndex[COMP_NUMCOMPONENTS];  ///< New component index, indexed by old component index, -1 if not replaced.
+
+	void add(COMPONENT_TYPE type, int oldIndex, int newIndex);
+	int replacement(unsigned type, int index) const  ///< Returns the component which replaces index, which may be index itself.
+	{
+		std::vector<int> const &replacements = newIndex[type];
+		return (unsigned)index < replacements.size() && replacements[index] >= 0 ? replacements[index] : index;
+	}
+	bool replaces(unsigned type) const
+	{
+		return !newIndex[type].empty();
+	}
+};
+static void replaceComponents(ComponentReplacements const &replacements, UBYTE player);
 static bool checkResearchName(RESEARCH *psRes, UDWORD numStats);
 
 //flag that indicates whether the player can self repair
 static UBYTE bSelfRepair[MAX_PLAYERS];
-static void replaceDroidComponent(DROID *pList, UDWORD oldType, UDWORD oldCompInc,
-                                  UDWORD newCompInc);
-static void replaceStructureComponent(STRUCTURE *pList, UDWORD oldType, UDWORD oldCompInc,
-                                      UDWORD newCompInc, UBYTE player);
-static void switchComponent(DROID *psDroid, UDWORD oldType, UDWORD oldCompInc,
-                            UDWORD newCompInc);
+static void replaceDroidComponent(DROID *pList, ComponentReplacements const &replacements);
+static void replaceStructureComponent(STRUCTURE *pList, ComponentReplacements const &replacements);
+static void switchComponent(DROID *psDroid, ComponentReplacements const &replacements);
 
-static void replaceTransDroidComponents(DROID *psTransporter, UDWORD oldType,
-                                        UDWORD oldCompInc, UDWORD newCompInc);
+static void replaceTransDroidComponents(DROID *psTransporter, ComponentReplacements const &replacements);
 
 
 bool researchInitVars()
@@ -108,9 +133,12 @@ bool researchInitVars()
 	cachedStatsObject = nlohmann::json(nullptr);
 	cachedPerPlayerUpgrades.clear();
 	playerUpgradeCounts = std::vector<PlayerUpgradeCounts>(MAX_PLAYERS);
+	researchIndexById.clear();
+	researchDependents.clear();
 
 	for (int i = 0; i < MAX_PLAYERS; i++)
 	{
+		invalidateResearchCandidates(i);
 		bSelfRepair[i] = false;
 		aDefaultSensor[i] = 0;
 		aDefaultECM[i] = 0;
@@ -475,6 +503,12 @@ bool loadResearch(WzConfig &ini)
 		ini.endGroup();
 	}
 
+	researchIndexById.clear();
+	for (size_t inc = 0; inc < asResearch.size(); inc++)
+	{
+		researchIndexById.emplace(asResearch[inc].id.toUtf8(), inc);
+	}
+
 	//Load and check research pre-requisites (need do it AFTER loading research items)
 	for (size_t inc = 0; inc < asResearch.size(); inc++)
 	{
@@ -491,6 +525,19 @@ bool loadResearch(WzConfig &ini)
 		}
 	}
 
+	researchDependents.assign(asResearch.size(), std::vector<uint16_t>());
+	for (size_t inc = 0; inc < asResearch.size(); inc++)
+	{
+		for (uint16_t pr : asResearch[inc].pPRList)
+		{
+			researchDependents[pr].push_back(inc);
+		}
+	}
+	for (int i = 0; i < MAX_PLAYERS; i++)
+	{
+		invalidateResearchCandidates(i);
+	}
+
 	if (auto cycle = CycleDetection::detectCycle())
 	{
 		debug(LOG_ERROR, "A cycle was detected in the research dependency graph:");
@@ -608,6 +655,85 @@ bool researchAvailable(int inc, UDWORD playerID, QUEUE_MODE mode)
 	return false;
 }
 
+// Whether the topic could be available for research, ignoring whether it is started, disabled or needs structures.
+static bool isResearchCandidate(UDWORD playerID, size_t inc)
+{
+	PLAYER_RESEARCH const *psPlRes = &asPlayerResList[playerID][inc];
+	if ((psPlRes->ResearchStatus & (CANCELLED_RESEARCH | CANCELLED_RESEARCH_PENDING)) != 0)
+	{
+		return true;
+	}
+	if (IsResearchCompleted(psPlRes))
+	{
+		return false;
+	}
+	if (IsResearchPossible(psPlRes))
+	{
+		return true;
+	}
+	if (asResearch[inc].pPRList.empty())
+	{
+		return false;
+	}
+	for (uint16_t pr : asResearch[inc].pPRList)
+	{
+		if (!IsResearchCompleted(&asPlayerResList[playerID][pr]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void invalidateResearchCandidates(UDWORD playerID)
+{
+	ASSERT_OR_RETURN(, playerID < MAX_PLAYERS, "invalid player: %" PRIu32 "", playerID);
+	researchCandidatesValid[playerID] = false;
+	researchCandidates[playerID].clear();
+}
+
+static void updateResearchCandidate(UDWORD playerID, size_t inc)
+{
+	if (researchCandidatesValid[playerID] && isResearchCandidate(playerID, inc))
+	{
+		researchCandidates[playerID].insert(inc);
+	}
+}
+
+static std::set<uint16_t> const &getResearchCandidates(UDWORD playerID)
+{
+	if (!researchCandidatesValid[playerID])
+	{
+		std::set<uint16_t> &candidates = researchCandidates[playerID];
+		candidates.clear();
+		size_t numResearch = std::min(asResearch.size(), asPlayerResList[playerID].size());
+		for (size_t inc = 0; inc < numResearch; inc++)
+		{
+			if (isResearchCandidate(playerID, inc))
+			{
+				candidates.insert(candidates.end(), inc);
+			}
+		}
+		researchCandidatesValid[playerID] = true;
+	}
+	return researchCandidates[playerID];
+}
+
+std::vector<uint16_t> availableResearchList(UDWORD playerID, QUEUE_MODE mode)
+{
+	std::vector<uint16_t> list;
+	ASSERT_OR_RETURN(list, playerID < MAX_PLAYERS, "invalid player: %" PRIu32 "", playerID);
+
+	for (uint16_t inc : getResearchCandidates(playerID))
+	{
+		if (researchAvailable(inc, playerID, mode))
+		{
+			list.push_back(inc);
+		}
+	}
+	return list;
+}
+
 /*
 Function to check what can be researched for a particular player at any one
 instant.
@@ -627,11 +753,27 @@ There can only be 'limit' number of entries
 std::vector<uint16_t> fillResearchList(UDWORD playerID, nonstd::optional<UWORD> topic, UWORD limit)
 {
 	std::vector<uint16_t> list;
+	ASSERT_OR_RETURN(list, playerID < MAX_PLAYERS, "invalid player: %" PRIu32 "", playerID);
 
-	for (auto inc = 0; inc < asResearch.size(); inc++)
+	// Only candidates can be available, so no need to check every topic.
+	bool topicAdded = !topic.has_value() || topic.value() >= asResearch.size();
+	for (uint16_t inc : getResearchCandidates(playerID))
 	{
-		// if the inc matches the 'topic' - automatically add to the list
-		if ((topic.has_value() && inc == topic.value()) || researchAvailable(inc, playerID, ModeQueue))
+		// if the inc matches the 'topic' - automatically add to the list, in order
+		if (!topicAdded && topic.value() <= inc)
+		{
+			topicAdded = true;
+			list.push_back(topic.value());
+			if (list.size() == limit)
+			{
+				return list;
+			}
+			if (topic.value() == inc)
+			{
+				continue;
+			}
+		}
+		if (researchAvailable(inc, playerID, ModeQueue))
 		{
 			list.push_back(inc);
 			if (list.size() == limit)
@@ -640,6 +782,10 @@ std::vector<uint16_t> fillResearchList(UDWORD playerID, nonstd::optional<UWORD>
 			}
 		}
 	}
+	if (!topicAdded)
+	{
+		list.push_back(topic.value());
+	}
 
 	return list;
 }
@@ -722,16 +868,16 @@ static void eventResearchedHandleUpgrades(const RESEARCH *psResearch, const STRU
 			ASSERT(pPlayerEntityClass, "Unknown entity class: %s", ctype.c_str());
 			continue;
 		}
+		const auto statsEntityClassObj = cachedStatsObject.find(ctype);
+		if (statsEntityClassObj == cachedStatsObject.end())
+		{
+			ASSERT(false, "Parameter \"%s\" does not exist in Stats[%s] ?", parameter.c_str(), ctype.c_str());
+			continue;
+		}
 		bool isBodyClass = ctype == "Body";
 		bool isWeaponClass = ctype == "Weapon";
 		for (auto cname : *pPlayerEntityClass) // iterate over all components of this type
 		{
-			const auto statsEntityClassObj = cachedStatsObject.find(ctype);
-			if (statsEntityClassObj == cachedStatsObject.end())
-			{
-				ASSERT(false, "Parameter \"%s\" does not exist in Stats[%s][%s] ?", parameter.c_str(), ctype.c_str(), cname.first.c_str());
-				continue;
-			}
 			const auto statsEntityObj = statsEntityClassObj->find(cname.first);
 			if (statsEntityObj == statsEntityClassObj->end())
 			{
@@ -954,7 +1100,22 @@ void researchResult(UDWORD researchIndex, UBYTE player, bool bDisplay, STRUCTURE
 
 	syncDebug("researchResult(%u, %u, …)", researchIndex, player);
 
+	if (!IsResearchCompleted(&asPlayerResList[player][researchIndex]))
+	{
+		stateHashResearchCompleted(player, researchIndex);
+	}
 	MakeResearchCompleted(&asPlayerResList[player][researchIndex]);
+	if (researchCandidatesValid[player])
+	{
+		researchCandidates[player].erase(researchIndex);
+		if (researchIndex < researchDependents.size())
+		{
+			for (uint16_t dependent : researchDependents[researchIndex])
+			{
+				updateResearchCandidate(player, dependent);
+			}
+		}
+	}
 
 	//check for structures to be made available
 	for (unsigned short pStructureResult : pResearch->pStructureResults)
@@ -971,12 +1132,18 @@ void researchResult(UDWORD researchIndex, UBYTE player, bool bDisplay, STRUCTURE
 	//check for component replacement
 	if (!pResearch->componentReplacement.empty())
 	{
+		ComponentReplacements replacements;
 		for (auto &ri : pResearch->componentReplacement)
 		{
 			COMPONENT_STATS *pOldComp = ri.pOldComponent;
-			replaceComponent(ri.pNewComponent, pOldComp, player);
+			//check old and new type are the same
+			if (pOldComp->compType == ri.pNewComponent->compType)
+			{
+				replacements.add(pOldComp->compType, pOldComp->index, ri.pNewComponent->index);
+			}
 			makeComponentRedundant(apCompLists[player][pOldComp->compType][pOldComp->index]);
 		}
+		replaceComponents(replacements, player);
 	}
 
 	//check for artefacts to be made available
@@ -1072,6 +1239,12 @@ void ResearchRelease()
 	cachedStatsObject = nlohmann::json(nullptr);
 	cachedPerPlayerUpgrades.clear();
 	playerUpgradeCounts = std::vector<PlayerUpgradeCounts>(MAX_PLAYERS);
+	researchIndexById.clear();
+	researchDependents.clear();
+	for (int i = 0; i < MAX_PLAYERS; i++)
+	{
+		invalidateResearchCandidates(i);
+	}
 }
 
 /*puts research facility on hold*/
@@ -1176,6 +1349,7 @@ void cancelResearch(STRUCTURE *psBuilding, QUEUE_MODE mode)
 			sendResearchStatus(psBuilding, topicInc, psBuilding->player, false);
 			// Immediately tell the UI that we can research this now. (But don't change the game state.)
 			MakeResearchCancelledPending(pPlayerRes);
+			updateResearchCandidate(psBuilding->player, topicInc);
 			setStatusPendingCancel(*psResFac);
 			return;  // Wait for our message before doing anything. (Whatever this function does...)
 		}
@@ -1190,6 +1364,7 @@ void cancelResearch(STRUCTURE *psBuilding, QUEUE_MODE mode)
 		{
 			// Set the researched flag
 			MakeResearchCancelled(pPlayerRes);
+			updateResearchCandidate(psBuilding->player, topicInc);
 		}
 
 		// Initialise the research facility's subject
@@ -1390,66 +1565,54 @@ SDWORD	mapIconToRID(UDWORD iconID)
 //return a pointer to a research topic based on the name
 RESEARCH *getResearch(const char *pName)
 {
-	for (auto &inc : asResearch)
+	auto it = researchIndexById.find(pName);
+	if (it != researchIndexById.end() && it->second < asResearch.size())
 	{
-		if (inc.id.compare(pName) == 0)
-		{
-			return &inc;
-		}
+		return &asResearch[it->second];
 	}
 	debug(LOG_WARNING, "Unknown research - %s", pName);
 	return nullptr;
 }
 
-/* looks through the players lists of structures and droids to see if any are using
- the old component - if any then replaces them with the new component */
-static void replaceComponent(COMPONENT_STATS *pNewComponent, COMPONENT_STATS *pOldComponent,
-                             UBYTE player)
+void ComponentReplacements::add(COMPONENT_TYPE type, int oldIndex, int newIndex_)
 {
-	ASSERT_OR_RETURN(, player < MAX_PLAYERS, "invalid player: %" PRIu8 "", player);
-
-	COMPONENT_TYPE oldType = pOldComponent->compType;
-	int oldCompInc = pOldComponent->index;
-	COMPONENT_TYPE newType = pNewComponent->compType;
-	int newCompInc = pNewComponent->index;
-
-	//check old and new type are the same
-	if (oldType != newType)
+	// Same result as replacing the components one after another: anything already replaced by the old component now
+	// gets the new one, and the old component can only be replaced if it wasn't replaced already.
+	std::vector<int> &replacements = newIndex[type];
+	for (int &index : replacements)
 	{
-		return;
+		if (index == oldIndex)
+		{
+			index = newIndex_;
+		}
+	}
+	if (replacements.size() <= (unsigned)oldIndex)
+	{
+		replacements.resize(oldIndex + 1, -1);
+	}
+	if (replacements[oldIndex] < 0)
+	{
+		replacements[oldIndex] = newIndex_;
 	}
+}
 
-	replaceDroidComponent(apsDroidLists[player], oldType, oldCompInc, newCompInc);
-	replaceDroidComponent(mission.apsDroidLists[player], oldType, oldCompInc, newCompInc);
-	replaceDroidComponent(apsLimboDroids[player], oldType, oldCompInc, newCompInc);
-	const auto replaceComponentInTemplate = [oldType, oldCompInc, newCompInc](DROID_TEMPLATE* psTemplates) {
-		switch (oldType)
-		{
-		case COMP_BODY:
-		case COMP_BRAIN:
-		case COMP_PROPULSION:
-		case COMP_REPAIRUNIT:
-		case COMP_ECM:
-		case COMP_SENSOR:
-		case COMP_CONSTRUCT:
-			if (psTemplates->asParts[oldType] == (SDWORD)oldCompInc)
-			{
-				psTemplates->asParts[oldType] = newCompInc;
-			}
-			break;
-		case COMP_WEAPON:
-			for (int inc = 0; inc < psTemplates->numWeaps; inc++)
-			{
-				if (psTemplates->asWeaps[inc] == oldCompInc)
-				{
-					psTemplates->asWeaps[inc] = newCompInc;
-				}
-			}
-			break;
-		default:
-			//unknown comp type
-			debug(LOG_ERROR, "Unknown component type - invalid Template");
-			return true;
+/* looks through the players lists of structures and droids to see if any are using
+ the old components - if any then replaces them with the new components, in one pass */
+static void replaceComponents(ComponentReplacements const &replacements, UBYTE player)
+{
+	ASSERT_OR_RETURN(, player < MAX_PLAYERS, "invalid player: %" PRIu8 "", player);
+
+	replaceDroidComponent(apsDroidLists[player], replacements);
+	replaceDroidComponent(mission.apsDroidLists[player], replacements);
+	replaceDroidComponent(apsLimboDroids[player], replacements);
+	const auto replaceComponentInTemplate = [&replacements](DROID_TEMPLATE* psTemplates) {
+		for (unsigned type : {COMP_BODY, COMP_BRAIN, COMP_PROPULSION, COMP_REPAIRUNIT, COMP_ECM, COMP_SENSOR, COMP_CONSTRUCT})
+		{
+			psTemplates->asParts[type] = replacements.replacement(type, psTemplates->asParts[type]);
+		}
+		for (int inc = 0; inc < psTemplates->numWeaps; inc++)
+		{
+			psTemplates->asWeaps[inc] = replacements.replacement(COMP_WEAPON, psTemplates->asWeaps[inc]);
 		}
 		return true;
 	};
@@ -1469,8 +1632,8 @@ static void replaceComponent(COMPONENT_STATS *pNewComponent, COMPONENT_STATS *pO
 			replaceComponentInTemplate(psCBuilding->pFunctionality->factory.psSubject);
 		}
 	}
-	replaceStructureComponent(apsStructLists[player], oldType, oldCompInc, newCompInc, player);
-	replaceStructureComponent(mission.apsStructLists[player], oldType, oldCompInc, newCompInc, player);
+	replaceStructureComponent(apsStructLists[player], replacements);
+	replaceStructureComponent(mission.apsStructLists[player], replacements);
 }
 
 /*Looks through all the currently allocated stats to check the name is not
@@ -1506,6 +1669,7 @@ bool enableResearch(RESEARCH *psResearch, UDWORD player)
 
 	//found, so set the flag
 	MakeResearchPossible(&asPlayerResList[player][inc]);
+	updateResearchCandidate(player, inc);
 
 	if (player == selectedPlayer)
 	{
@@ -1580,27 +1744,25 @@ bool selfRepairEnabled(UBYTE player)
 	}
 }
 
-/*for a given list of droids, replace the old component if exists*/
-void replaceDroidComponent(DROID *pList, UDWORD oldType, UDWORD oldCompInc,
-                           UDWORD newCompInc)
+/*for a given list of droids, replace the old components if they exist*/
+void replaceDroidComponent(DROID *pList, ComponentReplacements const &replacements)
 {
 	DROID   *psDroid;
 
 	//check thru the droids
 	for (psDroid = pList; psDroid != nullptr; psDroid = psDroid->psNext)
 	{
-		switchComponent(psDroid, oldType, oldCompInc, newCompInc);
+		switchComponent(psDroid, replacements);
 		// Need to replace the units inside the transporter
 		if (isTransporter(psDroid))
 		{
-			replaceTransDroidComponents(psDroid, oldType, oldCompInc, newCompInc);
+			replaceTransDroidComponents(psDroid, replacements);
 		}
 	}
 }
 
 /*replaces any components necessary for units that are inside a transporter*/
-void replaceTransDroidComponents(DROID *psTransporter, UDWORD oldType,
-                                 UDWORD oldCompInc, UDWORD newCompInc)
+void replaceTransDroidComponents(DROID *psTransporter, ComponentReplacements const &replacements)
 {
 	DROID       *psCurr;
 
@@ -1611,19 +1773,18 @@ void replaceTransDroidComponents(DROID *psTransporter, UDWORD oldType,
 	{
 		if (psCurr != psTransporter)
 		{
-			switchComponent(psCurr, oldType, oldCompInc, newCompInc);
+			switchComponent(psCurr, replacements);
 		}
 	}
 }
 
-void replaceStructureComponent(STRUCTURE *pList, UDWORD oldType, UDWORD oldCompInc,
-                               UDWORD newCompInc, UBYTE player)
+void replaceStructureComponent(STRUCTURE *pList, ComponentReplacements const &replacements)
 {
 	STRUCTURE   *psStructure;
 	int			inc;
 
-	// If the type is not one we are interested in, then don't bother checking
-	if (!(oldType == COMP_ECM || oldType == COMP_SENSOR || oldType == COMP_WEAPON))
+	// Only weapons are replaced in structures
+	if (!replacements.replaces(COMP_WEAPON))
 	{
 		return;
 	}
@@ -1631,62 +1792,32 @@ void replaceStructureComponent(STRUCTURE *pList, UDWORD oldType, UDWORD oldCompI
 	//check thru the structures
 	for (psStructure = pList; psStructure != nullptr; psStructure = psStructure->psNext)
 	{
-		switch (oldType)
+		for (inc = 0; inc < psStructure->numWeaps; inc++)
 		{
-		case COMP_WEAPON:
-			for (inc = 0; inc < psStructure->numWeaps; inc++)
+			if (psStructure->asWeaps[inc].nStat > 0)
 			{
-				if (psStructure->asWeaps[inc].nStat > 0)
-				{
-					if (psStructure->asWeaps[inc].nStat == oldCompInc)
-					{
-						psStructure->asWeaps[inc].nStat = newCompInc;
-					}
-				}
+				psStructure->asWeaps[inc].nStat = replacements.replacement(COMP_WEAPON, psStructure->asWeaps[inc].nStat);
 			}
-			break;
-		default:
-			//ignore all other component types
-			break;
 		}
 	}
 }
 
-/*swaps the old component for the new one for a specific droid*/
-static void switchComponent(DROID *psDroid, UDWORD oldType, UDWORD oldCompInc,
-                            UDWORD newCompInc)
+/*swaps the old components for the new ones for a specific droid*/
+static void switchComponent(DROID *psDroid, ComponentReplacements const &replacements)
 {
 	ASSERT_OR_RETURN(, psDroid != nullptr, "Invalid droid pointer");
 
-	switch (oldType)
+	for (unsigned type : {COMP_BODY, COMP_BRAIN, COMP_PROPULSION, COMP_REPAIRUNIT, COMP_ECM, COMP_SENSOR, COMP_CONSTRUCT})
 	{
-	case COMP_BODY:
-	case COMP_BRAIN:
-	case COMP_PROPULSION:
-	case COMP_REPAIRUNIT:
-	case COMP_ECM:
-	case COMP_SENSOR:
-	case COMP_CONSTRUCT:
-		if (psDroid->asBits[oldType] == oldCompInc)
+		if (replacements.replaces(type))
 		{
-			psDroid->asBits[oldType] = (UBYTE)newCompInc;
+			psDroid->asBits[type] = (UBYTE)replacements.replacement(type, psDroid->asBits[type]);
 		}
-		break;
-	case COMP_WEAPON:
-		// Can only be one weapon now
-		if (psDroid->asWeaps[0].nStat > 0)
-		{
-			if (psDroid->asWeaps[0].nStat == oldCompInc)
-			{
-				psDroid->asWeaps[0].nStat = newCompInc;
-			}
-		}
-		break;
-	default:
-		//unknown comp type
-		debug(LOG_ERROR, "Unknown component type - invalid droid");
-		abort();
-		return;
+	}
+	// Can only be one weapon now
+	if (psDroid->asWeaps[0].nStat > 0)
+	{
+		psDroid->asWeaps[0].nStat = replacements.replacement(COMP_WEAPON, psDroid->asWeaps[0].nStat);
 	}
 }
 
@@ -1809,3 +1940,144 @@ void RecursivelyDisableResearchByFlags(UBYTE flags)
 		}
 	}
 }
+
+static void researchSnapshotWriteCounts(SnapshotWriter &writer, std::unordered_map<std::string, uint32_t> const &counts)
+{
+	std::map<std::string, uint32_t> sorted(counts.begin(), counts.end());
+	writer.u32(static_cast<uint32_t>(sorted.size()));
+	for (auto const &count : sorted)
+	{
+		writer.u32(static_cast<uint32_t>(count.first.size()));
+		writer.bytes(count.first.data(), count.first.size());
+		writer.u32(count.second);
+	}
+}
+
+static bool researchSnapshotReadCounts(SnapshotReader &reader, std::unordered_map<std::string, uint32_t> &counts)
+{
+	uint32_t size = reader.u32();
+	for (uint32_t n = 0; n < size && reader.valid(); ++n)
+	{
+		uint32_t length = reader.u32();
+		if (length > MAX_STR_LENGTH)
+		{
+			return false;
+		}
+		std::string name(length, '\0');
+		reader.bytes(&name[0], name.size());
+		counts[name] = reader.u32();
+	}
+	return reader.valid();
+}
+
+void researchSnapshotWrite(SnapshotWriter &writer)
+{
+	writer.u32(static_cast<uint32_t>(asResearch.size()));
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		ASSERT(asPlayerResList[player].size() == asResearch.size(), "Research list of player %u has the wrong size", player);
+		for (PLAYER_RESEARCH const &research : asPlayerResList[player])
+		{
+			writer.u32(research.currentPoints);
+			writer.u8(research.ResearchStatus & ~RESBITS_PENDING_ONLY);
+			writer.u8(research.possible);
+		}
+		writer.u8(bSelfRepair[player]);
+		writer.u32(aDefaultSensor[player]);
+		writer.u32(aDefaultECM[player]);
+		writer.u32(aDefaultRepair[player]);
+		PlayerUpgradeCounts const &counts = playerUpgradeCounts[player];
+		researchSnapshotWriteCounts(writer, counts.numBodyClassArmourUpgrades);
+		researchSnapshotWriteCounts(writer, counts.numBodyClassThermalUpgrades);
+		researchSnapshotWriteCounts(writer, counts.numWeaponImpactClassUpgrades);
+	}
+}
+
+bool researchSnapshotRead(SnapshotReader &reader)
+{
+	if (reader.u32() != asResearch.size() || playerUpgradeCounts.size() != MAX_PLAYERS)
+	{
+		return false;
+	}
+	std::vector<PLAYER_RESEARCH> lists[MAX_PLAYERS];
+	UBYTE selfRepair[MAX_PLAYERS];
+	UDWORD defaultSensor[MAX_PLAYERS], defaultECM[MAX_PLAYERS], defaultRepair[MAX_PLAYERS];
+	std::vector<PlayerUpgradeCounts> counts(MAX_PLAYERS);
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		lists[player].resize(asResearch.size());
+		for (size_t inc = 0; inc < asResearch.size(); ++inc)
+		{
+			PLAYER_RESEARCH &research = lists[player][inc];
+			research.currentPoints = reader.u32();
+			// Keep the pending bits, until researchSnapshotReadLocal() replaces them.
+			research.ResearchStatus = reader.u8();
+			if (inc < asPlayerResList[player].size())
+			{
+				research.ResearchStatus |= asPlayerResList[player][inc].ResearchStatus & RESBITS_PENDING_ONLY;
+			}
+			research.possible = reader.u8();
+		}
+		selfRepair[player] = reader.u8();
+		defaultSensor[player] = reader.u32();
+		defaultECM[player] = reader.u32();
+		defaultRepair[player] = reader.u32();
+		if (!researchSnapshotReadCounts(reader, counts[player].numBodyClassArmourUpgrades)
+		    || !researchSnapshotReadCounts(reader, counts[player].numBodyClassThermalUpgrades)
+		    || !researchSnapshotReadCounts(reader, counts[player].numWeaponImpactClassUpgrades))
+		{
+			return false;
+		}
+	}
+	if (!reader.valid())
+	{
+		return false;
+	}
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		asPlayerResList[player] = std::move(lists[player]);
+		bSelfRepair[player] = selfRepair[player];
+		aDefaultSensor[player] = defaultSensor[player];
+		aDefaultECM[player] = defaultECM[player];
+		aDefaultRepair[player] = defaultRepair[player];
+		invalidateResearchCandidates(player);
+	}
+	playerUpgradeCounts = std::move(counts);
+	return true;
+}
+
+void researchSnapshotWriteLocal(SnapshotWriter &writer)
+{
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (PLAYER_RESEARCH const &research : asPlayerResList[player])
+		{
+			writer.u8(research.ResearchStatus & RESBITS_PENDING_ONLY);
+		}
+	}
+}
+
+bool researchSnapshotReadLocal(SnapshotReader &reader)
+{
+	std::vector<uint8_t> pending;
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (size_t inc = 0; inc < asPlayerResList[player].size(); ++inc)
+		{
+			pending.push_back(reader.u8());
+		}
+	}
+	if (!reader.valid())
+	{
+		return false;
+	}
+	auto bits = pending.begin();
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (PLAYER_RESEARCH &research : asPlayerResList[player])
+		{
+			research.ResearchStatus = (research.ResearchStatus & ~RESBITS_PENDING_ONLY) | (*bits++ & RESBITS_PENDING_ONLY);
+		}
+	}
+	return true;
+}
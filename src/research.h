@@ -135,6 +135,12 @@ bool researchInitVars();
 
 bool researchAvailable(int inc, UDWORD playerID, QUEUE_MODE mode);
 
+/// All topics for which researchAvailable() is true, in order, without checking every topic.
+std::vector<uint16_t> availableResearchList(UDWORD playerID, QUEUE_MODE mode);
+
+/// Must be called after changing the research status of a player, other than with researchResult() or enableResearch().
+void invalidateResearchCandidates(UDWORD playerID);
+
 struct AllyResearch
 {
 	unsigned player;
@@ -155,4 +161,14 @@ enum class BodyClass
 uint32_t getNumBodyClassArmourUpgrades(uint32_t player, BodyClass bodyClass);
 uint32_t getNumBodyClassThermalArmourUpgrades(uint32_t player, BodyClass bodyClass);
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/// Saves and restores the research state of all players, see snapshot.h. The pending status bits, which are not
+/// synchronised, are saved separately by researchSnapshotWriteLocal().
+void researchSnapshotWrite(SnapshotWriter &writer);
+bool researchSnapshotRead(SnapshotReader &reader);
+void researchSnapshotWriteLocal(SnapshotWriter &writer);
+bool researchSnapshotReadLocal(SnapshotReader &reader);
+
 #endif // __INCLUDED_SRC_RESEARCH_H__
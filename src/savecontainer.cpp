@@ -0,0 +1,279 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Single file savegames, see savecontainer.h.
+ */
+
+#include "lib/framework/savebatch.h"
+#include "lib/framework/frame.h"
+#include "lib/framework/physfs_ext.h"
+#include "lib/framework/wztime.h"
+
+#include "savecontainer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <zlib.h>
+
+static const char containerExtension[] = ".wzsave";
+
+bool saveContainerEnabled = false;
+
+static std::mutex containerMountMutex;  ///< The autosave thread also mounts and deletes containers.
+
+static std::string containerPathForFolder(std::string folderPath)
+{
+	while (!folderPath.empty() && folderPath.back() == '/')
+	{
+		folderPath.pop_back();
+	}
+	return folderPath + containerExtension;
+}
+
+static std::string folderPathForGam(std::string const &gamFileName)
+{
+	ASSERT_OR_RETURN(gamFileName, gamFileName.size() > 4, "Bad savegame filename %s", gamFileName.c_str());
+	return gamFileName.substr(0, gamFileName.size() - 4);
+}
+
+/// Containers are always in the write directory.
+static std::string containerRealPath(std::string const &containerPath)
+{
+	std::string realPath = PHYSFS_getWriteDir();
+	const char *separator = PHYSFS_getDirSeparator();
+	realPath += separator;
+	for (char c : containerPath)
+	{
+		if (c == '/')
+		{
+			realPath += separator;
+		}
+		else
+		{
+			realPath += c;
+		}
+	}
+	return realPath;
+}
+
+static bool containerIsMounted(std::string const &realPath)
+{
+	return PHYSFS_getMountPoint(realPath.c_str()) != nullptr;
+}
+
+static void containerMount(std::string const &folderPath)
+{
+	std::string containerPath = containerPathForFolder(folderPath);
+	if (PHYSFS_getWriteDir() == nullptr || !PHYSFS_exists(containerPath.c_str()))
+	{
+		return;
+	}
+	std::string realPath = containerRealPath(containerPath);
+	std::lock_guard<std::mutex> guard(containerMountMutex);
+	// Search paths are sometimes rebuilt from scratch, so check what is actually mounted.
+	if (containerIsMounted(realPath))
+	{
+		return;
+	}
+	if (!PHYSFS_mount(realPath.c_str(), folderPath.c_str(), PHYSFS_APPEND))
+	{
+		debug(LOG_ERROR, "Could not mount savegame %s: %s", realPath.c_str(), WZ_PHYSFS_getLastError());
+	}
+}
+
+static void containerUnmount(std::string const &containerPath)
+{
+	if (PHYSFS_getWriteDir() == nullptr)
+	{
+		return;
+	}
+	std::string realPath = containerRealPath(containerPath);
+	if (containerIsMounted(realPath) && WZ_PHYSFS_unmount(realPath.c_str()) == 0)
+	{
+		debug(LOG_ERROR, "Could not unmount savegame %s: %s", realPath.c_str(), WZ_PHYSFS_getLastError());
+	}
+}
+
+void saveContainerMount(std::string const &gamFileName)
+{
+	containerMount(folderPathForGam(gamFileName));
+}
+
+void saveContainerMountAll(std::string const &saveDirectory)
+{
+	std::string directory = saveDirectory;
+	if (!directory.empty() && directory.back() != '/')
+	{
+		directory += '/';
+	}
+	std::vector<std::string> folderPaths;
+	WZ_PHYSFS_enumerateFiles(directory.c_str(), [&](const char *fileName) -> bool {
+		size_t length = strlen(fileName);
+		if (length > strlen(containerExtension) && strcmp(fileName + length - strlen(containerExtension), containerExtension) == 0)
+		{
+			folderPaths.push_back(directory + std::string(fileName, length - strlen(containerExtension)));
+		}
+		return true;
+	});
+	for (std::string const &folderPath : folderPaths)
+	{
+		containerMount(folderPath);
+	}
+}
+
+void saveContainerDelete(std::string const &saveGameFolderPath)
+{
+	std::string containerPath = containerPathForFolder(saveGameFolderPath);
+	std::lock_guard<std::mutex> guard(containerMountMutex);
+	containerUnmount(containerPath);
+	if (PHYSFS_exists(containerPath.c_str()))
+	{
+		PHYSFS_delete(containerPath.c_str());
+	}
+}
+
+// MARK: - Writing
+
+/// Little-endian, as everything in a zip file.
+static void zipAppend16(std::vector<uint8_t> &data, uint16_t value)
+{
+	data.push_back(uint8_t(value));
+	data.push_back(uint8_t(value >> 8));
+}
+
+static void zipAppend32(std::vector<uint8_t> &data, uint32_t value)
+{
+	zipAppend16(data, uint16_t(value));
+	zipAppend16(data, uint16_t(value >> 16));
+}
+
+/// The header fields shared by the local file header and the central directory, from "version needed" to "extra field length".
+static void zipAppendEntryFields(std::vector<uint8_t> &data, uint16_t method, uint16_t dosTime, uint16_t dosDate, uint32_t crc, uint32_t storedSize, uint32_t size, std::string const &name)
+{
+	zipAppend16(data, 20);      // Version needed, 2.0.
+	zipAppend16(data, 0x0800);  // Names are UTF-8.
+	zipAppend16(data, method);
+	zipAppend16(data, dosTime);
+	zipAppend16(data, dosDate);
+	zipAppend32(data, crc);
+	zipAppend32(data, storedSize);
+	zipAppend32(data, size);
+	zipAppend16(data, static_cast<uint16_t>(name.size()));
+	zipAppend16(data, 0);       // Extra field length.
+}
+
+/// Raw deflate, as used by zip. Returns false if the data doesn't get smaller.
+static bool zipDeflate(const char *data, size_t size, std::vector<uint8_t> &output)
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+	output.resize(deflateBound(&stream, static_cast<uLong>(size)));
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+	stream.avail_in = static_cast<uInt>(size);
+	stream.next_out = output.data();
+	stream.avail_out = static_cast<uInt>(output.size());
+	int result = deflate(&stream, Z_FINISH);
+	output.resize(stream.total_out);
+	deflateEnd(&stream);
+	return result == Z_STREAM_END && output.size() < size;
+}
+
+bool saveContainerWrite(SaveBatch &batch, std::string const &gamFileName, bool compress)
+{
+	std::string folderPath = folderPathForGam(gamFileName) + "/";
+	std::string containerPath = containerPathForFolder(folderPath);
+
+	std::lock_guard<std::mutex> guard(containerMountMutex);
+	containerUnmount(containerPath);  // When overwriting a savegame.
+	PHYSFS_file *fileHandle = PHYSFS_openWrite(containerPath.c_str());
+	if (fileHandle == nullptr)
+	{
+		debug(LOG_ERROR, "Could not open %s for writing: %s", containerPath.c_str(), WZ_PHYSFS_getLastError());
+		return false;
+	}
+	WZ_PHYSFS_SETBUFFER(fileHandle, 65536)//;
+
+	struct tm timeinfo = getLocalTime(time(nullptr));
+	uint16_t dosTime = uint16_t(timeinfo.tm_hour << 11 | timeinfo.tm_min << 5 | timeinfo.tm_sec / 2);
+	uint16_t dosDate = uint16_t(std::max(timeinfo.tm_year - 80, 0) << 9 | (timeinfo.tm_mon + 1) << 5 | timeinfo.tm_mday);
+
+	std::vector<uint8_t> centralDirectory;
+	uint16_t entries = 0;
+	uint32_t offset = 0;
+	bool ok = batch.format(-1, [&](std::string const &fileName, const char *data, size_t size) {
+		ASSERT_OR_RETURN(false, fileName.compare(0, folderPath.size(), folderPath) == 0, "%s is not in savegame %s", fileName.c_str(), folderPath.c_str());
+		std::string name = fileName.substr(folderPath.size());
+
+		std::vector<uint8_t> deflated;
+		bool deflate = compress && zipDeflate(data, size, deflated);
+		uint16_t method = deflate ? 8 : 0;
+		uint32_t storedSize = static_cast<uint32_t>(deflate ? deflated.size() : size);
+		uint32_t crc = static_cast<uint32_t>(crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef *>(data), static_cast<uInt>(size)));
+
+		std::vector<uint8_t> header;
+		zipAppend32(header, 0x04034B50);  // Local file header.
+		zipAppendEntryFields(header, method, dosTime, dosDate, crc, storedSize, static_cast<uint32_t>(size), name);
+		header.insert(header.end(), name.begin(), name.end());
+
+		zipAppend32(centralDirectory, 0x02014B50);  // Central directory file header.
+		zipAppend16(centralDirectory, 20);          // Version made by.
+		zipAppendEntryFields(centralDirectory, method, dosTime, dosDate, crc, storedSize, static_cast<uint32_t>(size), name);
+		zipAppend16(centralDirectory, 0);  // File comment length.
+		zipAppend16(centralDirectory, 0);  // Disk number.
+		zipAppend16(centralDirectory, 0);  // Internal attributes.
+		zipAppend32(centralDirectory, 0);  // External attributes.
+		zipAppend32(centralDirectory, offset);
+		centralDirectory.insert(centralDirectory.end(), name.begin(), name.end());
+		++entries;
+
+		const void *stored = deflate ? static_cast<const void *>(deflated.data()) : static_cast<const void *>(data);
+		offset += static_cast<uint32_t>(header.size()) + storedSize;
+		return WZ_PHYSFS_writeBytes(fileHandle, header.data(), static_cast<PHYSFS_uint32>(header.size())) == static_cast<PHYSFS_sint64>(header.size())
+		    && WZ_PHYSFS_writeBytes(fileHandle, stored, storedSize) == static_cast<PHYSFS_sint64>(storedSize);
+	});
+
+	std::vector<uint8_t> end = std::move(centralDirectory);
+	uint32_t centralDirectorySize = static_cast<uint32_t>(end.size());
+	zipAppend32(end, 0x06054B50);  // End of central directory.
+	zipAppend16(end, 0);  // Disk number.
+	zipAppend16(end, 0);  // Disk with the central directory.
+	zipAppend16(end, entries);
+	zipAppend16(end, entries);
+	zipAppend32(end, centralDirectorySize);
+	zipAppend32(end, offset);
+	zipAppend16(end, 0);  // Comment length.
+	ok = WZ_PHYSFS_writeBytes(fileHandle, end.data(), static_cast<PHYSFS_uint32>(end.size())) == static_cast<PHYSFS_sint64>(end.size()) && ok;
+
+	if (!PHYSFS_close(fileHandle))
+	{
+		debug(LOG_ERROR, "Error closing %s: %s", containerPath.c_str(), WZ_PHYSFS_getLastError());
+		ok = false;
+	}
+	if (!ok)
+	{
+		debug(LOG_ERROR, "Failed to write savegame %s", containerPath.c_str());
+	}
+	return ok;
+}
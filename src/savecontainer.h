@@ -0,0 +1,44 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Single file savegames.
+ *
+ *  A savegame container holds all the files of a savegame directory "name/" in a single zip file, "name.wzsave", next
+ *  to where the directory would be. The JSON files are stored without indentation, and compressed unless that doesn't
+ *  make them smaller. The container is mounted in place of the directory, so loading, listing and deleting savegames
+ *  works the same for both. Any zip tool converts between the two.
+ */
+
+#ifndef __INCLUDED_SRC_SAVECONTAINER_H__
+#define __INCLUDED_SRC_SAVECONTAINER_H__
+
+#include <string>
+
+class SaveBatch;
+
+extern bool saveContainerEnabled;  ///< Save new games as containers, instead of directories.
+
+/// Writes the files of the savegame gamFileName ("path/name.gam"), collected in batch, as a container. Safe to call from any thread.
+bool saveContainerWrite(SaveBatch &batch, std::string const &gamFileName, bool compress = true);
+
+void saveContainerMount(std::string const &gamFileName);       ///< Mounts the container of the savegame, if there is one.
+void saveContainerMountAll(std::string const &saveDirectory);  ///< Mounts all containers in the directory, so they are listed as savegames.
+void saveContainerDelete(std::string const &saveGameFolderPath);  ///< Unmounts and deletes the container of the savegame folder, if there is one.
+
+#endif // __INCLUDED_SRC_SAVECONTAINER_H__
@@ -561,6 +561,25 @@ bool readScoreData(const char *fileName)
 	return true;
 }
 
+// NOTE: This duplicates the logic in rules.js - checkEndConditions()
+bool playerCantDoAnything(unsigned player)
+{
+	ASSERT_OR_RETURN(true, player < MAX_PLAYERS, "Invalid player: %u", player);
+	if (apsDroidLists[player] != nullptr)
+	{
+		return false;
+	}
+	for (STRUCTURE *psStruct = apsStructLists[player]; psStruct; psStruct = psStruct->psNext)
+	{
+		if (psStruct->status == SS_BUILT && psStruct->died == 0
+		    && (psStruct->pStructureType->type == REF_FACTORY || psStruct->pStructureType->type == REF_CYBORG_FACTORY))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 void stdOutGameSummary(UDWORD realTimeThrottleSeconds, bool flush_output /* = true */)
 {
 	static UDWORD lastOutputRealTime = 0;
@@ -587,7 +606,6 @@ void stdOutGameSummary(UDWORD realTimeThrottleSeconds, bool flush_output /* = tr
 			uint32_t numStructs = 0;
 			uint32_t numFactories = 0;
 			uint32_t numResearch = 0;
-			uint32_t numFactoriesThatCanProduceConstructionUnits = 0;
 			for (STRUCTURE *psStruct = apsStructLists[n]; psStruct; psStruct = psStruct->psNext, numStructs++)
 			{
 				if (psStruct->status != SS_BUILT || psStruct->died != 0)
@@ -597,11 +615,6 @@ void stdOutGameSummary(UDWORD realTimeThrottleSeconds, bool flush_output /* = tr
 				if (StructIsFactory(psStruct))
 				{
 					numFactories++;
-					if (psStruct->pStructureType->type == REF_FACTORY ||
-						psStruct->pStructureType->type == REF_CYBORG_FACTORY)
-					{
-						numFactoriesThatCanProduceConstructionUnits++;
-					}
 				}
 				else if (psStruct->pStructureType->type == REF_RESEARCH)
 				{
@@ -609,9 +622,7 @@ void stdOutGameSummary(UDWORD realTimeThrottleSeconds, bool flush_output /* = tr
 				}
 			}
 			std::string structInfoString = std::to_string(numStructs) + " (" + std::to_string(numFactories) + "/" + std::to_string(numResearch) + ")";
-			// NOTE: This duplicates the logic in rules.js - checkEndConditions()
-			const bool playerCantDoAnything = (numFactoriesThatCanProduceConstructionUnits == 0) && (numUnits == 0);
-			const char * deadStatus = playerCantDoAnything ? "x" : "";
+			const char * deadStatus = playerCantDoAnything(n) ? "x" : "";
 			fprintf(stdout, "%2u | %11.11s | %10" PRIi64 " | %12" PRIi32 " | %13.13s | %11" PRIi32 " | %7" PRIi32 " | %s\n", n, NetPlay.players[n].name, getExtractedPower(n), unitsKilled, structInfoString.c_str(), numUnits, getPower(n), deadStatus);
 		}
 	}
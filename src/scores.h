@@ -122,5 +122,6 @@ bool readScoreData(const char *fileName);
 bool writeScoreData(const char *fileName);
 
 void stdOutGameSummary(UDWORD realTimeThrottleSeconds = 5, bool flush_output = true);
+bool playerCantDoAnything(unsigned player);  ///< No units and no factory that can produce construction units.
 
 #endif // __INCLUDED_SRC_SCORES_H__
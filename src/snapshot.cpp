@@ -0,0 +1,2018 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  In-memory binary snapshots of the simulation state, see snapshot.h.
+ */
+
+#include "lib/framework/frame.h"
+#include "lib/framework/crc.h"
+#include "lib/gamelib/gtime.h"
+#include "lib/netplay/netplay.h"
+#include "lib/netplay/netreplay.h"
+
+#include "snapshot.h"
+#include "ai.h"
+#include "cmddroid.h"
+#include "component.h"
+#include "droid.h"
+#include "feature.h"
+#include "fpath.h"
+#include "group.h"
+#include "hci.h"
+#include "input/keyconfig.h"
+#include "keybind.h"
+#include "loop.h"
+#include "map.h"
+#include "mapgrid.h"
+#include "message.h"
+#include "mission.h"
+#include "objects.h"
+#include "objmem.h"
+#include "power.h"
+#include "projectile.h"
+#include "qtscript.h"
+#include "random.h"
+#include "research.h"
+#include "stats.h"
+#include "structure.h"
+#include "template.h"
+#include "terrain.h"
+#include "visibility.h"
+#include "warcam.h"
+#include "wrappers.h"
+#include "wzapi.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+extern uint32_t synchObjID;  // objmem.cpp
+
+#define SNAPSHOT_TAG(a, b, c, d) (uint32_t(a) << 24 | uint32_t(b) << 16 | uint32_t(c) << 8 | uint32_t(d))
+
+static const uint32_t snapshotTagRandom      = SNAPSHOT_TAG('R', 'A', 'N', 'D');
+static const uint32_t snapshotTagMap         = SNAPSHOT_TAG('M', 'A', 'P', ' ');
+static const uint32_t snapshotTagAux         = SNAPSHOT_TAG('A', 'U', 'X', ' ');
+static const uint32_t snapshotTagPower       = SNAPSHOT_TAG('P', 'O', 'W', 'R');
+static const uint32_t snapshotTagObjects     = SNAPSHOT_TAG('O', 'B', 'J', 'S');
+static const uint32_t snapshotTagVisibility  = SNAPSHOT_TAG('V', 'I', 'S', ' ');
+static const uint32_t snapshotTagPlayers     = SNAPSHOT_TAG('P', 'L', 'Y', 'R');
+static const uint32_t snapshotTagResearch    = SNAPSHOT_TAG('R', 'S', 'C', 'H');
+static const uint32_t snapshotTagStats       = SNAPSHOT_TAG('S', 'T', 'A', 'T');
+static const uint32_t snapshotTagStructures  = SNAPSHOT_TAG('S', 'T', 'R', 'C');
+static const uint32_t snapshotTagUpgrades    = SNAPSHOT_TAG('U', 'P', 'G', 'R');
+static const uint32_t snapshotTagPaths       = SNAPSHOT_TAG('P', 'A', 'T', 'H');
+static const uint32_t snapshotTagProjectiles = SNAPSHOT_TAG('P', 'R', 'O', 'J');
+static const uint32_t snapshotTagScripts     = SNAPSHOT_TAG('S', 'C', 'R', 'P');  ///< Not synchronised, see snapshotSynchronisedHash().
+static const uint32_t snapshotTagLocal       = SNAPSHOT_TAG('L', 'O', 'C', 'L');  ///< Not synchronised, see snapshotSynchronisedHash().
+static const size_t snapshotNumTags = 15;
+
+struct SnapshotSection
+{
+	uint8_t const *data;
+	size_t size;
+};
+
+typedef std::map<uint32_t, SnapshotSection> SnapshotSections;
+
+static std::string snapshotTagName(uint32_t tag)
+{
+	char name[5] = {char(tag >> 24), char(tag >> 16), char(tag >> 8), char(tag), '\0'};
+	return name;
+}
+
+/// Writes a section, filled in by writeContents.
+template<typename Fn>
+static void snapshotWriteSection(std::vector<uint8_t> &data, uint32_t tag, Fn writeContents)
+{
+	SnapshotWriter writer(data);
+	writer.u32(tag);
+	size_t sizePos = data.size();
+	writer.u32(0);
+	writeContents(writer);
+	uint32_t size = static_cast<uint32_t>(data.size() - sizePos - 4);
+	for (int n = 0; n < 4; ++n)
+	{
+		data[sizePos + n] = uint8_t(size >> 8 * (3 - n));
+	}
+}
+
+static bool snapshotParseSections(WorldSnapshot const &snapshot, SnapshotSections &sections)
+{
+	uint8_t const *data = snapshot.data.data();
+	size_t size = snapshot.data.size();
+	size_t pos = 0;
+	while (pos != size)
+	{
+		SnapshotReader reader(data + pos, size - pos);
+		uint32_t tag = reader.u32();
+		uint32_t sectionSize = reader.u32();
+		if (!reader.valid() || sectionSize > size - pos - 8)
+		{
+			return false;
+		}
+		sections[tag] = SnapshotSection{data + pos + 8, sectionSize};
+		pos += 8 + sectionSize;
+	}
+	return true;
+}
+
+static void snapshotWriteMap(SnapshotWriter &writer)
+{
+	writer.i32(mapWidth);
+	writer.i32(mapHeight);
+	for (int i = 0; i < mapWidth * mapHeight; ++i)
+	{
+		MAPTILE const &tile = psMapTiles[i];
+		writer.u8(tile.tileInfoBits);
+		writer.u16(tile.tileExploredBits);
+		writer.u16(tile.sensorBits);
+		writer.u16(tile.jammerBits);
+		writer.bytes(tile.watchers, MAX_PLAYERS);
+		writer.bytes(tile.sensors, MAX_PLAYERS);
+		writer.bytes(tile.jammers, MAX_PLAYERS);
+		writer.u16(tile.texture);
+		writer.i32(tile.height);
+		writer.u16(tile.limitedContinent);
+		writer.u16(tile.hoverContinent);
+		writer.u8(tile.ground);
+		writer.u16(tile.fireEndTime);
+		writer.i32(tile.waterLevel);
+	}
+}
+
+static bool snapshotReadMap(SnapshotReader &reader)
+{
+	if (reader.i32() != mapWidth || reader.i32() != mapHeight)
+	{
+		return false;
+	}
+	for (int i = 0; i < mapWidth * mapHeight; ++i)
+	{
+		MAPTILE &tile = psMapTiles[i];
+		int32_t oldHeight = tile.height;
+		tile.tileInfoBits = reader.u8();
+		tile.tileExploredBits = reader.u16();
+		tile.sensorBits = reader.u16();
+		tile.jammerBits = reader.u16();
+		reader.bytes(tile.watchers, MAX_PLAYERS);
+		reader.bytes(tile.sensors, MAX_PLAYERS);
+		reader.bytes(tile.jammers, MAX_PLAYERS);
+		tile.texture = reader.u16();
+		tile.height = reader.i32();
+		tile.limitedContinent = reader.u16();
+		tile.hoverContinent = reader.u16();
+		tile.ground = reader.u8();
+		tile.fireEndTime = reader.u16();
+		tile.waterLevel = reader.i32();
+		if (tile.height != oldHeight)
+		{
+			markTileDirty(i % mapWidth, i / mapWidth);
+		}
+	}
+	return reader.valid();
+}
+
+static void snapshotWriteAuxLayer(SnapshotWriter &writer, std::unique_ptr<uint8_t[]> const &layer)
+{
+	writer.u8(layer != nullptr);
+	if (layer != nullptr)
+	{
+		writer.bytes(layer.get(), mapWidth * mapHeight);
+	}
+}
+
+static void snapshotWriteAux(SnapshotWriter &writer)
+{
+	for (auto const &layer : psBlockMap)
+	{
+		snapshotWriteAuxLayer(writer, layer);
+	}
+	for (auto const &layer : psAuxMap)
+	{
+		snapshotWriteAuxLayer(writer, layer);
+	}
+}
+
+static bool snapshotReadAuxLayer(SnapshotReader &reader, std::unique_ptr<uint8_t[]> &layer)
+{
+	bool present = reader.u8() != 0;
+	if (present != (layer != nullptr))
+	{
+		return false;
+	}
+	return !present || reader.bytes(layer.get(), mapWidth * mapHeight);
+}
+
+static bool snapshotReadAux(SnapshotReader &reader)
+{
+	for (auto &layer : psBlockMap)
+	{
+		if (!snapshotReadAuxLayer(reader, layer))
+		{
+			return false;
+		}
+	}
+	for (auto &layer : psAuxMap)
+	{
+		if (!snapshotReadAuxLayer(reader, layer))
+		{
+			return false;
+		}
+	}
+	return reader.valid();
+}
+
+/// Where an object is kept, in the objects section.
+enum SnapshotLocation : uint8_t
+{
+	SNAPSHOT_LISTED,     ///< In the object list of its type.
+	SNAPSHOT_CARGO,      ///< Only in the group of a transporter.
+	SNAPSHOT_DESTROYED,  ///< In psDestroyedObj, until freed at the end of the next tick.
+	SNAPSHOT_LOCATIONS
+};
+
+struct SnapshotEntry
+{
+	SnapshotLocation location;
+	uint8_t list;                      ///< Index of the object list, if listed.
+	BASE_OBJECT *psObj;
+};
+
+/// Everything in the world which objects can refer to, in the order the objects section lists it.
+struct SnapshotWorld
+{
+	std::vector<SnapshotEntry> objects;
+	std::unordered_map<BASE_OBJECT const *, uint32_t> objectIds;
+	std::vector<FLAG_POSITION *> flags;  ///< The flags in apsFlagPosLists, then those only referred to by factories.
+	uint32_t flagsInLists = 0;
+	std::unordered_map<FLAG_POSITION const *, uint32_t> flagIndices;
+	std::vector<DROID_GROUP *> groups;
+	std::unordered_set<DROID_GROUP const *> knownGroups;
+};
+
+static bool snapshotCollectWorld(SnapshotWorld &world, std::string &error)
+{
+	std::unordered_set<uint32_t> ids;
+	auto add = [&](BASE_OBJECT *psObj, SnapshotLocation location, unsigned list) {
+		if (world.objectIds.count(psObj) != 0)
+		{
+			return true;
+		}
+		if (!ids.insert(psObj->id).second)
+		{
+			error = astringf("object id %u is used twice", psObj->id);
+			return false;
+		}
+		world.objects.push_back(SnapshotEntry{location, uint8_t(list), psObj});
+		world.objectIds[psObj] = psObj->id;
+		return true;
+	};
+
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (DROID *psDroid = apsDroidLists[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+		{
+			if (!add(psDroid, SNAPSHOT_LISTED, player))
+			{
+				return false;
+			}
+		}
+		for (STRUCTURE *psStruct = apsStructLists[player]; psStruct != nullptr; psStruct = psStruct->psNext)
+		{
+			if (!add(psStruct, SNAPSHOT_LISTED, player))
+			{
+				return false;
+			}
+		}
+		for (FEATURE *psFeature = apsFeatureLists[player]; psFeature != nullptr; psFeature = psFeature->psNext)
+		{
+			if (!add(psFeature, SNAPSHOT_LISTED, player))
+			{
+				return false;
+			}
+		}
+	}
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (DROID *psDroid = apsDroidLists[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+		{
+			if (!isTransporter(psDroid) || psDroid->psGroup == nullptr)
+			{
+				continue;
+			}
+			for (DROID *psCargo = psDroid->psGroup->psList; psCargo != nullptr && psCargo != psDroid; psCargo = psCargo->psGrpNext)
+			{
+				if (!add(psCargo, SNAPSHOT_CARGO, 0))
+				{
+					return false;
+				}
+			}
+		}
+	}
+	for (BASE_OBJECT *psObj = psDestroyedObj; psObj != nullptr; psObj = psObj->psNext)
+	{
+		if (!add(psObj, SNAPSHOT_DESTROYED, 0))
+		{
+			return false;
+		}
+	}
+
+	auto addFlag = [&world](FLAG_POSITION *psFlag) {
+		if (psFlag != nullptr && world.flagIndices.count(psFlag) == 0)
+		{
+			world.flagIndices[psFlag] = static_cast<uint32_t>(world.flags.size());
+			world.flags.push_back(psFlag);
+		}
+	};
+	for (FLAG_POSITION *psFlag : apsFlagPosLists)
+	{
+		for (; psFlag != nullptr; psFlag = psFlag->psNext)
+		{
+			addFlag(psFlag);
+		}
+	}
+	world.flagsInLists = static_cast<uint32_t>(world.flags.size());
+	for (STRUCTURE *psStruct : apsStructLists)
+	{
+		for (; psStruct != nullptr; psStruct = psStruct->psNext)
+		{
+			if (psStruct->pFunctionality == nullptr)
+			{
+				continue;
+			}
+			if (StructIsFactory(psStruct))
+			{
+				addFlag(psStruct->pFunctionality->factory.psAssemblyPoint);  // Not listed while the factory has a commander.
+			}
+			else if (psStruct->pStructureType->type == REF_REPAIR_FACILITY)
+			{
+				addFlag(psStruct->pFunctionality->repairFacility.psDeliveryPoint);
+			}
+		}
+	}
+
+	world.groups = grpSnapshotGroups();
+	world.knownGroups.insert(world.groups.begin(), world.groups.end());
+	return true;
+}
+
+/// Writes the fields of the objects, which refer to objects, groups and flags by id or index. A reference to something
+/// which is not in the world, such as an object which has already been freed, is written as null.
+class SnapshotObjectsOut : public SnapshotOut
+{
+public:
+	static const bool reading = false;
+
+	SnapshotObjectsOut(SnapshotWriter &writer, SnapshotWorld const &world) : SnapshotOut(writer), world(world) {}
+
+	using SnapshotOut::operator();
+	void operator ()(Vector2i const &v) { writer.i32(v.x); writer.i32(v.y); }
+	void operator ()(Vector3i const &v) { writer.i32(v.x); writer.i32(v.y); writer.i32(v.z); }
+	void operator ()(Rotation const &v) { writer.u16(v.direction); writer.u16(v.pitch); writer.u16(v.roll); }
+	void operator ()(std::bitset<OBJECT_FLAG_COUNT> const &v) { writer.u32(static_cast<uint32_t>(v.to_ulong())); }
+	void operator ()(std::string const &v) { writer.string(v); }
+	template<typename C>
+	void count(C const &container, size_t) { writer.u32(static_cast<uint32_t>(container.size())); }
+
+	template<typename T>
+	void ref(T *const &psObj)
+	{
+		auto it = world.objectIds.find(psObj);
+		writer.u32(it != world.objectIds.end() ? it->second : 0);
+	}
+	void group(DROID_GROUP *const &psGroup)
+	{
+		bool known = world.knownGroups.count(psGroup) != 0;
+		writer.u8(known);
+		if (known)
+		{
+			writer.i32(psGroup->id);
+		}
+	}
+	void flag(FLAG_POSITION *const &psFlag)
+	{
+		auto it = world.flagIndices.find(psFlag);
+		writer.u32(it != world.flagIndices.end() ? it->second : UINT32_MAX);
+	}
+	void droidTemplate(DROID_TEMPLATE *const &psTemplate)
+	{
+		writer.u8(psTemplate != nullptr);
+		if (psTemplate != nullptr)
+		{
+			if (getTemplateFromMultiPlayerID(psTemplate->multiPlayerID) != psTemplate)
+			{
+				error = astringf("template %u can't be found by its id", psTemplate->multiPlayerID);
+			}
+			writer.u32(psTemplate->multiPlayerID);
+		}
+	}
+	void research(RESEARCH *const &psResearch)
+	{
+		writer.u32(psResearch != nullptr ? static_cast<uint32_t>(psResearch - asResearch.data()) : UINT32_MAX);
+	}
+	void structureStats(STRUCTURE_STATS *const &psStats)
+	{
+		writer.u32(psStats != nullptr ? static_cast<uint32_t>(psStats - asStructureStats) : UINT32_MAX);
+	}
+	void imd(iIMDShape *const &imd, std::vector<iIMDShape *> const &candidates)
+	{
+		auto it = std::find(candidates.begin(), candidates.end(), imd);
+		if (imd != nullptr && it == candidates.end())
+		{
+			error = "object has a model which is not one of its stats";
+		}
+		writer.u32(imd != nullptr && it != candidates.end() ? static_cast<uint32_t>(it - candidates.begin()) : UINT32_MAX);
+	}
+
+	std::string error;
+
+private:
+	SnapshotWorld const &world;
+};
+
+/// Objects decoded from a snapshot, not yet linked into the world.
+struct SnapshotDecoded
+{
+	uint32_t synchObjID = 0;
+	std::vector<FLAG_POSITION *> flags;
+	uint32_t flagsInLists = 0;
+	std::vector<DROID_GROUP *> groups;
+	std::map<int, DROID_GROUP *> groupsById;
+	std::vector<SnapshotEntry> objects;
+	std::vector<BASE_OBJECT *> extractors[MAX_PLAYERS];
+	std::vector<BASE_OBJECT *> sensors;
+	std::vector<BASE_OBJECT *> oil;
+	std::vector<std::pair<uint32_t, BASE_OBJECT *>> tileObjects;
+
+	/// Deletes everything, if the snapshot turns out to be corrupt.
+	void free()
+	{
+		for (SnapshotEntry const &entry : objects)
+		{
+			entry.psObj->watchedTiles.clear();  // The tiles don't count these.
+			if (entry.psObj->type == OBJ_DROID)
+			{
+				static_cast<DROID *>(entry.psObj)->psGroup = nullptr;
+			}
+			delete entry.psObj;
+		}
+		for (DROID_GROUP *psGroup : groups)
+		{
+			delete psGroup;
+		}
+		for (FLAG_POSITION *psFlag : flags)
+		{
+			::free(psFlag);
+		}
+		*this = SnapshotDecoded();
+	}
+};
+
+template<typename T> static bool snapshotIsObjectType(BASE_OBJECT const *) { return true; }
+template<> bool snapshotIsObjectType<DROID>(BASE_OBJECT const *psObj) { return psObj->type == OBJ_DROID; }
+template<> bool snapshotIsObjectType<STRUCTURE>(BASE_OBJECT const *psObj) { return psObj->type == OBJ_STRUCTURE; }
+template<> bool snapshotIsObjectType<FEATURE>(BASE_OBJECT const *psObj) { return psObj->type == OBJ_FEATURE; }
+
+/// Reads what SnapshotObjectsOut wrote. References to objects are resolved by resolve(), once all objects are decoded.
+class SnapshotObjectsIn : public SnapshotIn
+{
+public:
+	static const bool reading = true;
+
+	SnapshotObjectsIn(SnapshotReader &reader, SnapshotDecoded const &decoded) : SnapshotIn(reader), decoded(decoded) {}
+
+	using SnapshotIn::operator();
+	void operator ()(Vector2i &v) { v.x = reader.i32(); v.y = reader.i32(); }
+	void operator ()(Vector3i &v) { v.x = reader.i32(); v.y = reader.i32(); v.z = reader.i32(); }
+	void operator ()(Rotation &v) { v.direction = reader.u16(); v.pitch = reader.u16(); v.roll = reader.u16(); }
+	void operator ()(std::bitset<OBJECT_FLAG_COUNT> &v) { v = std::bitset<OBJECT_FLAG_COUNT>(reader.u32()); }
+	void operator ()(std::string &v) { v = reader.string(); }
+	template<typename C>
+	void count(C &container, size_t max)
+	{
+		uint32_t count = reader.u32();
+		if (count > max)
+		{
+			fail("list too long");
+			count = 0;
+		}
+		container.resize(count);
+	}
+
+	template<typename T>
+	void ref(T *&psObj)
+	{
+		uint32_t id = reader.u32();
+		psObj = nullptr;
+		if (id != 0)
+		{
+			T **field = &psObj;
+			fixups.push_back([field, id]() {
+				BASE_OBJECT *psFound = snapshotFindObject(id);
+				if (psFound == nullptr || !snapshotIsObjectType<T>(psFound))
+				{
+					return false;
+				}
+				*field = static_cast<T *>(psFound);
+				return true;
+			});
+		}
+	}
+	void group(DROID_GROUP *&psGroup)
+	{
+		psGroup = nullptr;
+		if (reader.u8() != 0)
+		{
+			auto it = decoded.groupsById.find(reader.i32());
+			if (it == decoded.groupsById.end())
+			{
+				fail("unknown group");
+				return;
+			}
+			psGroup = it->second;
+		}
+	}
+	void flag(FLAG_POSITION *&psFlag)
+	{
+		uint32_t index = reader.u32();
+		psFlag = index < decoded.flags.size() ? decoded.flags[index] : nullptr;
+		if (index != UINT32_MAX && index >= decoded.flags.size())
+		{
+			fail("unknown flag position");
+		}
+	}
+	void droidTemplate(DROID_TEMPLATE *&psTemplate)
+	{
+		psTemplate = nullptr;
+		if (reader.u8() != 0)
+		{
+			uint32_t multiPlayerID = reader.u32();
+			psTemplate = getTemplateFromMultiPlayerID(multiPlayerID);
+			if (psTemplate == nullptr)
+			{
+				fail(astringf("template %u not found", multiPlayerID));
+			}
+		}
+	}
+	void research(RESEARCH *&psResearch)
+	{
+		uint32_t index = reader.u32();
+		psResearch = index < asResearch.size() ? &asResearch[index] : nullptr;
+		if (index != UINT32_MAX && index >= asResearch.size())
+		{
+			fail("unknown research");
+		}
+	}
+	void structureStats(STRUCTURE_STATS *&psStats)
+	{
+		uint32_t index = reader.u32();
+		psStats = index < numStructureStats ? &asStructureStats[index] : nullptr;
+		if (index != UINT32_MAX && index >= numStructureStats)
+		{
+			fail("unknown structure stats");
+		}
+	}
+	void imd(iIMDShape *&imd, std::vector<iIMDShape *> const &candidates)
+	{
+		uint32_t index = reader.u32();
+		imd = index < candidates.size() ? candidates[index] : nullptr;
+		if (index != UINT32_MAX && index >= candidates.size())
+		{
+			fail("unknown model");
+		}
+	}
+
+	void fail(std::string const &why)
+	{
+		if (error.empty())
+		{
+			error = why;
+		}
+	}
+	/// Points the references read so far at the decoded objects.
+	bool resolve()
+	{
+		for (auto const &fixup : fixups)
+		{
+			if (!fixup())
+			{
+				fail("reference to an unknown object");
+				break;
+			}
+		}
+		fixups.clear();
+		return error.empty() && reader.valid();
+	}
+
+	std::string error;
+
+private:
+	SnapshotDecoded const &decoded;
+	std::vector<std::function<bool ()>> fixups;
+};
+
+/// Longest list read from a snapshot, other than those bounded by the map size.
+static const size_t snapshotMaxCount = 1 << 20;
+
+template<typename Io>
+static void snapshotVisitWeapon(Io &io, WEAPON &weapon)
+{
+	io(weapon.nStat);
+	io(weapon.ammo);
+	io(weapon.lastFired);
+	io(weapon.shotsFired);
+	io(weapon.rot);
+	io(weapon.prevRot);
+	io(weapon.usedAmmo);
+	io.enumeration(weapon.origin);
+}
+
+/// The BASE_OBJECT fields, apart from the header written by snapshotWriteObjects(), and those which are local.
+template<typename Io>
+static void snapshotVisitBase(Io &io, BASE_OBJECT &obj)
+{
+	io(obj.pos);
+	io(obj.rot);
+	io(obj.born);
+	io(obj.died);
+	io(obj.time);
+	for (UBYTE &visible : obj.visible)
+	{
+		io(visible);
+	}
+	for (UBYTE &seen : obj.seenThisTick)
+	{
+		io(seen);
+	}
+	io(obj.lastEmission);
+	io.enumeration(obj.lastHitWeapon);
+	io(obj.timeLastHit);
+	io(obj.body);
+	io(obj.periodicalDamageStart);
+	io(obj.periodicalDamage);
+	io.count(obj.watchedTiles, mapWidth * mapHeight);
+	for (TILEPOS &tile : obj.watchedTiles)
+	{
+		io(tile.x);
+		io(tile.y);
+		io(tile.type);
+	}
+	io(obj.timeAnimationStarted);
+	io(obj.animationEvent);
+	io(obj.numWeaps);
+	for (WEAPON &weapon : obj.asWeaps)
+	{
+		snapshotVisitWeapon(io, weapon);
+	}
+	std::bitset<OBJECT_FLAG_COUNT> flags = obj.flags;
+	flags.reset(OBJECT_FLAG_TARGETED);  // Only for display, see snapshotVisitLocal().
+	io(flags);
+	if (Io::reading)
+	{
+		obj.flags = flags;
+	}
+}
+
+template<typename Io>
+static void snapshotVisitOrder(Io &io, DroidOrder &order)
+{
+	io.enumeration(order.type);
+	io(order.pos);
+	io(order.pos2);
+	io(order.direction);
+	io(order.index);
+	io.enumeration(order.rtrType);
+	io.ref(order.psObj);
+	io.structureStats(order.psStats);
+}
+
+template<typename Io>
+static void snapshotVisitDroid(Io &io, DROID &droid)
+{
+	snapshotVisitBase(io, droid);
+	io.enumeration(droid.droidType);
+	for (uint8_t &bits : droid.asBits)
+	{
+		io(bits);
+	}
+	DROID *psDroid = &droid;
+	io.imd(droid.sDisplay.imd, std::vector<iIMDShape *>{droid.asBits[COMP_BODY] < numBodyStats ? BODY_IMD(psDroid, droid.player) : nullptr});
+	io(droid.weight);
+	io(droid.baseSpeed);
+	io(droid.originalBody);
+	io(droid.experience);
+	io(droid.kills);
+	io(droid.lastFrustratedTime);
+	io(droid.resistance);
+	io.group(droid.psGroup);
+	io.ref(droid.psGrpNext);
+	io.ref(droid.psBaseStruct);
+	// Only the synchronised orders, the pending ones are local.
+	io(droid.listSize);
+	if (Io::reading)
+	{
+		droid.asOrderList.resize(std::max(0, std::min<int>(droid.listSize, snapshotMaxCount)));
+		droid.listPendingBegin = droid.asOrderList.size();
+	}
+	for (int i = 0; i < droid.listSize && i < (int)droid.asOrderList.size(); ++i)
+	{
+		snapshotVisitOrder(io, droid.asOrderList[i]);
+	}
+	snapshotVisitOrder(io, droid.order);
+	io(droid.secondaryOrder);
+	io.enumeration(droid.action);
+	io(droid.actionPos);
+	for (BASE_OBJECT *&psTarget : droid.psActionTarget)
+	{
+		io.ref(psTarget);
+	}
+	io.ref(droid.psDecidedTarget);  // Only meaningful if decidedTime == gameTime, so may be stale and written as null.
+	io(droid.decidedTime);
+	io(droid.actionStarted);
+	io(droid.actionPoints);
+	io(droid.expectedDamageDirect);
+	io(droid.expectedDamageIndirect);
+
+	MOVE_CONTROL &move = droid.sMove;
+	io.enumeration(move.Status);
+	io(move.pathIndex);
+	io.count(move.asPath, mapWidth * mapHeight);
+	for (Vector2i &point : move.asPath)
+	{
+		io(point);
+	}
+	io(move.destination);
+	io(move.src);
+	io(move.target);
+	io(move.speed);
+	io(move.moveDir);
+	io(move.bumpDir);
+	io(move.bumpTime);
+	io(move.lastBump);
+	io(move.pauseTime);
+	io(move.bumpPos);
+	io(move.shuffleStart);
+	io(move.iVertSpeed);
+
+	io(droid.prevSpacetime.time);
+	io(droid.prevSpacetime.pos);
+	io(droid.prevSpacetime.rot);
+	io(droid.blockedBits);
+}
+
+template<typename Io>
+static void snapshotVisitFunctionality(Io &io, STRUCTURE_TYPE type, FUNCTIONALITY &functionality)
+{
+	switch (type)
+	{
+	case REF_FACTORY:
+	case REF_CYBORG_FACTORY:
+	case REF_VTOL_FACTORY:
+		{
+			FACTORY &factory = functionality.factory;
+			io(factory.loopsPerformed);
+			io.droidTemplate(factory.psSubject);
+			io(factory.timeStarted);
+			io(factory.buildPointsRemaining);
+			io(factory.timeStartHold);
+			io.flag(factory.psAssemblyPoint);
+			io.ref(factory.psCommander);
+			io(factory.secondaryOrder);
+			break;
+		}
+	case REF_RESEARCH:
+		{
+			RESEARCH_FACILITY &facility = functionality.researchFacility;
+			io.research(facility.psSubject);
+			io.research(facility.psBestTopic);
+			io(facility.timeStartHold);
+			break;
+		}
+	case REF_POWER_GEN:
+		for (STRUCTURE *&psExtractor : functionality.powerGenerator.apResExtractors)
+		{
+			io.ref(psExtractor);
+		}
+		break;
+	case REF_RESOURCE_EXTRACTOR:
+		io.ref(functionality.resourceExtractor.psPowerGen);
+		break;
+	case REF_REPAIR_FACILITY:
+		{
+			REPAIR_FACILITY &facility = functionality.repairFacility;
+			io.ref(facility.psObj);
+			io.flag(facility.psDeliveryPoint);
+			io.group(facility.psGroup);
+			io.enumeration(facility.state);
+			break;
+		}
+	case REF_REARM_PAD:
+		{
+			REARM_PAD &pad = functionality.rearmPad;
+			io(pad.timeStarted);
+			io.ref(pad.psObj);
+			io(pad.timeLastUpdated);
+			break;
+		}
+	case REF_WALL:
+	case REF_GATE:
+		io(functionality.wall.type);
+		break;
+	default:
+		break;
+	}
+}
+
+template<typename Io>
+static void snapshotVisitStructure(Io &io, STRUCTURE &structure)
+{
+	snapshotVisitBase(io, structure);
+	io.imd(structure.sDisplay.imd, structure.pStructureType->pIMD);
+	io.enumeration(structure.status);
+	io(structure.currentBuildPts);
+	io(structure.resistance);
+	io(structure.lastResistance);
+	io(structure.buildRate);
+	io(structure.lastBuildRate);
+	for (BASE_OBJECT *&psTarget : structure.psTarget)
+	{
+		io.ref(psTarget);
+	}
+	io(structure.expectedDamage);
+	io(structure.prevTime);
+	uint32_t foundationDepth;
+	static_assert(sizeof(foundationDepth) == sizeof(structure.foundationDepth), "float is not 32 bit");
+	memcpy(&foundationDepth, &structure.foundationDepth, sizeof(foundationDepth));
+	io(foundationDepth);
+	memcpy(&structure.foundationDepth, &foundationDepth, sizeof(foundationDepth));
+	io(structure.capacity);
+	io.enumeration(structure.state);
+	io(structure.lastStateTime);
+	io.imd(structure.prebuiltImd, structure.pStructureType->pIMD);
+	io(structure.asleep);
+
+	bool hasFunctionality = structure.pFunctionality != nullptr;
+	io(hasFunctionality);
+	if (Io::reading && hasFunctionality)
+	{
+		structure.pFunctionality = (FUNCTIONALITY *)calloc(1, sizeof(*structure.pFunctionality));
+	}
+	if (hasFunctionality)
+	{
+		snapshotVisitFunctionality(io, structure.pStructureType->type, *structure.pFunctionality);
+	}
+}
+
+template<typename Io>
+static void snapshotVisitFeature(Io &io, FEATURE &feature)
+{
+	snapshotVisitBase(io, feature);
+	io.imd(feature.sDisplay.imd, std::vector<iIMDShape *>{feature.psStats->psImd});
+}
+
+template<typename Io>
+static void snapshotVisitFlag(Io &io, FLAG_POSITION &flag)
+{
+	io.enumeration(flag.type);
+	io(flag.player);
+	io(flag.coords);
+	io(flag.factoryInc);
+	io(flag.factoryType);
+}
+
+template<typename Io>
+static void snapshotVisitGroup(Io &io, DROID_GROUP &group)
+{
+	io.enumeration(group.type);
+	io(group.refCount);
+	io.ref(group.psList);
+	io.ref(group.psCommander);
+}
+
+/// Writes the ids of the objects in a list linked by psNextFunc.
+template<typename OBJECT>
+static void snapshotWriteFunctionList(SnapshotObjectsOut &io, OBJECT *psList)
+{
+	std::vector<BASE_OBJECT *> objects;
+	for (BASE_OBJECT *psObj = psList; psObj != nullptr; psObj = psObj->psNextFunc)
+	{
+		objects.push_back(psObj);
+	}
+	io.count(objects, snapshotMaxCount);
+	for (BASE_OBJECT *&psObj : objects)
+	{
+		io.ref(psObj);
+	}
+}
+
+static void snapshotWriteObjects(SnapshotWriter &writer, SnapshotWorld const &world, std::string &error)
+{
+	SnapshotObjectsOut io(writer, world);
+	writer.u32(synchObjID);
+
+	writer.u32(static_cast<uint32_t>(world.flags.size()));
+	writer.u32(world.flagsInLists);
+	for (FLAG_POSITION *psFlag : world.flags)
+	{
+		snapshotVisitFlag(io, *psFlag);
+	}
+	writer.u32(static_cast<uint32_t>(world.groups.size()));
+	for (DROID_GROUP *psGroup : world.groups)
+	{
+		writer.i32(psGroup->id);
+		snapshotVisitGroup(io, *psGroup);
+	}
+
+	writer.u32(static_cast<uint32_t>(world.objects.size()));
+	for (SnapshotEntry const &entry : world.objects)
+	{
+		BASE_OBJECT *psObj = entry.psObj;
+		writer.u8(entry.location);
+		writer.u8(entry.list);
+		writer.u8(psObj->type);
+		writer.u32(psObj->id);
+		writer.u8(psObj->player);
+		switch (psObj->type)
+		{
+		case OBJ_DROID:
+			snapshotVisitDroid(io, *static_cast<DROID *>(psObj));
+			break;
+		case OBJ_STRUCTURE:
+			writer.u32(static_cast<uint32_t>(static_cast<STRUCTURE *>(psObj)->pStructureType - asStructureStats));
+			snapshotVisitStructure(io, *static_cast<STRUCTURE *>(psObj));
+			break;
+		case OBJ_FEATURE:
+			writer.u32(static_cast<uint32_t>(static_cast<FEATURE *>(psObj)->psStats - asFeatureStats));
+			snapshotVisitFeature(io, *static_cast<FEATURE *>(psObj));
+			break;
+		default:
+			io.error = astringf("object %u has unknown type %d", psObj->id, psObj->type);
+			break;
+		}
+	}
+
+	for (STRUCTURE *psList : apsExtractorLists)
+	{
+		snapshotWriteFunctionList(io, psList);
+	}
+	snapshotWriteFunctionList(io, apsSensorList[0]);
+	snapshotWriteFunctionList(io, apsOilList[0]);
+
+	std::vector<uint32_t> tiles;
+	for (int i = 0; i < mapWidth * mapHeight; ++i)
+	{
+		if (psMapTiles[i].psObject != nullptr)
+		{
+			tiles.push_back(i);
+		}
+	}
+	writer.u32(static_cast<uint32_t>(tiles.size()));
+	for (uint32_t i : tiles)
+	{
+		writer.u32(i);
+		io.ref(psMapTiles[i].psObject);
+	}
+	if (!io.error.empty())
+	{
+		error = io.error;
+	}
+}
+
+static bool snapshotReadFunctionList(SnapshotReader &reader, bool (*isType)(BASE_OBJECT const *), std::vector<BASE_OBJECT *> &objects)
+{
+	uint32_t count = reader.u32();
+	for (uint32_t n = 0; n < count && reader.valid(); ++n)
+	{
+		BASE_OBJECT *psObj = snapshotFindObject(reader.u32());
+		if (psObj == nullptr || !isType(psObj))
+		{
+			return false;
+		}
+		objects.push_back(psObj);
+	}
+	return reader.valid();
+}
+
+static std::unordered_map<uint32_t, BASE_OBJECT *> snapshotObjectsById;
+
+BASE_OBJECT *snapshotFindObject(uint32_t id)
+{
+	auto it = snapshotObjectsById.find(id);
+	return it != snapshotObjectsById.end() ? it->second : nullptr;
+}
+
+/// Decodes the objects section into new objects, which are not linked into the world, and can be found with
+/// snapshotFindObject().
+static bool snapshotReadObjects(SnapshotReader &reader, SnapshotDecoded &decoded, std::string &error)
+{
+	SnapshotObjectsIn io(reader, decoded);
+	decoded.synchObjID = reader.u32();
+
+	uint32_t numFlags = reader.u32();
+	decoded.flagsInLists = reader.u32();
+	for (uint32_t n = 0; n < numFlags && reader.valid(); ++n)
+	{
+		FLAG_POSITION *psFlag = (FLAG_POSITION *)calloc(1, sizeof(*psFlag));
+		decoded.flags.push_back(psFlag);
+		snapshotVisitFlag(io, *psFlag);
+		if (psFlag->player >= MAX_PLAYERS)
+		{
+			io.fail("flag position of an invalid player");
+		}
+	}
+	if (decoded.flagsInLists > decoded.flags.size())
+	{
+		io.fail("corrupt flag positions");
+	}
+	uint32_t numGroups = reader.u32();
+	for (uint32_t n = 0; n < numGroups && reader.valid(); ++n)
+	{
+		DROID_GROUP *psGroup = new DROID_GROUP;
+		decoded.groups.push_back(psGroup);
+		psGroup->id = reader.i32();
+		if (!decoded.groupsById.emplace(psGroup->id, psGroup).second)
+		{
+			io.fail("group id is used twice");
+		}
+		snapshotVisitGroup(io, *psGroup);
+	}
+
+	uint32_t numObjects = reader.u32();
+	for (uint32_t n = 0; n < numObjects && reader.valid() && io.error.empty(); ++n)
+	{
+		SnapshotLocation location = static_cast<SnapshotLocation>(reader.u8());
+		uint8_t list = reader.u8();
+		OBJECT_TYPE type = static_cast<OBJECT_TYPE>(reader.u8());
+		uint32_t id = reader.u32();
+		uint8_t player = reader.u8();
+		if (location >= SNAPSHOT_LOCATIONS || list >= MAX_PLAYERS || (type != OBJ_FEATURE && player >= MAX_PLAYERS) || id == 0)
+		{
+			io.fail("corrupt object header");
+			break;
+		}
+		BASE_OBJECT *psObj = nullptr;
+		switch (type)
+		{
+		case OBJ_DROID:
+			{
+				DROID *psDroid = new DROID(id, player);
+				psObj = psDroid;
+				decoded.objects.push_back(SnapshotEntry{location, list, psObj});
+				snapshotVisitDroid(io, *psDroid);
+				break;
+			}
+		case OBJ_STRUCTURE:
+			{
+				uint32_t stats = reader.u32();
+				if (stats >= numStructureStats)
+				{
+					io.fail("unknown structure stats");
+					break;
+				}
+				STRUCTURE *psStruct = new STRUCTURE(id, player);
+				psStruct->pStructureType = &asStructureStats[stats];
+				psObj = psStruct;
+				decoded.objects.push_back(SnapshotEntry{location, list, psObj});
+				snapshotVisitStructure(io, *psStruct);
+				break;
+			}
+		case OBJ_FEATURE:
+			{
+				uint32_t stats = reader.u32();
+				if (stats >= numFeatureStats)
+				{
+					io.fail("unknown feature stats");
+					break;
+				}
+				FEATURE *psFeature = new FEATURE(id, &asFeatureStats[stats]);
+				psFeature->player = player;
+				psObj = psFeature;
+				decoded.objects.push_back(SnapshotEntry{location, list, psObj});
+				snapshotVisitFeature(io, *psFeature);
+				break;
+			}
+		default:
+			io.fail("unknown object type");
+			break;
+		}
+		if (psObj != nullptr && !snapshotObjectsById.emplace(id, psObj).second)
+		{
+			io.fail(astringf("object id %u is used twice", id));
+		}
+	}
+	if (!io.resolve())
+	{
+		error = !io.error.empty() ? io.error : "truncated";
+		return false;
+	}
+
+	bool listsOk = true;
+	for (auto &extractors : decoded.extractors)
+	{
+		listsOk = listsOk && snapshotReadFunctionList(reader, snapshotIsObjectType<STRUCTURE>, extractors);
+	}
+	listsOk = listsOk && snapshotReadFunctionList(reader, snapshotIsObjectType<BASE_OBJECT>, decoded.sensors);
+	listsOk = listsOk && snapshotReadFunctionList(reader, snapshotIsObjectType<FEATURE>, decoded.oil);
+	if (!listsOk)
+	{
+		error = "corrupt function lists";
+		return false;
+	}
+
+	uint32_t numTiles = reader.u32();
+	for (uint32_t n = 0; n < numTiles && reader.valid(); ++n)
+	{
+		uint32_t i = reader.u32();
+		uint32_t id = reader.u32();
+		BASE_OBJECT *psObj = id != 0 ? snapshotFindObject(id) : nullptr;
+		if (i >= static_cast<uint32_t>(mapWidth * mapHeight) || (id != 0 && psObj == nullptr))
+		{
+			error = "corrupt tile objects";
+			return false;
+		}
+		decoded.tileObjects.emplace_back(i, psObj);
+	}
+	if (!reader.valid())
+	{
+		error = "truncated";
+		return false;
+	}
+	return true;
+}
+
+/// The state of an object which is not synchronised, or only meaningful for selectedPlayer.
+template<typename Io>
+static void snapshotVisitLocal(Io &io, BASE_OBJECT &obj)
+{
+	io(obj.selected);
+	io(obj.group);
+	bool targeted = obj.flags.test(OBJECT_FLAG_TARGETED);
+	io(targeted);
+	if (Io::reading)
+	{
+		obj.flags.set(OBJECT_FLAG_TARGETED, targeted);
+	}
+
+	if (obj.type == OBJ_DROID)
+	{
+		DROID &droid = static_cast<DROID &>(obj);
+		std::string name = droid.aName;
+		io(name);
+		if (Io::reading)
+		{
+			sstrcpy(droid.aName, name.c_str());
+		}
+		// The orders after the synchronised ones.
+		size_t synchronised = std::min<size_t>(std::max(droid.listSize, 0), droid.asOrderList.size());
+		uint32_t numPending = static_cast<uint32_t>(droid.asOrderList.size() - synchronised);
+		io(numPending);
+		if (Io::reading)
+		{
+			droid.asOrderList.resize(synchronised + std::min<size_t>(numPending, snapshotMaxCount));
+		}
+		for (size_t i = synchronised; i < droid.asOrderList.size(); ++i)
+		{
+			snapshotVisitOrder(io, droid.asOrderList[i]);
+		}
+		io(droid.listPendingBegin);
+		io(droid.secondaryOrderPending);
+		io(droid.secondaryOrderPendingCount);
+	}
+	else if (obj.type == OBJ_STRUCTURE && static_cast<STRUCTURE &>(obj).pFunctionality != nullptr)
+	{
+		STRUCTURE &structure = static_cast<STRUCTURE &>(obj);
+		switch (structure.pStructureType->type)
+		{
+		case REF_FACTORY:
+		case REF_CYBORG_FACTORY:
+		case REF_VTOL_FACTORY:
+			{
+				FACTORY &factory = structure.pFunctionality->factory;
+				io(factory.productionLoops);
+				io.droidTemplate(factory.psSubjectPending);
+				io.enumeration(factory.statusPending);
+				io(factory.pendingCount);
+				break;
+			}
+		case REF_RESEARCH:
+			{
+				RESEARCH_FACILITY &facility = structure.pFunctionality->researchFacility;
+				io.research(facility.psSubjectPending);
+				io.enumeration(facility.statusPending);
+				io(facility.pendingCount);
+				break;
+			}
+		default:
+			break;
+		}
+	}
+}
+
+template<typename Io>
+static void snapshotVisitProductionRuns(Io &io)
+{
+	io(productionPlayer);
+	for (std::vector<ProductionRun> &runs : asProductionRun)
+	{
+		io.count(runs, snapshotMaxCount);
+		for (ProductionRun &run : runs)
+		{
+			io.count(run, snapshotMaxCount);
+			for (ProductionRunEntry &entry : run)
+			{
+				io(entry.quantity);
+				io(entry.built);
+				io.droidTemplate(entry.psTemplate);
+			}
+		}
+	}
+}
+
+static void snapshotWriteLocal(SnapshotWriter &writer, SnapshotWorld const &world, std::string &error)
+{
+	SnapshotObjectsOut io(writer, world);
+	writer.u32(static_cast<uint32_t>(world.objects.size()));
+	for (SnapshotEntry const &entry : world.objects)
+	{
+		snapshotVisitLocal(io, *entry.psObj);
+	}
+	for (FLAG_POSITION *psFlag : world.flags)
+	{
+		io(psFlag->selected);
+	}
+	snapshotVisitProductionRuns(io);
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		DROID *psDesignator = cmdDroidGetDesignator(player);
+		io.ref(psDesignator);
+	}
+	projSnapshotWriteLocal(writer);
+	researchSnapshotWriteLocal(writer);
+	if (!io.error.empty())
+	{
+		error = io.error;
+	}
+}
+
+static bool snapshotReadLocal(SnapshotReader &reader, SnapshotDecoded &decoded)
+{
+	SnapshotObjectsIn io(reader, decoded);
+	if (reader.u32() != decoded.objects.size())
+	{
+		return false;
+	}
+	for (SnapshotEntry const &entry : decoded.objects)
+	{
+		snapshotVisitLocal(io, *entry.psObj);
+	}
+	for (FLAG_POSITION *psFlag : decoded.flags)
+	{
+		io(psFlag->selected);
+	}
+	snapshotVisitProductionRuns(io);
+	DROID *designators[MAX_PLAYERS];
+	for (DROID *&psDesignator : designators)
+	{
+		io.ref(psDesignator);
+	}
+	if (!io.resolve())
+	{
+		debug(LOG_ERROR, "Corrupt local state in snapshot: %s", io.error.c_str());
+		return false;
+	}
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		if (designators[player] != nullptr)
+		{
+			cmdDroidSetDesignator(designators[player]);
+		}
+		else
+		{
+			cmdDroidClearDesignator(player);
+		}
+	}
+	return projSnapshotReadLocal(reader) && researchSnapshotReadLocal(reader);
+}
+
+/// Fails while part of the state is kept in the mission or limbo lists, which snapshots don't store.
+static bool snapshotWorldIsStorable(std::string &why)
+{
+	if (missionIsOffworld())
+	{
+		why = "offworld";
+		return false;
+	}
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		if (mission.apsDroidLists[player] != nullptr || mission.apsStructLists[player] != nullptr || mission.apsFeatureLists[player] != nullptr || apsLimboDroids[player] != nullptr)
+		{
+			why = "units are on a mission or in limbo";
+			return false;
+		}
+	}
+	return true;
+}
+
+/// Deletes all objects and flag positions, and clears everything else that points to them. The map tiles are left
+/// alone, since they are restored with the map, and the groups are replaced by snapshotLinkWorld().
+static void snapshotReleaseWorld(SnapshotWorld const &world)
+{
+	if (!headlessGameMode())
+	{
+		intResetScreen(true);
+		if (getWarCamStatus())
+		{
+			camToggleStatus();
+		}
+	}
+	keybindShutdown();
+	psLastDroidHit = nullptr;
+	psLastStructHit = nullptr;
+	g_pProjLastAttacker = nullptr;
+	psCBLastResStructure = nullptr;
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		cmdDroidClearDesignator(player);
+	}
+
+	for (SnapshotEntry const &entry : world.objects)
+	{
+		visRemoveVisibilityOffWorld(entry.psObj);
+		if (entry.psObj->type == OBJ_DROID)
+		{
+			static_cast<DROID *>(entry.psObj)->psGroup = nullptr;  // Else transporters would delete their cargo.
+		}
+	}
+	for (SnapshotEntry const &entry : world.objects)
+	{
+		delete entry.psObj;
+	}
+	std::fill(std::begin(apsDroidLists), std::end(apsDroidLists), nullptr);
+	std::fill(std::begin(apsStructLists), std::end(apsStructLists), nullptr);
+	std::fill(std::begin(apsFeatureLists), std::end(apsFeatureLists), nullptr);
+	std::fill(std::begin(apsExtractorLists), std::end(apsExtractorLists), nullptr);
+	apsSensorList[0] = nullptr;
+	apsOilList[0] = nullptr;
+	psDestroyedObj = nullptr;
+
+	for (size_t i = world.flagsInLists; i < world.flags.size(); ++i)
+	{
+		free(world.flags[i]);
+	}
+	freeAllFlagPositions();
+}
+
+template<typename OBJECT>
+static void snapshotAppend(OBJECT *&psList, OBJECT *&psLast, OBJECT *psObj)
+{
+	if (psLast != nullptr)
+	{
+		psLast->psNext = psObj;
+	}
+	else
+	{
+		psList = psObj;
+	}
+	psLast = psObj;
+}
+
+template<typename OBJECT>
+static void snapshotLinkFunctionList(OBJECT *&psList, std::vector<BASE_OBJECT *> const &objects)
+{
+	psList = nullptr;
+	for (auto it = objects.rbegin(); it != objects.rend(); ++it)
+	{
+		(*it)->psNextFunc = psList;
+		psList = static_cast<OBJECT *>(*it);
+	}
+}
+
+/// Puts the decoded objects, groups and flag positions into the world, after snapshotReleaseWorld().
+static void snapshotLinkWorld(SnapshotDecoded const &decoded)
+{
+	DROID *psLastDroid[MAX_PLAYERS] = {};
+	STRUCTURE *psLastStruct[MAX_PLAYERS] = {};
+	FEATURE *psLastFeature[MAX_PLAYERS] = {};
+	BASE_OBJECT *psLastDestroyed = nullptr;
+	for (SnapshotEntry const &entry : decoded.objects)
+	{
+		if (entry.location == SNAPSHOT_DESTROYED)
+		{
+			snapshotAppend(psDestroyedObj, psLastDestroyed, entry.psObj);
+		}
+		else if (entry.location == SNAPSHOT_LISTED)
+		{
+			switch (entry.psObj->type)
+			{
+			case OBJ_DROID:
+				snapshotAppend(apsDroidLists[entry.list], psLastDroid[entry.list], static_cast<DROID *>(entry.psObj));
+				break;
+			case OBJ_STRUCTURE:
+				snapshotAppend(apsStructLists[entry.list], psLastStruct[entry.list], static_cast<STRUCTURE *>(entry.psObj));
+				break;
+			default:
+				snapshotAppend(apsFeatureLists[entry.list], psLastFeature[entry.list], static_cast<FEATURE *>(entry.psObj));
+				break;
+			}
+		}
+	}
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		snapshotLinkFunctionList(apsExtractorLists[player], decoded.extractors[player]);
+	}
+	snapshotLinkFunctionList(apsSensorList[0], decoded.sensors);
+	snapshotLinkFunctionList(apsOilList[0], decoded.oil);
+
+	FLAG_POSITION *psLastFlag[MAX_PLAYERS] = {};
+	for (uint32_t i = 0; i < decoded.flagsInLists; ++i)
+	{
+		FLAG_POSITION *psFlag = decoded.flags[i];
+		snapshotAppend(apsFlagPosLists[psFlag->player], psLastFlag[psFlag->player], psFlag);
+	}
+	grpSnapshotReplace(decoded.groups);
+
+	for (int i = 0; i < mapWidth * mapHeight; ++i)
+	{
+		psMapTiles[i].psObject = nullptr;
+	}
+	for (auto const &tileObject : decoded.tileObjects)
+	{
+		psMapTiles[tileObject.first].psObject = tileObject.second;
+	}
+	synchObjID = decoded.synchObjID;
+}
+
+static void snapshotWritePlayers(SnapshotWriter &writer)
+{
+	for (auto const &row : alliances)
+	{
+		writer.bytes(row, MAX_PLAYER_SLOTS);
+	}
+	for (PlayerMask bits : alliancebits)
+	{
+		writer.u32(bits);
+	}
+	writer.u32(satuplinkbits);
+	droidExperienceSnapshotWrite(writer);
+}
+
+static bool snapshotReadPlayers(SnapshotReader &reader)
+{
+	uint8_t readAlliances[MAX_PLAYER_SLOTS][MAX_PLAYER_SLOTS];
+	PlayerMask readAllianceBits[MAX_PLAYER_SLOTS];
+	for (auto &row : readAlliances)
+	{
+		reader.bytes(row, MAX_PLAYER_SLOTS);
+	}
+	for (PlayerMask &bits : readAllianceBits)
+	{
+		bits = reader.u32();
+	}
+	PlayerMask readSatuplinkBits = reader.u32();
+	if (!reader.valid() || !droidExperienceSnapshotRead(reader))
+	{
+		return false;
+	}
+	memcpy(alliances, readAlliances, sizeof(alliances));
+	memcpy(alliancebits, readAllianceBits, sizeof(alliancebits));
+	satuplinkbits = readSatuplinkBits;
+	return true;
+}
+
+typedef std::function<void (SnapshotWriter &)> SnapshotSectionWriter;
+typedef std::function<bool (SnapshotReader &)> SnapshotSectionReader;
+
+bool snapshotCapture(WorldSnapshot &snapshot)
+{
+	ASSERT_OR_RETURN(false, psMapTiles != nullptr, "No map loaded");
+	std::string why;
+	if (!snapshotWorldIsStorable(why))
+	{
+		debug(LOG_WARNING, "Can't capture a snapshot: %s", why.c_str());
+		return false;
+	}
+	SnapshotWorld world;
+	if (!snapshotCollectWorld(world, why))
+	{
+		ASSERT(false, "Can't capture a snapshot: %s", why.c_str());
+		return false;
+	}
+
+	snapshot.version = WORLD_SNAPSHOT_VERSION;
+	snapshot.gameTime = gameTime;
+	snapshot.data.clear();
+	std::pair<uint32_t, SnapshotSectionWriter> const writers[] = {
+		{snapshotTagRandom, gameRandSnapshotWrite},
+		{snapshotTagMap, snapshotWriteMap},
+		{snapshotTagAux, snapshotWriteAux},
+		{snapshotTagPower, powerSnapshotWrite},
+		{snapshotTagObjects, [&](SnapshotWriter &writer) { snapshotWriteObjects(writer, world, why); }},
+		{snapshotTagVisibility, visSnapshotWrite},
+		{snapshotTagPlayers, snapshotWritePlayers},
+		{snapshotTagResearch, researchSnapshotWrite},
+		{snapshotTagStats, statsSnapshotWrite},
+		{snapshotTagStructures, structureSnapshotWrite},
+		{snapshotTagUpgrades, wzapi::pendingUpgradesSnapshotWrite},
+		{snapshotTagPaths, fpathSnapshotWrite},
+		{snapshotTagProjectiles, projSnapshotWrite},
+		{snapshotTagScripts, scriptSnapshotWrite},
+		{snapshotTagLocal, [&](SnapshotWriter &writer) { snapshotWriteLocal(writer, world, why); }},
+	};
+	for (auto const &writer : writers)
+	{
+		snapshotWriteSection(snapshot.data, writer.first, writer.second);
+	}
+	if (!why.empty())
+	{
+		ASSERT(false, "Can't capture a snapshot: %s", why.c_str());
+		snapshot.data.clear();
+		return false;
+	}
+	return true;
+}
+
+bool snapshotRestore(WorldSnapshot const &snapshot)
+{
+	ASSERT_OR_RETURN(false, psMapTiles != nullptr, "No map loaded");
+	if (snapshot.version != WORLD_SNAPSHOT_VERSION)
+	{
+		debug(LOG_ERROR, "Snapshot version %u, expected %u", snapshot.version, WORLD_SNAPSHOT_VERSION);
+		return false;
+	}
+	SnapshotSections sections;
+	if (!snapshotParseSections(snapshot, sections) || sections.size() != snapshotNumTags)
+	{
+		debug(LOG_ERROR, "Corrupt snapshot");
+		return false;
+	}
+	SnapshotSection const &map = sections[snapshotTagMap];
+	SnapshotReader mapSizeReader(map.data, map.size);
+	if (mapSizeReader.i32() != mapWidth || mapSizeReader.i32() != mapHeight)
+	{
+		debug(LOG_ERROR, "Snapshot is of a different map");
+		return false;
+	}
+	SnapshotSection const &scripts = sections[snapshotTagScripts];
+	SnapshotReader scriptsReader(scripts.data, scripts.size);
+	if (!scriptSnapshotMatches(scriptsReader))
+	{
+		debug(LOG_ERROR, "Different scripts are running than when the snapshot was captured");
+		return false;
+	}
+
+	// Check everything that could fail, before changing anything.
+	std::string why;
+	SnapshotWorld world;
+	if (!snapshotWorldIsStorable(why) || !snapshotCollectWorld(world, why))
+	{
+		debug(LOG_ERROR, "Can't restore a snapshot now: %s", why.c_str());
+		return false;
+	}
+	// Deleting the decoded droids would drop the path-finding results of the current droids with the same ids.
+	std::vector<uint8_t> paths;
+	SnapshotWriter pathsWriter(paths);
+	fpathSnapshotWrite(pathsWriter);
+	SnapshotDecoded decoded;
+	SnapshotSection const &objects = sections[snapshotTagObjects];
+	SnapshotReader objectsReader(objects.data, objects.size);
+	if (!snapshotReadObjects(objectsReader, decoded, why) || !objectsReader.atEnd())
+	{
+		debug(LOG_ERROR, "Corrupt objects in snapshot: %s", why.empty() ? "trailing data" : why.c_str());
+		decoded.free();
+		snapshotObjectsById.clear();
+		SnapshotReader pathsReader(paths.data(), paths.size());
+		fpathSnapshotRead(pathsReader);
+		return false;
+	}
+
+	std::vector<std::pair<MESSAGE *, uint32_t>> messageObjects;
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (MESSAGE *psMsg = apsMessages[player]; psMsg != nullptr; psMsg = psMsg->psNext)
+		{
+			if (psMsg->psObj != nullptr)
+			{
+				auto it = world.objectIds.find(psMsg->psObj);
+				messageObjects.emplace_back(psMsg, it != world.objectIds.end() ? it->second : 0);
+			}
+		}
+	}
+	snapshotReleaseWorld(world);
+	snapshotLinkWorld(decoded);
+
+	std::pair<uint32_t, SnapshotSectionReader> const readers[] = {
+		{snapshotTagRandom, gameRandSnapshotRead},
+		{snapshotTagMap, snapshotReadMap},
+		{snapshotTagAux, snapshotReadAux},
+		{snapshotTagPower, powerSnapshotRead},
+		{snapshotTagVisibility, visSnapshotRead},
+		{snapshotTagPlayers, snapshotReadPlayers},
+		{snapshotTagResearch, researchSnapshotRead},
+		{snapshotTagStats, statsSnapshotRead},
+		{snapshotTagStructures, structureSnapshotRead},
+		{snapshotTagUpgrades, wzapi::pendingUpgradesSnapshotRead},
+		{snapshotTagPaths, fpathSnapshotRead},
+		{snapshotTagProjectiles, projSnapshotRead},
+		{snapshotTagScripts, scriptSnapshotRead},
+		{snapshotTagLocal, [&](SnapshotReader &reader) { return snapshotReadLocal(reader, decoded); }},
+	};
+	bool ok = true;
+	for (auto const &restorer : readers)
+	{
+		SnapshotSection const &section = sections[restorer.first];
+		SnapshotReader reader(section.data, section.size);
+		if (!restorer.second(reader) || !reader.atEnd())
+		{
+			ASSERT(false, "Failed to restore snapshot section %s", snapshotTagName(restorer.first).c_str());
+			ok = false;
+		}
+	}
+
+	mapRestartFireTimers();  // The timer wheel isn't part of the snapshot, rebuild it from the restored tiles.
+	setCurrentStructQuantity(false);
+	resetFactoryNumFlag();
+	std::vector<std::array<UBYTE, MAX_PLAYERS>> seenThisTick;  // Cleared by gridReset(), but part of the snapshot.
+	for (SnapshotEntry const &entry : decoded.objects)
+	{
+		seenThisTick.emplace_back();
+		std::copy(std::begin(entry.psObj->seenThisTick), std::end(entry.psObj->seenThisTick), seenThisTick.back().begin());
+	}
+	gridReset();
+	for (size_t i = 0; i < decoded.objects.size(); ++i)
+	{
+		std::copy(seenThisTick[i].begin(), seenThisTick[i].end(), std::begin(decoded.objects[i].psObj->seenThisTick));
+	}
+	countUpdate(false);
+	for (auto const &messageObject : messageObjects)
+	{
+		messageObject.first->psObj = snapshotFindObject(messageObject.second);
+		if (messageObject.first->psObj == nullptr)
+		{
+			removeMessage(messageObject.first, messageObject.first->player);
+		}
+	}
+	snapshotObjectsById.clear();
+	if (gameTime != snapshot.gameTime)
+	{
+		setGameTime(snapshot.gameTime);
+	}
+	return ok;
+}
+
+struct SnapshotRoundTripState
+{
+	bool running = false;
+	unsigned ticks = 0;
+	unsigned ticksLeft = 0;
+	bool captured = false;
+	WorldSnapshot first;
+	SnapshotRoundTrip result;
+	std::function<void (SnapshotRoundTrip const &)> done;
+};
+
+static SnapshotRoundTripState roundTrip;
+
+void snapshotRoundTripStart(unsigned ticks, std::function<void (SnapshotRoundTrip const &)> done)
+{
+	ASSERT_OR_RETURN(, !roundTrip.running, "Snapshot round trip already running");
+	roundTrip = SnapshotRoundTripState();
+	roundTrip.running = true;
+	roundTrip.ticks = ticks;
+	roundTrip.ticksLeft = ticks;
+	roundTrip.done = std::move(done);
+}
+
+bool snapshotRoundTripIsRunning()
+{
+	return roundTrip.running;
+}
+
+static void snapshotFinishRoundTrip(std::string const &error)
+{
+	roundTrip.result.ok = error.empty();
+	roundTrip.result.error = error;
+	roundTrip.running = false;
+	roundTrip.first = WorldSnapshot();
+	std::function<void (SnapshotRoundTrip const &)> done = std::move(roundTrip.done);
+	done(roundTrip.result);
+}
+
+/// Restores the snapshot, and checks that capturing the restored state gives the same snapshot again.
+static std::string snapshotCheckRestore(WorldSnapshot const &snapshot, char const *name)
+{
+	if (!snapshotRestore(snapshot))
+	{
+		return astringf("restoring the %s snapshot failed", name);
+	}
+	WorldSnapshot check;
+	if (!snapshotCapture(check))
+	{
+		return astringf("capture after restoring the %s snapshot failed", name);
+	}
+	if (snapshotHash(check) != snapshotHash(snapshot))
+	{
+		return astringf("%s snapshot restored differently: %s", name, snapshotDiff(snapshot, check).c_str());
+	}
+	return std::string();
+}
+
+void snapshotUpdateRoundTrip()
+{
+	if (!roundTrip.running)
+	{
+		return;
+	}
+	typedef std::chrono::steady_clock Clock;
+	auto us = [](Clock::duration d) { return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count()); };
+
+	if (!roundTrip.captured)
+	{
+		Clock::time_point start = Clock::now();
+		if (!snapshotCapture(roundTrip.first))
+		{
+			snapshotFinishRoundTrip("capture failed");
+			return;
+		}
+		roundTrip.result.captureUs = us(Clock::now() - start);
+		roundTrip.result.bytes = roundTrip.first.data.size();
+		roundTrip.result.hash = snapshotHash(roundTrip.first);
+		roundTrip.captured = true;
+		return;
+	}
+	if (gameTime < roundTrip.first.gameTime)
+	{
+		snapshotFinishRoundTrip("game restarted");
+		return;
+	}
+	if (roundTrip.ticksLeft > 1)
+	{
+		--roundTrip.ticksLeft;
+		return;
+	}
+
+	// Go back to the first snapshot, then forward to the current state, which must both come back identically.
+	WorldSnapshot second;
+	if (!snapshotCapture(second))
+	{
+		snapshotFinishRoundTrip(astringf("capture after %u ticks failed", roundTrip.ticks));
+		return;
+	}
+	uint32_t queueTimes[MAX_GAMEQUEUE_SLOTS];
+	for (unsigned player = 0; player < MAX_GAMEQUEUE_SLOTS; ++player)
+	{
+		queueTimes[player] = getPlayerGameTime(player);
+	}
+	uint32_t savedDeltaGameTime = deltaGameTime;
+	uint32_t savedGraphicsTime = graphicsTime;
+	uint32_t savedDeltaGraphicsTime = deltaGraphicsTime;
+	float savedGraphicsTimeFraction = graphicsTimeFraction;
+
+	Clock::time_point start = Clock::now();
+	std::string error = snapshotCheckRestore(roundTrip.first, "first");
+	roundTrip.result.restoreUs = us(Clock::now() - start);
+	if (error.empty())
+	{
+		error = snapshotCheckRestore(second, "second");
+	}
+
+	for (unsigned player = 0; player < MAX_GAMEQUEUE_SLOTS; ++player)
+	{
+		setPlayerGameTime(player, queueTimes[player]);
+	}
+	deltaGameTime = savedDeltaGameTime;
+	graphicsTime = savedGraphicsTime;
+	deltaGraphicsTime = savedDeltaGraphicsTime;
+	graphicsTimeFraction = savedGraphicsTimeFraction;
+	snapshotFinishRoundTrip(error);
+}
+
+uint32_t snapshotHash(WorldSnapshot const &snapshot)
+{
+	std::vector<uint8_t> header;
+	SnapshotWriter writer(header);
+	writer.u32(snapshot.version);
+	writer.u32(snapshot.gameTime);
+	uint32_t crc = crcSum(0, header.data(), header.size());
+	return crcSum(crc, snapshot.data.data(), snapshot.data.size());
+}
+
+uint32_t snapshotSynchronisedHash(WorldSnapshot const &snapshot)
+{
+	std::vector<uint8_t> header;
+	SnapshotWriter writer(header);
+	writer.u32(snapshot.version);
+	writer.u32(snapshot.gameTime);
+	uint32_t crc = crcSum(0, header.data(), header.size());
+	SnapshotSections sections;
+	if (!snapshotParseSections(snapshot, sections))
+	{
+		return 0;
+	}
+	for (auto const &section : sections)
+	{
+		if (section.first == snapshotTagScripts || section.first == snapshotTagLocal)
+		{
+			continue;
+		}
+		std::vector<uint8_t> sectionHeader;
+		SnapshotWriter sectionWriter(sectionHeader);
+		sectionWriter.u32(section.first);
+		sectionWriter.u32(static_cast<uint32_t>(section.second.size));
+		crc = crcSum(crc, sectionHeader.data(), sectionHeader.size());
+		crc = crcSum(crc, section.second.data, section.second.size);
+	}
+	return crc;
+}
+
+std::string snapshotDiff(WorldSnapshot const &a, WorldSnapshot const &b)
+{
+	std::string diff;
+	if (a.version != b.version || a.gameTime != b.gameTime)
+	{
+		diff += astringf("header(version %u/%u, gameTime %u/%u) ", a.version, b.version, a.gameTime, b.gameTime);
+	}
+	SnapshotSections sectionsA, sectionsB;
+	if (!snapshotParseSections(a, sectionsA) || !snapshotParseSections(b, sectionsB))
+	{
+		return diff + "corrupt";
+	}
+	for (auto const &sectionA : sectionsA)
+	{
+		auto sectionB = sectionsB.find(sectionA.first);
+		if (sectionB == sectionsB.end())
+		{
+			diff += snapshotTagName(sectionA.first) + "(missing) ";
+			continue;
+		}
+		SnapshotSection const &sa = sectionA.second, &sb = sectionB->second;
+		size_t common = std::min(sa.size, sb.size);
+		size_t firstDifference = std::mismatch(sa.data, sa.data + common, sb.data).first - sa.data;
+		if (firstDifference != common || sa.size != sb.size)
+		{
+			diff += astringf("%s(size %zu/%zu, differs at byte %zu) ", snapshotTagName(sectionA.first).c_str(), sa.size, sb.size, firstDifference);
+		}
+	}
+	for (auto const &sectionB : sectionsB)
+	{
+		if (sectionsA.count(sectionB.first) == 0)
+		{
+			diff += snapshotTagName(sectionB.first) + "(missing) ";
+		}
+	}
+	if (!diff.empty())
+	{
+		diff.pop_back();
+	}
+	return diff;
+}
+
+static uint32_t replayKeyframeLastGameTime = 0;
+static size_t replayNextKeyframe = 0;
+static unsigned replayKeyframesChecked = 0;
+static unsigned replayKeyframesDiverged = 0;
+
+void snapshotResetReplayKeyframes()
+{
+	replayKeyframeLastGameTime = gameTime;
+	replayNextKeyframe = 0;
+	replayKeyframesChecked = 0;
+	replayKeyframesDiverged = 0;
+}
+
+/// A keyframe stores the snapshot, and the times of the game queues, which decide when the following messages are read.
+static void snapshotWriteKeyframe(std::vector<uint8_t> &data, WorldSnapshot const &snapshot)
+{
+	SnapshotWriter writer(data);
+	writer.u32(snapshot.version);
+	writer.u32(snapshot.gameTime);
+	writer.u32(MAX_GAMEQUEUE_SLOTS);
+	for (unsigned player = 0; player < MAX_GAMEQUEUE_SLOTS; ++player)
+	{
+		writer.u32(getPlayerGameTime(player));
+	}
+	writer.blob(snapshot.data);
+}
+
+static bool snapshotReadKeyframe(std::vector<uint8_t> const &data, WorldSnapshot &snapshot, std::vector<uint32_t> &queueTimes)
+{
+	SnapshotReader reader(data.data(), data.size());
+	snapshot.version = reader.u32();
+	snapshot.gameTime = reader.u32();
+	if (snapshot.version != WORLD_SNAPSHOT_VERSION || reader.u32() != MAX_GAMEQUEUE_SLOTS)
+	{
+		return false;
+	}
+	queueTimes.resize(MAX_GAMEQUEUE_SLOTS);
+	for (uint32_t &time : queueTimes)
+	{
+		time = reader.u32();
+	}
+	snapshot.data = reader.blob();
+	return reader.valid() && reader.atEnd();
+}
+
+void snapshotUpdateReplayKeyframes()
+{
+	uint32_t previousGameTime = replayKeyframeLastGameTime;
+	replayKeyframeLastGameTime = gameTime;
+
+	if (!NETisReplay())
+	{
+		if (NETreplaySaveIsActive() && gameTime / SNAPSHOT_REPLAY_KEYFRAME_INTERVAL != previousGameTime / SNAPSHOT_REPLAY_KEYFRAME_INTERVAL)
+		{
+			WorldSnapshot snapshot;
+			if (snapshotCapture(snapshot))
+			{
+				std::vector<uint8_t> keyframe;
+				snapshotWriteKeyframe(keyframe, snapshot);
+				NETreplaySaveKeyframe(gameTime, snapshotSynchronisedHash(snapshot), keyframe);
+			}
+		}
+		return;
+	}
+
+	std::vector<ReplayKeyframe> const &keyframes = NETreplayLoadKeyframes();
+	while (replayNextKeyframe < keyframes.size() && keyframes[replayNextKeyframe].gameTime < gameTime)
+	{
+		++replayNextKeyframe;
+	}
+	if (replayNextKeyframe < keyframes.size() && keyframes[replayNextKeyframe].gameTime == gameTime)
+	{
+		WorldSnapshot snapshot;
+		if (snapshotCapture(snapshot))
+		{
+			++replayKeyframesChecked;
+			if (snapshotSynchronisedHash(snapshot) != keyframes[replayNextKeyframe].stateHash)
+			{
+				++replayKeyframesDiverged;
+				debug(LOG_ERROR, "Replay has diverged from the recorded game by gameTime %u", gameTime);
+			}
+		}
+		++replayNextKeyframe;
+	}
+}
+
+bool snapshotSeekReplay(uint32_t targetGameTime)
+{
+	std::vector<ReplayKeyframe> const &keyframes = NETreplayLoadKeyframes();
+	for (size_t index = keyframes.size(); index-- > 0;)
+	{
+		ReplayKeyframe const &keyframe = keyframes[index];
+		if (keyframe.gameTime > targetGameTime || keyframe.gameTime <= gameTime || keyframe.snapshotPos < 0 || !NETreplayCanSkipToKeyframe(index))
+		{
+			continue;
+		}
+		std::vector<uint8_t> data;
+		WorldSnapshot snapshot;
+		std::vector<uint32_t> queueTimes;
+		if (!NETreplayLoadKeyframeSnapshot(index, data) || !snapshotReadKeyframe(data, snapshot, queueTimes)
+		    || snapshot.gameTime != keyframe.gameTime || snapshotSynchronisedHash(snapshot) != keyframe.stateHash)
+		{
+			debug(LOG_WARNING, "Replay keyframe at gameTime %u is unusable, trying an earlier one", keyframe.gameTime);
+			continue;
+		}
+		if (!snapshotRestore(snapshot))
+		{
+			break;  // Its checks failed before changing anything (it asserts otherwise), so simulate from the start.
+		}
+		NETreplaySkipToKeyframe(index);
+		for (unsigned player = 0; player < MAX_GAMEQUEUE_SLOTS; ++player)
+		{
+			setPlayerGameTime(player, queueTimes[player]);
+		}
+		replayKeyframeLastGameTime = gameTime;
+		replayNextKeyframe = index + 1;
+		debug(LOG_INFO, "Restored replay keyframe at gameTime %u", gameTime);
+		return true;
+	}
+	debug(LOG_INFO, "No usable replay keyframe before gameTime %u, simulating from the start", targetGameTime);
+	return false;
+}
+
+void snapshotGetReplayKeyframeStats(unsigned &checked, unsigned &diverged)
+{
+	checked = replayKeyframesChecked;
+	diverged = replayKeyframesDiverged;
+}
@@ -0,0 +1,219 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  In-memory binary snapshots of the simulation state.
+ *
+ *  A snapshot is a list of sections, one per subsystem, each of which can be hashed and compared separately, which
+ *  helps finding what diverged in a desync. Restoring a snapshot replaces every droid, structure, feature, group and
+ *  flag position, and restores the map, power, research, upgrades, projectiles, path-finding results and the script
+ *  globals, timers and labels. Objects refer to each other, and are referred to by the other sections, by id, and
+ *  templates by their multiplayer id, as in savegames.
+ *
+ *  Not stored: anything offworld (snapshots can't be captured while offworld, or while units are on a mission or in
+ *  limbo), the scores, and script globals which can't be saved in savegames either. The interface is reset when
+ *  restoring, so nothing on screen refers to the deleted objects.
+ */
+
+#ifndef __INCLUDED_SRC_SNAPSHOT_H__
+#define __INCLUDED_SRC_SNAPSHOT_H__
+
+#include "lib/framework/types.h"
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// Increment when changing what is written to any section.
+#define WORLD_SNAPSHOT_VERSION 2
+
+/// Appends big-endian values to a buffer.
+class SnapshotWriter
+{
+public:
+	explicit SnapshotWriter(std::vector<uint8_t> &buffer) : buffer(buffer) {}
+
+	void u8(uint8_t v)   { buffer.push_back(v); }
+	void u16(uint16_t v) { uint8_t b[2] = {uint8_t(v >> 8), uint8_t(v)}; bytes(b, 2); }
+	void u32(uint32_t v) { uint8_t b[4] = {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)}; bytes(b, 4); }
+	void u64(uint64_t v) { u32(uint32_t(v >> 32)); u32(uint32_t(v)); }
+	void i32(int32_t v)  { u32(v); }
+	void i64(int64_t v)  { u64(v); }
+	void bytes(void const *data, size_t size) { buffer.insert(buffer.end(), static_cast<uint8_t const *>(data), static_cast<uint8_t const *>(data) + size); }
+	void string(std::string const &s) { u32(static_cast<uint32_t>(s.size())); bytes(s.data(), s.size()); }
+	void blob(std::vector<uint8_t> const &v) { u32(static_cast<uint32_t>(v.size())); bytes(v.data(), v.size()); }
+
+private:
+	std::vector<uint8_t> &buffer;
+};
+
+/// Reads what SnapshotWriter wrote. Reading past the end returns zeros, and makes valid() false.
+class SnapshotReader
+{
+public:
+	SnapshotReader(uint8_t const *data, size_t size) : data(data), size(size) {}
+
+	uint8_t  u8()  { return have(1) ? data[index++] : 0; }
+	uint16_t u16() { uint16_t v = u8(); return v << 8 | u8(); }
+	uint32_t u32() { uint32_t v = u16(); return v << 16 | u16(); }
+	uint64_t u64() { uint64_t v = u32(); return v << 32 | u32(); }
+	int32_t  i32() { return u32(); }
+	int64_t  i64() { return u64(); }
+	bool bytes(void *out, size_t count) { if (!have(count)) { return false; } memcpy(out, data + index, count); index += count; return true; }
+	std::string string() { uint32_t count = u32(); std::string s; if (have(count)) { s.assign(reinterpret_cast<char const *>(data + index), count); index += count; } return s; }
+	std::vector<uint8_t> blob() { uint32_t count = u32(); std::vector<uint8_t> v; if (have(count)) { v.assign(data + index, data + index + count); index += count; } return v; }
+
+	bool valid() const { return ok; }
+	bool atEnd() const { return index == size; }
+
+private:
+	bool have(size_t count) { ok = ok && count <= size - index; return ok; }
+
+	uint8_t const *data;
+	size_t size;
+	size_t index = 0;
+	bool ok = true;
+};
+
+/// Writes the fields it is called with, so that one template function can describe a layout for writing and reading.
+class SnapshotOut
+{
+public:
+	explicit SnapshotOut(SnapshotWriter &writer) : writer(writer) {}
+
+	void operator ()(bool const &v)     { writer.u8(v); }
+	void operator ()(uint8_t const &v)  { writer.u8(v); }
+	void operator ()(int8_t const &v)   { writer.u8(v); }
+	void operator ()(uint16_t const &v) { writer.u16(v); }
+	void operator ()(int16_t const &v)  { writer.u16(v); }
+	void operator ()(uint32_t const &v) { writer.u32(v); }
+	void operator ()(int32_t const &v)  { writer.i32(v); }
+	void operator ()(uint64_t const &v) { writer.u64(v); }
+	void operator ()(int64_t const &v)  { writer.i64(v); }
+	template<typename E>
+	void enumeration(E const &v) { writer.u32(static_cast<uint32_t>(v)); }
+	template<typename T>
+	void values(std::vector<T> const &v)
+	{
+		writer.u32(static_cast<uint32_t>(v.size()));
+		for (T const &value : v)
+		{
+			(*this)(value);
+		}
+	}
+
+	SnapshotWriter &writer;
+};
+
+/// Reads the fields SnapshotOut wrote. If apply is false, the values are only read, to check that the data is complete.
+class SnapshotIn
+{
+public:
+	explicit SnapshotIn(SnapshotReader &reader, bool apply = true) : reader(reader), apply(apply) {}
+
+	void operator ()(bool &v)     { set(v, reader.u8() != 0); }
+	void operator ()(uint8_t &v)  { set(v, reader.u8()); }
+	void operator ()(int8_t &v)   { set(v, int8_t(reader.u8())); }
+	void operator ()(uint16_t &v) { set(v, reader.u16()); }
+	void operator ()(int16_t &v)  { set(v, int16_t(reader.u16())); }
+	void operator ()(uint32_t &v) { set(v, reader.u32()); }
+	void operator ()(int32_t &v)  { set(v, reader.i32()); }
+	void operator ()(uint64_t &v) { set(v, reader.u64()); }
+	void operator ()(int64_t &v)  { set(v, reader.i64()); }
+	template<typename E>
+	void enumeration(E &v) { set(v, static_cast<E>(reader.u32())); }
+	template<typename T>
+	void values(std::vector<T> &v)
+	{
+		std::vector<T> read;
+		uint32_t count = reader.u32();
+		SnapshotIn in(reader);
+		for (uint32_t n = 0; n < count && reader.valid(); ++n)
+		{
+			read.emplace_back();
+			in(read.back());
+		}
+		set(v, read);
+	}
+
+	SnapshotReader &reader;
+	bool apply;
+
+private:
+	template<typename T, typename V>
+	void set(T &field, V const &value) { if (apply) { field = value; } }
+};
+
+struct BASE_OBJECT;
+
+struct WorldSnapshot
+{
+	uint32_t version = 0;
+	uint32_t gameTime = 0;
+	std::vector<uint8_t> data;  ///< Sections, each a 4 character tag, a 32 bit size and the contents.
+};
+
+/// Captures the current simulation state. Nothing is formatted per object, so this is much faster than saving.
+bool snapshotCapture(WorldSnapshot &snapshot);
+/// Restores a snapshot of the current game, replacing all objects. Fails without changing anything, if the snapshot is
+/// from another version or map, or its objects are corrupt. If a later section turns out to be corrupt, the restore
+/// asserts, and the state is only partly restored.
+bool snapshotRestore(WorldSnapshot const &snapshot);
+/// Finds a restored object by id, for the sections which refer to objects. Only valid during snapshotRestore().
+BASE_OBJECT *snapshotFindObject(uint32_t id);
+
+struct SnapshotRoundTrip
+{
+	bool ok = false;
+	std::string error;      ///< Why the round trip failed, if it did.
+	size_t bytes = 0;
+	uint32_t hash = 0;
+	uint64_t captureUs = 0;
+	uint64_t restoreUs = 0;
+};
+/// Captures the state, lets the game run for the given number of ticks and captures it again, then restores the first
+/// snapshot and the second one in turn, checking that each restored state hashes identically to its snapshot. Calls
+/// done with the result, from snapshotUpdateRoundTrip().
+void snapshotRoundTripStart(unsigned ticks, std::function<void (SnapshotRoundTrip const &)> done);
+bool snapshotRoundTripIsRunning();
+/// Call after each game state update, to advance the round trip in progress, if any.
+void snapshotUpdateRoundTrip();
+/// A CRC of the whole snapshot.
+uint32_t snapshotHash(WorldSnapshot const &snapshot);
+/// A CRC of the sections which are the same on all clients, leaving out the scripts, which only run where they are
+/// responsible for a player, and the selections and other local state.
+uint32_t snapshotSynchronisedHash(WorldSnapshot const &snapshot);
+/// Lists the sections which differ, or returns an empty string if the snapshots are identical.
+std::string snapshotDiff(WorldSnapshot const &a, WorldSnapshot const &b);
+
+/// Interval between the keyframes saved in replays.
+#define SNAPSHOT_REPLAY_KEYFRAME_INTERVAL (60 * GAME_TICKS_PER_SEC)
+/// Call when starting a game, before the first snapshotUpdateReplayKeyframes().
+void snapshotResetReplayKeyframes();
+/// Call after each game state update. Saves a keyframe with a snapshot in the replay being recorded, or checks the
+/// state against the keyframe in the replay being played, if there is one at this gameTime.
+void snapshotUpdateReplayKeyframes();
+/// Restores the last keyframe of the replay being played at or before targetGameTime, so that seeking only simulates
+/// from there. Call before the first game tick. Returns false, leaving the game at the start, if there is no usable
+/// keyframe, for example in replays recorded by older versions, or by a client running different scripts.
+bool snapshotSeekReplay(uint32_t targetGameTime);
+/// The number of keyframes checked in the replay being played, and how many of them did not match.
+void snapshotGetReplayKeyframeStats(unsigned &checked, unsigned &diverged);
+
+#endif // __INCLUDED_SRC_SNAPSHOT_H__
@@ -0,0 +1,296 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Per-subsystem game state hashes, see statehash.h.
+ */
+
+#include "lib/framework/frame.h"
+#include "lib/gamelib/gtime.h"
+#include "lib/netplay/netplay.h"
+
+#include "statehash.h"
+#include "droid.h"
+#include "feature.h"
+#include "group.h"
+#include "multiplay.h"
+#include "power.h"
+#include "random.h"
+#include "research.h"
+#include "structure.h"
+
+#include <algorithm>
+#include <array>
+#include <deque>
+
+#define STATE_HASH_HISTORY 64  ///< Number of remembered hash vectors, must cover the maximum latency.
+
+typedef std::array<uint32_t, static_cast<size_t>(StateHashSubsystem::Count)> StateHashVector;
+
+struct StateHashEntry
+{
+	uint32_t gameTime;
+	StateHashVector hashes;
+};
+
+static const char *subsystemNames[static_cast<size_t>(StateHashSubsystem::Count)] = {
+	"random", "power", "research", "droids", "structures", "features"
+};
+
+static StateHashVector runningHashes;  ///< Hashes of everything up to the end of the last tick.
+static StateHashVector tickHashes;     ///< Objects updated in the current tick, combined with XOR, since the update order doesn't matter.
+static uint32_t researchHash = 0;      ///< XOR of the keys of all completed research.
+static std::deque<StateHashEntry> history;
+static bool pendingSend = false;
+static uint32_t reportedSubsystems[MAX_CONNECTED_PLAYERS];  ///< Only report the first divergence of each subsystem.
+
+static inline uint32_t rotl32(uint32_t value, unsigned bits)
+{
+	return value << bits | value >> (32 - bits);
+}
+
+/// MurmurHash3 mixing steps.
+static inline uint32_t hashCombine(uint32_t hash, uint32_t value)
+{
+	value *= 0xCC9E2D51;
+	value = rotl32(value, 15);
+	value *= 0x1B873593;
+	hash ^= value;
+	hash = rotl32(hash, 13);
+	return hash * 5 + 0xE6546B64;
+}
+
+static inline uint32_t hashFinish(uint32_t hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6B;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+static inline uint32_t hashObject(BASE_OBJECT const *psObj)
+{
+	uint32_t hash = hashCombine(psObj->type, psObj->id);
+	hash = hashCombine(hash, psObj->pos.x);
+	hash = hashCombine(hash, psObj->pos.y);
+	hash = hashCombine(hash, psObj->pos.z);
+	hash = hashCombine(hash, psObj->rot.direction | psObj->rot.pitch << 16);
+	hash = hashCombine(hash, psObj->rot.roll);
+	return hashCombine(hash, psObj->body);
+}
+
+static inline uint32_t researchKey(unsigned player, unsigned researchIndex)
+{
+	return hashFinish(hashCombine(hashCombine(0x52455345, player), researchIndex));
+}
+
+static inline uint32_t &tickHash(StateHashSubsystem subsystem)
+{
+	return tickHashes[static_cast<size_t>(subsystem)];
+}
+
+void stateHashReset()
+{
+	runningHashes.fill(0);
+	tickHashes.fill(0);
+	history.clear();
+	pendingSend = false;
+	std::fill(std::begin(reportedSubsystems), std::end(reportedSubsystems), 0);
+
+	researchHash = 0;
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (size_t index = 0; index < asPlayerResList[player].size(); ++index)
+		{
+			if (IsResearchCompleted(&asPlayerResList[player][index]))
+			{
+				researchHash ^= researchKey(player, index);
+			}
+		}
+	}
+}
+
+static inline uint32_t hashDroid(DROID const *psDroid)
+{
+	uint32_t hash = hashObject(psDroid);
+	hash = hashCombine(hash, psDroid->order.type);
+	hash = hashCombine(hash, psDroid->action);
+	return hashFinish(hash);
+}
+
+void stateHashDroid(DROID const *psDroid)
+{
+	tickHash(StateHashSubsystem::Droids) ^= hashDroid(psDroid);
+	if (isTransporter(psDroid) && psDroid->psGroup != nullptr)
+	{
+		// The cargo isn't in any droid list, so it is only hashed here.
+		for (DROID const *psCargo = psDroid->psGroup->psList; psCargo != nullptr; psCargo = psCargo->psGrpNext)
+		{
+			if (psCargo != psDroid)
+			{
+				tickHash(StateHashSubsystem::Droids) ^= hashDroid(psCargo);
+			}
+		}
+	}
+}
+
+void stateHashStructure(STRUCTURE const *psStructure)
+{
+	uint32_t hash = hashObject(psStructure);
+	hash = hashCombine(hash, psStructure->status);
+	hash = hashCombine(hash, psStructure->currentBuildPts);
+	tickHash(StateHashSubsystem::Structures) ^= hashFinish(hash);
+}
+
+void stateHashFeature(FEATURE const *psFeature)
+{
+	tickHash(StateHashSubsystem::Features) ^= hashFinish(hashObject(psFeature));
+}
+
+void stateHashResearchCompleted(unsigned player, unsigned researchIndex)
+{
+	researchHash ^= researchKey(player, researchIndex);
+}
+
+void stateHashTickEnd()
+{
+	tickHash(StateHashSubsystem::Random) = gameRandStateHash();
+	uint32_t power = 0;
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		uint64_t precisePower = getPrecisePower(player);
+		power = hashCombine(power, uint32_t(precisePower));
+		power = hashCombine(power, uint32_t(precisePower >> 32));
+	}
+	tickHash(StateHashSubsystem::Power) = power;
+
+	for (size_t subsystem = 0; subsystem < runningHashes.size(); ++subsystem)
+	{
+		runningHashes[subsystem] = hashFinish(hashCombine(runningHashes[subsystem], tickHashes[subsystem]));
+	}
+	runningHashes[static_cast<size_t>(StateHashSubsystem::Research)] = researchHash;
+	tickHashes.fill(0);
+
+	if (gameTime / GAME_TICKS_PER_UPDATE % STATE_HASH_INTERVAL != 0)
+	{
+		return;
+	}
+	history.push_back(StateHashEntry{gameTime, runningHashes});
+	if (history.size() > STATE_HASH_HISTORY)
+	{
+		history.pop_front();
+	}
+	pendingSend = true;
+}
+
+void sendStateHash()
+{
+	if (!pendingSend)
+	{
+		return;
+	}
+	pendingSend = false;
+	if (NETisReplay())
+	{
+		return;
+	}
+
+	StateHashEntry entry = history.back();
+	NETbeginEncode(NETgameQueue(selectedPlayer), GAME_STATE_HASH);
+	NETuint32_t(&entry.gameTime);
+	for (uint32_t &hash : entry.hashes)
+	{
+		NETuint32_t(&hash);
+	}
+	NETend();
+}
+
+bool recvStateHash(NETQUEUE queue)
+{
+	StateHashEntry received;
+	NETbeginDecode(queue, GAME_STATE_HASH);
+	NETuint32_t(&received.gameTime);
+	for (uint32_t &hash : received.hashes)
+	{
+		NETuint32_t(&hash);
+	}
+	NETend();
+
+	unsigned player = queue.index;
+	ASSERT_OR_RETURN(false, player < MAX_CONNECTED_PLAYERS, "Bad player %u", player);
+	if (player == selectedPlayer
+	    || !NetPlay.players[player].allocated
+	    || ingame.endTime.has_value()
+	    || (NetPlay.players[player].isSpectator && player != NetPlay.hostPlayer))
+	{
+		return true;  // Same conditions as for checking the GAME_GAME_TIME CRCs.
+	}
+
+	auto entry = std::find_if(history.begin(), history.end(), [&](StateHashEntry const &entry) { return entry.gameTime == received.gameTime; });
+	if (entry == history.end())
+	{
+		debug(LOG_NET, "No state hashes to compare with player %u's, from gameTime %u", player, received.gameTime);
+		return true;
+	}
+
+	uint32_t diverged = 0;
+	std::string names;
+	for (size_t subsystem = 0; subsystem < received.hashes.size(); ++subsystem)
+	{
+		if (received.hashes[subsystem] != entry->hashes[subsystem])
+		{
+			diverged |= 1 << subsystem;
+			names += names.empty() ? "" : ", ";
+			names += subsystemNames[subsystem];
+		}
+	}
+	if ((diverged & ~reportedSubsystems[player]) == 0)
+	{
+		return true;
+	}
+	reportedSubsystems[player] |= diverged;
+
+	debug(LOG_ERROR, "Game state of player %u diverged from ours by gameTime %u, in: %s", player, received.gameTime, names.c_str());
+	if (!NETisReplay())
+	{
+		NETsetPlayerConnectionStatus(CONNECTIONSTATUS_DESYNC, player);
+	}
+	return true;
+}
+
+uint32_t stateHashGet(StateHashSubsystem subsystem)
+{
+	return runningHashes[static_cast<size_t>(subsystem)];
+}
+
+const char *stateHashSubsystemName(StateHashSubsystem subsystem)
+{
+	return subsystemNames[static_cast<size_t>(subsystem)];
+}
+
+uint32_t stateHashDivergedSubsystems()
+{
+	uint32_t diverged = 0;
+	for (uint32_t reported : reportedSubsystems)
+	{
+		diverged |= reported;
+	}
+	return diverged;
+}
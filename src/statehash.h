@@ -0,0 +1,66 @@
+/*
+	This file is part of Warzone 2100.
+	Copyright (C) 2022  Warzone 2100 Project
+
+	Warzone 2100 is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	Warzone 2100 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Warzone 2100; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+/** @file
+ *  Per-subsystem game state hashes, for finding desyncs.
+ *
+ *  Each subsystem keeps a running hash, which is folded together from the objects as they are updated each tick, so it
+ *  costs no extra pass over the game state. Research is a Zobrist-style set hash, updated when research completes. The
+ *  hashes describe the whole history of the game, so once a client diverges, its hashes stay different. Every
+ *  STATE_HASH_INTERVAL ticks, each client sends its hashes as GAME_STATE_HASH, and the receivers compare them with their
+ *  own hashes for the same gameTime, which tells which subsystem diverged first, without needing the syncDebug logs.
+ */
+
+#ifndef __INCLUDED_SRC_STATEHASH_H__
+#define __INCLUDED_SRC_STATEHASH_H__
+
+#include "lib/netplay/nettypes.h"
+
+struct DROID;
+struct STRUCTURE;
+struct FEATURE;
+
+#define STATE_HASH_INTERVAL 10  ///< Number of ticks between hash exchanges.
+
+enum class StateHashSubsystem
+{
+	Random,
+	Power,
+	Research,
+	Droids,
+	Structures,
+	Features,
+	Count
+};
+
+void stateHashReset();  ///< Starts hashing the current game state, when a game starts.
+
+void stateHashDroid(DROID const *psDroid);              ///< Folds the droid and any cargo into this tick's hash, after updating it.
+void stateHashStructure(STRUCTURE const *psStructure);  ///< Folds the structure into this tick's hash, after updating it.
+void stateHashFeature(FEATURE const *psFeature);        ///< Folds the feature into this tick's hash, after updating it.
+void stateHashResearchCompleted(unsigned player, unsigned researchIndex);
+
+void stateHashTickEnd();  ///< Called at the end of gameStateUpdate(), remembers the hashes every STATE_HASH_INTERVAL ticks.
+void sendStateHash();     ///< Sends the hashes remembered at the end of the last tick, if any.
+bool recvStateHash(NETQUEUE queue);
+
+uint32_t stateHashGet(StateHashSubsystem subsystem);  ///< Hash of the subsystem up to the end of the last tick.
+const char *stateHashSubsystemName(StateHashSubsystem subsystem);
+uint32_t stateHashDivergedSubsystems();  ///< Bit mask of the subsystems in which any player has diverged from us.
+
+#endif // __INCLUDED_SRC_STATEHASH_H__
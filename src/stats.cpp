@@ -39,6 +39,7 @@
 #include "lib/sound/audio_id.h"
 #include "projectile.h"
 #include "text.h"
+#include "snapshot.h"
 #include <unordered_map>
 
 #define WEAPON_TIME		100
@@ -1793,3 +1794,114 @@ bool objRadarDetector(const BASE_OBJECT *psObj)
 	}
 	return false;
 }
+
+template<typename IO, typename STATS, typename Fn>
+static void statsSnapshotVisitComponents(IO &io, unsigned player, COMPONENT_TYPE type, STATS *asStats, unsigned numStats, Fn visitUpgrade)
+{
+	for (unsigned i = 0; i < numStats; ++i)
+	{
+		auto &upgrade = asStats[i].upgrade[player];
+		io(upgrade.hitpoints);
+		io(upgrade.hitpointPct);
+		visitUpgrade(upgrade);
+		io(apCompLists[player][type][i]);
+	}
+}
+
+template<typename IO>
+static void statsSnapshotVisit(IO &io)
+{
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		statsSnapshotVisitComponents(io, player, COMP_BODY, asBodyStats, numBodyStats, [&](decltype(BODY_STATS::base) &upgrade) {
+			io(upgrade.power);
+			io(upgrade.armour);
+			io(upgrade.thermal);
+			io(upgrade.resistance);
+		});
+		statsSnapshotVisitComponents(io, player, COMP_BRAIN, asBrainStats, numBrainStats, [&](decltype(BRAIN_STATS::base) &upgrade) {
+			io.values(upgrade.rankThresholds);
+			io(upgrade.maxDroids);
+			io(upgrade.maxDroidsMult);
+		});
+		statsSnapshotVisitComponents(io, player, COMP_PROPULSION, asPropulsionStats, numPropulsionStats, [&](decltype(PROPULSION_STATS::base) &upgrade) {
+			io(upgrade.hitpointPctOfBody);
+		});
+		statsSnapshotVisitComponents(io, player, COMP_REPAIRUNIT, asRepairStats, numRepairStats, [&](decltype(REPAIR_STATS::base) &upgrade) {
+			io(upgrade.repairPoints);
+		});
+		statsSnapshotVisitComponents(io, player, COMP_ECM, asECMStats, numECMStats, [&](decltype(ECM_STATS::base) &upgrade) {
+			io(upgrade.range);
+		});
+		statsSnapshotVisitComponents(io, player, COMP_SENSOR, asSensorStats, numSensorStats, [&](decltype(SENSOR_STATS::base) &upgrade) {
+			io(upgrade.range);
+		});
+		statsSnapshotVisitComponents(io, player, COMP_CONSTRUCT, asConstructStats, numConstructStats, [&](decltype(CONSTRUCT_STATS::base) &upgrade) {
+			io(upgrade.constructPoints);
+		});
+		statsSnapshotVisitComponents(io, player, COMP_WEAPON, asWeaponStats, numWeaponStats, [&](decltype(WEAPON_STATS::base) &upgrade) {
+			io(upgrade.shortRange);
+			io(upgrade.maxRange);
+			io(upgrade.minRange);
+			io(upgrade.hitChance);
+			io(upgrade.shortHitChance);
+			io(upgrade.firePause);
+			io(upgrade.numRounds);
+			io(upgrade.reloadTime);
+			io(upgrade.damage);
+			io(upgrade.radius);
+			io(upgrade.radiusDamage);
+			io(upgrade.periodicalDamage);
+			io(upgrade.periodicalDamageRadius);
+			io(upgrade.periodicalDamageTime);
+			io(upgrade.minimumDamage);
+		});
+	}
+}
+
+static void statsSnapshotCounts(unsigned counts[COMP_NUMCOMPONENTS])
+{
+	counts[COMP_BODY] = numBodyStats;
+	counts[COMP_BRAIN] = numBrainStats;
+	counts[COMP_PROPULSION] = numPropulsionStats;
+	counts[COMP_REPAIRUNIT] = numRepairStats;
+	counts[COMP_ECM] = numECMStats;
+	counts[COMP_SENSOR] = numSensorStats;
+	counts[COMP_CONSTRUCT] = numConstructStats;
+	counts[COMP_WEAPON] = numWeaponStats;
+}
+
+void statsSnapshotWrite(SnapshotWriter &writer)
+{
+	unsigned counts[COMP_NUMCOMPONENTS];
+	statsSnapshotCounts(counts);
+	for (unsigned count : counts)
+	{
+		writer.u32(count);
+	}
+	SnapshotOut out(writer);
+	statsSnapshotVisit(out);
+}
+
+bool statsSnapshotRead(SnapshotReader &reader)
+{
+	unsigned counts[COMP_NUMCOMPONENTS];
+	statsSnapshotCounts(counts);
+	for (unsigned count : counts)
+	{
+		if (reader.u32() != count)
+		{
+			return false;
+		}
+	}
+	SnapshotReader check = reader;
+	SnapshotIn dryRun(check, false);
+	statsSnapshotVisit(dryRun);
+	if (!check.valid())
+	{
+		return false;
+	}
+	SnapshotIn in(reader);
+	statsSnapshotVisit(in);
+	return reader.valid();
+}
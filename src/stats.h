@@ -244,4 +244,11 @@ WZ_DECL_PURE SENSOR_STATS *objActiveRadar(const BASE_OBJECT *psObj);
 /** Returns whether object has a radar detector sensor. */
 WZ_DECL_PURE bool objRadarDetector(const BASE_OBJECT *psObj);
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/// Saves and restores the component upgrades and which components each player has, see snapshot.h.
+void statsSnapshotWrite(SnapshotWriter &writer);
+bool statsSnapshotRead(SnapshotReader &reader);
+
 #endif // __INCLUDED_SRC_STATS_H__
@@ -25,6 +25,7 @@
 #include "multiint.h"
 #include "multilobbycommands.h"
 #include "clparse.h"
+#include "hosttelemetry.h"
 
 #include <string>
 #include <atomic>
@@ -347,6 +348,27 @@ int stdinThreadFunc(void *)
 				});
 			}
 		}
+		else if(!strncmpl(line, "telemetry every "))
+		{
+			unsigned seconds = 0;
+			int r = sscanf(line, "telemetry every %u", &seconds);
+			if (r != 1)
+			{
+				errlog("WZCMD error: Failed to get telemetry interval! (Expecting a number of seconds)\n");
+			}
+			else
+			{
+				wzAsyncExecOnMainThread([seconds] {
+					hostTelemetrySetInterval(seconds);
+				});
+			}
+		}
+		else if(!strncmpl(line, "telemetry"))
+		{
+			wzAsyncExecOnMainThread([] {
+				hostTelemetryOutput();
+			});
+		}
 		else if(!strncmpl(line, "shutdown now"))
 		{
 			errlog("WZCMD info: shutdown now command received - shutting down\n");
@@ -467,3 +489,12 @@ void wz_command_interface_output(const char *str, ...)
 	fflush(stderr);
 }
 
+void wz_command_interface_output_str(const char *str)
+{
+	if (wz_command_interface() == WZ_Command_Interface::None)
+	{
+		return;
+	}
+	fwrite(str, sizeof(char), strlen(str), stderr);
+	fflush(stderr);
+}
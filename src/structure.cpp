@@ -80,7 +80,9 @@
 #include "gateway.h"
 
 #include "random.h"
+#include "snapshot.h"
 #include <functional>
+#include <map>
 #include <unordered_map>
 
 //Maximium slope of the terrain for building a structure
@@ -871,6 +873,7 @@ void structureBuild(STRUCTURE *psStruct, DROID *psDroid, int buildPoints, int bu
 	int deltaBody = quantiseFraction(9 * structureBody(psStruct), 10 * structureBuildPointsToCompletion(*psStruct), newBuildPoints, psStruct->currentBuildPts);
 	psStruct->currentBuildPts = newBuildPoints;
 	psStruct->body = std::max<int>(psStruct->body + deltaBody, 1);
+	structureWake(psStruct);
 
 	//check if structure is built
 	if (buildPoints > 0 && psStruct->currentBuildPts >= structureBuildPointsToCompletion(*psStruct))
@@ -989,6 +992,7 @@ void structureRepair(STRUCTURE *psStruct, DROID *psDroid, int buildRate)
 		and notify the caller (read: droid) of your idleness by returning false.
 	*/
 	psStruct->body = clip<UDWORD>(psStruct->body + repairAmount, 0, structureBody(psStruct));
+	structureWake(psStruct);
 }
 
 static void refundFactoryBuildPower(STRUCTURE *psBuilding)
@@ -1537,6 +1541,7 @@ STRUCTURE *buildStructureDir(STRUCTURE_STATS *pStructureType, UDWORD x, UDWORD y
 
 		psBuilding->status = SS_BEING_BUILT;
 		psBuilding->currentBuildPts = 0;
+		structureWake(psBuilding);
 
 		alignStructure(psBuilding);
 
@@ -1800,6 +1805,7 @@ STRUCTURE *buildStructureDir(STRUCTURE_STATS *pStructureType, UDWORD x, UDWORD y
 			//start building again
 			psBuilding->status = SS_BEING_BUILT;
 			psBuilding->buildRate = 1;  // Don't abandon the structure first tick, so set to nonzero.
+			structureWake(psBuilding);
 
 			if (!FromSave)
 			{
@@ -2592,6 +2598,81 @@ int getMaxConstructors(UDWORD player)
 	return constructorLimit[player];
 }
 
+template<typename IO>
+static void structureSnapshotVisit(IO &io)
+{
+	for (unsigned player = 0; player < MAX_PLAYERS; ++player)
+	{
+		for (unsigned i = 0; i < numStructureStats; ++i)
+		{
+			auto &upgrade = asStructureStats[i].upgrade[player];
+			unsigned *fields[] = {&upgrade.research, &upgrade.moduleResearch, &upgrade.repair, &upgrade.power, &upgrade.modulePower,
+			                      &upgrade.production, &upgrade.moduleProduction, &upgrade.rearm, &upgrade.armour, &upgrade.thermal,
+			                      &upgrade.hitpoints, &upgrade.resistance, &upgrade.limit};
+			for (unsigned *field : fields)
+			{
+				io(*field);
+			}
+			io(apStructTypeLists[player][i]);
+		}
+		io(droidLimit[player]);
+		io(commanderLimit[player]);
+		io(constructorLimit[player]);
+		io(satUplinkExists[player]);
+		io(lasSatExists[player]);
+	}
+}
+
+void structureSnapshotWrite(SnapshotWriter &writer)
+{
+	writer.u32(numStructureStats);
+	SnapshotOut out(writer);
+	structureSnapshotVisit(out);
+	for (auto const &modules : moduleToBuilding)
+	{
+		std::map<UDWORD, UDWORD> sorted(modules.begin(), modules.end());
+		writer.u32(static_cast<uint32_t>(sorted.size()));
+		for (auto const &module : sorted)
+		{
+			writer.u32(module.first);
+			writer.u32(module.second);
+		}
+	}
+}
+
+bool structureSnapshotRead(SnapshotReader &reader)
+{
+	if (reader.u32() != numStructureStats)
+	{
+		return false;
+	}
+	SnapshotReader check = reader;
+	SnapshotIn dryRun(check, false);
+	structureSnapshotVisit(dryRun);
+	std::unordered_map<UDWORD, UDWORD> modules[MAX_PLAYER_SLOTS];
+	for (auto &playerModules : modules)
+	{
+		uint32_t count = check.u32();
+		for (uint32_t n = 0; n < count && check.valid(); ++n)
+		{
+			uint32_t module = check.u32();
+			playerModules[module] = check.u32();
+		}
+	}
+	if (!check.valid())
+	{
+		return false;
+	}
+	SnapshotIn in(reader);
+	structureSnapshotVisit(in);
+	reader = check;
+	for (unsigned player = 0; player < MAX_PLAYER_SLOTS; ++player)
+	{
+		moduleToBuilding[player] = std::move(modules[player]);
+	}
+	return true;
+}
+
 bool IsPlayerDroidLimitReached(int player)
 {
 	int numDroids = getNumDroids(player) + getNumMissionDroids(player) + getNumTransporterDroids(player);
@@ -3500,6 +3581,31 @@ int gateCurrentOpenHeight(const STRUCTURE *psStructure, uint32_t time, int minim
 }
 
 /* The main update routine for all Structures */
+// Check whether structureUpdate() has nothing to do for a structure, until something happens to it.
+// Only structures without weapons, sensor turrets or any functionality can sleep, such as walls and tank traps.
+static bool structureCanSleep(const STRUCTURE *psBuilding)
+{
+	switch (psBuilding->pStructureType->type)
+	{
+	case REF_WALL:
+	case REF_WALLCORNER:
+	case REF_DEFENSE:
+	case REF_GENERIC:
+		break;
+	default:
+		return false;
+	}
+
+	return psBuilding->status == SS_BUILT
+	       && psBuilding->numWeaps == 0
+	       && (psBuilding->pStructureType->pSensor == nullptr || psBuilding->pStructureType->pSensor->location != LOC_TURRET)
+	       && !psBuilding->flags.test(OBJECT_FLAG_DIRTY)
+	       && psBuilding->buildRate == 0 && psBuilding->lastBuildRate == 0
+	       && psBuilding->periodicalDamageStart == 0
+	       && psBuilding->resistance >= (int)structureResistance(psBuilding->pStructureType, psBuilding->player)
+	       && psBuilding->body >= structureBody(psBuilding);
+}
+
 void structureUpdate(STRUCTURE *psBuilding, bool bMission)
 {
 	UDWORD widthScatter, breadthScatter;
@@ -3747,6 +3853,8 @@ void structureUpdate(STRUCTURE *psBuilding, bool bMission)
 		}
 	}
 
+	psBuilding->asleep = structureCanSleep(psBuilding);
+
 	syncDebugStructure(psBuilding, '>');
 
 	CHECK_STRUCTURE(psBuilding);
@@ -5482,6 +5590,7 @@ bool electronicDamage(BASE_OBJECT *psTarget, UDWORD damage, UBYTE attackPlayer)
 			triggerEventAttacked(psStructure, g_pProjLastAttacker, lastHit);
 
 			psStructure->resistance = (SWORD)(psStructure->resistance - damage);
+			structureWake(psStructure);
 
 			if (psStructure->resistance < 0)
 			{
@@ -6982,7 +7091,7 @@ bool writeFavoriteStructsFile(const char* path)
 	}
 	root["favoriteStructures"] = std::move(structsArray);
 
-	return saveJSONToFile(root, path);
+	return saveJSONToFile(std::move(root), path);
 }
 
 static void parseFavoriteStructs()
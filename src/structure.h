@@ -79,6 +79,13 @@ void setMaxDroids(UDWORD player, int value);
 void setMaxCommanders(UDWORD player, int value);
 void setMaxConstructors(UDWORD player, int value);
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/// Saves and restores the structure upgrades, which structures each player can build, and the unit limits, see snapshot.h.
+void structureSnapshotWrite(SnapshotWriter &writer);
+bool structureSnapshotRead(SnapshotReader &reader);
+
 bool structureExists(int player, STRUCTURE_TYPE type, bool built, bool isMission);
 
 bool IsPlayerDroidLimitReached(int player);
@@ -110,6 +117,12 @@ STRUCTURE *buildBlueprint(STRUCTURE_STATS const *psStats, Vector3i xy, uint16_t
 /* The main update routine for all Structures */
 void structureUpdate(STRUCTURE *psBuilding, bool bMission);
 
+/// Make structureUpdate() be called for the structure again. Must be called whenever something happens to a structure which might be asleep.
+static inline void structureWake(STRUCTURE *psBuilding)
+{
+	psBuilding->asleep = false;
+}
+
 /* Remove a structure and free it's memory */
 bool destroyStruct(STRUCTURE *psDel, unsigned impactTime);
 
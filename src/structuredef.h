@@ -304,6 +304,7 @@ struct STRUCTURE : public BASE_OBJECT
 	STRUCT_ANIM_STATES	state;
 	UDWORD lastStateTime;
 	iIMDShape *prebuiltImd;
+	bool asleep = false;             ///< Nothing for structureUpdate() to do, until woken up by structureWake()
 
 	inline Vector2i size() const { return pStructureType->size(rot.direction); }
 };
@@ -31,6 +31,7 @@
 #include "lib/ivis_opengl/ivisdef.h"
 
 #include <limits>
+#include <memory>
 
 #include "visibility.h"
 
@@ -47,6 +48,7 @@
 #include "display.h"
 #include "multiplay.h"
 #include "qtscript.h"
+#include "snapshot.h"
 #include "wavecast.h"
 
 // accuracy for the height gradient
@@ -67,6 +69,9 @@ public:
 	{
 		id = generateSynchronisedObjectId();
 	}
+	SPOTTER(uint32_t id, Position pos, int plr, int radius, int type, uint32_t expiry)
+		: pos(pos), player(plr), sensorRadius(radius), sensorType(type), expiryTime(expiry), numWatchedTiles(0), watchedTiles(nullptr), id(id)
+	{}
 	~SPOTTER();
 
 	Position pos;
@@ -94,9 +99,6 @@ struct VisibleObjectHelp_t
 	Vector2i wall; // The position of a wall if it is on the LOS
 };
 
-static int *gNumWalls = nullptr;
-static Vector2i *gWall = nullptr;
-
 // forward declarations
 static void setSeenBy(BASE_OBJECT *psObj, unsigned viewer, int val);
 
@@ -187,6 +189,80 @@ void removeSpotters()
 	}
 }
 
+void visSnapshotWrite(SnapshotWriter &writer)
+{
+	writer.u32(static_cast<uint32_t>(apsInvisibleViewers.size()));
+	for (SPOTTER const *psSpot : apsInvisibleViewers)
+	{
+		writer.u32(psSpot->id);
+		writer.i32(psSpot->pos.x);
+		writer.i32(psSpot->pos.y);
+		writer.i32(psSpot->pos.z);
+		writer.i32(psSpot->player);
+		writer.i32(psSpot->sensorRadius);
+		writer.i32(psSpot->sensorType);
+		writer.u32(psSpot->expiryTime);
+		writer.u32(psSpot->numWatchedTiles);
+		for (int i = 0; i < psSpot->numWatchedTiles; ++i)
+		{
+			writer.bytes(&psSpot->watchedTiles[i], sizeof(TILEPOS));
+		}
+	}
+}
+
+bool visSnapshotRead(SnapshotReader &reader)
+{
+	std::vector<std::unique_ptr<SPOTTER>> read;
+	auto fail = [&read]() {
+		for (auto &psSpot : read)
+		{
+			psSpot->numWatchedTiles = 0;  // The tiles don't count these.
+		}
+		return false;
+	};
+	uint32_t count = reader.u32();
+	for (uint32_t n = 0; n < count && reader.valid(); ++n)
+	{
+		uint32_t id = reader.u32();
+		Position pos;
+		pos.x = reader.i32();
+		pos.y = reader.i32();
+		pos.z = reader.i32();
+		int player = reader.i32();
+		int radius = reader.i32();
+		int type = reader.i32();
+		uint32_t expiry = reader.u32();
+		read.emplace_back(new SPOTTER(id, pos, player, radius, type, expiry));
+		uint32_t numWatchedTiles = reader.u32();
+		if (!reader.valid() || numWatchedTiles > static_cast<uint32_t>(mapWidth * mapHeight))
+		{
+			return fail();
+		}
+		SPOTTER *psSpot = read.back().get();
+		psSpot->watchedTiles = (TILEPOS *)malloc(std::max<uint32_t>(numWatchedTiles, 1) * sizeof(*psSpot->watchedTiles));
+		for (uint32_t i = 0; i < numWatchedTiles && reader.bytes(&psSpot->watchedTiles[i], sizeof(TILEPOS)); ++i)
+		{
+			psSpot->numWatchedTiles = i + 1;
+		}
+	}
+	if (!reader.valid())
+	{
+		return fail();
+	}
+	// The watcher counts of the tiles are restored with the map, so the old spotters must not change them.
+	for (SPOTTER *psSpot : apsInvisibleViewers)
+	{
+		psSpot->numWatchedTiles = 0;
+		delete psSpot;
+	}
+	apsInvisibleViewers.clear();
+	for (auto &psSpot : read)
+	{
+		apsInvisibleViewers.push_back(psSpot.release());
+	}
+	return true;
+}
+
 static void updateSpotters()
 {
 	static GridList gridList;  // static to avoid allocations.
@@ -473,13 +549,10 @@ void revealAll(UBYTE player)
 	//the objects gets revealed in processVisibility()
 }
 
-/* Check whether psViewer can see psTarget.
- * psViewer should be an object that has some form of sensor,
- * currently droids and structures.
- * psTarget can be any type of BASE_OBJECT (e.g. a tree).
- * wallsBlock controls whether structures block LOS
+/* Same as visibleObject(), but also returns the wall (if any) blocking the LOS, if numWalls and wall are not null.
+ * Does not modify any global state, so can be called from several threads at once.
  */
-int visibleObject(const BASE_OBJECT *psViewer, const BASE_OBJECT *psTarget, bool wallsBlock)
+static int visibleObjectWalls(const BASE_OBJECT *psViewer, const BASE_OBJECT *psTarget, bool wallsBlock, int *numWalls, Vector2i *wall)
 {
 	ASSERT_OR_RETURN(0, psViewer != nullptr, "Invalid viewer pointer!");
 	ASSERT_OR_RETURN(0, psTarget != nullptr, "Invalid viewed pointer!");
@@ -578,10 +651,10 @@ int visibleObject(const BASE_OBJECT *psViewer, const BASE_OBJECT *psTarget, bool
 	// Cast a ray from the viewer to the target
 	rayCast(psViewer->pos.xy(), psTarget->pos.xy(), rayLOSCallback, &help);
 
-	if (gWall != nullptr && gNumWalls != nullptr) // Out globals are set
+	if (wall != nullptr && numWalls != nullptr)
 	{
-		*gWall = help.wall;
-		*gNumWalls = help.numWalls;
+		*wall = help.wall;
+		*numWalls = help.numWalls;
 	}
 
 	bool tileWatched = psTile->watchers[psViewer->player] > 0;
@@ -609,20 +682,24 @@ int visibleObject(const BASE_OBJECT *psViewer, const BASE_OBJECT *psTarget, bool
 	return 0;
 }
 
+/* Check whether psViewer can see psTarget.
+ * psViewer should be an object that has some form of sensor,
+ * currently droids and structures.
+ * psTarget can be any type of BASE_OBJECT (e.g. a tree).
+ * wallsBlock controls whether structures block LOS
+ */
+int visibleObject(const BASE_OBJECT *psViewer, const BASE_OBJECT *psTarget, bool wallsBlock)
+{
+	return visibleObjectWalls(psViewer, psTarget, wallsBlock, nullptr, nullptr);
+}
+
 // Find the wall that is blocking LOS to a target (if any)
 STRUCTURE *visGetBlockingWall(const BASE_OBJECT *psViewer, const BASE_OBJECT *psTarget)
 {
 	int numWalls = 0;
 	Vector2i wall;
 
-	// HACK Using globals to not clutter visibleObject() interface too much
-	gNumWalls = &numWalls;
-	gWall = &wall;
-
-	visibleObject(psViewer, psTarget, true);
-
-	gNumWalls = nullptr;
-	gWall = nullptr;
+	visibleObjectWalls(psViewer, psTarget, true, &numWalls, &wall);
 
 	// see if there was a wall in the way
 	if (numWalls > 0)
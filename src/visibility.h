@@ -116,4 +116,11 @@ void removeSpotters();
 bool removeSpotter(uint32_t id);
 uint32_t addSpotter(int x, int y, int player, int radius, bool radar, uint32_t expiry = 0);
 
+class SnapshotWriter;
+class SnapshotReader;
+
+/// Saves and restores the spotters added by scripts, see snapshot.h.
+void visSnapshotWrite(SnapshotWriter &writer);
+bool visSnapshotRead(SnapshotReader &reader);
+
 #endif // __INCLUDED_SRC_VISIBILITY__
@@ -77,6 +77,8 @@
 #include "chat.h"
 #include "scores.h"
 #include "data.h"
+#include "replaybench.h"
+#include "snapshot.h"
 
 #include <list>
 
@@ -599,6 +601,7 @@ bool wzapi::setHealth(WZAPI_PARAMS(BASE_OBJECT* psObject, int health)) MULTIPLAY
 		STRUCTURE *psStruct = (STRUCTURE *)psObject;
 		SCRIPT_ASSERT(false, context, psStruct, "No such structure id %d belonging to player %d", id, player);
 		psStruct->body = health * MAX(1, structureBody(psStruct)) / 100;
+		structureWake(psStruct);
 	}
 	else
 	{
@@ -1210,12 +1213,11 @@ wzapi::researchResults wzapi::enumResearch(WZAPI_NO_PARAMS)
 	researchResults result;
 	int player = context.player();
 	SCRIPT_ASSERT_PLAYER({}, context, player);
-	for (int i = 0; i < asResearch.size(); i++)
+	for (uint16_t i : availableResearchList(player, ModeQueue))
 	{
-		RESEARCH *psResearch = &asResearch[i];
-		if (!IsResearchCompleted(&asPlayerResList[player][i]) && researchAvailable(i, player, ModeQueue))
+		if (!IsResearchCompleted(&asPlayerResList[player][i]))
 		{
-			result.resList.push_back(psResearch);
+			result.resList.push_back(&asResearch[i]);
 		}
 	}
 	result.player = player;
@@ -2402,6 +2404,10 @@ bool wzapi::gameOverMessage(WZAPI_PARAMS(bool gameWon, optional<bool> _showBackD
 		}
 		wzQuit(0); // Trigger a *graceful* shutdown
 	}
+	else if (replayBenchIsRunning())
+	{
+		replayBenchFinish(true);
+	}
 	else if (headlessGameMode())
 	{
 		debug(LOG_WARNING, "Headless game completed successfully!");
@@ -3294,35 +3300,173 @@ bool wzapi::transformPlayerToSpectator(WZAPI_PARAMS(int player))
 	return makePlayerSpectator(static_cast<uint32_t>(player), false, false);
 }
 
-// flag all droids as requiring update on next frame
-static void dirtyAllDroids(int player)
+// Upgrades waiting to be applied to the objects of a player by wzapi::applyPendingUpgrades().
+// Research results often upgrade dozens of components at once, so instead of going through all droids
+// for each upgraded component, remember the components and go through the droids once per tick.
+struct PendingUpgrades
+{
+	std::vector<bool> components[COMP_NUMCOMPONENTS];  ///< Indexed by component index, true if upgraded.
+	bool droids = false;                               ///< Whether any components were upgraded.
+	bool structures = false;
+};
+static PendingUpgrades pendingUpgrades[MAX_PLAYERS];
+
+// flag all droids using the component as requiring update on next frame
+static void dirtyAllDroids(int player, int type, unsigned index)
+{
+	ASSERT_OR_RETURN(, player >= 0 && player < MAX_PLAYERS && type >= 0 && type < COMP_NUMCOMPONENTS, "Bad player %d or component type %d", player, type);
+	std::vector<bool> &components = pendingUpgrades[player].components[type];
+	if (components.size() <= index)
+	{
+		components.resize(index + 1, false);
+	}
+	components[index] = true;
+	pendingUpgrades[player].droids = true;
+}
+
+static void dirtyAllStructures(int player)
+{
+	ASSERT_OR_RETURN(, player >= 0 && player < MAX_PLAYERS, "Bad player %d", player);
+	pendingUpgrades[player].structures = true;
+}
+
+static bool droidHasUpgradedComponent(const DROID *psDroid, const PendingUpgrades &pending)
 {
-	for (DROID *psDroid = apsDroidLists[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+	for (int type = 0; type < COMP_NUMCOMPONENTS; ++type)
 	{
-		psDroid->flags.set(OBJECT_FLAG_DIRTY);
+		const std::vector<bool> &components = pending.components[type];
+		if (components.empty())
+		{
+			continue;
+		}
+		if (type == COMP_WEAPON)
+		{
+			for (unsigned i = 0; i < psDroid->numWeaps; ++i)
+			{
+				if (psDroid->asWeaps[i].nStat < components.size() && components[psDroid->asWeaps[i].nStat])
+				{
+					return true;
+				}
+			}
+		}
+		else if (psDroid->asBits[type] < components.size() && components[psDroid->asBits[type]])
+		{
+			return true;
+		}
 	}
-	for (DROID *psDroid = mission.apsDroidLists[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+	return false;
+}
+
+// Droids loaded in a transporter are not in any droid list, they are upgraded along with their transporter.
+static bool transporterHasUpgradedCargo(const DROID *psTransporter, const PendingUpgrades &pending)
+{
+	if (!isTransporter(psTransporter) || psTransporter->psGroup == nullptr)
 	{
-		psDroid->flags.set(OBJECT_FLAG_DIRTY);
+		return false;
 	}
-	for (DROID *psDroid = apsLimboDroids[player]; psDroid != nullptr; psDroid = psDroid->psNext)
+	for (const DROID *psCurr = psTransporter->psGroup->psList; psCurr != nullptr; psCurr = psCurr->psGrpNext)
 	{
-		psDroid->flags.set(OBJECT_FLAG_DIRTY);
+		if (psCurr != psTransporter && droidHasUpgradedComponent(psCurr, pending))
+		{
+			return true;
+		}
 	}
+	return false;
 }
 
-static void dirtyAllStructures(int player)
+static void dirtyUpgradedDroids(DROID *psList, const PendingUpgrades &pending)
 {
-	for (STRUCTURE *psCurr = apsStructLists[player]; psCurr; psCurr = psCurr->psNext)
+	for (DROID *psDroid = psList; psDroid != nullptr; psDroid = psDroid->psNext)
 	{
-		psCurr->flags.set(OBJECT_FLAG_DIRTY);
+		if (droidHasUpgradedComponent(psDroid, pending) || transporterHasUpgradedCargo(psDroid, pending))
+		{
+			psDroid->flags.set(OBJECT_FLAG_DIRTY);
+		}
 	}
-	for (STRUCTURE *psCurr = mission.apsStructLists[player]; psCurr; psCurr = psCurr->psNext)
+}
+
+void wzapi::applyPendingUpgrades()
+{
+	for (int player = 0; player < MAX_PLAYERS; ++player)
 	{
-		psCurr->flags.set(OBJECT_FLAG_DIRTY);
+		PendingUpgrades &pending = pendingUpgrades[player];
+		if (pending.droids)
+		{
+			dirtyUpgradedDroids(apsDroidLists[player], pending);
+			dirtyUpgradedDroids(mission.apsDroidLists[player], pending);
+			dirtyUpgradedDroids(apsLimboDroids[player], pending);
+		}
+		if (pending.structures)
+		{
+			for (STRUCTURE *psCurr = apsStructLists[player]; psCurr; psCurr = psCurr->psNext)
+			{
+				psCurr->flags.set(OBJECT_FLAG_DIRTY);
+				structureWake(psCurr);
+			}
+			for (STRUCTURE *psCurr = mission.apsStructLists[player]; psCurr; psCurr = psCurr->psNext)
+			{
+				psCurr->flags.set(OBJECT_FLAG_DIRTY);
+				structureWake(psCurr);
+			}
+		}
+		for (std::vector<bool> &components : pending.components)
+		{
+			components.clear();
+		}
+		pending.droids = false;
+		pending.structures = false;
+	}
+}
+
+void wzapi::clearPendingUpgrades()
+{
+	for (PendingUpgrades &pending : pendingUpgrades)
+	{
+		pending = PendingUpgrades();
 	}
 }
 
+void wzapi::pendingUpgradesSnapshotWrite(SnapshotWriter &writer)
+{
+	for (PendingUpgrades const &pending : pendingUpgrades)
+	{
+		for (std::vector<bool> const &components : pending.components)
+		{
+			writer.u32(static_cast<uint32_t>(components.size()));
+			for (bool upgraded : components)
+			{
+				writer.u8(upgraded);
+			}
+		}
+		writer.u8(pending.droids);
+		writer.u8(pending.structures);
+	}
+}
+
+bool wzapi::pendingUpgradesSnapshotRead(SnapshotReader &reader)
+{
+	PendingUpgrades read[MAX_PLAYERS];
+	for (PendingUpgrades &pending : read)
+	{
+		for (std::vector<bool> &components : pending.components)
+		{
+			uint32_t count = reader.u32();
+			for (uint32_t n = 0; n < count && reader.valid(); ++n)
+			{
+				components.push_back(reader.u8() != 0);
+			}
+		}
+		pending.droids = reader.u8() != 0;
+		pending.structures = reader.u8() != 0;
+	}
+	if (!reader.valid())
+	{
+		return false;
+	}
+	std::move(read, read + MAX_PLAYERS, pendingUpgrades);
+	return true;
+}
+
 enum Scrcb {
 	SCRCB_FIRST = COMP_NUMCOMPONENTS,
 	SCRCB_RES = SCRCB_FIRST,  // Research upgrade
@@ -3352,12 +3496,12 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "Armour")
 		{
@@ -3370,7 +3514,7 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		else if (name == "Power")
 		{
 			psStats->upgrade[player].power = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "Resistance")
 		{
@@ -3408,12 +3552,12 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		else if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else
 		{
@@ -3427,18 +3571,18 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		if (name == "Range")
 		{
 			psStats->upgrade[player].range = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 			dirtyAllStructures(player);
 		}
 		else if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else
 		{
@@ -3452,18 +3596,18 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		if (name == "Range")
 		{
 			psStats->upgrade[player].range = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 			dirtyAllStructures(player);
 		}
 		else if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else
 		{
@@ -3477,17 +3621,17 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPctOfBody")
 		{
 			psStats->upgrade[player].hitpointPctOfBody = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else
 		{
@@ -3505,12 +3649,12 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		else if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else
 		{
@@ -3528,12 +3672,12 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		else if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else
 		{
@@ -3607,12 +3751,12 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 		else if (name == "HitPoints")
 		{
 			psStats->upgrade[player].hitpoints = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else if (name == "HitPointPct")
 		{
 			psStats->upgrade[player].hitpointPct = value;
-			dirtyAllDroids(player);
+			dirtyAllDroids(player, type, index);
 		}
 		else
 		{
@@ -3642,6 +3786,7 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 			{
 				if (psStats == psCurr->pStructureType && psStats->upgrade[player].resistance < value)
 				{
+					structureWake(psCurr);
 					psCurr->resistance = value;
 				}
 			}
@@ -3649,6 +3794,7 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 			{
 				if (psStats == psCurr->pStructureType && psStats->upgrade[player].resistance < value)
 				{
+					structureWake(psCurr);
 					psCurr->resistance = value;
 				}
 			}
@@ -3662,6 +3808,7 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 			{
 				if (psStats == psCurr->pStructureType && psStats->upgrade[player].hitpoints < value)
 				{
+					structureWake(psCurr);
 					psCurr->body = (psCurr->body * value) / psStats->upgrade[player].hitpoints;
 				}
 			}
@@ -3669,6 +3816,7 @@ bool wzapi::setUpgradeStats(WZAPI_BASE_PARAMS(int player, const std::string& nam
 			{
 				if (psStats == psCurr->pStructureType && psStats->upgrade[player].hitpoints < value)
 				{
+					structureWake(psCurr);
 					psCurr->body = (psCurr->body * value) / psStats->upgrade[player].hitpoints;
 				}
 			}
@@ -66,6 +66,9 @@ using nonstd::nullopt;
 #include <memory>
 #include <functional>
 
+class SnapshotWriter;
+class SnapshotReader;
+
 typedef uint64_t uniqueTimerID;
 class timerAdditionalData
 {
@@ -1108,6 +1111,14 @@ namespace wzapi
 	nlohmann::json constructStaticPlayerData();
 	std::vector<PerPlayerUpgrades> getUpgradesObject();
 	nlohmann::json constructMapTilesArray();
+
+	/// Mark the objects affected by setUpgradeStats() calls since the last call as needing update. Called once per game tick.
+	void applyPendingUpgrades();
+	/// Forget the objects waiting for applyPendingUpgrades(), when the game shuts down.
+	void clearPendingUpgrades();
+	/// Saves and restores the objects waiting for applyPendingUpgrades(), see snapshot.h.
+	void pendingUpgradesSnapshotWrite(SnapshotWriter &writer);
+	bool pendingUpgradesSnapshotRead(SnapshotReader &reader);
 }
 
 #endif